@@ -0,0 +1,366 @@
+/*
+ * =========================================================================
+ * batch.c - Routines to convert many SDTS transfers at once.
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * sdts2dem and sdts2dlg normally convert a single SDTS transfer.
+ * Converting a whole state's worth of transfers that way means running
+ * the program thousands of times.  In batch mode (the -b option), they
+ * instead take any number of transfers, directories of transfers, and
+ * lists of transfers, and convert them all, several at a time.
+ *
+ * batch_add() and batch_add_list() build up the list of transfers.
+ * A transfer is named by its ????CEL?.DDF or ????LE??.DDF file (which
+ * may be gzip-compressed), or by a tar archive that holds it.  A directory
+ * is searched, along with all of its subdirectories, for such files, since
+ * the usual practice is to unpack each transfer into its own directory.
+ *
+ * batch_run() then converts the transfers.  As in drawmap's -j option,
+ * each transfer is converted in a separate child process, and at most
+ * num_jobs children run at once.  The conversion code has a lot of global
+ * state, and it calls exit() whenever something goes wrong, so separate
+ * processes are much the simplest way to run conversions side by side,
+ * and they also keep a bad transfer from taking the others down with it.
+ *
+ * A child that finishes its conversion calls _exit(0).  If the conversion
+ * code calls exit() instead, which it only does when something has gone
+ * wrong, batch_failed() turns that into an exit status of 1.  The parent
+ * reports each transfer on stderr as it finishes, along with the time
+ * it took, and whether it failed.
+ */
+
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include "drawmap.h"
+
+
+static char **batch_names = (char **)0;
+static int32_t batch_num_names = 0;
+static int32_t batch_max_names = 0;
+
+
+
+
+/*
+ * Add one name to the list.
+ */
+static void
+batch_append(char *name)
+{
+	char **tmp;
+
+	if (batch_num_names == batch_max_names)  {
+		batch_max_names = batch_max_names == 0 ? 256 : batch_max_names * 2;
+		tmp = (char **)realloc(batch_names, batch_max_names * sizeof(char *));
+		if (tmp == (char **)0)  {
+			fprintf(stderr, "realloc of batch file list failed.\n");
+			exit(0);
+		}
+		batch_names = tmp;
+	}
+	if ((batch_names[batch_num_names] = strdup(name)) == (char *)0)  {
+		fprintf(stderr, "strdup of batch file name failed.\n");
+		exit(0);
+	}
+	batch_num_names++;
+}
+
+
+
+
+/*
+ * Return non-zero if the name looks like a transfer of the kind we want:
+ * a tar archive, or a file of the form ????XXXX.DDF (or ????XXXX.DDF.gz),
+ * where XXXX begins with module_type.  Case doesn't matter.
+ */
+static int32_t
+batch_match(char *name, char *module_type)
+{
+	int32_t length;
+
+	length = strlen(name);
+
+	if (((length > 4) && ((strcasecmp(name + length - 4, ".tar") == 0) || (strcasecmp(name + length - 4, ".tgz") == 0))) ||
+	    ((length > 7) && (strcasecmp(name + length - 7, ".tar.gz") == 0)))  {
+		return 1;
+	}
+	if ((length > 3) && (strcasecmp(name + length - 3, ".gz") == 0))  {
+		length = length - 3;
+	}
+	if ((length >= 12) && (strncasecmp(name + length - 4, ".ddf", 4) == 0) &&
+	    (strncasecmp(name + length - 8, module_type, strlen(module_type)) == 0))  {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * Compare two names, for qsort().
+ */
+static int
+batch_compare(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+
+
+
+/*
+ * Add a transfer to the list.  If name is a directory, search it
+ * (and its subdirectories) for transfers, and add them, in alphabetical
+ * order.  module_type is "CEL" for DEMs, or "LE" for DLGs.
+ *
+ * Returns 0 on success, or -1 if the name can't be found.
+ */
+int32_t
+batch_add(char *name, char *module_type)
+{
+	DIR *dir;
+	struct dirent *entry;
+	struct stat stat_buf;
+	char path[MAX_FILE_NAME + 1];
+	int32_t first;
+	int length;
+
+	if (stat(name, &stat_buf) != 0)  {
+		fprintf(stderr, "Can't find %s, errno = %d\n", name, errno);
+		return -1;
+	}
+	if (!S_ISDIR(stat_buf.st_mode))  {
+		batch_append(name);
+		return 0;
+	}
+
+	if ((dir = opendir(name)) == (DIR *)0)  {
+		fprintf(stderr, "Can't read directory %s, errno = %d\n", name, errno);
+		return -1;
+	}
+	first = batch_num_names;
+	while ((entry = readdir(dir)) != (struct dirent *)0)  {
+		if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))  {
+			continue;
+		}
+		length = snprintf(path, sizeof(path), "%s/%s", name, entry->d_name);
+		if ((length < 0) || (length >= (int)sizeof(path)))  {
+			fprintf(stderr, "Path name %s/%s is too long.  Ignoring it.\n", name, entry->d_name);
+			continue;
+		}
+		if (stat(path, &stat_buf) != 0)  {
+			continue;
+		}
+		if (S_ISDIR(stat_buf.st_mode))  {
+			(void)batch_add(path, module_type);
+		}
+		else if (batch_match(entry->d_name, module_type) != 0)  {
+			batch_append(path);
+		}
+	}
+	closedir(dir);
+
+	/*
+	 * readdir() returns the entries in no particular order.
+	 * Sort them, so that the order of the conversions is predictable.
+	 */
+	qsort(batch_names + first, batch_num_names - first, sizeof(char *), batch_compare);
+
+	return 0;
+}
+
+
+
+
+/*
+ * Add the transfers named in a file, one per line, to the list.
+ * A list_name of "-" means the standard input.  Each line is
+ * handled as by batch_add(), so it may also name a directory.
+ *
+ * Returns 0 on success, or -1 if the list file can't be opened.
+ */
+int32_t
+batch_add_list(char *list_name, char *module_type)
+{
+	FILE *list;
+	char line[MAX_FILE_NAME + 2];
+	int32_t length;
+
+	if (strcmp(list_name, "-") == 0)  {
+		list = stdin;
+	}
+	else if ((list = fopen(list_name, "r")) == (FILE *)0)  {
+		fprintf(stderr, "Can't open %s for reading, errno = %d\n", list_name, errno);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), list) != (char *)0)  {
+		length = strlen(line);
+		while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r') || (line[length - 1] == ' ')))  {
+			line[--length] = '\0';
+		}
+		if (length == 0)  {
+			continue;
+		}
+		(void)batch_add(line, module_type);
+	}
+
+	if (list != stdin)  {
+		fclose(list);
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * A child process calls exit() only when the conversion fails.
+ * Let the parent know.
+ */
+static void
+batch_failed(void)
+{
+	_exit(1);
+}
+
+
+
+
+/*
+ * The time, in seconds.
+ */
+static double
+batch_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, (struct timezone *)0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+
+
+
+/*
+ * Convert all of the transfers on the list, with at most num_jobs
+ * of them running at once.  convert() is called, in a child process,
+ * with the name of each transfer.  It should return when the transfer
+ * has been converted, or call exit() if the conversion fails.
+ *
+ * Returns the number of transfers that failed.
+ */
+int32_t
+batch_run(int32_t num_jobs, void (*convert)(char *))
+{
+	pid_t *pids;
+	double *start_times;
+	pid_t pid;
+	int status;
+	int32_t next_start = 0;
+	int32_t running = 0;
+	int32_t num_done = 0;
+	int32_t num_failed = 0;
+	int32_t i;
+	double start_time;
+
+	if (batch_num_names == 0)  {
+		fprintf(stderr, "No SDTS transfers were found.\n");
+		return 0;
+	}
+	if (num_jobs < 1)  {
+		num_jobs = 1;
+	}
+
+	pids = (pid_t *)malloc(batch_num_names * sizeof(pid_t));
+	start_times = (double *)malloc(batch_num_names * sizeof(double));
+	if ((pids == (pid_t *)0) || (start_times == (double *)0))  {
+		fprintf(stderr, "malloc of batch process table failed\n");
+		exit(0);
+	}
+
+	/* Don't let the children inherit, and later repeat, any buffered output. */
+	fflush(stdout);
+	fflush(stderr);
+
+	start_time = batch_time();
+	while (num_done < batch_num_names)  {
+		/* Start as many children as we are allowed. */
+		while ((running < num_jobs) && (next_start < batch_num_names))  {
+			start_times[next_start] = batch_time();
+			if ((pid = fork()) < 0)  {
+				fprintf(stderr, "Can't fork a process for %s, errno = %d\n", batch_names[next_start], errno);
+				exit(0);
+			}
+			if (pid == 0)  {
+				/* Child. */
+				atexit(batch_failed);
+				convert(batch_names[next_start]);
+				_exit(0);
+			}
+			pids[next_start] = pid;
+			next_start++;
+			running++;
+		}
+
+		/* Wait for any child to finish, and report on it. */
+		if ((pid = wait(&status)) < 0)  {
+			fprintf(stderr, "wait() for a conversion process failed, errno = %d\n", errno);
+			exit(0);
+		}
+		for (i = 0; i < next_start; i++)  {
+			if (pids[i] == pid)  {
+				break;
+			}
+		}
+		if (i == next_start)  {
+			continue;
+		}
+		running--;
+		num_done++;
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))  {
+			num_failed++;
+		}
+		fprintf(stderr, "[%d/%d] %.2f s  %s%s\n", num_done, batch_num_names, batch_time() - start_times[i],
+			batch_names[i], (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) ? "  FAILED" : "");
+	}
+
+	fprintf(stderr, "Converted %d of %d transfer%s in %.2f s, using %d job%s.\n",
+		batch_num_names - num_failed, batch_num_names, batch_num_names == 1 ? "" : "s",
+		batch_time() - start_time, num_jobs, num_jobs == 1 ? "" : "s");
+
+	free(pids);
+	free(start_times);
+
+	return num_failed;
+}
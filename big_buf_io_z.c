@@ -40,10 +40,14 @@
  * get_a_line_z() fills a buffer with information until it finds a newline,
  * or runs out of space.
  *
+ * buf_read_all_z() decompresses the whole of a newly-opened file into
+ * a malloc()ed buffer.
+ *
  * These routines depend on the zread() function, in the file gunzip.c
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -56,6 +60,7 @@ int buf_open_z(const char *, int);
 int buf_close_z(int);
 ssize_t buf_read_z(int, void *, size_t);
 ssize_t get_a_line_z(int, void *, size_t);
+ssize_t buf_read_all_z(int, char **);
 int zread(int, char *, int, int);
 
 #define BUF_SIZE  WSIZE		/* This MUST be at least as large as WSIZE, or zread() won't work properly */
@@ -157,3 +162,71 @@ get_a_line_z(int filedes, void *buf, size_t nbyte)
 
 	return((ssize_t)nbyte);
 }
+
+
+
+
+/*
+ * Decompress everything that remains in the file into a
+ * buffer, which is malloc()ed (and grown as needed) by this
+ * function.  The caller is responsible for freeing it.
+ * The buffer always has room for at least one byte past the
+ * end of the data.
+ *
+ * Returns the number of bytes read, or -1 on error.
+ */
+ssize_t
+buf_read_all_z(int filedes, char **buf)
+{
+	int32_t size = 0;
+	int32_t buf_size = 4 * BUF_SIZE;
+	int32_t amount;
+	char *tmp;
+
+	if ((*buf = (char *)malloc(buf_size)) == (char *)0)  {
+		return(-1);
+	}
+
+	/*
+	 * Use up anything left in the buffer from buf_read_z() first.
+	 * (Normally there won't be anything.)
+	 */
+	if ((r_size > 0) && (r_place < r_size))  {
+		amount = r_size - r_place;
+		if (buf_read_z(filedes, *buf, amount) != amount)  {
+			free(*buf);
+			*buf = (char *)0;
+			return(-1);
+		}
+		size = amount;
+	}
+
+	while (1)  {
+		if ((buf_size - size) <= BUF_SIZE)  {
+			buf_size = buf_size * 2;
+			if ((tmp = (char *)realloc(*buf, buf_size)) == (char *)0)  {
+				free(*buf);
+				*buf = (char *)0;
+				return(-1);
+			}
+			*buf = tmp;
+		}
+
+		amount = zread(filedes, *buf + size, BUF_SIZE, new_flag);
+		if (amount < 0)  {
+			free(*buf);
+			*buf = (char *)0;
+			return(-1);
+		}
+		new_flag = 0;
+		if (amount == 0)  {
+			break;
+		}
+		size = size + amount;
+	}
+
+	r_place = 0;
+	r_size = 0;
+
+	return(size);
+}
@@ -1383,21 +1383,13 @@ process_dem_sdts(char *file_name, struct image_corners *image_corners,
 		struct dem_corners *dem_corners, struct dem_record_type_a *dem_a, struct datum *dem_datum)
 {
 	int32_t i, j;
-	union conv {
-		uint32_t i;
-		float f;
-	} conv;
 	short *sptr;
 	int32_t dem_size_x, dem_size_y;
-	int32_t byte_order;
-	struct subfield subfield;
+	struct ddf_item cvls_item = { "CVLS", "ELEVATION", DDF_SHORT, (void *)0, 0, 0 };
+	struct ddf *cel_ddf;
 	int32_t get_ret;
 
 
-	/* Begin by finding the native byte-order on this machine. */
-	byte_order = swab_type();
-
-
 	/*
 	 * Make sure that the UTM zone information isn't bogus.
 	 */
@@ -1487,140 +1479,104 @@ process_dem_sdts(char *file_name, struct image_corners *image_corners,
 	/*
 	 * Open the file in preparation for parsing.
 	 */
-	if (begin_ddf(file_name) < 0)  {
+	if ((cel_ddf = ddf_open(file_name)) == (struct ddf *)0)  {
 		fprintf(stderr, "Can't open %s for reading, errno = %d\n", file_name, errno);
 		exit(0);
 	}
 	/*
-	 * Loop through the subfields until we find what we want.
+	 * Read the records one at a time.  Each record holds one row of elevations,
+	 * which get_record() converts, rounds to integers, and puts straight into
+	 * the corresponding row of the array.  Then we make a pass over the row
+	 * to take care of the fill values and units.
 	 */
+	cvls_item.max = dem_size_x;
+	(void)ddf_bind(cel_ddf, &cvls_item, 1);
 	for (j = 0; j < dem_size_y; j++)  {
-		while ((get_ret = get_subfield(&subfield)) != 0)  {
+		cvls_item.dest = dem_corners->ptr + j * dem_size_x;
+		while ((get_ret = get_record(cel_ddf, &cvls_item, 1)) != 0)  {
 			/*
-			 * Skip unwanted subfields at the beginning of the record.
+			 * Skip records that don't contain elevations.
 			 */
-			if (strcmp(subfield.tag, "CVLS") == 0)  {
+			if (cvls_item.count > 0)  {
 				break;
 			}
 		}
 		if (get_ret == 0)  {
 			/* At end of file and we still haven't found what we need. */
 			fprintf(stderr, "Ran out of data in file %s.  Ignoring file.\n", file_name);
-			end_ddf();
+			ddf_close(cel_ddf);
 			return 1;
 		}
-		for (i = 0; i < dem_size_x; i++)  {
-			if ((strstr(subfield.format, "B") != (char *)0) && (strcmp(subfield.label, "ELEVATION") == 0))  {
-				sptr = (dem_corners->ptr + j * dem_size_x + i);
+		if (cvls_item.count < dem_size_x)  {
+			/* There weren't the expected number of elevations in the row. */
+			fprintf(stderr, "Shortage of data in %s.  Ignoring file.\n", file_name);
+			ddf_close(cel_ddf);
+			return 1;
+		}
+		sptr = dem_corners->ptr + j * dem_size_x;
+		/*
+		 * The values are normally stored in two's-complement binary (BI16),
+		 * or as IEEE 754 floating point numbers (BFP32), rather than in
+		 * 'I' format.  get_record() has already taken care of swabbing them
+		 * into native form.
+		 */
+		if ((cvls_item.format == 'B') && (cvls_item.size != 2) && (cvls_item.size != 4))  {
+			/* Error */
+			for (i = 0; i < dem_size_x; i++)  {
+				sptr[i] = HIGHEST_ELEVATION;
+			}
+		}
+		for (i = 0; i < dem_size_x; i++, sptr++)  {
+			if (*sptr == dem_a->edge_fill)  {
+				/* This is a point, along the edges of the quad, that doesn't contain valid data. */
+				*sptr = HIGHEST_ELEVATION;
+			}
+			else if (*sptr == 32767)  {
 				/*
-				 * These values, rather than being stored in 'I' format (integer numbers),
-				 * are stored in two's-complement binary.  Thus, they must be properly swabbed
-				 * during conversion to internal form.
+				 * Some DEM files appear to mark invalid data points with 32767.
+				 * I can think of two possible reasons for this; but these are just
+				 * guesses, and the real reason may be entirely different.
+				 * First guess:  it may have been a human data entry error, since the
+				 * edge_fill value is normally -32767.  Second guess:  for a while, it
+				 * may have been the standard was to use 32767 for an edge_fill marker in
+				 * the original (non-SDTS) DEM files; and these values may have been carried
+				 * over as part of the automated conversion process.  I don't know
+				 * how these values got there, but they are clearly not valid elevations.
+				 *
+				 * One concern from all of this is that some of the original DEM files
+				 * appear to contain either of 32767 and -32767 as non-valid data
+				 * markers.  (Perhaps sometimes both, although I haven't located such a
+				 * file yet.)  They may have been automatically carried over into the
+				 * SDTS files during automated conversion.  For the 32767 value, this
+				 * wouldn't appear to be a big problem, because we can still detect it.
+				 * However, the -32767 value is identical to the normal SDTS void_fill
+				 * value.  Thus, unless -32767 meant void_fill in the original DEM files,
+				 * this value may be misinterpreted after the conversion to SDTS.
+				 *
+				 * We treat 32767 in the same way as the edge_fill marker, and convert
+				 * it to HIGHEST_ELEVATION.
 				 */
-				if (subfield.length == 2)  {
-					if (byte_order == 0)  {
-						*sptr = (((int32_t)subfield.value[1] << 8) & 0x0000ff00) + ((int32_t)subfield.value[0] & 0x000000ff);
-					}
-					else  {
-						*sptr = (((int32_t)subfield.value[0] << 8) & 0x0000ff00) + ((int32_t)subfield.value[1] & 0x000000ff);
-					}
-				}
-				else if (subfield.length == 4)  {
-					/*
-					 * Note:  When the length is 4, we assume that this is a
-					 * BFP32 value, which means that it is a raw binary IEEE 754
-					 * floating point number.  Thus, this conversion won't work
-					 * on machines where IEEE 754 is not the native floating point
-					 * format.  We could convert from binary into the native floating
-					 * point format the hard way, but it appears that most machines
-					 * support IEEE 754, so we will try it this way for a while.
-					 */
-					conv.i = (((int32_t)subfield.value[3] & 0xff) << 24) |
-						  (((int32_t)subfield.value[2] & 0xff) << 16) |
-						  (((int32_t)subfield.value[1] & 0xff) <<  8) |
-						   ((int32_t)subfield.value[0] & 0xff);
-					if (byte_order == 0)  {
-						/* Do nothing. */
-					}
-					else if (byte_order == 1)  {
-						LE_SWAB(&conv.i);
-					}
-					else if (byte_order == 2)  {
-						PDP_SWAB(&conv.i);
-					}
-					*sptr = drawmap_round(conv.f);
-				}
-				else  {
-					/* Error */
-					*sptr = HIGHEST_ELEVATION;
-				}
-				if (*sptr == dem_a->edge_fill)  {
-					/* This is a point, along the edges of the quad, that doesn't contain valid data. */
-					*sptr = HIGHEST_ELEVATION;
-				}
-				else if (*sptr == 32767)  {
-					/*
-					 * Some DEM files appear to mark invalid data points with 32767.
-					 * I can think of two possible reasons for this; but these are just
-					 * guesses, and the real reason may be entirely different.
-					 * First guess:  it may have been a human data entry error, since the
-					 * edge_fill value is normally -32767.  Second guess:  for a while, it
-					 * may have been the standard was to use 32767 for an edge_fill marker in
-					 * the original (non-SDTS) DEM files; and these values may have been carried
-					 * over as part of the automated conversion process.  I don't know
-					 * how these values got there, but they are clearly not valid elevations.
-					 *
-					 * One concern from all of this is that some of the original DEM files
-					 * appear to contain either of 32767 and -32767 as non-valid data
-					 * markers.  (Perhaps sometimes both, although I haven't located such a
-					 * file yet.)  They may have been automatically carried over into the
-					 * SDTS files during automated conversion.  For the 32767 value, this
-					 * wouldn't appear to be a big problem, because we can still detect it.
-					 * However, the -32767 value is identical to the normal SDTS void_fill
-					 * value.  Thus, unless -32767 meant void_fill in the original DEM files,
-					 * this value may be misinterpreted after the conversion to SDTS.
-					 *
-					 * We treat 32767 in the same way as the edge_fill marker, and convert
-					 * it to HIGHEST_ELEVATION.
-					 */
-					*sptr = HIGHEST_ELEVATION;
-				}
-				else if (*sptr == dem_a->void_fill)  {
-					/* This is a point, somewhere within the quad, that falls within a void in the data. */
-					*sptr = 0;
-				}
-				else if (dem_a->elev_units == 1)  {
-					/*
-					 * The main body of drawmap likes to work in meters.
-					 * We satisfy that desire by changing feet into meters
-					 * before passing the data back.
-					 *
-					 * We alter the header information below, after all data
-					 * points have been processed.
-					 */
-					*sptr = (short)drawmap_round((double)*sptr * 0.3048);
-				}
-
-				if (i == (dem_size_x - 1))  {
-					break;
-				}
+				*sptr = HIGHEST_ELEVATION;
 			}
-
-			if (get_subfield(&subfield) == 0)  {
-				fprintf(stderr, "Shortage of data in %s.  Ignoring file.\n", file_name);
-				end_ddf();
-				return 1;
+			else if (*sptr == dem_a->void_fill)  {
+				/* This is a point, somewhere within the quad, that falls within a void in the data. */
+				*sptr = 0;
 			}
-			if (strcmp(subfield.tag, "CVLS") != 0)  {
-				/* There weren't the expected number of elevations in the row. */
-				fprintf(stderr, "Shortage of data in %s.  Ignoring file.\n", file_name);
-				end_ddf();
-				return 1;
+			else if (dem_a->elev_units == 1)  {
+				/*
+				 * The main body of drawmap likes to work in meters.
+				 * We satisfy that desire by changing feet into meters
+				 * before passing the data back.
+				 *
+				 * We alter the header information below, after all data
+				 * points have been processed.
+				 */
+				*sptr = (short)drawmap_round((double)*sptr * 0.3048);
 			}
 		}
 	}
 	/* We are done with this file, so close it. */
-	end_ddf();
+	ddf_close(cel_ddf);
 
 
 	/*
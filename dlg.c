@@ -33,12 +33,14 @@
 
 
 /*
- * Storage for attribute types.
+ * Storage for attribute types.  num_A_attrib and num_L_attrib count
+ * the Area and Line entries in the user's attribute file, and the entries
+ * themselves are compiled into attrib_filter_A and attrib_filter_L.
  */
 int32_t num_A_attrib;
 int32_t num_L_attrib;
-struct maj_min attributes_A[MAX_A_ATTRIB];
-struct maj_min attributes_L[MAX_L_ATTRIB];
+struct attrib_filter attrib_filter_A;
+struct attrib_filter attrib_filter_L;
 
 
 /*
@@ -52,15 +54,30 @@ struct maj_min attributes_L[MAX_L_ATTRIB];
  */
 
 /*
- * The sizes of the nodes, areas, and lines arrays are their theoretical maximum values.
- * It would probably be cooler to malloc() these as we go, but coolness was not an
- * objective of this program.  It would still be cool to read the maximum values from
- * the DLG file headers and check them against the values below to verify that
- * the standards haven't changed and left this program behind.
+ * The nodes, areas, and lines of the current DLG file.  The arrays used to
+ * be fixed at the theoretical maximum sizes for a 100K DLG file.  Now they
+ * grow as needed (see dlg_reserve_nodes() and friends), and, like the arena,
+ * they keep their memory from one file to the next.
  */
-struct nodes nodes[MAX_NODES];
-struct areas areas[MAX_AREAS];
-struct lines lines[MAX_LINES];
+struct nodes *nodes = (struct nodes *)0;
+struct areas *areas = (struct areas *)0;
+struct lines *lines = (struct lines *)0;
+int32_t nodes_size = 0;
+int32_t areas_size = 0;
+int32_t lines_size = 0;
+
+/*
+ * The coordinates and attributes for the nodes, areas, and lines.
+ * See the description of struct dlg_arena in dlg.h.
+ */
+struct dlg_arena dlg_arena;
+
+/*
+ * Nonzero when the arena holds longitude (x) and latitude (y) in degrees,
+ * rather than UTM coordinates.  See dlg_arena_to_geographic().
+ */
+int32_t dlg_geographic = 0;
+int32_t dlg_indexed = 0;	// Nonzero when line_index and area_index are already built for the arena
 
 double lat_se, long_se, lat_sw, long_sw, lat_ne, long_ne, lat_nw, long_nw;
 static double grid_x_se, grid_y_se, grid_x_sw, grid_y_sw, grid_x_ne, grid_y_ne, grid_x_nw, grid_y_nw;
@@ -71,6 +88,28 @@ int32_t utm_zone;
 
 int32_t right_border = RIGHT_BORDER;
 
+extern int32_t display_list_recording;	// Defined in dlg_display.c
+extern char *dlg_cache_name;		// Defined in dlg_cache.c
+
+
+/*
+ * Return the count in a six-character field of a DLG header record,
+ * or zero if the field is blank or garbled.
+ */
+static int32_t
+header_count(char *field)
+{
+	char tmp[7];
+	int32_t count;
+
+	strncpy(tmp, field, 6);
+	tmp[6] = '\0';
+	count = strtol(tmp, (char **)0, 10);
+
+	return count > 0 ? count : 0;
+}
+
+
 
 /*
  * Process the data from an optional-format DLG file.
@@ -86,11 +125,9 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 	char *end_ptr;
 	char buf[DLG_RECORD_LENGTH + 1];
 	char buf2[DLG_RECORD_LENGTH + 1];
-	struct point **current_point;
-	struct point *tmp_point;
-	struct attribute **current_attrib;
-	struct attribute *tmp_attrib;
 	int32_t attrib;
+	int32_t major, minor;
+	double x, y;
 	int32_t line_list;
 	int32_t num_nodes = 0;
 	int32_t num_areas = 0;
@@ -460,6 +497,18 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 			exit(0);
 			break;
 		}
+
+		/*
+		 * The rest of this record gives the numbers of nodes, areas, and lines
+		 * in the file, in columns 31-36, 47-52, and 63-68.  If they are there,
+		 * size the arrays from them, rather than growing them as we go.
+		 * They are only hints, since the arrays will grow anyway if need be.
+		 */
+		if ((ret_val >= 68) && (info_flag == 0))  {
+			dlg_reserve_nodes(header_count(&buf[30]));
+			dlg_reserve_areas(header_count(&buf[46]));
+			dlg_reserve_lines(header_count(&buf[62]));
+		}
 	}
 
 	/* If info_flag is non-zero, then we just want to print some info about the DLG file and return. */
@@ -522,6 +571,7 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 	while ((ret_val = read_function(fdesc, buf, DLG_RECORD_LENGTH)) > 0)  {
 		switch(buf[0])  {
 		case 'N':
+			dlg_reserve_nodes(num_nodes + 1);
 			i = 1;
 			nodes[num_nodes].id = strtol(&buf[i], &end_ptr, 10);
 			i = i + end_ptr - &buf[i];
@@ -565,6 +615,7 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 			break;
 
 		case 'A':
+			dlg_reserve_areas(num_areas + 1);
 			i = 1;
 			areas[num_areas].id = strtol(&buf[i], &end_ptr, 10);
 			i = i + end_ptr - &buf[i];
@@ -580,6 +631,7 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 			i = 48;
 			attrib = strtol(&buf[i], &end_ptr, 10);
 			areas[num_areas].number_attrib = attrib;
+			areas[num_areas].attribute = dlg_arena.num_attrib;
 
 			if (line_list != 0)  {
 				while (line_list > 0)  {
@@ -601,8 +653,6 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 						exit(0);
 					}
 
-					current_attrib = &areas[num_areas].attribute;
-
 					if (attrib > 6)  {
 						i = 6;
 						attrib = attrib - 6;
@@ -613,21 +663,12 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 					}
 
 					end_ptr = buf2;
-
 					while (i > 0)  {
-						*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-						if (*current_attrib == (struct attribute *)0)  {
-							fprintf(stderr, "malloc failed\n");
-							exit(0);
-						}
-
-						(*current_attrib)->major = strtol(end_ptr, &end_ptr, 10);
-						(*current_attrib)->minor = strtol(end_ptr, &end_ptr, 10);
-
-						current_attrib = &((*current_attrib)->attribute);
+						major = strtol(end_ptr, &end_ptr, 10);
+						minor = strtol(end_ptr, &end_ptr, 10);
+						(void)dlg_arena_add_attrib(major, minor);
 						i--;
 					}
-					*current_attrib = (struct attribute *)0;
 				}
 			}
 
@@ -635,8 +676,10 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 			break;
 
 		case 'L':
+			dlg_reserve_lines(num_lines + 1);
 			i = 1;
 			lines[num_lines].id = strtol(&buf[i], &end_ptr, 10);
+			lines[num_lines].drawn = 0;
 			i = i + end_ptr - &buf[i];
 
 			lines[num_lines].start_node = strtol(&buf[i], &end_ptr, 10);
@@ -656,8 +699,9 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 
 			attrib = strtol(&buf[i], &end_ptr, 10);
 			lines[num_lines].number_attrib = attrib;
+			lines[num_lines].attribute = dlg_arena.num_attrib;
 
-			current_point = &lines[num_lines].point;
+			lines[num_lines].point = dlg_arena.num_coords;
 			count = lines[num_lines].number_coords;
 			while (count != 0)  {
 				if ((ret_val = read_function(fdesc, buf2, DLG_RECORD_LENGTH)) <= 0)  {
@@ -681,22 +725,17 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 						break;
 					}
 
-					*current_point = (struct point *)malloc(sizeof(struct point));
-					if (*current_point == (struct point *)0)  {
-						fprintf(stderr, "malloc failed\n");
-						exit(0);
-					}
-
-					(*current_point)->x = (int32_t)strtod(&buf2[i], &end_ptr);
+					x = (int32_t)strtod(&buf2[i], &end_ptr);
 					i = i + end_ptr - &buf2[i];
-					(*current_point)->y = (int32_t)strtod(&buf2[i], &end_ptr);
+					y = (int32_t)strtod(&buf2[i], &end_ptr);
 					i = i + end_ptr - &buf2[i];
 
-					current_point = &((*current_point)->point);
+					(void)dlg_arena_add_coord(x, y);
 					count--;
 				}
 			}
-			*current_point = (struct point *)0;
+			lines[num_lines].number_coords = dlg_arena.num_coords - lines[num_lines].point;
+			set_line_bounds(&lines[num_lines]);
 
 			if (attrib != 0)  {
 				while (attrib > 0)  {
@@ -706,8 +745,6 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 						exit(0);
 					}
 
-					current_attrib = &lines[num_lines].attribute;
-
 					if (attrib > 6)  {
 						i = 6;
 						attrib = attrib - 6;
@@ -719,19 +756,11 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 
 					end_ptr = buf2;
 					while (i > 0)  {
-						*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-						if (*current_attrib == (struct attribute *)0)  {
-							fprintf(stderr, "malloc failed\n");
-							exit(0);
-						}
-
-						(*current_attrib)->major = strtol(end_ptr, &end_ptr, 10);
-						(*current_attrib)->minor = strtol(end_ptr, &end_ptr, 10);
-
-						current_attrib = &((*current_attrib)->attribute);
+						major = strtol(end_ptr, &end_ptr, 10);
+						minor = strtol(end_ptr, &end_ptr, 10);
+						(void)dlg_arena_add_attrib(major, minor);
 						i--;
 					}
-					*current_attrib = (struct attribute *)0;
 				}
 			}
 
@@ -750,7 +779,43 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 	/*
 	 * All of the useful data is parsed.
 	 * Now do something with it.
-	 *
+	 */
+	draw_dlg(&datum, color, data_type, num_lines, num_areas, image_corners);
+
+
+	/* Empty the arena, so that it is ready for the next file. */
+	dlg_arena_reset();
+}
+
+
+
+/*
+ * Draw the lines and areas of a DLG file, once they have been parsed into
+ * the arena and the lines, areas, and nodes arrays.  This is shared by
+ * process_dlg_optional(), process_dlg_sdts(), and the DLG cache (see dlg_cache.c).
+ * The corners of the DLG file must be in lat_sw, long_sw, lat_ne, and long_ne.
+ *
+ * If the arena is to be saved in the cache, we first convert it into
+ * latitude/longitude, and write it out, and then draw it from the converted
+ * coordinates, so that the image is the same as it will be when the file
+ * is later drawn from the cache.
+ *
+ * Lines that have already been drawn (by read_dlg_sdts(), as it read them)
+ * are marked as such, and are skipped here.
+ */
+void
+draw_dlg(struct datum *datum, int32_t color, int32_t data_type, int32_t num_lines, int32_t num_areas, struct image_corners *image_corners)
+{
+	int32_t i, k;
+	int32_t *selected;
+	int32_t num_selected, sel;
+	struct attribute *current_attrib;
+
+	if ((dlg_cache_name != (char *)0) && (dlg_arena_to_geographic(datum, num_lines, num_areas) == 0))  {
+		dlg_cache_write(color, data_type, num_lines, num_areas);
+	}
+
+	/*
 	 * First find the x and y image coordinates that border this DLG chunk.
 	 *
 	 * Then draw the lines for which we have appropriate atribute codes stored,
@@ -760,141 +825,31 @@ process_dlg_optional(int fdesc, int gz_flag, struct image_corners *image_corners
 	 * appropriate attribute codes stored, but don't go outside
 	 * the x-y border.
 	 */
-	dlg_x_low = -1 + drawmap_round((long_sw - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-	dlg_y_low = image_corners->y - 1 - drawmap_round((lat_ne - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-	dlg_x_high = -1 + drawmap_round((long_ne - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-	dlg_y_high = image_corners->y - 1 - drawmap_round((lat_sw - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-	if (dlg_x_low < -1)  {
-		dlg_x_low = -1;
-	}
-	if (dlg_y_low < -1)  {
-		dlg_y_low = -1;
-	}
-	if (dlg_x_high >= image_corners->x)  {
-		dlg_x_high = image_corners->x - 1;
-	}
-	if (dlg_y_high >= image_corners->y)  {
-		dlg_y_high = image_corners->y - 1;
-	}
+	draw_dlg_begin(datum, image_corners);
 
 	/*
 	 * Cycle through all of the line data and draw all of the appropriate lines
 	 * onto the image (overlaying any previous data).
+	 * Lines whose bounding boxes miss the map window are skipped
+	 * before we do any work on them.
 	 */
-	for (i = 0; i < num_lines; i++)  {
-		/*
-		 * In the DLG-3 format, the first area element listed
-		 * represents the universe outside of the map area.
-		 * Thus, lines that have area 1 as a boundary should be
-		 * "neatlines" that bound the map area.
-		 * Since these clutter up a map, we normally discard them.
-		 * (If you want to keep them, then change the #define of OMIT_NEATLINES
-		 * so that it is zero, rather than non-zero.)
-		 *
-		 * Here are relevant quotes from the DLG-3 guide:
-		 *
-		 *	expressed by network data is that of connectivity.  The network case
-		 *	differs from the area case in that, irrespective of the number of closed
-		 *	areas forming the graph, only two areas are encoded:  (1) the area out-
-		 *	side the graph, termed the outside area; and (2) the area within the
-		 *	graph, termed the background area.  All lines except the graph boundary,
-		 *	or neatline, are considered to be contained within the background area.
-		 *
-		 *	map border.  There is one outside area for each DLG-3. It is always the
-		 *	first area encountered (its ID is 1) and has the attribute code 000 0000.
-		 */
-
-		/*
-		 * If the user provided a file full of attributes, then
-		 * use them to control whether or not the lines are drawn.
-		 * If not, then just go ahead and draw everything.
-		 *
-		 * Note:  If a major or minor attribute code in the attribute
-		 *        file (supplied by the user) is less than
-		 *        zero, it is treated as a wild card and matches
-		 *        anything.
-		 */
-		if ((num_A_attrib > 0) || (num_L_attrib > 0))  {
-			if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
-				current_attrib = &lines[i].attribute;
-				if (*current_attrib != (struct attribute *)0)  {
-					while (*current_attrib != (struct attribute *)0)  {
-						for (j = 0; j < num_L_attrib; j++)  {
-							if (((attributes_L[j].major < 0) ||
-							     (attributes_L[j].major == ((*current_attrib)->major))) &&
-							    ((attributes_L[j].minor < 0) ||
-							     (attributes_L[j].minor == ((*current_attrib)->minor))))  {
-								draw_lines(&datum, lines[i].point, color, image_corners);
-								goto FIN1;
-							}
-						}
-						current_attrib = &((*current_attrib)->attribute);
-					}
-				}
-				else  {
-					/*
-					 * If the feature had no attribute codes, then check if
-					 * it is covered by a wild card in the attributes file.
-					 */
-					for (j = 0; j < num_L_attrib; j++)  {
-						if (((attributes_L[j].major < 0) ||
-						     (attributes_L[j].major == data_type)) &&
-						    (attributes_L[j].minor < 0))  {
-							draw_lines(&datum, lines[i].point, color, image_corners);
-							goto FIN1;
-						}
-					}
-				}
-			}
-
-			/*
-			 * For those (hopefully rare) occasions in which something
-			 * goes wrong, we provide the capability for a user to
-			 * specifically request a single line from a DLG file so that
-			 * the cause of the problem can be isolated.
-			 * The user specifies a specific line by providing a major
-			 * attribute number of 10000, and a minor attribute number
-			 * equal to the desired line ID number.  Since no
-			 * valid attribute (as far as I know) is ever as large as
-			 * 10,000, such user-specified attribute pairs will not
-			 * affect the search for legitimate attributes above (since
-			 * they can't possibly match anything).  If we reach this point,
-			 * then we failed to draw a line due to the legitimate-attribute
-			 * checks above; so we give it one more try here, based on
-			 * user-requested ID numbers.
-			 *
-			 * Note:  If you are using this feature, then it doesn't make
-			 *        a lot of sense to process more than one DLG file,
-			 *        since the ID number you give (as the minor attribute)
-			 *        will be matched in every DLG file that has a
-			 *        Line with that ID.  If you are trying to isolate
-			 *        one (or a few) Line(s), then you probably want to
-			 *        be certain which file is the source of the data.
-			 */
-			for (j = 0; j < num_L_attrib; j++)  {
-				if ((attributes_L[j].major == 10000) &&
-				     (attributes_L[j].minor == lines[i].id))  {
-					draw_lines(&datum, lines[i].point, color, image_corners);
-					goto FIN1;
-				}
-			}
-		}
-		else  {
-			if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
-				draw_lines(&datum, lines[i].point, color, image_corners);
-			}
+	num_selected = window_lines(num_lines, &selected);
+	for (sel = 0; sel < num_selected; sel++)  {
+		i = selected[sel];
+		if (lines[i].drawn == 0)  {
+			draw_dlg_line(datum, i, color, data_type, image_corners);
 		}
-FIN1:
-		{;}
 	}
 
 	/*
 	 * Now we fill in each interesting area on the map with the
 	 * same color that bounds the area.  (For example,
 	 * lakes (attribute code 050 0421) might be filled in.)
-	 * However, sometimes areas might be filled in improperly.
-	 * The code assumes that the reference point for an area falls
-	 * within the polygon of lines that define that area.
+	 * Each area is rasterized from the rings of lines that bound it,
+	 * as given by the left/right area topology of the lines.
+	 * If the topology is unusable, we fall back to a flood fill
+	 * from the area's representative point, which assumes that
+	 * the point falls within the polygon of lines that define that area.
 	 * According to the DLG guide, this isn't guaranteed
 	 * to always be the case, but the assumption has nonetheless
 	 * worked reasonably well in practice.
@@ -905,392 +860,499 @@ FIN1:
 	 * file, then no areas are filled in.  This is because the area-fill
 	 * algorithm can occasionally run amok, and therefore the appropriate
 	 * default is to not give it a chance.  For extensive details on the
-	 * area-fill algorithm, see the comments at the top of fill_area().
+	 * area-fill algorithm, see the comments at the top of fill_area()
+	 * and fill_area_polygon().
 	 */
 	if (num_A_attrib > 0)  {
-		for (i = 0; i < num_areas; i++)  {
-			if (areas[i].number_attrib <= 0)  {
+		build_area_index(num_lines);
+		set_area_bounds(num_areas);
+		num_selected = window_areas(num_areas, &selected);
+		for (sel = 0; sel < num_selected; sel++)  {
+			i = selected[sel];
+			if ((areas[i].number_attrib <= 0) || (area_outside_window(&areas[i]) != 0))  {
 				continue;
 			}
 
-			current_attrib = &areas[i].attribute;
-			while (*current_attrib != (struct attribute *)0)  {
-				for (j = 0; j < num_A_attrib; j++)  {
-					if (((attributes_A[j].major < 0) ||
-					     (attributes_A[j].major == ((*current_attrib)->major))) &&
-					    ((attributes_A[j].minor < 0) ||
-					     (attributes_A[j].minor == ((*current_attrib)->minor))))  {
-						fill_area(&datum, areas[i].x, areas[i].y, color, image_corners);
-						goto FIN2;
-					}
+			current_attrib = &dlg_arena.attrib[areas[i].attribute];
+			for (k = 0; k < areas[i].number_attrib; k++)  {
+				if (attrib_filter_match(&attrib_filter_A, current_attrib[k].major, current_attrib[k].minor) != 0)  {
+					fill_area_polygon(datum, areas[i].id, areas[i].x, areas[i].y, color, image_corners);
+					goto FIN2;
 				}
-				current_attrib = &((*current_attrib)->attribute);
 			}
 
 			/*
 			 * As with the Line attributes, we provide an interface
 			 * for the user to select specific areas, via their IDs.
 			 */
-			for (j = 0; j < num_A_attrib; j++)  {
-				if ((attributes_A[j].major == 10000) &&
-				     (attributes_A[j].minor == areas[i].id))  {
-					fill_area(&datum, areas[i].x, areas[i].y, color, image_corners);
-					goto FIN2;
-				}
+			if (attrib_filter_id(&attrib_filter_A, areas[i].id) != 0)  {
+				fill_area_polygon(datum, areas[i].id, areas[i].x, areas[i].y, color, image_corners);
 			}
 FIN2:
 			{;}
 		}
 	}
+}
 
 
-	/* Free up all of the malloc() memory */
-	for (i = 0; i < num_lines; i++)  {
-		if (lines[i].number_coords > 0)  {
-			current_point = &lines[i].point;
 
-			while (*current_point != (struct point *)0)  {
-				tmp_point = (*current_point)->point;
-				free(*current_point);
-				*current_point = tmp_point;
-			}
-		}
-		if (lines[i].number_attrib > 0)  {
-			current_attrib = &lines[i].attribute;
 
-			while (*current_attrib != (struct attribute *)0)  {
-				tmp_attrib = (*current_attrib)->attribute;
-				free(*current_attrib);
-				*current_attrib = tmp_attrib;
-			}
-		}
+/*
+ * Find the x and y image coordinates that border the current DLG file,
+ * and set up the map window and the line-simplification tolerance,
+ * in preparation for drawing lines with draw_dlg_line().
+ */
+void
+draw_dlg_begin(struct datum *datum, struct image_corners *image_corners)
+{
+	dlg_x_low = -1 + drawmap_round((long_sw - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
+	dlg_y_low = image_corners->y - 1 - drawmap_round((lat_ne - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
+	dlg_x_high = -1 + drawmap_round((long_ne - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
+	dlg_y_high = image_corners->y - 1 - drawmap_round((lat_sw - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
+	if (dlg_x_low < -1)  {
+		dlg_x_low = -1;
 	}
-	for (i = 0; i < num_areas; i++)  {
-		if (areas[i].number_attrib > 0)  {
-			current_attrib = &areas[i].attribute;
-
-			while (*current_attrib != (struct attribute *)0)  {
-				tmp_attrib = (*current_attrib)->attribute;
-				free(*current_attrib);
-				*current_attrib = tmp_attrib;
-			}
-		}
+	if (dlg_y_low < -1)  {
+		dlg_y_low = -1;
+	}
+	if (dlg_x_high >= image_corners->x)  {
+		dlg_x_high = image_corners->x - 1;
+	}
+	if (dlg_y_high >= image_corners->y)  {
+		dlg_y_high = image_corners->y - 1;
 	}
+
+	set_window_bounds(datum, image_corners);
+	set_simplify_tolerance(image_corners);
 }
 
 
 
 /*
- * Draw a series of line segments, as defined by a linked list of
- * points from an optional-format DLG file.
- *
- * This routine is recursive, not because it has to be, but because
- * it was slightly simpler that way.  Since it doesn't recurse very
- * far (on average), it isn't a performance or memory problem.
- *
- * It is a nasty routine to understand, because it has a generalized
- * interpolation algorithm to capture line segments that go beyond the
- * image boundaries.
+ * Draw line i, if it falls within the map window, and if the user's
+ * attributes (if any) call for it.  draw_dlg_begin() must be called first.
  */
 void
-draw_lines(struct datum *datum, struct point *cur_point, int32_t color, struct image_corners *image_corners)
+draw_dlg_line(struct datum *datum, int32_t i, int32_t color, int32_t data_type, struct image_corners *image_corners)
 {
-	double latitude1, longitude1;
-	double latitude2, longitude2;
-	int32_t xx1, yy1;
-	int32_t xx2, yy2;
-	double fxx, fyy;
-	double delta_x, delta_y;
-	int32_t steps;
-	int32_t i;
-	double m_lat, m_long, b_lat, b_long;
-	double p_lat1, p_long1, p_lat2, p_long2;
-	double d_lat, d_long;
-	int32_t pointflags = 0;
-	int32_t bothflag = 0;
+	int32_t k;
+	struct attribute *current_attrib;
+
+	if (line_outside_window(&lines[i]) != 0)  {
+		return;
+	}
 
 	/*
-	 * We recurse to the end of the linked list, and then draw line
-	 * segments as we pop back up the recursion stack.
+	 * In the DLG-3 format, the first area element listed
+	 * represents the universe outside of the map area.
+	 * Thus, lines that have area 1 as a boundary should be
+	 * "neatlines" that bound the map area.
+	 * Since these clutter up a map, we normally discard them.
+	 * (If you want to keep them, then change the #define of OMIT_NEATLINES
+	 * so that it is zero, rather than non-zero.)
+	 *
+	 * Here are relevant quotes from the DLG-3 guide:
+	 *
+	 *	expressed by network data is that of connectivity.  The network case
+	 *	differs from the area case in that, irrespective of the number of closed
+	 *	areas forming the graph, only two areas are encoded:  (1) the area out-
+	 *	side the graph, termed the outside area; and (2) the area within the
+	 *	graph, termed the background area.  All lines except the graph boundary,
+	 *	or neatline, are considered to be contained within the background area.
+	 *
+	 *	map border.  There is one outside area for each DLG-3. It is always the
+	 *	first area encountered (its ID is 1) and has the attribute code 000 0000.
 	 */
-	if (cur_point->point != (struct point *)0)  {
-		draw_lines(datum, cur_point->point, color, image_corners);
-
-		/*
-		 * Draw a segment between this point and the next one down the linked list.
-		 *
-		 * Begin by figuring out the latitude and longitude of the endpoints.
-		 */
-		(void)redfearn_inverse(datum, cur_point->x, cur_point->y, utm_zone, &latitude1, &longitude1);
-		(void)redfearn_inverse(datum, (cur_point->point)->x, (cur_point->point)->y, utm_zone, &latitude2, &longitude2);
-//fprintf(stderr, "x=%g, y=%g, zone=%d, lat=%g, long=%g\n", (cur_point->point)->x, (cur_point->point)->y, utm_zone, latitude1, longitude1);
 
+	/*
+	 * If the user provided a file full of attributes, then
+	 * use them to control whether or not the lines are drawn.
+	 * If not, then just go ahead and draw everything.
+	 *
+	 * Note:  If a major or minor attribute code in the attribute
+	 *        file (supplied by the user) is less than
+	 *        zero, it is treated as a wild card and matches
+	 *        anything.
+	 *
+	 * The user's codes have been compiled into hash sets
+	 * (see attrib_filter_match()), so each of the line's
+	 * attributes costs a few probes, no matter how many
+	 * codes the user gave us.
+	 */
+	if ((num_A_attrib > 0) || (num_L_attrib > 0))  {
+		if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
+			if (lines[i].number_attrib > 0)  {
+				current_attrib = &dlg_arena.attrib[lines[i].attribute];
+				for (k = 0; k < lines[i].number_attrib; k++)  {
+					if (attrib_filter_match(&attrib_filter_L, current_attrib[k].major, current_attrib[k].minor) != 0)  {
+						draw_lines(datum, &dlg_arena.x[lines[i].point], &dlg_arena.y[lines[i].point], lines[i].number_coords, color, image_corners);
+						return;
+					}
+				}
+			}
+			else  {
+				/*
+				 * If the feature had no attribute codes, then check if
+				 * it is covered by a wild card in the attributes file.
+				 */
+				if (attrib_filter_theme(&attrib_filter_L, data_type) != 0)  {
+					draw_lines(datum, &dlg_arena.x[lines[i].point], &dlg_arena.y[lines[i].point], lines[i].number_coords, color, image_corners);
+					return;
+				}
+			}
+		}
 
 		/*
-		 * Find out whether only one endpoint, or both of them, fall
-		 * outside the map area.
+		 * For those (hopefully rare) occasions in which something
+		 * goes wrong, we provide the capability for a user to
+		 * specifically request a single line from a DLG file so that
+		 * the cause of the problem can be isolated.
+		 * The user specifies a specific line by providing a major
+		 * attribute number of 10000, and a minor attribute number
+		 * equal to the desired line ID number.  Since no
+		 * valid attribute (as far as I know) is ever as large as
+		 * 10,000, such user-specified attribute pairs will not
+		 * affect the search for legitimate attributes above (since
+		 * they can't possibly match anything).  If we reach this point,
+		 * then we failed to draw a line due to the legitimate-attribute
+		 * checks above; so we give it one more try here, based on
+		 * user-requested ID numbers.
+		 *
+		 * Note:  If you are using this feature, then it doesn't make
+		 *        a lot of sense to process more than one DLG file,
+		 *        since the ID number you give (as the minor attribute)
+		 *        will be matched in every DLG file that has a
+		 *        Line with that ID.  If you are trying to isolate
+		 *        one (or a few) Line(s), then you probably want to
+		 *        be certain which file is the source of the data.
 		 */
-		if ((latitude1 < image_corners->sw_lat) || (latitude1 > image_corners->ne_lat) ||
-		    (longitude1 < image_corners->sw_long) || (longitude1 > image_corners->ne_long))  {
-			bothflag++;
+		if (attrib_filter_id(&attrib_filter_L, lines[i].id) != 0)  {
+			draw_lines(datum, &dlg_arena.x[lines[i].point], &dlg_arena.y[lines[i].point], lines[i].number_coords, color, image_corners);
 		}
-		if ((latitude2 < image_corners->sw_lat) || (latitude2 > image_corners->ne_lat) ||
-		    (longitude2 < image_corners->sw_long) || (longitude2 > image_corners->ne_long))  {
-			bothflag++;
+	}
+	else  {
+		if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
+			draw_lines(datum, &dlg_arena.x[lines[i].point], &dlg_arena.y[lines[i].point], lines[i].number_coords, color, image_corners);
 		}
+	}
+}
 
 
-		/*
-		 * If at least one endpoint of a line segment is outside of the area
-		 * covered by the map image, then interpolate the segment.
-		 *
-		 * This isn't just to catch errors in a DLG file.  Since the user
-		 * can specify arbitrary latitude/longitude boundaries for the
-		 * map image, either or both endpoints of a segment can easily
-		 * be outside of the map boundaries.
-		 */
-		if (bothflag > 0)  {
-			/*
-			 * Construct two equations for the line passing through the two
-			 * endpoints.  These equations can be solved for four potential
-			 * intercepts with the edge of the map area, only zero or two of
-			 * which should be actual intercepts.  (In theory, there can
-			 * be a single intercept at a corner, but this code should find
-			 * it twice.)
-			 *
-			 * We construct the two lines using the classic Y = m * X + b formula,
-			 * where, in one case, we let Y be the latitude and X be the longitude,
-			 * and in the other case they switch roles.
-			 */
-			m_lat = (latitude2 - latitude1) / (longitude2 - longitude1);
-			b_lat = latitude1 - m_lat * longitude1;
-			m_long = 1.0 / m_lat;
-			b_long = longitude1 - m_long * latitude1;
 
-			/*
-			 * We need the distance (in the Manhattan (city-block) metric) between
-			 * the two endpoints.
-			 * It will be used to determine whether one of the intercepts with
-			 * the map edges falls between the two given endpoints.
-			 */
-			d_lat = fabs(latitude1 - latitude2);
-			d_long = fabs(longitude1 - longitude2);
+/*
+ * Storage for the image coordinates of the points in a single line.
+ * It is kept from one call to the next, and grows as needed.
+ */
+static double *pixel_x = (double *)0;
+static double *pixel_y = (double *)0;
+static int32_t pixel_size = 0;
 
-			/*
-			 * Solve the two equations for the four possible intercepts, and check
-			 * that they are truly intercepts.
-			 * Set a flag to remember which points turned out to be intercepts.
-			 */
-			p_lat1 = m_lat * image_corners->sw_long + b_lat;
-			if ((p_lat1 >= image_corners->sw_lat) && (p_lat1 <= image_corners->ne_lat))  {
-				if ((fabs(image_corners->sw_long - longitude1) <= d_long) && (fabs(image_corners->sw_long - longitude2) <= d_long))  {
-					pointflags |= 1;
-				}
-			}
-			p_lat2 = m_lat * image_corners->ne_long + b_lat;
-			if ((p_lat2 >= image_corners->sw_lat) && (p_lat2 <= image_corners->ne_lat))  {
-				if ((fabs(image_corners->ne_long - longitude1) <= d_long) && (fabs(image_corners->ne_long - longitude2) <= d_long))  {
-					pointflags |= 2;
-				}
-			}
-			p_long1 = m_long * image_corners->sw_lat + b_long;
-			if ((p_long1 >= image_corners->sw_long) && (p_long1 <= image_corners->ne_long))  {
-				if ((fabs(image_corners->sw_lat - latitude1) <= d_lat) && (fabs(image_corners->sw_lat - latitude2) <= d_lat))  {
-					pointflags |= 4;
-				}
-			}
-			p_long2 = m_long * image_corners->ne_lat + b_long;
-			if ((p_long2 >= image_corners->sw_long) && (p_long2 <= image_corners->ne_long))  {
-				if ((fabs(image_corners->ne_lat - latitude1) <= d_lat) && (fabs(image_corners->ne_lat - latitude2) <= d_lat))  {
-					pointflags |= 8;
-				}
-			}
 
-			/*
-			 * If both endpoints fall outside the map area, and there aren't exactly two
-			 * intercepts, then there should be none.  (In theory, when a segment
-			 * just touches a corner of the map area, then there is only one intercept,
-			 * but the above code will find the same intercept twice.)
-			 */
-			if ((bothflag == 2) && (pointflags != 3) && (pointflags != 5) && (pointflags != 6) &&
-			    (pointflags != 9) && (pointflags != 10) && (pointflags != 12))  {
-				if (pointflags != 0)  {
-			    		fprintf(stderr, " should have had exactly two intercepts:  0x%x  (%f %f) (%f %f)\n",
-						pointflags, latitude1, longitude1, latitude2, longitude2);
-				}
-				return;
-			}
+/*
+ * A DLG file digitized at 1:100,000 scale has a vertex every few tens of meters.
+ * When such a file is drawn onto a map of a whole state, where a pixel might
+ * cover a kilometer or more, dozens of consecutive vertices fall into the same
+ * pixel, and projecting them all is wasted effort.  Thus, before a line is
+ * projected, we thin it out with the Douglas-Peucker algorithm:  the line
+ * is replaced by the segment between its end points, unless some vertex is
+ * farther than a given tolerance from that segment, in which case the farthest
+ * vertex is kept, and the two halves are treated the same way.
+ *
+ * The tolerance is a fraction of a pixel (SIMPLIFY_FRACTION), converted into meters
+ * by set_simplify_tolerance(), so the thinned line never strays from the original
+ * by more than that much on the map.  When the map is zoomed in far enough that
+ * the vertices are more than a pixel apart, hardly any are removed.
+ *
+ * The end points of a line are always kept, and a given line is always thinned
+ * in the same way, whether it is being drawn or being used as part of the
+ * boundary of an area.  Thus the rings assembled by fill_area_polygon() still
+ * close at their nodes, and neighboring areas share exactly the same boundary,
+ * so area fills neither leak nor leave gaps.
+ *
+ * The recursion is replaced by an explicit stack of (first, last) pairs.
+ *
+ * When the arena has already been converted to latitude/longitude
+ * (see dlg_arena_to_geographic()), the thinning is done in image
+ * coordinates instead.  See line_to_pixels().
+ */
+#define SIMPLIFY_FRACTION	0.25	// Maximum deviation of a simplified line, in pixels
 
-			/* If the first endpoint is out of range, then replace it with an intercept. */
-			if ((latitude1 < image_corners->sw_lat) || (latitude1 > image_corners->ne_lat) ||
-			    (longitude1 < image_corners->sw_long) || (longitude1 > image_corners->ne_long))  {
-				if (pointflags & 1)  {
-					latitude1 = p_lat1;
-					longitude1 = image_corners->sw_long;
-					pointflags &= ~1;
-					goto DONE1;
-				}
-				if (pointflags & 2)  {
-					latitude1 = p_lat2;
-					longitude1 = image_corners->ne_long;
-					pointflags &= ~2;
-					goto DONE1;
-				}
-				if (pointflags & 4)  {
-					latitude1 = image_corners->sw_lat;
-					longitude1 = p_long1;
-					pointflags &= ~4;
-					goto DONE1;
-				}
-				if (pointflags & 8)  {
-					latitude1 = image_corners->ne_lat;
-					longitude1 = p_long2;
-					pointflags &= ~8;
-					goto DONE1;
-				}
-			}
-DONE1:
-
-			/* If the second endpoint is out of range, then replace it with an intercept. */
-			if ((latitude2 < image_corners->sw_lat) || (latitude2 > image_corners->ne_lat) ||
-			    (longitude2 < image_corners->sw_long) || (longitude2 > image_corners->ne_long))  {
-				if (pointflags & 1)  {
-					latitude2 = p_lat1;
-					longitude2 = image_corners->sw_long;
-					goto DONE2;
-				}
-				if (pointflags & 2)  {
-					latitude2 = p_lat2;
-					longitude2 = image_corners->ne_long;
-					goto DONE2;
-				}
-				if (pointflags & 4)  {
-					latitude2 = image_corners->sw_lat;
-					longitude2 = p_long1;
-					goto DONE2;
-				}
-				if (pointflags & 8)  {
-					latitude2 = image_corners->ne_lat;
-					longitude2 = p_long2;
-					goto DONE2;
-				}
-			}
-DONE2:
-	;
-		}
+static double simplify_tolerance = 0.0;	// Maximum deviation, in meters.  Zero means don't simplify.
+static double *simple_x = (double *)0;
+static double *simple_y = (double *)0;
+static int32_t *simple_stack = (int32_t *)0;
+static unsigned char *simple_keep = (unsigned char *)0;
+static int32_t simple_size = 0;
 
 
 
-		/*
-		 * Convert the latitude/longitude pairs into pixel locations within the image.
-		 *
-		 * Note:  because there may be small errors in longitude1, latitude1, longitude2,
-		 * and latitude2, the values of xx1, yy1, xx2, or yy2 may occasionally be off by
-		 * one pixel.
-		 * This appears to be acceptable in the middle of the image, since one pixel
-		 * doesn't amount to much linear distance in the image.  At the edges, one might
-		 * worry that the discrepancy would cause us to go over the image edges.
-		 * However, the interpolation code above should successfully eliminate this
-		 * potential problem.
-		 *
-		 * As noted above, it is okay for the array index values to go to -1, since that
-		 * is the appropriate value for image_corners->sw_long or image_corners->ne_lat.
-		 */
-		xx1 = -1 + drawmap_round((longitude1 - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-		yy1 = image_corners->y - 1 - drawmap_round((latitude1 - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-		xx2 = -1 + drawmap_round((longitude2 - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-		yy2 = image_corners->y - 1 - drawmap_round((latitude2 - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-		if ((xx1 < -1) || (yy1 < -1) || (xx1 >= image_corners->x) || (yy1 >= image_corners->y))  {
-			fprintf(stderr, "In draw_lines(), a coordinate exceeds the image boundaries, %d %d   %d %d\n", xx1, yy1, xx2, yy2);
+/*
+ * Compute the simplification tolerance for the current map.
+ * We use the smaller dimension of a pixel, measured at the most poleward
+ * latitude of the map, where the meridians are closest together.
+ * The conversion to meters needn't be precise, since the tolerance is
+ * only a fraction of a pixel anyway.
+ */
+void
+set_simplify_tolerance(struct image_corners *image_corners)
+{
+	double meters_x, meters_y;
+	double max_lat;
+
+	max_lat = fabs(image_corners->sw_lat) > fabs(image_corners->ne_lat) ? fabs(image_corners->sw_lat) : fabs(image_corners->ne_lat);
+	meters_x = (image_corners->ne_long - image_corners->sw_long) / (double)image_corners->x * 111320.0 * cos(max_lat * M_PI / 180.0);
+	meters_y = (image_corners->ne_lat - image_corners->sw_lat) / (double)image_corners->y * 110574.0;
+
+	simplify_tolerance = SIMPLIFY_FRACTION * (meters_x < meters_y ? meters_x : meters_y);
+	if (simplify_tolerance < 0.0)  {
+		simplify_tolerance = 0.0;
+	}
+}
+
+
+
+/*
+ * Thin out the points of a single line, as described above, and leave the
+ * survivors in simple_x and simple_y.  Return the number of survivors.
+ * The tolerance is in the same units as the coordinates.
+ */
+static int32_t
+simplify_line(double *x, double *y, int32_t number_coords, double tolerance)
+{
+	int32_t first, last, farthest;
+	int32_t i, n, top;
+	double dx, dy, length_2, d, max_d, tolerance_2;
+
+	if (number_coords > simple_size)  {
+		while (number_coords > simple_size)  {
+			simple_size = simple_size == 0 ? 1024 : simple_size << 1;
+		}
+		simple_x = (double *)realloc(simple_x, simple_size * sizeof(double));
+		simple_y = (double *)realloc(simple_y, simple_size * sizeof(double));
+		simple_stack = (int32_t *)realloc(simple_stack, 2 * simple_size * sizeof(int32_t));
+		simple_keep = (unsigned char *)realloc(simple_keep, simple_size);
+		if ((simple_x == (double *)0) || (simple_y == (double *)0) ||
+		    (simple_stack == (int32_t *)0) || (simple_keep == (unsigned char *)0))  {
+			fprintf(stderr, "realloc of line simplification storage failed\n");
 			exit(0);
 		}
+	}
 
+	memset(simple_keep, 0, number_coords);
+	simple_keep[0] = 1;
+	simple_keep[number_coords - 1] = 1;
+	tolerance_2 = tolerance * tolerance;
+
+	top = 0;
+	simple_stack[top++] = 0;
+	simple_stack[top++] = number_coords - 1;
+	while (top > 0)  {
+		last = simple_stack[--top];
+		first = simple_stack[--top];
+		if ((last - first) < 2)  {
+			continue;
+		}
 
 		/*
-		 * Now all that remains is to draw the line segment.
-		 * We begin by deciding whether x or y is the fastest-changing
-		 * coordinate.
+		 * Find the interior point farthest from the segment between first and last.
+		 * To avoid a division and a square root per point, we compare the
+		 * squared cross product with the squared tolerance times the squared length.
+		 * If first and last coincide (as they do for a closed ring),
+		 * we measure the distance to the point instead.
 		 */
-		delta_x = xx2 - xx1;
-		delta_y = yy2 - yy1;
-
-		if (fabs(delta_x) < fabs(delta_y))  {
-			steps = (int32_t)fabs(delta_y) - 1;
-
-			if (delta_y > 0.0)  {
-				delta_x = delta_x / delta_y;
-				delta_y = 1.0;
-			}
-			else if (delta_y < 0.0)  {
-				delta_x = -delta_x / delta_y;
-				delta_y = -1.0;
+		dx = x[last] - x[first];
+		dy = y[last] - y[first];
+		length_2 = dx * dx + dy * dy;
+		farthest = -1;
+		max_d = -1.0;
+		for (i = first + 1; i < last; i++)  {
+			if (length_2 > 0.0)  {
+				d = dx * (y[i] - y[first]) - dy * (x[i] - x[first]);
+				d = d * d;
 			}
 			else  {
-				delta_x = 1.0;
+				d = (x[i] - x[first]) * (x[i] - x[first]) + (y[i] - y[first]) * (y[i] - y[first]);
+			}
+			if (d > max_d)  {
+				max_d = d;
+				farthest = i;
 			}
 		}
-		else  {
-			steps = (int32_t)fabs(delta_x) - 1;
+		if (max_d > tolerance_2 * (length_2 > 0.0 ? length_2 : 1.0))  {
+			simple_keep[farthest] = 1;
+			simple_stack[top++] = first;
+			simple_stack[top++] = farthest;
+			simple_stack[top++] = farthest;
+			simple_stack[top++] = last;
+		}
+	}
 
-			if (delta_x > 0.0)  {
-				delta_y = delta_y / delta_x;
-				delta_x = 1.0;
-			}
-			else if (delta_x < 0.0)  {
-				delta_y = -delta_y / delta_x;
-				delta_x = -1.0;
-			}
-			else  {
-				delta_y = 1.0;
-			}
+	n = 0;
+	for (i = 0; i < number_coords; i++)  {
+		if (simple_keep[i] != 0)  {
+			simple_x[n] = x[i];
+			simple_y[n] = y[i];
+			n++;
 		}
+	}
+
+	return n;
+}
+
+
+/*
+ * Convert the points of a single line from UTM coordinates into image pixel
+ * coordinates, without rounding, and leave them in pixel_x and pixel_y.
+ * The line is simplified first, if that will help, and the return value
+ * is the number of points that were actually converted.
+ *
+ * All of the points are handed to redfearn_inverse_array() at once.
+ * It leaves the latitudes and longitudes in pixel_y and pixel_x,
+ * and we then convert them to image coordinates in place.
+ *
+ * If the arena has already been converted to latitude/longitude,
+ * there is no projection to save, so we convert all of the points
+ * straight into image coordinates, and then simplify them there,
+ * with a tolerance of SIMPLIFY_FRACTION pixels.
+ */
+static int32_t
+line_to_pixels(struct datum *datum, double *x, double *y, int32_t number_coords, struct image_corners *image_corners)
+{
+	int32_t i;
 
-		/* Put dots at the two endpoints. */
-		*(image_corners->ptr + (yy1 + TOP_BORDER) * x_prime + xx1 + LEFT_BORDER) = color;
-		*(image_corners->ptr + (yy2 + TOP_BORDER) * x_prime + xx2 + LEFT_BORDER) = color;
+	if ((dlg_geographic == 0) && (simplify_tolerance > 0.0) && (number_coords > 2))  {
+		number_coords = simplify_line(x, y, number_coords, simplify_tolerance);
+		x = simple_x;
+		y = simple_y;
+	}
 
-		/* Fill in pixels between the two endpoints. */
-		fxx = xx1;
-		fyy = yy1;
-		for (i = 0; i < steps; i++)  {
-			fxx = fxx + delta_x;
-			fyy = fyy + delta_y;
-			*(image_corners->ptr + (drawmap_round(fyy) + TOP_BORDER) * x_prime + drawmap_round(fxx) + LEFT_BORDER) = color;
+	if (number_coords > pixel_size)  {
+		while (number_coords > pixel_size)  {
+			pixel_size = pixel_size == 0 ? 1024 : pixel_size << 1;
+		}
+		pixel_x = (double *)realloc(pixel_x, pixel_size * sizeof(double));
+		pixel_y = (double *)realloc(pixel_y, pixel_size * sizeof(double));
+		if ((pixel_x == (double *)0) || (pixel_y == (double *)0))  {
+			fprintf(stderr, "realloc of line coordinates failed\n");
+			exit(0);
 		}
 	}
+
+	if (dlg_geographic == 0)  {
+		(void)redfearn_inverse_array(datum, x, y, utm_zone, pixel_y, pixel_x, number_coords);
+	}
+	else  {
+		memcpy(pixel_x, x, number_coords * sizeof(double));
+		memcpy(pixel_y, y, number_coords * sizeof(double));
+	}
+	for (i = 0; i < number_coords; i++)  {
+		pixel_x[i] = -1.0 + (pixel_x[i] - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long);
+		pixel_y[i] = (double)image_corners->y - 1.0 - (pixel_y[i] - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat);
+	}
+
+	if ((dlg_geographic != 0) && (simplify_tolerance > 0.0) && (number_coords > 2))  {
+		number_coords = simplify_line(pixel_x, pixel_y, number_coords, SIMPLIFY_FRACTION);
+		memcpy(pixel_x, simple_x, number_coords * sizeof(double));
+		memcpy(pixel_y, simple_y, number_coords * sizeof(double));
+	}
+
+	return number_coords;
 }
 
 
 
 /*
- * Fill in an area bounded by a polygon of the given color, beginning at the
- * given representative point.  (The polygon was previously created by the
- * line-drawing algorithm.)  The algorithm does this by filling in a given
- * point and then recursively calling itself to fill in the four nearest neighbors
- * (to the left, right, top, and bottom).
+ * Draw a series of line segments, as defined by an array of
+ * points from a DLG file.
  *
- * Two functions handle this:  fill_area() sets things up, and then
- * fill_small_area() recursively does the work.  An enterprising reader might
- * want to convert the recursion into something less likely to consume all
- * computing resources on the planet.  However, these routines generally
- * work well unless somehow the representative point falls outside of a bounded
- * polygon.  (This problem can and does occur, particularly if we aren't using a
- * one-to-one mapping between DEM elevation samples and image pixels.  Stretching
- * and scaling can goof things up and, in my experience, more often than not lead
- * to area fill problems.)
- * If this happens, then, as the routine attempts to fill large swaths of the image,
- * the recursion chomps up all available stack memory and the program goes kaboom.
- * (More commonly, the program doesn't crash, but areas of the image are incorrectly
- * covered with swaths of blue.)  Less resources would be gobbled if, instead of using
- * recursion, we simply built a stack datatype, and pushed and popped coordinates
- * onto/from it.  No program is so perfect that it can't be improved.  However,
- * the recursion itself is not the problem, but rather the errors that
- * lead to the wrong areas being filled, and thus to excess recursion.
+ * This routine used to recurse to the end of the array, and draw the
+ * segments as it popped back up the recursion stack.  That made the stack
+ * depth equal to the number of points, and converted every interior point
+ * from UTM to latitude/longitude twice, once for each segment that touches it.
+ * Now we convert all of the points once, with line_to_pixels(), and then
+ * walk the arrays to draw the segments.
  *
- * One other problem with the approach taken here is that, if a lake has a narrow
- * neck, the line segments at the sides of the neck may touch.  If this is the case,
- * then only one side of the lake will be filled in (the side containing the
- * representative point) because the neck forms a solid boundary.
+ * Each point is carried all the way into image pixel coordinates, without
+ * rounding, before any clipping is done.  Clipping a segment to the map
+ * boundaries is then a matter of clipping it to a rectangle of pixels,
+ * which clip_line() does without any of the special cases that used to
+ * arise from intersecting lines in latitude/longitude space.
+ * (It used to be possible for a segment that crossed the edge of the map
+ * to be dropped, when the intercept arithmetic didn't come out quite right.)
+ *
+ * As noted elsewhere, it is okay for the pixel coordinates to go to -1, since that
+ * is the appropriate value for image_corners->sw_long or image_corners->ne_lat.
+ */
+void
+draw_lines(struct datum *datum, double *x, double *y, int32_t number_coords, int32_t color, struct image_corners *image_corners)
+{
+	double x1, y1, x2, y2;
+	int32_t i;
+
+	if (number_coords < 2)  {
+		return;
+	}
+
+	number_coords = line_to_pixels(datum, x, y, number_coords, image_corners);
+
+	for (i = 0; i < (number_coords - 1); i++)  {
+		x1 = pixel_x[i];
+		y1 = pixel_y[i];
+		x2 = pixel_x[i + 1];
+		y2 = pixel_y[i + 1];
+		if (clip_line(&x1, &y1, &x2, &y2, -1.0, -1.0, (double)(image_corners->x - 1), (double)(image_corners->y - 1)) != 0)  {
+			if (display_list_recording != 0)  {
+				display_list_add(DL_LINE, color, drawmap_round(x1), drawmap_round(y1), drawmap_round(x2), drawmap_round(y2));
+			}
+			else  {
+				draw_line(image_corners, drawmap_round(x1), drawmap_round(y1), drawmap_round(x2), drawmap_round(y2), color);
+			}
+		}
+	}
+}
+
+
+
+/*
+ * A horizontal range of pixels, on image row y, that fill_small_area()
+ * still needs to examine.
+ */
+struct fill_span  {
+	int32_t x_low;
+	int32_t x_high;
+	int32_t y;
+};
+
+
+/*
+ * Fill in an area bounded by a polygon of the given color, beginning at the
+ * given representative point.  (The polygon was previously created by the
+ * line-drawing algorithm.)  The algorithm fills in every pixel that can be
+ * reached from the representative point by moving left, right, up, or down,
+ * without crossing a pixel of the given color.
+ *
+ * Two functions handle this:  fill_area() sets things up, and then
+ * fill_small_area() does the work.  The original version of fill_small_area()
+ * filled in a given point and then recursively called itself to fill in the
+ * four nearest neighbors.  This worked well unless somehow the representative point
+ * fell outside of a bounded polygon.  (This problem can and does occur, particularly
+ * if we aren't using a one-to-one mapping between DEM elevation samples and image pixels.
+ * Stretching and scaling can goof things up and, in my experience, more often than not
+ * lead to area fill problems.)  If this happened, then, as the routine attempted to fill
+ * large swaths of the image, the recursion chomped up all available stack memory and
+ * the program went kaboom.  Even a legitimate fill of a large lake on a large image
+ * could go millions of calls deep.  The current version fills whole horizontal runs of
+ * pixels (spans) at a time, and keeps a stack of spans that still need to be examined,
+ * in memory obtained from malloc(), rather than on the call stack.  It fills exactly the
+ * same pixels as the recursive version did.  (More commonly than crashing, by the way,
+ * a misplaced representative point results in areas of the image being incorrectly
+ * covered with swaths of blue.  The recursion itself was never the real problem, but
+ * rather the errors that lead to the wrong areas being filled.)
+ *
+ * One other problem with the approach taken here is that, if a lake has a narrow
+ * neck, the line segments at the sides of the neck may touch.  If this is the case,
+ * then only one side of the lake will be filled in (the side containing the
+ * representative point) because the neck forms a solid boundary.
  *
  * Yet another problem is that the representative point may be off the map boundaries
  * if, say, a lake is at the edge of the map and the whole lake doesn't show up on
@@ -1378,6 +1440,16 @@ DONE2:
 void
 fill_small_area(struct image_corners *image_corners, int32_t x1, int32_t y1, int32_t color)
 {
+	/*
+	 * The span stack is kept from one call to the next, since there are
+	 * usually many areas to fill.  It grows as needed, and is never freed.
+	 */
+	static struct fill_span *span_stack = (struct fill_span *)0;
+	static int32_t span_stack_size = 0;
+	int32_t num_spans;
+	int32_t x, x_left, x_right, x_low, x_high, y;
+	unsigned char *row;
+
 	/*
 	 * Check that we have not wandered outside of the area
 	 * covered by the data from this DLG file.
@@ -1387,22 +1459,71 @@ fill_small_area(struct image_corners *image_corners, int32_t x1, int32_t y1, int
 	}
 
 	/*
-	 * Fill in the given pixel, and recusively fill in the pixels to the
-	 * left, right, top, and bottom.
+	 * Each entry on the stack is a range of pixels, on a single row, that might
+	 * contain pixels in need of filling.  For each such range, we find every pixel
+	 * that isn't already of the given color, extend it to the left and right into
+	 * a maximal span of such pixels (staying within the DLG limits), fill the span,
+	 * and push the corresponding ranges on the rows above and below.
+	 *
+	 * The set of pixels filled is the set of pixels that are four-way connected to
+	 * the starting point, through pixels that are within the DLG limits and not
+	 * already of the given color.  This is the same set that the old recursive
+	 * version of this routine filled.
 	 */
-	*(image_corners->ptr + (y1 + TOP_BORDER) * x_prime + x1 + LEFT_BORDER) = color;
+	num_spans = 0;
+	x_low = x1;
+	x_high = x1;
+	y = y1;
+	for (;;)  {
+		row = image_corners->ptr + (y + TOP_BORDER) * x_prime + LEFT_BORDER;
+		for (x = x_low; x <= x_high; x++)  {
+			if (row[x] == color)  {
+				continue;
+			}
 
-	if (*(image_corners->ptr + (y1 - 1 + TOP_BORDER) * x_prime + x1 + LEFT_BORDER) != color)  {
-		fill_small_area(image_corners, x1, y1 - 1, color);
-	}
-	if (*(image_corners->ptr + (y1 + 1 + TOP_BORDER) * x_prime + x1 + LEFT_BORDER) != color)  {
-		fill_small_area(image_corners, x1, y1 + 1, color);
-	}
-	if (*(image_corners->ptr + (y1 + TOP_BORDER) * x_prime + x1 - 1 + LEFT_BORDER) != color)  {
-		fill_small_area(image_corners, x1 - 1, y1, color);
-	}
-	if (*(image_corners->ptr + (y1 + TOP_BORDER) * x_prime + x1 + 1 + LEFT_BORDER) != color)  {
-		fill_small_area(image_corners, x1 + 1, y1, color);
+			/* Find the full extent of the span, and fill it in. */
+			x_left = x;
+			while ((x_left > dlg_x_low) && (row[x_left - 1] != color))  {
+				x_left--;
+			}
+			x_right = x;
+			while ((x_right < dlg_x_high) && (row[x_right + 1] != color))  {
+				x_right++;
+			}
+			memset(row + x_left, color, x_right - x_left + 1);
+
+			/* Push the neighboring ranges on the rows above and below. */
+			if ((num_spans + 2) > span_stack_size)  {
+				span_stack_size = span_stack_size == 0 ? 1024 : span_stack_size << 1;
+				span_stack = (struct fill_span *)realloc(span_stack, span_stack_size * sizeof(struct fill_span));
+				if (span_stack == (struct fill_span *)0)  {
+					fprintf(stderr, "realloc of span_stack failed\n");
+					exit(0);
+				}
+			}
+			if (y > dlg_y_low)  {
+				span_stack[num_spans].x_low = x_left;
+				span_stack[num_spans].x_high = x_right;
+				span_stack[num_spans].y = y - 1;
+				num_spans++;
+			}
+			if (y < dlg_y_high)  {
+				span_stack[num_spans].x_low = x_left;
+				span_stack[num_spans].x_high = x_right;
+				span_stack[num_spans].y = y + 1;
+				num_spans++;
+			}
+
+			x = x_right + 1;
+		}
+
+		if (num_spans == 0)  {
+			break;
+		}
+		num_spans--;
+		x_low = span_stack[num_spans].x_low;
+		x_high = span_stack[num_spans].x_high;
+		y = span_stack[num_spans].y;
 	}
 }
 void
@@ -1412,7 +1533,13 @@ fill_area(struct datum *datum, double px1, double py1, int32_t color, struct ima
 	int32_t xx1, yy1;
 
 	/* Find the latitude and longitude of the representative point and convert them into index values. */
-	(void)redfearn_inverse(datum, px1, py1, utm_zone, &latitude1, &longitude1);
+	if (dlg_geographic == 0)  {
+		(void)redfearn_inverse(datum, px1, py1, utm_zone, &latitude1, &longitude1);
+	}
+	else  {
+		latitude1 = py1;
+		longitude1 = px1;
+	}
 
 	xx1 = -1 + drawmap_round((longitude1 - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
 	yy1 = image_corners->y - 1 - drawmap_round((latitude1 - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
@@ -1450,6 +1577,24 @@ fill_area(struct datum *datum, double px1, double py1, int32_t color, struct ima
 //	}
 
 
+	if (display_list_recording != 0)  {
+		display_list_add(DL_FLOOD, color, xx1, yy1, 0, 0);
+		return;
+	}
+	flood_area(image_corners, xx1, yy1, color);
+}
+
+
+
+/*
+ * Flood fill from the pixel (xx1, yy1), after the representative point
+ * of an area has been converted into image coordinates by fill_area().
+ * This is separate from fill_area() so that a recorded display list
+ * can replay it.  See dlg_display.c.
+ */
+void
+flood_area(struct image_corners *image_corners, int32_t xx1, int32_t yy1, int32_t color)
+{
 	/*
 	 * Some small areas are so small that the lines around their borders have
 	 * already filled them in.  If the representative point is already set to
@@ -1473,94 +1618,1209 @@ fill_area(struct datum *datum, double px1, double py1, int32_t color, struct ima
 		return;
 	}
 
-	/* Recursively call fill_small_area() to do most of the work. */
+	/* Call fill_small_area() to do most of the work. */
 	fill_small_area(image_corners, xx1, yy1, color);
 }
 
 
 
 
+
+
 /*
- * Parse the given attribute file and store the results
- * in the appropriate storage areas.
+ * The routines above fill an area by seeding a flood fill at the area's
+ * representative point, and letting it spread until it runs into the lines
+ * that were drawn around the area.  As the long comment above explains,
+ * this can leak out of an area, or miss parts of it, or miss it entirely.
+ *
+ * However, the DLG data carry complete topology:  each line records the
+ * area on its left and the area on its right.  Thus, the boundary of
+ * any given area consists of exactly those lines that have the area on
+ * one side, and some other area on the other side.  (Lines with the same
+ * area on both sides are dangling lines within the area, and aren't part
+ * of its boundary.)  Chained together end-to-end, through their start and
+ * end nodes, these lines form one or more closed rings:  an outer boundary,
+ * plus one boundary around each island.  (In DLG files, areas that extend
+ * past the edges of the data are closed off by the neatlines, so the rings
+ * are closed even in that case.)
+ *
+ * Once we have the rings, we can rasterize them directly with a
+ * conventional scanline polygon fill, using an active edge table.
+ * A pixel is filled if its center falls inside an odd number of rings,
+ * which takes care of islands without any special effort.  The cost is
+ * proportional to the number of edges plus the number of pixels filled,
+ * regardless of the shape of the area, and the result doesn't depend on the
+ * representative point, or on which boundary pixels have already been drawn.
+ *
+ * This is done in two stages.  build_area_index() runs once per DLG file,
+ * after all of the lines have been read in.  It builds a table of
+ * (area, line) pairs, sorted by area, so that we can quickly find the lines
+ * that bound any given area.  fill_area_polygon() then assembles the rings
+ * for a single area, and fills them.  If it can't assemble closed rings
+ * (because of missing or inconsistent topology), it falls back to the
+ * older fill_area().  It also falls back for area 1, the outside area,
+ * since the "inside" of its neatline ring is actually everything else.
  */
-void
-process_attrib(char *attribute_file)
+struct area_line  {
+	int32_t area;
+	int32_t line;
+};
+struct ring_end  {
+	int32_t node;
+	int32_t index;
+};
+struct poly_edge  {
+	int32_t row_low;	// first image row whose center the edge crosses
+	int32_t row_high;	// last image row whose center the edge crosses
+	double x;		// x coordinate of the edge at row_low
+	double dxdy;		// change in x per row
+};
+
+static struct area_line *area_lines = (struct area_line *)0;
+static int32_t area_lines_size = 0;
+static int32_t num_area_lines = 0;
+
+static struct ring_end *ring_ends = (struct ring_end *)0;
+static unsigned char *ring_used = (unsigned char *)0;
+static int32_t ring_size = 0;
+
+static struct poly_edge *poly_edges = (struct poly_edge *)0;
+static int32_t poly_edges_size = 0;
+static int32_t num_poly_edges;
+
+static double *crossings = (double *)0;
+static int32_t *active_edges = (int32_t *)0;
+static int32_t active_size = 0;
+
+
+
+static int
+compare_area_lines(const void *a, const void *b)
 {
-	int gz_flag;
-	int attribute_fdesc;
-	int32_t ret_val;
-	char *ptr;
-	char buf[MAX_ATTRIB_RECORD_LENGTH];
+	const struct area_line *al = (const struct area_line *)a;
+	const struct area_line *bl = (const struct area_line *)b;
 
+	if (al->area != bl->area)  {
+		return al->area < bl->area ? -1 : 1;
+	}
+	if (al->line != bl->line)  {
+		return al->line < bl->line ? -1 : 1;
+	}
+	return 0;
+}
 
-	num_A_attrib = 0;
-	num_L_attrib = 0;
-	if (attribute_file != (char *)0)  {
-		if (strcmp(attribute_file + strlen(attribute_file) - 3, ".gz") == 0)  {
-			gz_flag = 1;
-			if ((attribute_fdesc = buf_open_z(attribute_file, O_RDONLY)) < 0)  {
-				fprintf(stderr, "Can't open %s for reading, errno = %d\n", attribute_file, errno);
+static int
+compare_ring_ends(const void *a, const void *b)
+{
+	const struct ring_end *ae = (const struct ring_end *)a;
+	const struct ring_end *be = (const struct ring_end *)b;
+
+	if (ae->node != be->node)  {
+		return ae->node < be->node ? -1 : 1;
+	}
+	if (ae->index != be->index)  {
+		return ae->index < be->index ? -1 : 1;
+	}
+	return 0;
+}
+
+static int
+compare_poly_edges(const void *a, const void *b)
+{
+	const struct poly_edge *ae = (const struct poly_edge *)a;
+	const struct poly_edge *be = (const struct poly_edge *)b;
+
+	if (ae->row_low != be->row_low)  {
+		return ae->row_low < be->row_low ? -1 : 1;
+	}
+	return 0;
+}
+
+
+
+/*
+ * Build the sorted table of (area, line) pairs for the lines
+ * currently stored in the lines array.
+ */
+void
+build_area_index(int32_t num_lines)
+{
+	int32_t i;
+
+	num_area_lines = 0;
+	for (i = 0; i < num_lines; i++)  {
+		if (lines[i].left_area == lines[i].right_area)  {
+			continue;
+		}
+		if ((num_area_lines + 2) > area_lines_size)  {
+			area_lines_size = area_lines_size == 0 ? 4096 : area_lines_size << 1;
+			area_lines = (struct area_line *)realloc(area_lines, area_lines_size * sizeof(struct area_line));
+			if (area_lines == (struct area_line *)0)  {
+				fprintf(stderr, "realloc of area_lines failed\n");
 				exit(0);
 			}
 		}
-		else  {
-			gz_flag = 0;
-			if ((attribute_fdesc = buf_open(attribute_file, O_RDONLY)) < 0)  {
-				fprintf(stderr, "Can't open %s for reading, errno = %d\n", attribute_file, errno);
-				exit(0);
+		if (lines[i].left_area > 0)  {
+			area_lines[num_area_lines].area = lines[i].left_area;
+			area_lines[num_area_lines].line = i;
+			num_area_lines++;
+		}
+		if (lines[i].right_area > 0)  {
+			area_lines[num_area_lines].area = lines[i].right_area;
+			area_lines[num_area_lines].line = i;
+			num_area_lines++;
+		}
+	}
+	qsort(area_lines, num_area_lines, sizeof(struct area_line), compare_area_lines);
+}
+
+
+
+/*
+ * Convert the segments of a single line into polygon edges, in image coordinates.
+ * The image coordinates come from line_to_pixels(), just as they do for draw_lines().
+ */
+static void
+add_poly_edges(struct datum *datum, double *x, double *y, int32_t number_coords, struct image_corners *image_corners)
+{
+	double x1, y1, x2, y2;
+	double row_low, row_high;
+	int32_t i;
+
+	number_coords = line_to_pixels(datum, x, y, number_coords, image_corners);
+
+	x1 = 0.0;	// Keep the compiler quiet.
+	y1 = 0.0;	// Keep the compiler quiet.
+	for (i = 0; i < number_coords; i++)  {
+		x2 = pixel_x[i];
+		y2 = pixel_y[i];
+
+		if (i > 0)  {
+			/*
+			 * The edge crosses the center of every row r with
+			 * min(y1, y2) <= r < max(y1, y2).  Horizontal edges,
+			 * and short edges between row centers, cross no rows at all.
+			 */
+			if (y1 < y2)  {
+				row_low = ceil(y1);
+				row_high = ceil(y2) - 1.0;
+			}
+			else  {
+				row_low = ceil(y2);
+				row_high = ceil(y1) - 1.0;
+			}
+			/*
+			 * Rows outside of the area covered by the DLG file are never
+			 * filled, so trim the edge to that area (or discard it).
+			 */
+			if (row_low < (double)dlg_y_low)  {
+				row_low = (double)dlg_y_low;
+			}
+			if (row_high > (double)dlg_y_high)  {
+				row_high = (double)dlg_y_high;
+			}
+			if (row_low <= row_high)  {
+				if (num_poly_edges >= poly_edges_size)  {
+					poly_edges_size = poly_edges_size == 0 ? 4096 : poly_edges_size << 1;
+					poly_edges = (struct poly_edge *)realloc(poly_edges, poly_edges_size * sizeof(struct poly_edge));
+					if (poly_edges == (struct poly_edge *)0)  {
+						fprintf(stderr, "realloc of poly_edges failed\n");
+						exit(0);
+					}
+				}
+				poly_edges[num_poly_edges].row_low = (int32_t)row_low;
+				poly_edges[num_poly_edges].row_high = (int32_t)row_high;
+				poly_edges[num_poly_edges].dxdy = (x2 - x1) / (y2 - y1);
+				poly_edges[num_poly_edges].x = x1 + (row_low - y1) * poly_edges[num_poly_edges].dxdy;
+				num_poly_edges++;
 			}
 		}
+		x1 = x2;
+		y1 = y2;
+	}
+}
 
-		fprintf(stderr, "Processing Attribute file:  %s\n", attribute_file);
 
-		while ( 1 )  {
-			if (gz_flag == 0)  {
-				if ((ret_val = get_a_line(attribute_fdesc, buf, MAX_ATTRIB_RECORD_LENGTH)) <= 0)  {
-					break;
+
+/*
+ * Fill in the area with the given ID, using its boundary rings.
+ * The representative point (px1, py1) is only used if we have
+ * to fall back to fill_area().
+ */
+void
+fill_area_polygon(struct datum *datum, int32_t area_id, double px1, double py1, int32_t color, struct image_corners *image_corners)
+{
+	int32_t i, j, k, n;
+	int32_t first, last, low, high, mid;
+	int32_t start_node, cur_node, line;
+	int32_t row, next_edge, num_active, num_crossings;
+	int32_t x_low, x_high;
+	double x, x_tmp;
+	unsigned char *ptr;
+
+	if (area_id == 1)  {
+		fill_area(datum, px1, py1, color, image_corners);
+		return;
+	}
+
+	/* Find the lines that bound this area. */
+	low = 0;
+	high = num_area_lines;
+	while (low < high)  {
+		mid = (low + high) >> 1;
+		if (area_lines[mid].area < area_id)  {
+			low = mid + 1;
+		}
+		else  {
+			high = mid;
+		}
+	}
+	first = low;
+	for (last = first; (last < num_area_lines) && (area_lines[last].area == area_id); last++)  {
+		;
+	}
+	n = last - first;
+	if (n == 0)  {
+		fill_area(datum, px1, py1, color, image_corners);
+		return;
+	}
+
+	/*
+	 * Build a table of line ends, sorted by node ID, so that
+	 * we can find the line(s) that continue a ring from a given node.
+	 */
+	if ((n << 1) > ring_size)  {
+		ring_size = n << 1;
+		ring_ends = (struct ring_end *)realloc(ring_ends, ring_size * sizeof(struct ring_end));
+		ring_used = (unsigned char *)realloc(ring_used, ring_size);
+		if ((ring_ends == (struct ring_end *)0) || (ring_used == (unsigned char *)0))  {
+			fprintf(stderr, "realloc of ring_ends failed\n");
+			exit(0);
+		}
+	}
+	for (i = 0; i < n; i++)  {
+		line = area_lines[first + i].line;
+		ring_ends[i << 1].node = lines[line].start_node;
+		ring_ends[i << 1].index = i;
+		ring_ends[(i << 1) + 1].node = lines[line].end_node;
+		ring_ends[(i << 1) + 1].index = i;
+		ring_used[i] = 0;
+	}
+	qsort(ring_ends, n << 1, sizeof(struct ring_end), compare_ring_ends);
+
+	/*
+	 * Walk the rings, converting each line into edges as we go.
+	 * Since we use the odd/even rule, it doesn't matter which direction
+	 * we traverse each line, or in what order the rings are found.
+	 * If a ring fails to close, the topology isn't usable, and we fall back.
+	 */
+	num_poly_edges = 0;
+	for (i = 0; i < n; i++)  {
+		if (ring_used[i] != 0)  {
+			continue;
+		}
+		ring_used[i] = 1;
+		line = area_lines[first + i].line;
+		add_poly_edges(datum, &dlg_arena.x[lines[line].point], &dlg_arena.y[lines[line].point], lines[line].number_coords, image_corners);
+		start_node = lines[line].start_node;
+		cur_node = lines[line].end_node;
+
+		while (cur_node != start_node)  {
+			low = 0;
+			high = n << 1;
+			while (low < high)  {
+				mid = (low + high) >> 1;
+				if (ring_ends[mid].node < cur_node)  {
+					low = mid + 1;
+				}
+				else  {
+					high = mid;
 				}
 			}
-			else  {
-				if ((ret_val = get_a_line_z(attribute_fdesc, buf, MAX_ATTRIB_RECORD_LENGTH)) <= 0)  {
+			for (j = low; (j < (n << 1)) && (ring_ends[j].node == cur_node); j++)  {
+				if (ring_used[ring_ends[j].index] == 0)  {
 					break;
 				}
 			}
+			if ((j >= (n << 1)) || (ring_ends[j].node != cur_node))  {
+				/* The ring is open. */
+				fill_area(datum, px1, py1, color, image_corners);
+				return;
+			}
+			k = ring_ends[j].index;
+			ring_used[k] = 1;
+			line = area_lines[first + k].line;
+			add_poly_edges(datum, &dlg_arena.x[lines[line].point], &dlg_arena.y[lines[line].point], lines[line].number_coords, image_corners);
+			if (lines[line].start_node == cur_node)  {
+				cur_node = lines[line].end_node;
+			}
+			else  {
+				cur_node = lines[line].start_node;
+			}
+		}
+	}
+	if (num_poly_edges == 0)  {
+		return;
+	}
 
-			buf[ret_val - 1] = '\0';	/* Put a null in place of the newline */
 
-			switch(buf[0])  {
-			case '\0':
-			case '\n':
-			case '\r':
-			case ' ':
-			case '\t':
-				/* Blank line, or line that begins with white space.  Ignore. */
-				break;
-			case '#':
-				/* Comment line.  Ignore. */
-				break;
-			case 'N':
-				/* We don't currently use Node attributes, so do nothing with them. */
-				fprintf(stderr, "Ignoring Node attribute:  %s\n", buf);
-				break;
-			case 'A':
-				/* Area attribute. */
-				if (num_A_attrib >= MAX_A_ATTRIB)  {
-					fprintf(stderr, "Out of space for Area attributes, ignoring:  %s\n", buf);
-					break;
+	/*
+	 * Scan-convert the edges.  The edges are sorted by their first row, and
+	 * we keep a list of active edges (the ones that cross the current row).
+	 * For each row, we find the x coordinates at which the active edges
+	 * cross the row, sort them, and fill the pixels whose centers lie between
+	 * alternate pairs of crossings.  We don't fill outside the area covered
+	 * by the current DLG file.
+	 */
+	qsort(poly_edges, num_poly_edges, sizeof(struct poly_edge), compare_poly_edges);
+	if (num_poly_edges > active_size)  {
+		active_size = num_poly_edges;
+		active_edges = (int32_t *)realloc(active_edges, active_size * sizeof(int32_t));
+		crossings = (double *)realloc(crossings, active_size * sizeof(double));
+		if ((active_edges == (int32_t *)0) || (crossings == (double *)0))  {
+			fprintf(stderr, "realloc of active_edges failed\n");
+			exit(0);
+		}
+	}
+	num_active = 0;
+	next_edge = 0;
+	for (row = poly_edges[0].row_low; row <= dlg_y_high; row++)  {
+		/* Add newly-active edges, and drop edges that are finished. */
+		while ((next_edge < num_poly_edges) && (poly_edges[next_edge].row_low <= row))  {
+			active_edges[num_active++] = next_edge++;
+		}
+		for (i = 0, j = 0; i < num_active; i++)  {
+			if (poly_edges[active_edges[i]].row_high >= row)  {
+				active_edges[j++] = active_edges[i];
+			}
+		}
+		num_active = j;
+		if ((num_active == 0) && (next_edge >= num_poly_edges))  {
+			break;
+		}
+
+		/* Find and sort the crossings.  There are usually only a few, so an insertion sort will do. */
+		num_crossings = 0;
+		for (i = 0; i < num_active; i++)  {
+			x = poly_edges[active_edges[i]].x + (double)(row - poly_edges[active_edges[i]].row_low) * poly_edges[active_edges[i]].dxdy;
+			for (j = num_crossings; (j > 0) && (crossings[j - 1] > x); j--)  {
+				crossings[j] = crossings[j - 1];
+			}
+			crossings[j] = x;
+			num_crossings++;
+		}
+
+		ptr = image_corners->ptr + (row + TOP_BORDER) * x_prime + LEFT_BORDER;
+		for (i = 0; (i + 1) < num_crossings; i += 2)  {
+			x_tmp = ceil(crossings[i]);
+			x_low = x_tmp < (double)dlg_x_low ? dlg_x_low : (int32_t)x_tmp;
+			x_tmp = floor(crossings[i + 1]);
+			x_high = x_tmp > (double)dlg_x_high ? dlg_x_high : (int32_t)x_tmp;
+			if (x_low <= x_high)  {
+				if (display_list_recording != 0)  {
+					display_list_add(DL_SPAN, color, row, x_low, x_high, 0);
 				}
-				attributes_A[num_A_attrib].major = strtol(&buf[1], &ptr, 10);
-				attributes_A[num_A_attrib].minor = strtol(ptr, &ptr, 10);
-				num_A_attrib++;
-				break;
-			case 'L':
-				/* Line attribute. */
-				if (num_L_attrib >= MAX_L_ATTRIB)  {
-					fprintf(stderr, "Out of space for Line attributes, ignoring:  %s\n", buf);
-					break;
+				else  {
+					memset(ptr + x_low, color, x_high - x_low + 1);
 				}
-				attributes_L[num_L_attrib].major = strtol(&buf[1], &ptr, 10);
-				attributes_L[num_L_attrib].minor = strtol(ptr, &ptr, 10);
+			}
+		}
+	}
+}
+
+
+
+/*
+ * Empty the DLG arena.  The memory is retained, since
+ * the next DLG file will probably need about as much.
+ */
+void
+dlg_arena_reset(void)
+{
+	dlg_arena.num_coords = 0;
+	dlg_arena.num_attrib = 0;
+	dlg_geographic = 0;
+	dlg_indexed = 0;
+}
+
+
+
+/*
+ * Append a coordinate pair to the DLG arena, and return its index.
+ */
+int32_t
+dlg_arena_add_coord(double x, double y)
+{
+	if (dlg_arena.num_coords >= dlg_arena.coords_size)  {
+		dlg_arena.coords_size = dlg_arena.coords_size == 0 ? 65536 : dlg_arena.coords_size << 1;
+		dlg_arena.x = (double *)realloc(dlg_arena.x, dlg_arena.coords_size * sizeof(double));
+		dlg_arena.y = (double *)realloc(dlg_arena.y, dlg_arena.coords_size * sizeof(double));
+		if ((dlg_arena.x == (double *)0) || (dlg_arena.y == (double *)0))  {
+			fprintf(stderr, "realloc of DLG coordinate storage failed\n");
+			exit(0);
+		}
+	}
+	dlg_arena.x[dlg_arena.num_coords] = x;
+	dlg_arena.y[dlg_arena.num_coords] = y;
+
+	return dlg_arena.num_coords++;
+}
+
+
+
+/*
+ * Append an attribute to the DLG arena, and return its index.
+ */
+int32_t
+dlg_arena_add_attrib(short major, short minor)
+{
+	if (dlg_arena.num_attrib >= dlg_arena.attrib_size)  {
+		dlg_arena.attrib_size = dlg_arena.attrib_size == 0 ? 16384 : dlg_arena.attrib_size << 1;
+		dlg_arena.attrib = (struct attribute *)realloc(dlg_arena.attrib, dlg_arena.attrib_size * sizeof(struct attribute));
+		if (dlg_arena.attrib == (struct attribute *)0)  {
+			fprintf(stderr, "realloc of DLG attribute storage failed\n");
+			exit(0);
+		}
+	}
+	dlg_arena.attrib[dlg_arena.num_attrib].major = major;
+	dlg_arena.attrib[dlg_arena.num_attrib].minor = minor;
+
+	return dlg_arena.num_attrib++;
+}
+
+
+
+/*
+ * Grow one of the nodes, areas, or lines arrays, if necessary, so that it
+ * can hold at least num_items items.  Return the (possibly moved) array.
+ * As with the arena, the size at least doubles each time.
+ */
+static void *
+grow_table(void *table, int32_t *table_size, int32_t num_items, size_t item_size, char *name)
+{
+	int32_t new_size;
+
+	if (num_items <= *table_size)  {
+		return table;
+	}
+	new_size = *table_size == 0 ? 4096 : *table_size << 1;
+	while (new_size < num_items)  {
+		new_size = new_size << 1;
+	}
+	table = realloc(table, new_size * item_size);
+	if (table == (void *)0)  {
+		fprintf(stderr, "realloc of DLG %s storage failed\n", name);
+		exit(0);
+	}
+	*table_size = new_size;
+
+	return table;
+}
+
+
+
+/*
+ * Make room for at least the given number of nodes, areas, or lines.
+ * The parsers call these before storing each new item, and may also call
+ * them up front, when the file header says how many items to expect.
+ * The arrays may move, so don't hold pointers into them across these calls.
+ */
+void
+dlg_reserve_nodes(int32_t num_nodes)
+{
+	nodes = (struct nodes *)grow_table(nodes, &nodes_size, num_nodes, sizeof(struct nodes), "node");
+}
+
+void
+dlg_reserve_areas(int32_t num_areas)
+{
+	areas = (struct areas *)grow_table(areas, &areas_size, num_areas, sizeof(struct areas), "area");
+}
+
+void
+dlg_reserve_lines(int32_t num_lines)
+{
+	lines = (struct lines *)grow_table(lines, &lines_size, num_lines, sizeof(struct lines), "line");
+}
+
+
+
+/*
+ * Trade the current DLG file (the arena, and the nodes, areas, and lines arrays)
+ * for the one held in *file.  Calling this twice puts everything back.
+ */
+void
+dlg_file_swap(struct dlg_file *file)
+{
+	struct dlg_file tmp;
+
+	tmp.arena = dlg_arena;
+	tmp.nodes = nodes;
+	tmp.nodes_size = nodes_size;
+	tmp.areas = areas;
+	tmp.areas_size = areas_size;
+	tmp.lines = lines;
+	tmp.lines_size = lines_size;
+
+	dlg_arena = file->arena;
+	nodes = file->nodes;
+	nodes_size = file->nodes_size;
+	areas = file->areas;
+	areas_size = file->areas_size;
+	lines = file->lines;
+	lines_size = file->lines_size;
+
+	*file = tmp;
+}
+
+
+
+/*
+ * Most of the lines in a DLG file often lie well outside of the map window,
+ * particularly when a small window is cut out of a 100K DLG file.  Projecting
+ * and clipping such lines is wasted work, so we give each line a bounding box,
+ * in the file's own UTM coordinates, and compare it with a bounding box for
+ * the map window, converted into those same coordinates.  A line whose box
+ * misses the window box is discarded without any projection at all.
+ *
+ * The window box is only used to throw lines away, so it must contain the
+ * whole window.  The edges of the window are parallels and meridians, which
+ * are curved in UTM, but the extreme coordinates along each edge occur either
+ * at the corners, or where a parallel crosses the central meridian, or where
+ * a meridian crosses the equator.  We convert those points, and then pad the
+ * box by WINDOW_PAD meters.  The padding covers rounding, the small difference
+ * between the forward and inverse projections, and the small bulge that occurs
+ * because the segments are drawn as straight lines in latitude/longitude
+ * rather than in UTM.
+ *
+ * If the window extends more than MAX_WINDOW_OFFSET degrees from the central
+ * meridian of the zone, or reaches into the polar regions, then the projection
+ * becomes unreliable, and we simply don't reject anything.
+ *
+ * Areas get bounding boxes too, built from the boxes of the lines around them.
+ *
+ * Rather than test every box against the window, the renderer asks
+ * window_lines() and window_areas() for the candidates.  These drop the boxes
+ * into a uniform grid (see dlg_index.c) and return only the items in the cells
+ * that the window overlaps.  The candidates still get the box test, since
+ * a cell can overlap the window without every item in it doing so.
+ */
+#define WINDOW_PAD		100.0	// meters
+#define MAX_WINDOW_OFFSET	20.0	// degrees
+
+static struct dlg_box window_box;
+static int32_t window_valid = 0;
+
+/*
+ * Spatial indexes over the lines and areas of the current DLG file.
+ * They are normally built when they are first needed, but the DLG cache
+ * stores them, and sets dlg_indexed when it reads them back.
+ */
+struct dlg_index line_index;
+struct dlg_index area_index;
+static int32_t *all_items = (int32_t *)0;
+static int32_t all_items_size = 0;
+
+#define MIN_INDEX_ITEMS		256	// Below this many items, a linear scan is just as good as the index
+
+
+
+/*
+ * Compute the bounding box of a single line, from its coordinates in the arena.
+ */
+void
+set_line_bounds(struct lines *line)
+{
+	double *x = &dlg_arena.x[line->point];
+	double *y = &dlg_arena.y[line->point];
+	struct dlg_box *box = &line->bounds;
+	int32_t i;
+
+	if (line->number_coords <= 0)  {
+		/* An empty box, which lies outside of any window. */
+		box->x_min = 1.0;
+		box->x_max = -1.0;
+		box->y_min = 1.0;
+		box->y_max = -1.0;
+		return;
+	}
+
+	box->x_min = box->x_max = x[0];
+	box->y_min = box->y_max = y[0];
+	for (i = 1; i < line->number_coords; i++)  {
+		if (x[i] < box->x_min)  {
+			box->x_min = x[i];
+		}
+		else if (x[i] > box->x_max)  {
+			box->x_max = x[i];
+		}
+		if (y[i] < box->y_min)  {
+			box->y_min = y[i];
+		}
+		else if (y[i] > box->y_max)  {
+			box->y_max = y[i];
+		}
+	}
+}
+
+
+
+/*
+ * Compute the bounding box of each area, as the union of the boxes of the
+ * lines that bound it, plus its representative point (in case fill_area_polygon()
+ * has to fall back to fill_area()).  This uses the table built by build_area_index(),
+ * so it must be called after that.
+ */
+void
+set_area_bounds(int32_t num_areas)
+{
+	struct dlg_box *box;
+	int32_t i, j, line;
+	int32_t low, high, mid;
+
+	for (i = 0; i < num_areas; i++)  {
+		box = &areas[i].bounds;
+		box->x_min = box->x_max = areas[i].x;
+		box->y_min = box->y_max = areas[i].y;
+
+		low = 0;
+		high = num_area_lines;
+		while (low < high)  {
+			mid = (low + high) >> 1;
+			if (area_lines[mid].area < areas[i].id)  {
+				low = mid + 1;
+			}
+			else  {
+				high = mid;
+			}
+		}
+		for (j = low; (j < num_area_lines) && (area_lines[j].area == areas[i].id); j++)  {
+			line = area_lines[j].line;
+			if (lines[line].number_coords <= 0)  {
+				continue;
+			}
+			if (lines[line].bounds.x_min < box->x_min)  {
+				box->x_min = lines[line].bounds.x_min;
+			}
+			if (lines[line].bounds.x_max > box->x_max)  {
+				box->x_max = lines[line].bounds.x_max;
+			}
+			if (lines[line].bounds.y_min < box->y_min)  {
+				box->y_min = lines[line].bounds.y_min;
+			}
+			if (lines[line].bounds.y_max > box->y_max)  {
+				box->y_max = lines[line].bounds.y_max;
+			}
+		}
+	}
+}
+
+
+
+/*
+ * Convert the map window into a UTM bounding box, in the zone of
+ * the current DLG file.  This must be called after utm_zone is known,
+ * and before line_outside_window() is used.  (If the arena has been
+ * converted to longitude/latitude, the box is in those coordinates.)
+ */
+void
+set_window_bounds(struct datum *datum, struct image_corners *image_corners)
+{
+	double latitude[8], longitude[8];
+	double utm_x[8], utm_y[8];
+	double central_meridian;
+	int32_t num_points;
+	int32_t i;
+
+	/*
+	 * If the arena holds latitude/longitude, then the window is simply the map
+	 * corners, padded by a pixel to cover rounding.  The segments are straight lines
+	 * in latitude/longitude, just as they are on the map, so there is no bulge to cover.
+	 */
+	if (dlg_geographic != 0)  {
+		window_box.x_min = image_corners->sw_long - (image_corners->ne_long - image_corners->sw_long) / (double)image_corners->x;
+		window_box.x_max = image_corners->ne_long + (image_corners->ne_long - image_corners->sw_long) / (double)image_corners->x;
+		window_box.y_min = image_corners->sw_lat - (image_corners->ne_lat - image_corners->sw_lat) / (double)image_corners->y;
+		window_box.y_max = image_corners->ne_lat + (image_corners->ne_lat - image_corners->sw_lat) / (double)image_corners->y;
+		window_valid = 1;
+		return;
+	}
+
+	window_valid = 0;
+	if ((utm_zone < 1) || (utm_zone > 60))  {
+		return;
+	}
+	central_meridian = (double)(6 * utm_zone - 183);
+	if (((image_corners->sw_long - central_meridian) < -MAX_WINDOW_OFFSET) ||
+	    ((image_corners->ne_long - central_meridian) > MAX_WINDOW_OFFSET) ||
+	    (image_corners->sw_lat < -80.0) || (image_corners->ne_lat > 84.0))  {
+		return;
+	}
+
+	latitude[0] = image_corners->sw_lat;	longitude[0] = image_corners->sw_long;
+	latitude[1] = image_corners->sw_lat;	longitude[1] = image_corners->ne_long;
+	latitude[2] = image_corners->ne_lat;	longitude[2] = image_corners->sw_long;
+	latitude[3] = image_corners->ne_lat;	longitude[3] = image_corners->ne_long;
+	num_points = 4;
+	if ((image_corners->sw_long < central_meridian) && (image_corners->ne_long > central_meridian))  {
+		latitude[num_points] = image_corners->sw_lat;	longitude[num_points++] = central_meridian;
+		latitude[num_points] = image_corners->ne_lat;	longitude[num_points++] = central_meridian;
+	}
+	if ((image_corners->sw_lat < 0.0) && (image_corners->ne_lat > 0.0))  {
+		latitude[num_points] = 0.0;	longitude[num_points++] = image_corners->sw_long;
+		latitude[num_points] = 0.0;	longitude[num_points++] = image_corners->ne_long;
+	}
+	if (redfearn_array(datum, utm_x, utm_y, utm_zone, latitude, longitude, num_points) != 0)  {
+		return;
+	}
+
+	window_box.x_min = window_box.x_max = utm_x[0];
+	window_box.y_min = window_box.y_max = utm_y[0];
+	for (i = 1; i < num_points; i++)  {
+		if (utm_x[i] < window_box.x_min)  {
+			window_box.x_min = utm_x[i];
+		}
+		if (utm_x[i] > window_box.x_max)  {
+			window_box.x_max = utm_x[i];
+		}
+		if (utm_y[i] < window_box.y_min)  {
+			window_box.y_min = utm_y[i];
+		}
+		if (utm_y[i] > window_box.y_max)  {
+			window_box.y_max = utm_y[i];
+		}
+	}
+	window_box.x_min -= WINDOW_PAD;
+	window_box.y_min -= WINDOW_PAD;
+	window_box.x_max += WINDOW_PAD;
+	window_box.y_max += WINDOW_PAD;
+	window_valid = 1;
+}
+
+
+
+/*
+ * Return nonzero if the given bounding box lies entirely outside of the map window.
+ */
+static int32_t
+box_outside_window(struct dlg_box *box)
+{
+	if (window_valid == 0)  {
+		return 0;
+	}
+
+	return (box->x_max < window_box.x_min) || (box->x_min > window_box.x_max) ||
+	       (box->y_max < window_box.y_min) || (box->y_min > window_box.y_max);
+}
+
+
+
+/*
+ * Return nonzero if the given line lies entirely outside of the map window.
+ */
+int32_t
+line_outside_window(struct lines *line)
+{
+	return box_outside_window(&line->bounds);
+}
+
+
+
+/*
+ * Return nonzero if the given area lies entirely outside of the map window.
+ */
+int32_t
+area_outside_window(struct areas *area)
+{
+	return box_outside_window(&area->bounds);
+}
+
+
+
+/*
+ * Return a list of all of the item indices from 0 through num_items - 1.
+ * This is what the renderer walks when there is no usable index.
+ */
+static int32_t
+every_item(int32_t num_items, int32_t **list)
+{
+	int32_t i;
+
+	if (num_items > all_items_size)  {
+		all_items_size = num_items;
+		all_items = (int32_t *)realloc(all_items, all_items_size * sizeof(int32_t));
+		if (all_items == (int32_t *)0)  {
+			fprintf(stderr, "realloc of all_items failed\n");
+			exit(0);
+		}
+	}
+	for (i = 0; i < num_items; i++)  {
+		all_items[i] = i;
+	}
+	*list = all_items;
+
+	return num_items;
+}
+
+
+
+/*
+ * Find the lines that might fall within the map window, and return them
+ * (in ascending order, so that they are drawn in the same order as before)
+ * via *list.  The return value is the number of lines in the list.
+ *
+ * The lines are indexed with a uniform grid, so the cost of the query
+ * depends on the number of lines near the window, rather than on the size
+ * of the DLG file.  For small files, or if the window couldn't be converted
+ * into UTM, we just return all of the lines.  set_window_bounds()
+ * must be called first.
+ */
+int32_t
+window_lines(int32_t num_lines, int32_t **list)
+{
+	if ((window_valid == 0) || (num_lines < MIN_INDEX_ITEMS))  {
+		return every_item(num_lines, list);
+	}
+
+	if ((dlg_indexed == 0) || (line_index.num_items != num_lines))  {
+		dlg_index_build(&line_index, num_lines, &lines[0].bounds, sizeof(struct lines));
+	}
+	return dlg_index_query(&line_index, &window_box, list);
+}
+
+
+
+/*
+ * The same as window_lines(), but for areas.
+ * set_area_bounds() must be called first.
+ */
+int32_t
+window_areas(int32_t num_areas, int32_t **list)
+{
+	if ((window_valid == 0) || (num_areas < MIN_INDEX_ITEMS))  {
+		return every_item(num_areas, list);
+	}
+
+	if ((dlg_indexed == 0) || (area_index.num_items != num_areas))  {
+		dlg_index_build(&area_index, num_areas, &areas[0].bounds, sizeof(struct areas));
+	}
+	return dlg_index_query(&area_index, &window_box, list);
+}
+
+
+
+
+/*
+ * Convert the coordinates in the arena, and the representative points
+ * of the areas, from UTM into longitude (x) and latitude (y), all at once.
+ * After this, the drawing routines no longer need the datum or the zone,
+ * which is what allows the arena to be saved in the DLG cache.
+ * The bounding boxes and spatial indexes are rebuilt in the new coordinates.
+ * (The nodes are left alone, since nothing draws them.)
+ *
+ * Returns 0 on success, and -1 if the zone is bad, in which case
+ * the arena is left as it was.
+ */
+int32_t
+dlg_arena_to_geographic(struct datum *datum, int32_t num_lines, int32_t num_areas)
+{
+	double latitude, longitude;
+	int32_t i;
+
+	if (dlg_geographic != 0)  {
+		return 0;
+	}
+	if (redfearn_inverse_array(datum, dlg_arena.x, dlg_arena.y, utm_zone, dlg_arena.y, dlg_arena.x, dlg_arena.num_coords) != 0)  {
+		return -1;
+	}
+	for (i = 0; i < num_areas; i++)  {
+		(void)redfearn_inverse(datum, areas[i].x, areas[i].y, utm_zone, &latitude, &longitude);
+		areas[i].x = longitude;
+		areas[i].y = latitude;
+	}
+	dlg_geographic = 1;
+
+	for (i = 0; i < num_lines; i++)  {
+		set_line_bounds(&lines[i]);
+	}
+	build_area_index(num_lines);
+	set_area_bounds(num_areas);
+	dlg_index_build(&line_index, num_lines, &lines[0].bounds, sizeof(struct lines));
+	dlg_index_build(&area_index, num_areas, &areas[0].bounds, sizeof(struct areas));
+	dlg_indexed = 1;
+
+	return 0;
+}
+
+
+
+/*
+ * The user's attribute file can list any number of Area and Line attribute codes,
+ * and every attribute of every line and area in every DLG file has to be
+ * checked against them.  Rather than scanning the list for each check,
+ * we compile the codes into three hash sets per attribute type:
+ *
+ *	pairs:   exact (major, minor) pairs
+ *	majors:  major codes given with a negative (wild card) minor code
+ *	minors:  minor codes given with a negative (wild card) major code
+ *
+ * A code with both parts negative matches everything, and just sets a flag.
+ * An attribute (major, minor) then matches if the flag is set, or if the pair,
+ * the major, or the minor is in the appropriate set.  This is exactly the
+ * rule that the old linear scan applied, so the same features are selected.
+ * The (10000, ID) pairs, that select individual features, are ordinary pairs,
+ * and attrib_filter_id() looks for them alone.
+ *
+ * Each set is an open-addressed table of keys, with linear probing.
+ * It is kept no more than half full, and doubles in size when necessary.
+ * A key packs the two 16-bit codes into 32 bits, which uses up every
+ * 32-bit value (an attribute of (-1, -1) in a DLG file gives 0xffffffff),
+ * so the slots are 64 bits wide, and an empty slot has the upper bits set.
+ */
+#define ATTRIB_EMPTY	0xffffffffffffffffULL	// Marks an unused slot.  ATTRIB_KEY() can't produce this value.
+
+#define ATTRIB_KEY(major, minor)	((uint64_t)((((uint32_t)(major) & 0xffff) << 16) | ((uint32_t)(minor) & 0xffff)))
+
+
+
+/*
+ * Find the slot for the given key:  either the slot that holds it,
+ * or the empty slot where it would go.
+ */
+static uint64_t *
+attrib_set_slot(struct attrib_set *set, uint64_t key)
+{
+	uint32_t h;
+
+	h = (uint32_t)key;
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	h &= set->size - 1;
+	while ((set->keys[h] != ATTRIB_EMPTY) && (set->keys[h] != key))  {
+		h = (h + 1) & (set->size - 1);
+	}
+
+	return &set->keys[h];
+}
+
+
+
+/*
+ * Add a key to a set, if it isn't already there.
+ */
+static void
+attrib_set_add(struct attrib_set *set, uint64_t key)
+{
+	uint64_t *old_keys, *slot;
+	int32_t old_size, i;
+
+	if (((set->count + 1) << 1) > set->size)  {
+		old_keys = set->keys;
+		old_size = set->size;
+		set->size = set->size == 0 ? 64 : set->size << 1;
+		set->keys = (uint64_t *)malloc(set->size * sizeof(uint64_t));
+		if (set->keys == (uint64_t *)0)  {
+			fprintf(stderr, "malloc of attribute table failed\n");
+			exit(0);
+		}
+		memset(set->keys, 0xff, set->size * sizeof(uint64_t));
+		for (i = 0; i < old_size; i++)  {
+			if (old_keys[i] != ATTRIB_EMPTY)  {
+				*attrib_set_slot(set, old_keys[i]) = old_keys[i];
+			}
+		}
+		free(old_keys);
+	}
+
+	slot = attrib_set_slot(set, key);
+	if (*slot == ATTRIB_EMPTY)  {
+		*slot = key;
+		set->count++;
+	}
+}
+
+
+
+/*
+ * Return nonzero if the key is in the set.
+ */
+static int32_t
+attrib_set_find(struct attrib_set *set, uint64_t key)
+{
+	if (set->count == 0)  {
+		return 0;
+	}
+
+	return *attrib_set_slot(set, key) == key;
+}
+
+
+
+/*
+ * Empty an attribute filter.  Its memory is kept for reuse.
+ */
+void
+attrib_filter_reset(struct attrib_filter *filter)
+{
+	filter->match_all = 0;
+	if (filter->pairs.size > 0)  {
+		memset(filter->pairs.keys, 0xff, filter->pairs.size * sizeof(uint64_t));
+	}
+	if (filter->majors.size > 0)  {
+		memset(filter->majors.keys, 0xff, filter->majors.size * sizeof(uint64_t));
+	}
+	if (filter->minors.size > 0)  {
+		memset(filter->minors.keys, 0xff, filter->minors.size * sizeof(uint64_t));
+	}
+	filter->pairs.count = 0;
+	filter->majors.count = 0;
+	filter->minors.count = 0;
+}
+
+
+
+/*
+ * Add a (major, minor) code from the attribute file to a filter.
+ */
+void
+attrib_filter_add(struct attrib_filter *filter, short major, short minor)
+{
+	if ((major < 0) && (minor < 0))  {
+		filter->match_all = 1;
+	}
+	else if (minor < 0)  {
+		attrib_set_add(&filter->majors, ATTRIB_KEY(0, major));
+	}
+	else if (major < 0)  {
+		attrib_set_add(&filter->minors, ATTRIB_KEY(0, minor));
+	}
+	else  {
+		attrib_set_add(&filter->pairs, ATTRIB_KEY(major, minor));
+	}
+}
+
+
+
+/*
+ * Return nonzero if the given attribute is selected by the filter.
+ */
+int32_t
+attrib_filter_match(struct attrib_filter *filter, short major, short minor)
+{
+	return (filter->match_all != 0) ||
+	       (attrib_set_find(&filter->pairs, ATTRIB_KEY(major, minor)) != 0) ||
+	       (attrib_set_find(&filter->majors, ATTRIB_KEY(0, major)) != 0) ||
+	       (attrib_set_find(&filter->minors, ATTRIB_KEY(0, minor)) != 0);
+}
+
+
+
+/*
+ * Return nonzero if the filter selects every feature of the given theme
+ * (data_type), which is how features without any attributes are selected.
+ */
+int32_t
+attrib_filter_theme(struct attrib_filter *filter, int32_t data_type)
+{
+	return (filter->match_all != 0) || (attrib_set_find(&filter->majors, ATTRIB_KEY(0, data_type)) != 0);
+}
+
+
+
+/*
+ * Return nonzero if the user asked for the feature with the given ID,
+ * with a major code of 10000.  Wild cards don't count.
+ */
+int32_t
+attrib_filter_id(struct attrib_filter *filter, int32_t id)
+{
+	if ((id < 0) || (id > 32767))  {
+		return 0;	// The user's codes are shorts, so they can't name an ID this large.
+	}
+	return attrib_set_find(&filter->pairs, ATTRIB_KEY(10000, id));
+}
+
+
+
+/*
+ * Parse the given attribute file and store the results
+ * in the appropriate storage areas.
+ */
+void
+process_attrib(char *attribute_file)
+{
+	int gz_flag;
+	int attribute_fdesc;
+	int32_t ret_val;
+	short major, minor;
+	char *ptr;
+	char buf[MAX_ATTRIB_RECORD_LENGTH];
+
+
+	num_A_attrib = 0;
+	num_L_attrib = 0;
+	attrib_filter_reset(&attrib_filter_A);
+	attrib_filter_reset(&attrib_filter_L);
+	if (attribute_file != (char *)0)  {
+		if (strcmp(attribute_file + strlen(attribute_file) - 3, ".gz") == 0)  {
+			gz_flag = 1;
+			if ((attribute_fdesc = buf_open_z(attribute_file, O_RDONLY)) < 0)  {
+				fprintf(stderr, "Can't open %s for reading, errno = %d\n", attribute_file, errno);
+				exit(0);
+			}
+		}
+		else  {
+			gz_flag = 0;
+			if ((attribute_fdesc = buf_open(attribute_file, O_RDONLY)) < 0)  {
+				fprintf(stderr, "Can't open %s for reading, errno = %d\n", attribute_file, errno);
+				exit(0);
+			}
+		}
+
+		fprintf(stderr, "Processing Attribute file:  %s\n", attribute_file);
+
+		while ( 1 )  {
+			if (gz_flag == 0)  {
+				if ((ret_val = get_a_line(attribute_fdesc, buf, MAX_ATTRIB_RECORD_LENGTH)) <= 0)  {
+					break;
+				}
+			}
+			else  {
+				if ((ret_val = get_a_line_z(attribute_fdesc, buf, MAX_ATTRIB_RECORD_LENGTH)) <= 0)  {
+					break;
+				}
+			}
+
+			buf[ret_val - 1] = '\0';	/* Put a null in place of the newline */
+
+			switch(buf[0])  {
+			case '\0':
+			case '\n':
+			case '\r':
+			case ' ':
+			case '\t':
+				/* Blank line, or line that begins with white space.  Ignore. */
+				break;
+			case '#':
+				/* Comment line.  Ignore. */
+				break;
+			case 'N':
+				/* We don't currently use Node attributes, so do nothing with them. */
+				fprintf(stderr, "Ignoring Node attribute:  %s\n", buf);
+				break;
+			case 'A':
+				/* Area attribute. */
+				major = strtol(&buf[1], &ptr, 10);
+				minor = strtol(ptr, &ptr, 10);
+				attrib_filter_add(&attrib_filter_A, major, minor);
+				num_A_attrib++;
+				break;
+			case 'L':
+				/* Line attribute. */
+				major = strtol(&buf[1], &ptr, 10);
+				minor = strtol(ptr, &ptr, 10);
+				attrib_filter_add(&attrib_filter_L, major, minor);
 				num_L_attrib++;
 				break;
 			default:
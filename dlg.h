@@ -36,74 +36,172 @@
 #define	MANMADE_FEATURES	200
 #define	PUBLIC_LAND_SURVEYS	300
 
-#define MAX_A_ATTRIB		100		// Maximum number of Area attributes
-#define MAX_L_ATTRIB		100		// Maximum number of Line attributes
-#define MAX_POLY_NUM		MAX_AREAS	// Maximum number of stored polygon attribute references
 #define MAX_LINE_LIST		2000		// Maximum size of a line list for output.
 #define MAX_EXTRA		8		// Maximum number of attributes per line, area, or node entry
 #define MAX_ATTRIB_FILES	10		// Maximum number of SDTS attribute files that we can read in
 
-#define MAX_LINES 25938		// Theoretical maximum number of lines in a 100K DLG file.  This number may be out of date.
-#define MAX_AREAS 25960		// Theoretical maximum number of areas in a 100K DLG file.  This number may be out of date.
-#define MAX_NODES 25960		// Theoretical maximum number of nodes in a 100K DLG file.  This number may be out of date.
+
+/*
+ * Storage for attribute types.
+ */
+struct attribute  {
+	short major;
+	short minor;
+};
 
 
 /*
- * For storing linked lists of points.
+ * The attribute codes from the user's attribute file, compiled into
+ * hash sets for quick lookup.  See attrib_filter_match() in dlg.c.
  */
-struct point  {
-	double x;
-	double y;
-	struct point *point;
+struct attrib_set  {
+	uint64_t *keys;
+	int32_t size;		// Number of slots, a power of two (or zero)
+	int32_t count;		// Number of keys in the set
+};
+struct attrib_filter  {
+	int32_t match_all;		// Nonzero if a code had both major and minor negative
+	struct attrib_set pairs;	// Exact (major, minor) pairs
+	struct attrib_set majors;	// Majors given with a wild-card minor
+	struct attrib_set minors;	// Minors given with a wild-card major
 };
 
 
 /*
- * Storage for attribute types.
+ * The coordinates and attributes of the nodes, areas, and lines of a single
+ * DLG file are kept in one arena, rather than in individually malloc()ed
+ * linked lists.  The coordinates of each line occupy a contiguous run
+ * of the x and y arrays, and the attributes of each node, area, or line
+ * occupy a contiguous run of the attrib array.  The nodes, areas, and lines
+ * arrays hold the index of the start of each run.
+ *
+ * The arrays grow as needed.  When we are done with a DLG file,
+ * dlg_arena_reset() empties the arena, but keeps the memory for the next file.
  */
-struct maj_min {
-	short major;
-	short minor;
+struct dlg_arena  {
+	double *x;
+	double *y;
+	int32_t num_coords;
+	int32_t coords_size;
+
+	struct attribute *attrib;
+	int32_t num_attrib;
+	int32_t attrib_size;
 };
-struct attribute  {
-	short major;
-	short minor;
-	struct attribute *attribute;
+
+/*
+ * A bounding box, in the UTM coordinates of a DLG file (or in longitude and
+ * latitude, once the arena has been converted by dlg_arena_to_geographic()).
+ * A box with x_min > x_max is empty.
+ */
+struct dlg_box  {
+	double x_min;
+	double y_min;
+	double x_max;
+	double y_max;
+};
+
+
+/*
+ * A uniform grid over the bounding boxes of a set of items (lines or areas),
+ * so that we can quickly find the items that might overlap a given window.
+ * Each cell holds the indices of the items whose boxes overlap it, and
+ * the items of cell c occupy items[cell_start[c]] through items[cell_start[c + 1] - 1].
+ * The index can be written to, and read back from, a file.
+ * See dlg_index.c for the details.
+ */
+struct dlg_index  {
+	struct dlg_box extent;	// Union of all of the (non-empty) item boxes
+	double cell_width;
+	double cell_height;
+	int32_t num_x;		// Number of cells in the x direction
+	int32_t num_y;		// Number of cells in the y direction
+	int32_t num_items;	// Number of items that were indexed (including any with empty boxes)
+	int32_t *cell_start;
+	int32_t cell_start_size;
+	int32_t *items;
+	int32_t items_size;
+
+	int32_t *mark;		// Used by dlg_index_query() to return each item only once
+	int32_t mark_size;
+	int32_t stamp;
+	int32_t *result;	// The result of the most recent query
+	int32_t result_size;
 };
 
+
 /*
- * The sizes of the nodes, areas, and lines arrays are their theoretical maximum values.
- * It would probably be cooler to malloc() these as we go, but coolness was not an
- * objective of this program.  It would still be cool to read the maximum values from
- * the DLG file headers and check them against the values below to verify that
- * the standards haven't changed and left this program behind.
+ * The nodes, areas, and lines of a DLG file.  The arrays of these used to have
+ * fixed sizes, set to the theoretical maximum for a 100K DLG file, and the IDs
+ * and counts were shorts.  Now the arrays grow as needed (see dlg_reserve_nodes()
+ * and friends in dlg.c), and the IDs and counts are 32 bits, so larger files fit.
  */
 struct nodes  {
-	short id;
+	int32_t id;
 	double x;
 	double y;
-	short number_attrib;
-	struct attribute *attribute;
+	int32_t number_attrib;
+	int32_t attribute;	// Index of the first attribute in dlg_arena.attrib
 };
 
 struct areas  {
-	short id;
+	int32_t id;
 	double x;
 	double y;
-	short number_attrib;
-	struct attribute *attribute;
+	int32_t number_attrib;
+	int32_t attribute;	// Index of the first attribute in dlg_arena.attrib
+	struct dlg_box bounds;	// Bounding box of the area's boundary, filled in by set_area_bounds()
 };
 
 struct lines  {
-	short id;
-	short start_node;
-	short end_node;
-	short left_area;
-	short right_area;
-	short number_coords;
-	struct point *point;
-	short number_attrib;
-	struct attribute *attribute;
+	int32_t id;
+	int32_t start_node;
+	int32_t end_node;
+	int32_t left_area;
+	int32_t right_area;
+	int32_t number_coords;
+	int32_t point;		// Index of the first coordinate in dlg_arena.x and dlg_arena.y
+	int32_t number_attrib;
+	int32_t attribute;	// Index of the first attribute in dlg_arena.attrib
+	int32_t record;		// Position of the line's first LE?? record, when sdts2dlg streams a transfer, or -1
+	int32_t drawn;		// Nonzero if read_dlg_sdts() has already drawn the line (see le_draw_line())
+	struct dlg_box bounds;	// Bounding box of the line's coordinates, filled in by set_line_bounds()
+};
+
+
+/*
+ * Everything that we hold for a single DLG file:  its arena, and its nodes,
+ * areas, and lines arrays.  The DLG code works on the file whose pieces are in
+ * the global variables dlg_arena, nodes, areas, and lines.  dlg_file_swap()
+ * trades those globals with the contents of one of these structures, so that
+ * other files can be kept on the side, and brought back when they are wanted.
+ */
+struct dlg_file  {
+	struct dlg_arena arena;
+	struct nodes *nodes;
+	int32_t nodes_size;
+	struct areas *areas;
+	int32_t areas_size;
+	struct lines *lines;
+	int32_t lines_size;
+};
+
+
+/*
+ * A recorded drawing operation, for the display lists in dlg_display.c.
+ *
+ *	DL_LINE:   v[0], v[1] = first pixel (x, y);  v[2], v[3] = second pixel (x, y)
+ *	DL_SPAN:   v[0] = row;  v[1], v[2] = first and last pixel in the row
+ *	DL_FLOOD:  v[0], v[1] = seed pixel (x, y);  v[2] through v[5] = dlg_x_low, dlg_y_low, dlg_x_high, dlg_y_high
+ */
+#define DL_LINE		1
+#define DL_SPAN		2
+#define DL_FLOOD	3
+
+struct display_op  {
+	int32_t type;
+	int32_t color;
+	int32_t v[6];
 };
 
 
@@ -115,7 +213,7 @@ struct attribute_list  {
 	short minor[MAX_EXTRA];
 };
 struct polygon_attrib  {
-	short poly_id;
+	int32_t poly_id;
 	int32_t attrib;
 	char module_num;
 };
@@ -123,7 +221,45 @@ struct polygon_attrib  {
 
 
 void fill_area(struct datum *, double, double, int32_t, struct image_corners *);
+void flood_area(struct image_corners *, int32_t, int32_t, int32_t);
+void build_area_index(int32_t);
+void fill_area_polygon(struct datum *, int32_t, double, double, int32_t, struct image_corners *);
 void process_dlg_optional(int, int, struct image_corners *, int32_t);
+void draw_dlg(struct datum *, int32_t, int32_t, int32_t, int32_t, struct image_corners *);
+void draw_dlg_begin(struct datum *, struct image_corners *);
+void draw_dlg_line(struct datum *, int32_t, int32_t, int32_t, struct image_corners *);
 int32_t process_dlg_sdts(char *, char *, int32_t, struct image_corners *, int32_t, int32_t);
-void draw_lines(struct datum *, struct point *, int32_t, struct image_corners *);
+void extra_attrib_init(void);
+void draw_lines(struct datum *, double *, double *, int32_t, int32_t, struct image_corners *);
 void process_attrib(char *);
+void attrib_filter_reset(struct attrib_filter *);
+void attrib_filter_add(struct attrib_filter *, short, short);
+int32_t attrib_filter_match(struct attrib_filter *, short, short);
+int32_t attrib_filter_theme(struct attrib_filter *, int32_t);
+int32_t attrib_filter_id(struct attrib_filter *, int32_t);
+void dlg_arena_reset(void);
+int32_t dlg_arena_add_coord(double, double);
+int32_t dlg_arena_add_attrib(short, short);
+int32_t dlg_arena_to_geographic(struct datum *, int32_t, int32_t);
+void dlg_reserve_nodes(int32_t);
+void dlg_reserve_areas(int32_t);
+void dlg_reserve_lines(int32_t);
+void dlg_file_swap(struct dlg_file *);
+void set_line_bounds(struct lines *);
+void set_area_bounds(int32_t);
+void set_window_bounds(struct datum *, struct image_corners *);
+void set_simplify_tolerance(struct image_corners *);
+int32_t line_outside_window(struct lines *);
+int32_t area_outside_window(struct areas *);
+int32_t window_lines(int32_t, int32_t **);
+int32_t window_areas(int32_t, int32_t **);
+void dlg_index_build(struct dlg_index *, int32_t, struct dlg_box *, size_t);
+int32_t dlg_index_query(struct dlg_index *, struct dlg_box *, int32_t **);
+int32_t dlg_index_write(struct dlg_index *, int);
+int32_t dlg_index_read(struct dlg_index *, int);
+void display_list_begin(void);
+void display_list_add(int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+int32_t display_list_end(int);
+int32_t display_list_replay(int, struct image_corners *);
+int32_t dlg_cache_draw(char *, char *, struct image_corners *);
+void dlg_cache_write(int32_t, int32_t, int32_t, int32_t);
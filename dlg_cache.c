@@ -0,0 +1,409 @@
+/*
+ * =========================================================================
+ * dlg_cache.c - Routines to save parsed and projected DLG files for reuse.
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * People tend to draw the same DLG files over and over, with different
+ * map windows, different DEM data, or different attribute files.
+ * Each time, drawmap parses the files from scratch, and converts every
+ * point from UTM into latitude/longitude.  The geometry never changes,
+ * so this is wasted effort.
+ *
+ * If the user gives drawmap a cache directory (with the -P option),
+ * then, the first time a DLG file is drawn, the parsed file is converted
+ * into latitude/longitude (by dlg_arena_to_geographic()) and written into
+ * the cache directory.  Later runs find it there, map it into memory,
+ * and draw it directly, without parsing or projecting anything.
+ *
+ * A cache file holds everything that draw_dlg() needs:
+ *
+ *	A header, giving the identity of the DLG file that it came from, and
+ *	the counts and the per-file values (color, theme, and corners).
+ *	The full path name of the DLG file.
+ *	The lines and areas arrays, including their bounding boxes.
+ *	The arena coordinates (longitude in x, latitude in y), and attributes.
+ *	The spatial indexes for the lines and areas (see dlg_index.c).
+ *
+ * Everything before the indexes is padded to a multiple of eight bytes, so
+ * that the lines, areas, and coordinates can be used in place, directly from
+ * the mapped file.  dlg_file_swap() makes them the current DLG file.
+ *
+ * The attributes are stored as they are in the DLG file, rather than being
+ * checked against the user's attribute file in advance, so the same cache
+ * file serves for any attribute file.  Checking them is cheap.
+ *
+ * The cache file name is a hash of the full path name of the DLG file.
+ * The file is only used if the path name, size, and modification time of
+ * the DLG file match those in the header, and if it was made with the same
+ * projection engine and the same structure layouts as the running program.
+ * Otherwise, the DLG file is parsed as usual, and a new cache file replaces
+ * the old one.  (For an SDTS transfer, only the ????LE??.DDF file, named
+ * on the command line, is checked.  If you replace the other files in
+ * the transfer, remove the cache file.)
+ *
+ * As with the index files, the cache is in native byte order, since
+ * it is only meant for use on the machine that created it.
+ *
+ * A cache file is written under a temporary name and then renamed,
+ * so that a drawmap that crashes, or one that runs at the same time,
+ * never sees a partial file.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "drawmap.h"
+#include "dlg.h"
+
+
+#define DLG_CACHE_MAGIC		0x444c4743	// "DLGC"
+#define DLG_CACHE_VERSION	2
+
+#define PAD8(n)			(((n) + 7) & ~(size_t)7)
+
+
+/*
+ * The fixed-size header at the start of a cache file.
+ * Its size is a multiple of eight bytes.
+ */
+struct dlg_cache_header  {
+	int32_t magic;
+	int32_t version;
+	int32_t lines_size;	// sizeof(struct lines), to detect a change in the layout
+	int32_t areas_size;	// sizeof(struct areas)
+	int32_t tm_engine;	// The projection engine that converted the coordinates
+	int32_t path_length;	// Length of the DLG path name, including the null
+	int64_t file_size;	// Size of the DLG file
+	int64_t file_mtime;	// Modification time of the DLG file
+	int32_t color;
+	int32_t data_type;
+	int32_t num_lines;
+	int32_t num_areas;
+	int32_t num_coords;
+	int32_t num_attrib;
+	double lat_sw;
+	double long_sw;
+	double lat_ne;
+	double long_ne;
+};
+
+
+extern struct areas *areas;
+extern struct lines *lines;
+extern struct dlg_arena dlg_arena;
+extern double lat_sw, long_sw, lat_ne, long_ne;
+extern int32_t x_prime;
+extern int32_t right_border;
+extern int32_t tm_engine;
+extern int32_t dlg_geographic;
+extern int32_t dlg_indexed;
+extern struct dlg_index line_index;
+extern struct dlg_index area_index;
+
+
+/*
+ * When this is non-null, draw_dlg() converts the current DLG file and
+ * calls dlg_cache_write() to save it under this name.
+ * It is set by dlg_cache_draw() when it doesn't find a usable cache file.
+ */
+char *dlg_cache_name = (char *)0;
+
+static char cache_name[PATH_MAX + 32];
+static char dlg_path[PATH_MAX];
+static int64_t dlg_size;
+static int64_t dlg_mtime;
+
+
+
+/*
+ * Find the cache file name, and the identity, of the given DLG file.
+ * Return 0 on success, and -1 if the DLG file can't be found.
+ */
+static int32_t
+cache_identity(char *cache_dir, char *file_name)
+{
+	struct stat stat_buf;
+	uint64_t hash;
+	unsigned char *ptr;
+
+	if (realpath(file_name, dlg_path) == (char *)0)  {
+		return -1;
+	}
+	if (stat(dlg_path, &stat_buf) != 0)  {
+		return -1;
+	}
+	dlg_size = (int64_t)stat_buf.st_size;
+	dlg_mtime = (int64_t)stat_buf.st_mtime;
+
+	/* A 64-bit FNV-1a hash of the path name. */
+	hash = 0xcbf29ce484222325ULL;
+	for (ptr = (unsigned char *)dlg_path; *ptr != '\0'; ptr++)  {
+		hash = (hash ^ *ptr) * 0x100000001b3ULL;
+	}
+	snprintf(cache_name, sizeof(cache_name), "%s/%016llx.dlgc", cache_dir, (unsigned long long)hash);
+
+	return 0;
+}
+
+
+
+/*
+ * Draw the given DLG file from its cache file, if there is a usable one
+ * in cache_dir.  Return 0 if the file was drawn.
+ *
+ * Otherwise, return -1, and the caller should process the DLG file as usual.
+ * In that case, dlg_cache_name is set, so that the file will be added to the cache.
+ */
+int32_t
+dlg_cache_draw(char *cache_dir, char *file_name, struct image_corners *image_corners)
+{
+	struct dlg_cache_header *header;
+	struct dlg_file file;
+	struct stat stat_buf;
+	unsigned char *map;
+	size_t offset, lines_offset, areas_offset, x_offset, y_offset, attrib_offset;
+	int32_t i;
+	int fdesc;
+
+	dlg_cache_name = (char *)0;
+	if (cache_identity(cache_dir, file_name) != 0)  {
+		return -1;
+	}
+	dlg_cache_name = cache_name;
+
+	if ((fdesc = open(cache_name, O_RDONLY)) < 0)  {
+		return -1;
+	}
+	if ((fstat(fdesc, &stat_buf) != 0) || (stat_buf.st_size < (off_t)sizeof(struct dlg_cache_header)))  {
+		close(fdesc);
+		return -1;
+	}
+	map = (unsigned char *)mmap((void *)0, stat_buf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fdesc, 0);
+	if (map == (unsigned char *)MAP_FAILED)  {
+		close(fdesc);
+		return -1;
+	}
+
+	/*
+	 * Check that the cache file belongs to this DLG file, and to this program,
+	 * and that all of its pieces are actually present.
+	 */
+	header = (struct dlg_cache_header *)map;
+	if ((header->magic != DLG_CACHE_MAGIC) || (header->version != DLG_CACHE_VERSION) ||
+	    (header->lines_size != sizeof(struct lines)) || (header->areas_size != sizeof(struct areas)) ||
+	    (header->tm_engine != tm_engine) ||
+	    (header->file_size != dlg_size) || (header->file_mtime != dlg_mtime) ||
+	    (header->path_length != (strlen(dlg_path) + 1)) ||
+	    (header->num_lines < 0) || (header->num_areas < 0) ||
+	    (header->num_coords < 0) || (header->num_attrib < 0))  {
+		goto FAIL;
+	}
+	offset = sizeof(struct dlg_cache_header);
+	if ((offset + header->path_length > (size_t)stat_buf.st_size) ||
+	    (memcmp(map + offset, dlg_path, header->path_length) != 0))  {
+		goto FAIL;
+	}
+	offset += PAD8(header->path_length);
+	lines_offset = offset;
+	offset += header->num_lines * sizeof(struct lines);
+	areas_offset = offset;
+	offset += header->num_areas * sizeof(struct areas);
+	x_offset = offset;
+	offset += header->num_coords * sizeof(double);
+	y_offset = offset;
+	offset += header->num_coords * sizeof(double);
+	attrib_offset = offset;
+	offset += PAD8(header->num_attrib * sizeof(struct attribute));
+	if (offset > (size_t)stat_buf.st_size)  {
+		goto FAIL;
+	}
+
+	/*
+	 * Everything that draw_dlg() needs is used in place, straight from the
+	 * mapped file.  (The mapping is private, so that set_area_bounds() can
+	 * write the area boxes without touching the file.)
+	 */
+	file.arena.x = (double *)(map + x_offset);
+	file.arena.y = (double *)(map + y_offset);
+	file.arena.num_coords = header->num_coords;
+	file.arena.coords_size = header->num_coords;
+	file.arena.attrib = (struct attribute *)(map + attrib_offset);
+	file.arena.num_attrib = header->num_attrib;
+	file.arena.attrib_size = header->num_attrib;
+	file.nodes = (struct nodes *)0;
+	file.nodes_size = 0;
+	file.lines = (struct lines *)(map + lines_offset);
+	file.lines_size = header->num_lines;
+	file.areas = (struct areas *)(map + areas_offset);
+	file.areas_size = header->num_areas;
+
+	/* Make sure that a damaged file can't send us outside of the arena. */
+	for (i = 0; i < header->num_lines; i++)  {
+		if ((file.lines[i].number_coords < 0) || (file.lines[i].point < 0) ||
+		    ((file.lines[i].point + file.lines[i].number_coords) > header->num_coords) ||
+		    (file.lines[i].number_attrib < 0) || (file.lines[i].attribute < 0) ||
+		    ((file.lines[i].attribute + file.lines[i].number_attrib) > header->num_attrib) ||
+		    (file.lines[i].drawn != 0))  {
+			goto FAIL;
+		}
+	}
+	for (i = 0; i < header->num_areas; i++)  {
+		if ((file.areas[i].number_attrib < 0) || (file.areas[i].attribute < 0) ||
+		    ((file.areas[i].attribute + file.areas[i].number_attrib) > header->num_attrib))  {
+			goto FAIL;
+		}
+	}
+
+	if ((lseek(fdesc, (off_t)offset, SEEK_SET) != (off_t)offset) ||
+	    (dlg_index_read(&line_index, fdesc) != 0) || (line_index.num_items != header->num_lines) ||
+	    (dlg_index_read(&area_index, fdesc) != 0) || (area_index.num_items != header->num_areas))  {
+		goto FAIL;
+	}
+
+	fprintf(stderr, "Processing DLG file:  %s  (from cache %s)\n", file_name, cache_name);
+	dlg_cache_name = (char *)0;
+
+	/*
+	 * Swap the mapped file in as the current DLG file, draw it,
+	 * and then swap the previous contents back.
+	 */
+	dlg_file_swap(&file);
+	dlg_geographic = 1;
+	dlg_indexed = 1;
+
+	lat_sw = header->lat_sw;
+	long_sw = header->long_sw;
+	lat_ne = header->lat_ne;
+	long_ne = header->long_ne;
+	x_prime = image_corners->x + LEFT_BORDER + right_border;
+
+	draw_dlg((struct datum *)0, header->color, header->data_type, header->num_lines, header->num_areas, image_corners);
+
+	dlg_file_swap(&file);
+	dlg_arena_reset();
+	munmap(map, stat_buf.st_size);
+	close(fdesc);
+
+	return 0;
+
+FAIL:
+	munmap(map, stat_buf.st_size);
+	close(fdesc);
+	return -1;
+}
+
+
+
+/*
+ * Write a block of data, padded with zeroes to a multiple of eight bytes.
+ * Return 0 on success, and -1 on failure.
+ */
+static int32_t
+write_padded(int fdesc, void *data, size_t size)
+{
+	static char zeroes[8];
+	size_t pad = PAD8(size) - size;
+
+	if ((size > 0) && (write(fdesc, data, size) != size))  {
+		return -1;
+	}
+	if ((pad > 0) && (write(fdesc, zeroes, pad) != pad))  {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * Save the current DLG file in the cache, under the name in dlg_cache_name.
+ * This is called by draw_dlg(), after dlg_arena_to_geographic().
+ *
+ * The cache is only a time saver, so failure to write it isn't fatal.
+ * We print a warning, remove any partial file, and carry on.
+ */
+void
+dlg_cache_write(int32_t color, int32_t data_type, int32_t num_lines, int32_t num_areas)
+{
+	struct dlg_cache_header header;
+	char temp_name[PATH_MAX + 64];
+	int fdesc;
+
+	if (dlg_cache_name == (char *)0)  {
+		return;
+	}
+	snprintf(temp_name, sizeof(temp_name), "%s.%d", dlg_cache_name, (int)getpid());
+
+	memset(&header, 0, sizeof(header));
+	header.magic = DLG_CACHE_MAGIC;
+	header.version = DLG_CACHE_VERSION;
+	header.lines_size = sizeof(struct lines);
+	header.areas_size = sizeof(struct areas);
+	header.tm_engine = tm_engine;
+	header.path_length = strlen(dlg_path) + 1;
+	header.file_size = dlg_size;
+	header.file_mtime = dlg_mtime;
+	header.color = color;
+	header.data_type = data_type;
+	header.num_lines = num_lines;
+	header.num_areas = num_areas;
+	header.num_coords = dlg_arena.num_coords;
+	header.num_attrib = dlg_arena.num_attrib;
+	header.lat_sw = lat_sw;
+	header.long_sw = long_sw;
+	header.lat_ne = lat_ne;
+	header.long_ne = long_ne;
+
+	if ((fdesc = open(temp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)  {
+		fprintf(stderr, "Warning:  Can't create DLG cache file %s, errno = %d\n", temp_name, errno);
+		dlg_cache_name = (char *)0;
+		return;
+	}
+	if ((write_padded(fdesc, &header, sizeof(header)) != 0) ||
+	    (write_padded(fdesc, dlg_path, header.path_length) != 0) ||
+	    (write_padded(fdesc, lines, num_lines * sizeof(struct lines)) != 0) ||
+	    (write_padded(fdesc, areas, num_areas * sizeof(struct areas)) != 0) ||
+	    (write_padded(fdesc, dlg_arena.x, dlg_arena.num_coords * sizeof(double)) != 0) ||
+	    (write_padded(fdesc, dlg_arena.y, dlg_arena.num_coords * sizeof(double)) != 0) ||
+	    (write_padded(fdesc, dlg_arena.attrib, dlg_arena.num_attrib * sizeof(struct attribute)) != 0) ||
+	    (dlg_index_write(&line_index, fdesc) != 0) ||
+	    (dlg_index_write(&area_index, fdesc) != 0))  {
+		fprintf(stderr, "Warning:  Failed to write DLG cache file %s, errno = %d\n", temp_name, errno);
+		close(fdesc);
+		unlink(temp_name);
+		dlg_cache_name = (char *)0;
+		return;
+	}
+	close(fdesc);
+	if (rename(temp_name, dlg_cache_name) != 0)  {
+		fprintf(stderr, "Warning:  Can't rename DLG cache file %s, errno = %d\n", temp_name, errno);
+		unlink(temp_name);
+	}
+
+	dlg_cache_name = (char *)0;
+}
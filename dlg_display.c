@@ -0,0 +1,219 @@
+/*
+ * =========================================================================
+ * dlg_display.c - Routines to record DLG drawing operations for later replay.
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * Nearly all of the time spent on a DLG file goes into parsing it and
+ * projecting its coordinates, and very little goes into actually setting
+ * pixels in the image.  Only the pixel-setting has to happen in the order
+ * that the files were given on the command line (since each file overlays
+ * the ones before it), so drawmap can parse several DLG files at once,
+ * in separate processes, as long as each process hands back a list of the
+ * pixel operations it would have performed.  The parent process then
+ * replays the lists in command-line order.  The result is identical to
+ * processing the files one at a time.
+ *
+ * These routines record and replay such a display list.  While recording
+ * is turned on (by display_list_begin()), the DLG code calls display_list_add()
+ * instead of touching the image.  There are only three kinds of operation:
+ *
+ *	DL_LINE:   a line segment between two pixels, drawn with draw_line().
+ *	DL_SPAN:   a horizontal run of pixels in one row, from an area fill.
+ *	DL_FLOOD:  a flood fill from a seed pixel, bounded by the given
+ *	           limits (the limits of the DLG file that produced it).
+ *
+ * A flood fill depends on what is already in the image, which is why it
+ * is recorded as an operation, rather than as the pixels it filled.
+ *
+ * The list is written as a fixed-size header, followed by the operations.
+ * The header carries a count, so that the parent can tell a complete list
+ * from one whose process died partway through.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "drawmap.h"
+#include "dlg.h"
+
+
+#define DISPLAY_LIST_MAGIC	0x444c4731	// "DLG1"
+
+
+extern int32_t x_prime;
+extern int32_t dlg_x_low, dlg_y_low, dlg_x_high, dlg_y_high;
+
+
+/*
+ * Nonzero while drawing operations are being recorded, rather than performed.
+ */
+int32_t display_list_recording = 0;
+
+static struct display_op *display_ops = (struct display_op *)0;
+static int32_t num_display_ops = 0;
+static int32_t display_ops_size = 0;
+
+
+
+/*
+ * Start recording drawing operations.
+ */
+void
+display_list_begin(void)
+{
+	num_display_ops = 0;
+	display_list_recording = 1;
+}
+
+
+
+/*
+ * Record a single drawing operation.  The meanings of the values
+ * depend on the type of operation.  See dlg.h.
+ */
+void
+display_list_add(int32_t type, int32_t color, int32_t v0, int32_t v1, int32_t v2, int32_t v3)
+{
+	struct display_op *op;
+
+	if (num_display_ops >= display_ops_size)  {
+		display_ops_size = display_ops_size == 0 ? 65536 : display_ops_size << 1;
+		display_ops = (struct display_op *)realloc(display_ops, display_ops_size * sizeof(struct display_op));
+		if (display_ops == (struct display_op *)0)  {
+			fprintf(stderr, "realloc of display list failed\n");
+			exit(0);
+		}
+	}
+
+	op = &display_ops[num_display_ops++];
+	op->type = type;
+	op->color = color;
+	op->v[0] = v0;
+	op->v[1] = v1;
+	op->v[2] = v2;
+	op->v[3] = v3;
+	if (type == DL_FLOOD)  {
+		/* The limits of the flood fill come from the DLG file that is currently being processed. */
+		op->v[2] = dlg_x_low;
+		op->v[3] = dlg_y_low;
+		op->v[4] = dlg_x_high;
+		op->v[5] = dlg_y_high;
+	}
+	else  {
+		op->v[4] = 0;
+		op->v[5] = 0;
+	}
+}
+
+
+
+/*
+ * Stop recording, and write the recorded operations to the given file.
+ * Return 0 on success, and nonzero on failure.
+ */
+int32_t
+display_list_end(int fdesc)
+{
+	int32_t header[2];
+	ssize_t size;
+
+	display_list_recording = 0;
+
+	header[0] = DISPLAY_LIST_MAGIC;
+	header[1] = num_display_ops;
+	if (write(fdesc, header, sizeof(header)) != sizeof(header))  {
+		return -1;
+	}
+	size = num_display_ops * sizeof(struct display_op);
+	if ((size > 0) && (write(fdesc, display_ops, size) != size))  {
+		return -1;
+	}
+	num_display_ops = 0;
+
+	return 0;
+}
+
+
+
+/*
+ * Read a display list, written by display_list_end(), from the current position
+ * of the given file, and perform its operations on the image.
+ * Return 0 on success, and nonzero if the list is missing or incomplete.
+ */
+int32_t
+display_list_replay(int fdesc, struct image_corners *image_corners)
+{
+	int32_t header[2];
+	struct display_op op[256];
+	int32_t remaining, count, i;
+	ssize_t size;
+	int32_t save_x_low, save_y_low, save_x_high, save_y_high;
+
+	if (read(fdesc, header, sizeof(header)) != sizeof(header))  {
+		return -1;
+	}
+	if ((header[0] != DISPLAY_LIST_MAGIC) || (header[1] < 0))  {
+		return -1;
+	}
+
+	save_x_low = dlg_x_low;
+	save_y_low = dlg_y_low;
+	save_x_high = dlg_x_high;
+	save_y_high = dlg_y_high;
+
+	remaining = header[1];
+	while (remaining > 0)  {
+		count = remaining > 256 ? 256 : remaining;
+		size = count * sizeof(struct display_op);
+		if (read(fdesc, op, size) != size)  {
+			return -1;
+		}
+		for (i = 0; i < count; i++)  {
+			switch (op[i].type)  {
+			case DL_LINE:
+				draw_line(image_corners, op[i].v[0], op[i].v[1], op[i].v[2], op[i].v[3], op[i].color);
+				break;
+			case DL_SPAN:
+				memset(image_corners->ptr + (op[i].v[0] + TOP_BORDER) * x_prime + LEFT_BORDER + op[i].v[1],
+					op[i].color, op[i].v[2] - op[i].v[1] + 1);
+				break;
+			case DL_FLOOD:
+				dlg_x_low = op[i].v[2];
+				dlg_y_low = op[i].v[3];
+				dlg_x_high = op[i].v[4];
+				dlg_y_high = op[i].v[5];
+				flood_area(image_corners, op[i].v[0], op[i].v[1], op[i].color);
+				break;
+			default:
+				return -1;
+			}
+		}
+		remaining -= count;
+	}
+
+	dlg_x_low = save_x_low;
+	dlg_y_low = save_y_low;
+	dlg_x_high = save_x_high;
+	dlg_y_high = save_y_high;
+
+	return 0;
+}
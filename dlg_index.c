@@ -0,0 +1,446 @@
+/*
+ * =========================================================================
+ * dlg_index.c - A uniform-grid spatial index over DLG lines and areas.
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * Choosing what to draw from a DLG file used to be a linear scan over
+ * all of the lines and areas, no matter how small the map window was.
+ * The routines here index a set of bounding boxes (in the UTM coordinates
+ * of the DLG file, or in longitude/latitude once the file has been converted
+ * for the DLG cache) with a uniform grid, so that the items near a given
+ * window can be found by looking only at the grid cells that the window
+ * overlaps.
+ *
+ * The grid covers the union of the boxes, and is sized so that there
+ * are roughly two items per cell, with cells that are as close to square
+ * as the extent allows.  Each item is entered into every cell that its box
+ * overlaps.  The cells are stored in compressed form:  the item indices
+ * for all of the cells are packed into one array, in cell order, and
+ * a second array gives the starting position of each cell's run.
+ * The index is built with two passes over the boxes (one to count,
+ * and one to fill), so there is no per-cell allocation.
+ *
+ * Since an item can appear in several cells, dlg_index_query() marks the
+ * items it has already returned.  It returns them in ascending order,
+ * so that the caller processes them in the same order as a linear scan would.
+ *
+ * Because the index consists of a few flat arrays, it is easy to write it
+ * to a file and read it back.  dlg_index_write() and dlg_index_read() do this.
+ * The file is in native byte order, since it is intended as a cache that
+ * lives alongside the preprocessed data it describes, on the same machine.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "drawmap.h"
+#include "dlg.h"
+
+
+#define INDEX_MAGIC		0x44474958	// "DGIX"
+#define INDEX_VERSION		1
+#define ITEMS_PER_CELL		2
+#define MAX_CELLS_PER_SIDE	1024
+
+
+
+/*
+ * Make sure that an int32_t array has room for at least size elements.
+ */
+static void
+grow_array(int32_t **array, int32_t *array_size, int32_t size, char *name)
+{
+	if (size > *array_size)  {
+		*array_size = size;
+		*array = (int32_t *)realloc(*array, *array_size * sizeof(int32_t));
+		if (*array == (int32_t *)0)  {
+			fprintf(stderr, "realloc of %s failed\n", name);
+			exit(0);
+		}
+	}
+}
+
+
+
+/*
+ * Find the range of cells covered by the given box, clamped to the grid.
+ * Return 0 if the box misses the grid entirely.
+ */
+static int32_t
+cell_range(struct dlg_index *index, struct dlg_box *box, int32_t *x_low, int32_t *y_low, int32_t *x_high, int32_t *y_high)
+{
+	if ((box->x_min > box->x_max) || (box->y_min > box->y_max) ||
+	    (box->x_max < index->extent.x_min) || (box->x_min > index->extent.x_max) ||
+	    (box->y_max < index->extent.y_min) || (box->y_min > index->extent.y_max))  {
+		return 0;
+	}
+
+	*x_low = (int32_t)floor((box->x_min - index->extent.x_min) / index->cell_width);
+	*x_high = (int32_t)floor((box->x_max - index->extent.x_min) / index->cell_width);
+	*y_low = (int32_t)floor((box->y_min - index->extent.y_min) / index->cell_height);
+	*y_high = (int32_t)floor((box->y_max - index->extent.y_min) / index->cell_height);
+	/*
+	 * A box that touches the far edge of the extent can land one cell
+	 * beyond the grid, through rounding, so the low ends get clamped
+	 * at the top as well as the bottom.
+	 */
+	if (*x_low < 0)  {
+		*x_low = 0;
+	}
+	if (*x_low >= index->num_x)  {
+		*x_low = index->num_x - 1;
+	}
+	if (*y_low < 0)  {
+		*y_low = 0;
+	}
+	if (*y_low >= index->num_y)  {
+		*y_low = index->num_y - 1;
+	}
+	if (*x_high >= index->num_x)  {
+		*x_high = index->num_x - 1;
+	}
+	if (*y_high >= index->num_y)  {
+		*y_high = index->num_y - 1;
+	}
+
+	return 1;
+}
+
+
+
+/*
+ * Build the index over num_items bounding boxes.  The boxes need not be
+ * contiguous:  the box for item i is found stride bytes beyond the box
+ * for item i - 1, so that the boxes can be embedded in the lines or areas array.
+ * Items with empty boxes are not entered into any cell.
+ *
+ * The index structure should be zeroed before its first use.
+ * After that, it can be rebuilt as often as desired, and its memory is reused.
+ */
+void
+dlg_index_build(struct dlg_index *index, int32_t num_items, struct dlg_box *first_box, size_t stride)
+{
+	struct dlg_box *box;
+	double width, height, cell;
+	int32_t num_cells;
+	int32_t x_low, y_low, x_high, y_high;
+	int32_t i, x, y, c, total;
+	int32_t have_extent = 0;
+
+	index->num_items = num_items;
+
+	/* Find the extent of the non-empty boxes. */
+	for (i = 0; i < num_items; i++)  {
+		box = (struct dlg_box *)((char *)first_box + i * stride);
+		if ((box->x_min > box->x_max) || (box->y_min > box->y_max))  {
+			continue;
+		}
+		if (have_extent == 0)  {
+			index->extent = *box;
+			have_extent = 1;
+			continue;
+		}
+		if (box->x_min < index->extent.x_min)  {
+			index->extent.x_min = box->x_min;
+		}
+		if (box->x_max > index->extent.x_max)  {
+			index->extent.x_max = box->x_max;
+		}
+		if (box->y_min < index->extent.y_min)  {
+			index->extent.y_min = box->y_min;
+		}
+		if (box->y_max > index->extent.y_max)  {
+			index->extent.y_max = box->y_max;
+		}
+	}
+	if (have_extent == 0)  {
+		/* Nothing to index.  An empty extent makes every query come up empty. */
+		index->extent.x_min = 1.0;
+		index->extent.x_max = -1.0;
+		index->extent.y_min = 1.0;
+		index->extent.y_max = -1.0;
+	}
+
+	/*
+	 * Size the grid.  Guard against an extent with zero width or height,
+	 * as when all of the items are points, or lie along a single meridian.
+	 * The guard is relative to the extent, since the boxes may be in meters
+	 * or in degrees.
+	 */
+	width = index->extent.x_max - index->extent.x_min;
+	height = index->extent.y_max - index->extent.y_min;
+	cell = (width > height ? width : height) / (double)MAX_CELLS_PER_SIDE;
+	if (cell <= 0.0)  {
+		cell = 1.0;
+	}
+	if (width < cell)  {
+		width = cell;
+	}
+	if (height < cell)  {
+		height = cell;
+	}
+	cell = sqrt(width * height / (double)(num_items / ITEMS_PER_CELL + 1));
+	index->num_x = (int32_t)ceil(width / cell);
+	index->num_y = (int32_t)ceil(height / cell);
+	if (index->num_x < 1)  {
+		index->num_x = 1;
+	}
+	if (index->num_x > MAX_CELLS_PER_SIDE)  {
+		index->num_x = MAX_CELLS_PER_SIDE;
+	}
+	if (index->num_y < 1)  {
+		index->num_y = 1;
+	}
+	if (index->num_y > MAX_CELLS_PER_SIDE)  {
+		index->num_y = MAX_CELLS_PER_SIDE;
+	}
+	index->cell_width = width / (double)index->num_x;
+	index->cell_height = height / (double)index->num_y;
+	num_cells = index->num_x * index->num_y;
+
+	/* First pass:  count the items in each cell. */
+	grow_array(&index->cell_start, &index->cell_start_size, num_cells + 1, "index cells");
+	memset(index->cell_start, 0, (num_cells + 1) * sizeof(int32_t));
+	for (i = 0; i < num_items; i++)  {
+		box = (struct dlg_box *)((char *)first_box + i * stride);
+		if (cell_range(index, box, &x_low, &y_low, &x_high, &y_high) == 0)  {
+			continue;
+		}
+		for (y = y_low; y <= y_high; y++)  {
+			for (x = x_low; x <= x_high; x++)  {
+				index->cell_start[y * index->num_x + x + 1]++;
+			}
+		}
+	}
+
+	/*
+	 * Turn the counts into starting positions.  For the moment, cell_start[c + 1]
+	 * is the start of cell c.  The second pass advances each one to the end of
+	 * its cell, which is the start of the next one, and leaves cell_start correct.
+	 */
+	total = 0;
+	for (c = 1; c <= num_cells; c++)  {
+		i = index->cell_start[c];
+		index->cell_start[c] = total;
+		total += i;
+	}
+
+	/* Second pass:  fill in the items.  They go in ascending order within each cell. */
+	grow_array(&index->items, &index->items_size, total > 0 ? total : 1, "index items");
+	for (i = 0; i < num_items; i++)  {
+		box = (struct dlg_box *)((char *)first_box + i * stride);
+		if (cell_range(index, box, &x_low, &y_low, &x_high, &y_high) == 0)  {
+			continue;
+		}
+		for (y = y_low; y <= y_high; y++)  {
+			for (x = x_low; x <= x_high; x++)  {
+				c = y * index->num_x + x + 1;
+				index->items[index->cell_start[c]++] = i;
+			}
+		}
+	}
+
+	/* Reset the marks used by queries. */
+	grow_array(&index->mark, &index->mark_size, num_items > 0 ? num_items : 1, "index marks");
+	memset(index->mark, 0, (num_items > 0 ? num_items : 1) * sizeof(int32_t));
+	index->stamp = 0;
+}
+
+
+
+static int
+compare_items(const void *a, const void *b)
+{
+	int32_t ia = *(const int32_t *)a;
+	int32_t ib = *(const int32_t *)b;
+
+	return ia < ib ? -1 : (ia > ib ? 1 : 0);
+}
+
+
+
+/*
+ * Find the items whose cells overlap the given window box.
+ * The items are returned (via *list) in ascending order, with no duplicates,
+ * and the return value is the number of items.  The list remains valid
+ * until the next query on the same index.
+ *
+ * The items are candidates:  their boxes overlap cells that overlap the window,
+ * but the caller still needs to check the boxes themselves.
+ */
+int32_t
+dlg_index_query(struct dlg_index *index, struct dlg_box *window, int32_t **list)
+{
+	int32_t x_low, y_low, x_high, y_high;
+	int32_t x, y, c, j, item;
+	int32_t num_result = 0;
+
+	grow_array(&index->result, &index->result_size, index->num_items > 0 ? index->num_items : 1, "index result");
+	*list = index->result;
+
+	if (cell_range(index, window, &x_low, &y_low, &x_high, &y_high) == 0)  {
+		return 0;
+	}
+
+	index->stamp++;
+	if (index->stamp <= 0)  {
+		/* The stamp wrapped around.  Start over. */
+		memset(index->mark, 0, index->num_items * sizeof(int32_t));
+		index->stamp = 1;
+	}
+
+	for (y = y_low; y <= y_high; y++)  {
+		for (x = x_low; x <= x_high; x++)  {
+			c = y * index->num_x + x;
+			for (j = index->cell_start[c]; j < index->cell_start[c + 1]; j++)  {
+				item = index->items[j];
+				if (index->mark[item] != index->stamp)  {
+					index->mark[item] = index->stamp;
+					index->result[num_result++] = item;
+				}
+			}
+		}
+	}
+
+	/* A single cell is already in order, but the union of several cells isn't. */
+	if ((x_low != x_high) || (y_low != y_high))  {
+		qsort(index->result, num_result, sizeof(int32_t), compare_items);
+	}
+
+	return num_result;
+}
+
+
+
+/*
+ * Write the index to an open file.
+ * Return 0 on success, and nonzero on failure.
+ */
+int32_t
+dlg_index_write(struct dlg_index *index, int fdesc)
+{
+	int32_t header[5];
+	double grid[6];
+	int32_t num_cells = index->num_x * index->num_y;
+	ssize_t size;
+
+	header[0] = INDEX_MAGIC;
+	header[1] = INDEX_VERSION;
+	header[2] = index->num_x;
+	header[3] = index->num_y;
+	header[4] = index->num_items;
+	grid[0] = index->extent.x_min;
+	grid[1] = index->extent.y_min;
+	grid[2] = index->extent.x_max;
+	grid[3] = index->extent.y_max;
+	grid[4] = index->cell_width;
+	grid[5] = index->cell_height;
+
+	if (write(fdesc, header, sizeof(header)) != sizeof(header))  {
+		return -1;
+	}
+	if (write(fdesc, grid, sizeof(grid)) != sizeof(grid))  {
+		return -1;
+	}
+	size = (num_cells + 1) * sizeof(int32_t);
+	if (write(fdesc, index->cell_start, size) != size)  {
+		return -1;
+	}
+	size = index->cell_start[num_cells] * sizeof(int32_t);
+	if ((size > 0) && (write(fdesc, index->items, size) != size))  {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+/*
+ * Read an index, written by dlg_index_write(), from an open file.
+ * Return 0 on success, and nonzero on failure.  On failure,
+ * the index should be rebuilt from the data.
+ */
+int32_t
+dlg_index_read(struct dlg_index *index, int fdesc)
+{
+	int32_t header[5];
+	double grid[6];
+	int32_t num_cells;
+	int32_t i;
+	ssize_t size;
+
+	if (read(fdesc, header, sizeof(header)) != sizeof(header))  {
+		return -1;
+	}
+	if ((header[0] != INDEX_MAGIC) || (header[1] != INDEX_VERSION) ||
+	    (header[2] < 1) || (header[2] > MAX_CELLS_PER_SIDE) ||
+	    (header[3] < 1) || (header[3] > MAX_CELLS_PER_SIDE) || (header[4] < 0))  {
+		return -1;
+	}
+	if (read(fdesc, grid, sizeof(grid)) != sizeof(grid))  {
+		return -1;
+	}
+	index->num_x = header[2];
+	index->num_y = header[3];
+	index->num_items = header[4];
+	index->extent.x_min = grid[0];
+	index->extent.y_min = grid[1];
+	index->extent.x_max = grid[2];
+	index->extent.y_max = grid[3];
+	index->cell_width = grid[4];
+	index->cell_height = grid[5];
+	num_cells = index->num_x * index->num_y;
+
+	grow_array(&index->cell_start, &index->cell_start_size, num_cells + 1, "index cells");
+	size = (num_cells + 1) * sizeof(int32_t);
+	if (read(fdesc, index->cell_start, size) != size)  {
+		return -1;
+	}
+	if ((index->cell_start[0] != 0) || (index->cell_start[num_cells] < 0))  {
+		return -1;
+	}
+	grow_array(&index->items, &index->items_size, index->cell_start[num_cells] > 0 ? index->cell_start[num_cells] : 1, "index items");
+	size = index->cell_start[num_cells] * sizeof(int32_t);
+	if ((size > 0) && (read(fdesc, index->items, size) != size))  {
+		return -1;
+	}
+
+	/* Make sure that a damaged file can't send us outside of the arrays. */
+	for (i = 0; i < num_cells; i++)  {
+		if (index->cell_start[i + 1] < index->cell_start[i])  {
+			return -1;
+		}
+	}
+	for (i = 0; i < index->cell_start[num_cells]; i++)  {
+		if ((index->items[i] < 0) || (index->items[i] >= index->num_items))  {
+			return -1;
+		}
+	}
+
+	grow_array(&index->mark, &index->mark_size, index->num_items > 0 ? index->num_items : 1, "index marks");
+	memset(index->mark, 0, (index->num_items > 0 ? index->num_items : 1) * sizeof(int32_t));
+	index->stamp = 0;
+
+	return 0;
+}
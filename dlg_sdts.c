@@ -86,29 +86,21 @@
 
 
 /*
- * Storage for attribute types.
+ * The nodes, areas, and lines arrays grow as needed.  See dlg_reserve_nodes() in dlg.c.
  */
+extern struct nodes *nodes;
+extern struct areas *areas;
+extern struct lines *lines;
+extern struct dlg_arena dlg_arena;
 extern int32_t num_A_attrib;
-extern int32_t num_L_attrib;
-extern struct maj_min attributes_A[MAX_A_ATTRIB];
-extern struct maj_min attributes_L[MAX_L_ATTRIB];
-
-/*
- * The sizes of the nodes, areas, and lines arrays are their theoretical maximum values.
- * It would probably be cooler to malloc() these as we go, but coolness was not an
- * objective of this program.  It would still be cool to read the maximum values from
- * the DLG file headers and check them against the values below to verify that
- * the standards haven't changed and left this program behind.
- */
-extern struct nodes nodes[MAX_NODES];
-extern struct areas areas[MAX_AREAS];
-extern struct lines lines[MAX_LINES];
+extern char *dlg_cache_name;
 
 
 /*
  * Arrays to keep track of attributes from various SDTS files.
  */
-static struct polygon_attrib polygon_attrib[MAX_POLY_NUM];
+static struct polygon_attrib *polygon_attrib = (struct polygon_attrib *)0;
+static int32_t polygon_attrib_size = 0;
 static struct attrib_files  {
 	char module_name[4];
 	int32_t num_attrib;
@@ -120,6 +112,321 @@ static struct attrib_files  {
  */
 static int32_t line_list[MAX_LINE_LIST];
 
+/*
+ * An index from node (or area) IDs to the lines that touch them.
+ * (See index_lines().)
+ */
+static int32_t *line_index_start = (int32_t *)0;
+static int32_t line_index_start_size = 0;
+static int32_t *line_index = (int32_t *)0;
+static int32_t line_index_size = 0;
+
+/*
+ * The LE?? module, which holds the linear features, is the biggest
+ * module in a DLG transfer, so we read it a record at a time with
+ * get_record() rather than a subfield at a time with get_subfield().
+ * These are the subfields we want from each record, and the places
+ * where get_record() puts them.  Each record describes one line.
+ * The ATID (attribute reference) and SADR (coordinate) subfields
+ * repeat within a record, so they go into arrays that grow as needed.
+ * (See le_reserve().)
+ */
+static struct le_record  {
+	int32_t id;
+	int32_t left_area;
+	int32_t right_area;
+	int32_t start_node;
+	int32_t end_node;
+} le_record;
+static struct le_atid  {
+	struct ddf_string modn;
+	int32_t rcid;
+} *le_atid = (struct le_atid *)0;
+static int32_t le_atid_size = 0;
+static struct le_point  {
+	int32_t x;
+	int32_t y;
+} *le_point = (struct le_point *)0;
+static int32_t le_point_size = 0;
+
+#define LE_LINE		0
+#define LE_ATID_MODN	1
+#define LE_ATID_RCID	2
+#define LE_PIDL		3
+#define LE_PIDR		4
+#define LE_SNID		5
+#define LE_ENID		6
+#define LE_SADR_X	7
+#define LE_SADR_Y	8
+#define LE_NUM_ITEMS	9
+static struct ddf_item le_items[LE_NUM_ITEMS] = {
+	{ "LINE", "RCID", DDF_INT, &le_record.id, 0, 1 },
+	{ "ATID", "MODN", DDF_STRING, (void *)0, sizeof(struct le_atid), 0 },
+	{ "ATID", "RCID", DDF_INT, (void *)0, sizeof(struct le_atid), 0 },
+	{ "PIDL", "RCID", DDF_INT, &le_record.left_area, 0, 1 },
+	{ "PIDR", "RCID", DDF_INT, &le_record.right_area, 0, 1 },
+	{ "SNID", "RCID", DDF_INT, &le_record.start_node, 0, 1 },
+	{ "ENID", "RCID", DDF_INT, &le_record.end_node, 0, 1 },
+	{ "SADR", "X", DDF_INT, (void *)0, sizeof(struct le_point), 0 },
+	{ "SADR", "Y", DDF_INT, (void *)0, sizeof(struct le_point), 0 },
+};
+
+
+/*
+ * Make sure that the le_atid and le_point arrays are big enough
+ * for the counts that get_record() found in the current record,
+ * and point the LE?? items at them.  On the first call, this just
+ * sets up the initial arrays.
+ *
+ * Returns 1 if either array had to grow, in which case the caller
+ * needs to decode the current record again.
+ */
+static int32_t
+le_reserve()
+{
+	int32_t need;
+	int32_t grew = 0;
+
+	need = le_items[LE_ATID_MODN].count > le_items[LE_ATID_RCID].count ? le_items[LE_ATID_MODN].count : le_items[LE_ATID_RCID].count;
+	if ((le_atid_size == 0) || (need > le_atid_size))  {
+		if (le_atid_size == 0)  {
+			le_atid_size = 16;
+		}
+		while (le_atid_size < need)  {
+			le_atid_size = le_atid_size << 1;
+		}
+		le_atid = (struct le_atid *)realloc(le_atid, le_atid_size * sizeof(struct le_atid));
+		if (le_atid == (struct le_atid *)0)  {
+			fprintf(stderr, "realloc of line attribute storage failed\n");
+			exit(0);
+		}
+		grew = 1;
+	}
+
+	need = le_items[LE_SADR_X].count > le_items[LE_SADR_Y].count ? le_items[LE_SADR_X].count : le_items[LE_SADR_Y].count;
+	if ((le_point_size == 0) || (need > le_point_size))  {
+		if (le_point_size == 0)  {
+			le_point_size = 1024;
+		}
+		while (le_point_size < need)  {
+			le_point_size = le_point_size << 1;
+		}
+		le_point = (struct le_point *)realloc(le_point, le_point_size * sizeof(struct le_point));
+		if (le_point == (struct le_point *)0)  {
+			fprintf(stderr, "realloc of line coordinate storage failed\n");
+			exit(0);
+		}
+		grew = 1;
+	}
+
+	le_items[LE_ATID_MODN].dest = &le_atid[0].modn;
+	le_items[LE_ATID_MODN].max = le_atid_size;
+	le_items[LE_ATID_RCID].dest = &le_atid[0].rcid;
+	le_items[LE_ATID_RCID].max = le_atid_size;
+	le_items[LE_SADR_X].dest = &le_point[0].x;
+	le_items[LE_SADR_X].max = le_point_size;
+	le_items[LE_SADR_Y].dest = &le_point[0].y;
+	le_items[LE_SADR_Y].max = le_point_size;
+
+	return grew;
+}
+
+
+/*
+ * Add the coordinates of the LE?? record that get_record() has just
+ * decoded to dlg_arena, and add the number of them to *count.
+ * If attrib is non-null, add the record's attributes too, and add
+ * the number of them to *attrib.
+ *
+ * The first pass over the LE?? module uses this to build up each line,
+ * and, when sdts2dlg is streaming a transfer out to a file, the output
+ * pass uses it to read each line again, just before writing it out.
+ */
+static void
+le_add_record(int32_t num_attrib_files, double x_scale_factor, double x_origin, double y_scale_factor, double y_origin,
+		int32_t *attrib, int32_t *count)
+{
+	int32_t i, j, k;
+	int32_t module_num;
+	int32_t current_point;
+
+	if (attrib != (int32_t *)0)  {
+		for (k = 0; k < le_items[LE_ATID_MODN].count; k++)  {
+			if (le_atid[k].modn.length != 4)  {
+				fprintf(stderr, "Attribute module name (%.*s) is not 4 characters long.\n", le_atid[k].modn.length, le_atid[k].modn.value);
+				continue;
+			}
+			for (module_num = 0; module_num < num_attrib_files; module_num++)  {
+				if (strncmp(le_atid[k].modn.value, attrib_files[module_num].module_name, 4) == 0)  {
+					break;
+				}
+			}
+			if (module_num == num_attrib_files)  {
+				fprintf(stderr, "Warning:  Attribute module has unexpected name (%.*s).  Attributes may be in error.\n", le_atid[k].modn.length, le_atid[k].modn.value);
+				continue;
+			}
+			if (k >= le_items[LE_ATID_RCID].count)  {
+				break;
+			}
+			i = le_atid[k].rcid;
+			if (i <= attrib_files[module_num].num_attrib)  {
+				for (j = 0; j < MAX_EXTRA; j++)  {
+					if (attrib_files[module_num].attrib[i - 1].major[j] != 0)  {
+						(void)dlg_arena_add_attrib(attrib_files[module_num].attrib[i - 1].major[j], attrib_files[module_num].attrib[i - 1].minor[j]);
+						(*attrib)++;
+					}
+				}
+			}
+		}
+	}
+
+	/*
+	 * The coordinates are 32-bit binary integers, which we scale
+	 * into UTM coordinates.  Anything else is an error.
+	 */
+	if (le_items[LE_SADR_X].format == 'B')  {
+		for (k = 0; k < le_items[LE_SADR_X].count; k++)  {
+			current_point = dlg_arena_add_coord(-1.0, -1.0);
+			if (le_items[LE_SADR_X].size == 4)  {
+				dlg_arena.x[current_point] = (double)le_point[k].x * x_scale_factor + x_origin;
+			}
+			if ((k < le_items[LE_SADR_Y].count) && (le_items[LE_SADR_Y].format == 'B'))  {
+				if (le_items[LE_SADR_Y].size == 4)  {
+					dlg_arena.y[current_point] = (double)le_point[k].y * y_scale_factor + y_origin;
+				}
+				(*count)++;
+			}
+		}
+	}
+}
+
+
+
+
+/*
+ * When drawmap renders a transfer, there is no need to hold all of the
+ * lines until the whole transfer has been read.  Each line from the LE??
+ * module is drawn as soon as it is complete (which is when its attributes
+ * are known), and then its attributes are dropped from dlg_arena.
+ * Its coordinates are dropped too, unless the line bounds an area, and
+ * the user has asked for areas to be filled, in which case they are
+ * still needed to build the area rings.  The lines are drawn by the same
+ * code as they would be by draw_dlg(), and all in the same color, so the
+ * order doesn't matter.  Each drawn line is marked, and draw_dlg() skips it.
+ * (A count of drawn lines won't do, because the lines are sorted, and
+ * degenerate lines from the NE?? module added, after they are streamed.)
+ * draw_dlg_begin() must be called first.
+ */
+static void
+le_draw_line(struct datum *datum, int32_t n, int32_t color, int32_t data_type, struct image_corners *image_corners)
+{
+	draw_dlg_line(datum, n, color, data_type, image_corners);
+	lines[n].drawn = 1;
+
+	dlg_arena.num_attrib = lines[n].attribute;
+	lines[n].number_attrib = 0;
+	if ((num_A_attrib <= 0) || (lines[n].left_area == lines[n].right_area))  {
+		dlg_arena.num_coords = lines[n].point;
+		lines[n].number_coords = 0;
+		set_line_bounds(&lines[n]);
+	}
+}
+
+
+
+
+/*
+ * Build an index from node IDs (if area_flag is zero) or area IDs
+ * (if area_flag is non-zero) to the lines that touch them, so that
+ * the line list for each node or area can be built without searching
+ * through every line in the transfer.  IDs from 1 through max_id are
+ * indexed.  The entries for ID n are line_index[line_index_start[n]]
+ * through line_index[line_index_start[n + 1] - 1], and they are in
+ * the same order as the lines array.
+ *
+ * For nodes, each line is entered under its start node, as the line ID,
+ * and under its end node, as the negated line ID.  (A degenerate line
+ * thus appears twice under the same node.)  For areas, each line is
+ * entered under its left and right areas, unless they are the same area.
+ */
+static void
+index_lines(int32_t num_lines, int32_t max_id, int32_t area_flag)
+{
+	int32_t i, j, k;
+	int32_t ids[2], values[2];
+	int32_t num_ids;
+	int32_t pass;
+
+	if ((line_index_start_size == 0) || ((max_id + 2) > line_index_start_size))  {
+		line_index_start_size = max_id + 2;
+		line_index_start = (int32_t *)realloc(line_index_start, line_index_start_size * sizeof(int32_t));
+		if (line_index_start == (int32_t *)0)  {
+			fprintf(stderr, "realloc of line index failed\n");
+			exit(0);
+		}
+	}
+	if ((line_index_size == 0) || ((num_lines << 1) > line_index_size))  {
+		line_index_size = (num_lines << 1) + 1;
+		line_index = (int32_t *)realloc(line_index, line_index_size * sizeof(int32_t));
+		if (line_index == (int32_t *)0)  {
+			fprintf(stderr, "realloc of line index failed\n");
+			exit(0);
+		}
+	}
+	for (i = 0; i < (max_id + 2); i++)  {
+		line_index_start[i] = 0;
+	}
+
+	/*
+	 * On the first pass, count the entries for each ID, and turn
+	 * the counts into starting positions.  On the second pass,
+	 * put the entries in place.
+	 */
+	for (pass = 0; pass < 2; pass++)  {
+		for (j = 0; j < num_lines; j++)  {
+			num_ids = 0;
+			if (area_flag == 0)  {
+				ids[0] = lines[j].start_node;
+				values[0] = lines[j].id;
+				ids[1] = lines[j].end_node;
+				values[1] = -lines[j].id;
+				num_ids = 2;
+			}
+			else if (lines[j].left_area != lines[j].right_area)  {
+				ids[0] = lines[j].right_area;
+				values[0] = lines[j].id;
+				ids[1] = lines[j].left_area;
+				values[1] = lines[j].id;
+				num_ids = 2;
+			}
+			for (k = 0; k < num_ids; k++)  {
+				if ((ids[k] < 1) || (ids[k] > max_id))  {
+					continue;
+				}
+				if (pass == 0)  {
+					line_index_start[ids[k] + 1]++;
+				}
+				else  {
+					line_index[line_index_start[ids[k]]++] = values[k];
+				}
+			}
+		}
+		if (pass == 0)  {
+			for (i = 1; i < (max_id + 2); i++)  {
+				line_index_start[i] += line_index_start[i - 1];
+			}
+		}
+	}
+
+	/* The second pass left each starting position at the start of the next ID's entries. */
+	for (i = max_id + 1; i > 0; i--)  {
+		line_index_start[i] = line_index_start[i - 1];
+	}
+	line_index_start[0] = 0;
+}
+
+
+
 
 /*
  * comparison function for use with qsort.
@@ -149,7 +456,7 @@ extern int32_t utm_zone;
 
 int32_t get_extra_attrib(int32_t, int32_t *major, int32_t *minor, int32_t *major2, int32_t *minor2, struct subfield *subfield);
 int32_t process_attrib_sdts(char *, char *, int32_t *, int32_t *, int32_t, int32_t);
-void uniq_attrib(struct attribute **, short *);
+void uniq_attrib(int32_t, int32_t *);
 void get_theme(char *, char *, int32_t, int32_t);
 
 
@@ -204,8 +511,8 @@ void get_theme(char *, char *, int32_t, int32_t);
  *                        The same data is available in AHDR in the form of latitude/longitude.)
  *   PC01 --- Polygon
  */
-int32_t
-process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag,
+static int32_t
+read_dlg_sdts(struct sdts_transfer *transfer, char *passed_file_name, char *output_file_name, int32_t gz_flag,
 		struct image_corners *image_corners, int32_t info_flag, int32_t file_image_flag)
 {
 	int32_t i, j = 100000000, k = 100000000;	// bogus initializers to expose errors.
@@ -223,12 +530,13 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 	int output_fdesc = -1;
 	char buf[DLG_RECORD_LENGTH + 1];
 	char buf3[DLG_RECORD_LENGTH + 1];
-	struct point **current_point = (struct point **)0;		// bogus initializer to expose errors.
-	struct point **current_point2= (struct point **)0;		// bogus initializer to expose errors.
-	struct point *tmp_point;
-	struct attribute **current_attrib = (struct attribute **)0;	// bogus initializer to expose errors.
-	struct attribute *tmp_attrib;
+	int32_t current_point = -100000000;				// bogus initializer to expose errors.
+	int32_t current_point2 = -100000000;				// bogus initializer to expose errors.
+	struct attribute *current_attrib;
 	int32_t attrib;
+	struct ddf *le_ddf;
+	int32_t record_pos;
+	int32_t draw_flag;
 	int32_t current_poly = -100000000;				// bogus initializer to expose errors.
 	int32_t num_polys;
 	int32_t num_areas = -1;
@@ -258,6 +566,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 	int32_t horizontal_datum = -1;
 	int32_t dlg_level = -1;
 	int32_t line_list_size;
+	int32_t max_id;
 	double se_x = -100000000.0,	// bogus initializers to expose errors.
 	       se_y = -100000000.0,
 	       sw_x = -100000000.0,
@@ -1533,176 +1842,96 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 	/*
 	 * Open the file in preparation for parsing.
 	 */
-	if (begin_ddf(passed_file_name) < 0)  {
+	if ((le_ddf = sdts_open_file(transfer, passed_file_name)) == (struct ddf *)0)  {
 		fprintf(stderr, "Can't open %s for reading, errno = %d\n", passed_file_name, errno);
 		exit(0);
 	}
 	/*
-	 * Loop through the subfields until we find what we want.
+	 * Loop through the records, one line per record.
+	 *
+	 * When we are writing a DLG file, the coordinates and attributes of
+	 * a line aren't needed until the line is written out, at the very end.
+	 * Rather than hold all of them in memory until then, we just note where
+	 * each line's records are, and keep its bounding box, which the area
+	 * code needs.  The line's coordinates are dropped from dlg_arena as soon
+	 * as the line is complete, and its attributes aren't collected at all.
+	 * The output code reads the records again, one line at a time.
+	 * That way, the coordinates and attributes don't pile up in memory,
+	 * although each line still costs us its entry in lines[].
+	 * The nodes and areas are held whole, as before, because the node and
+	 * area records come first in the output, and they need the topology of
+	 * every line.  None of them carries a coordinate list, though, so the
+	 * memory still grows with the number of nodes, areas, and lines in the
+	 * transfer, but not with the number of points.
+	 *
+	 * Similarly, when we are drawing into the drawmap image, each line is
+	 * drawn as soon as it is complete, and then mostly forgotten.
+	 * (See le_draw_line().)  This isn't done if the transfer is also going
+	 * into the DLG cache, since the cache needs all of the lines.
 	 */
+	draw_flag = (file_image_flag == 0) && (dlg_cache_name == (char *)0);
+	if (draw_flag != 0)  {
+		draw_dlg_begin(&datum, image_corners);
+	}
+	(void)le_reserve();
+	(void)ddf_bind(le_ddf, le_items, LE_NUM_ITEMS);
 	attrib = -1;	// Use this convenient variable as a non-related flag for first trip through loop.
 	count = 0;
-	while (get_subfield(&subfield) != 0)  {
-		if (strcmp(subfield.tag, "LINE") == 0)  {
-			if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				/* We are starting a new line.  Initialize what need initializing. */
-				if (attrib >= 0)  {
-					/*
-					 * If we aren't starting the first line,
-					 * then terminate the attribute string and node list of the
-					 * previous line and update the counts.
-					 */
-					*current_attrib = (struct attribute *)0;
-					*current_point = (struct point *)0;
-					lines[num_lines].number_attrib = attrib;
-					lines[num_lines].number_coords = count;
-					uniq_attrib(&lines[num_lines].attribute, &lines[num_lines].number_attrib);
-				}
-				module_num = -1;
-				num_lines++;
-				count = 0;
-				attrib = 0;
-				if (num_lines >= MAX_LINES)  {
-					fprintf(stderr, "Ran out of space to store lines.  Some lines may be missing.\n");
-					break;
-				}
-				current_attrib = &lines[num_lines].attribute;
-				current_point = &lines[num_lines].point;
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				lines[num_lines].id = strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-			}
+	for (record_pos = ddf_tell(le_ddf); get_record(le_ddf, le_items, LE_NUM_ITEMS) != 0; record_pos = ddf_tell(le_ddf))  {
+		if (le_reserve() != 0)  {
+			/* The record had more attributes or coordinates than would fit.  Decode it again. */
+			decode_record(le_ddf, le_items, LE_NUM_ITEMS);
 		}
-		else if (strcmp(subfield.tag, "ATID") == 0)  {
-			if ((strstr(subfield.format, "A") != (char *)0) && (strcmp(subfield.label, "MODN") == 0))  {
-				if (subfield.length != 4)  {
-					fprintf(stderr, "Attribute module name (%.*s) is not 4 characters long.\n", subfield.length, subfield.value);
-					module_num = -1;
-					continue;
-				}
-				for (module_num = 0; module_num < num_attrib_files; module_num++)  {
-					if (strncmp(subfield.value, attrib_files[module_num].module_name, 4) == 0)  {
-						break;
-					}
-				}
-				if (module_num == num_attrib_files)  {
-					fprintf(stderr, "Warning:  Attribute module has unexpected name (%.*s).  Attributes may be in error.\n", subfield.length, subfield.value);
-					module_num = -1;
-				}
-			}
-			else if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				if (module_num < 0)  {
-					continue;
-				}
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				i =  strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-				if (i <= attrib_files[module_num].num_attrib)  {
-					for (j = 0; j < MAX_EXTRA; j++)  {
-						if (attrib_files[module_num].attrib[i - 1].major[j] != 0)  {
-							*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-							if (*current_attrib == (struct attribute *)0)  {
-								fprintf(stderr, "malloc failed\n");
-								exit(0);
-							}
-							(*current_attrib)->major = attrib_files[module_num].attrib[i - 1].major[j];
-							(*current_attrib)->minor = attrib_files[module_num].attrib[i - 1].minor[j];
 
-							current_attrib = &((*current_attrib)->attribute);
-							attrib++;
-						}
-					}
+		if (le_items[LE_LINE].count > 0)  {
+			/* We are starting a new line.  Initialize what need initializing. */
+			if (attrib >= 0)  {
+				/*
+				 * If we aren't starting the first line,
+				 * then terminate the attribute string and node list of the
+				 * previous line and update the counts.
+				 */
+				lines[num_lines].number_attrib = attrib;
+				lines[num_lines].number_coords = count;
+				uniq_attrib(lines[num_lines].attribute, &lines[num_lines].number_attrib);
+				set_line_bounds(&lines[num_lines]);
+				if (file_image_flag != 0)  {
+					dlg_arena.num_coords = lines[num_lines].point;
+				}
+				else if (draw_flag != 0)  {
+					le_draw_line(&datum, num_lines, color, data_type, image_corners);
 				}
 			}
+			num_lines++;
+			count = 0;
+			attrib = 0;
+			dlg_reserve_lines(num_lines + 1);
+			lines[num_lines].attribute = dlg_arena.num_attrib;
+			lines[num_lines].point = dlg_arena.num_coords;
+			lines[num_lines].id = le_record.id;
+			lines[num_lines].record = record_pos;
+			lines[num_lines].drawn = 0;
 		}
-		else if (strcmp(subfield.tag, "PIDL") == 0)  {
-			if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				lines[num_lines].left_area = strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-			}
+		if (num_lines < 0)  {
+			/* There is no line to attach the rest of the record to. */
+			continue;
 		}
-		else if (strcmp(subfield.tag, "PIDR") == 0)  {
-			if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				lines[num_lines].right_area = strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-			}
+
+		if (le_items[LE_PIDL].count > 0)  {
+			lines[num_lines].left_area = le_record.left_area;
 		}
-		else if (strcmp(subfield.tag, "SNID") == 0)  {
-			if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				lines[num_lines].start_node = strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-			}
+		if (le_items[LE_PIDR].count > 0)  {
+			lines[num_lines].right_area = le_record.right_area;
 		}
-		else if (strcmp(subfield.tag, "ENID") == 0)  {
-			if ((strstr(subfield.format, "I") != (char *)0) && (strcmp(subfield.label, "RCID") == 0))  {
-				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
-				lines[num_lines].end_node = strtol(subfield.value, (char **)0, 10);
-				subfield.value[subfield.length] = save_byte;
-			}
+		if (le_items[LE_SNID].count > 0)  {
+			lines[num_lines].start_node = le_record.start_node;
 		}
-		else if (strcmp(subfield.tag, "SADR") == 0)  {
-			/*
-			 * We assume that the X coordinate always comes first.
-			 */
-			if ((strstr(subfield.format, "B") != (char *)0) && (strcmp(subfield.label, "X") == 0))  {
-				*current_point = (struct point *)malloc(sizeof(struct point));
-				if (*current_point == (struct point *)0)  {
-					fprintf(stderr, "malloc failed\n");
-					exit(0);
-				}
-
-				if (subfield.length != 4)  {
-					/* Error */
-					(*current_point)->x = -1.0;
-				}
-				else  {
-					i = (((int32_t)subfield.value[3] & 0xff) << 24) |
-					    (((int32_t)subfield.value[2] & 0xff) << 16) |
-					    (((int32_t)subfield.value[1] & 0xff) <<  8) |
-					     ((int32_t)subfield.value[0] & 0xff);
-					if (byte_order == 0)  {
-						(*current_point)->x = (double)i * x_scale_factor + x_origin;
-					}
-					else if (byte_order == 1)  {
-						LE_SWAB(&i);
-						(*current_point)->x = (double)i * x_scale_factor + x_origin;
-					}
-					else if (byte_order == 2)  {
-						PDP_SWAB(&i);
-						(*current_point)->x = (double)i * x_scale_factor + x_origin;
-					}
-				}
-			}
-			else if ((strstr(subfield.format, "B") != (char *)0) && (strcmp(subfield.label, "Y") == 0))  {
-				if (subfield.length != 4)  {
-					/* Error */
-					(*current_point)->y = -1.0;
-				}
-				else  {
-					i = (((int32_t)subfield.value[3] & 0xff) << 24) |
-					    (((int32_t)subfield.value[2] & 0xff) << 16) |
-					    (((int32_t)subfield.value[1] & 0xff) <<  8) |
-					     ((int32_t)subfield.value[0] & 0xff);
-					if (byte_order == 0)  {
-						(*current_point)->y = (double)i * y_scale_factor + y_origin;
-					}
-					else if (byte_order == 1)  {
-						LE_SWAB(&i);
-						(*current_point)->y = (double)i * y_scale_factor + y_origin;
-					}
-					else if (byte_order == 2)  {
-						PDP_SWAB(&i);
-						(*current_point)->y = (double)i * y_scale_factor + y_origin;
-					}
-				}
-
-				current_point = &((*current_point)->point);
-				count++;
-			}
+		if (le_items[LE_ENID].count > 0)  {
+			lines[num_lines].end_node = le_record.end_node;
 		}
+
+		le_add_record(num_attrib_files, x_scale_factor, x_origin, y_scale_factor, y_origin,
+			file_image_flag == 0 ? &attrib : (int32_t *)0, &count);
 	}
 	if (num_lines >= 0)  {
 		/*
@@ -1710,15 +1939,25 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 		 * then close out the attribute and node information of the
 		 * previous line and update the counts.
 		 */
-		*current_attrib = (struct attribute *)0;
-		*current_point = (struct point *)0;
 		lines[num_lines].number_attrib = attrib;
 		lines[num_lines].number_coords = count;
-		uniq_attrib(&lines[num_lines].attribute, &lines[num_lines].number_attrib);
+		uniq_attrib(lines[num_lines].attribute, &lines[num_lines].number_attrib);
+		set_line_bounds(&lines[num_lines]);
+		if (file_image_flag != 0)  {
+			dlg_arena.num_coords = lines[num_lines].point;
+		}
+		else if (draw_flag != 0)  {
+			le_draw_line(&datum, num_lines, color, data_type, image_corners);
+		}
 	}
 	num_lines++;
-	/* We are done with this file, so close it. */
-	end_ddf();
+	/*
+	 * If we are writing a DLG file, we will be back to read the lines
+	 * again, so leave the file open until then.
+	 */
+	if (file_image_flag == 0)  {
+		ddf_close(le_ddf);
+	}
 
 
 
@@ -1768,18 +2007,14 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					 * then terminate the attribute string of the
 					 * previous node and update the count.
 					 */
-					*current_attrib = (struct attribute *)0;
 					nodes[num_nodes].number_attrib = attrib;
-					uniq_attrib(&nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
+					uniq_attrib(nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
 				}
 				module_num = -1;
 				num_nodes++;
 				attrib = 0;
-				if (num_nodes >= MAX_NODES)  {
-					fprintf(stderr, "Ran out of space to store nodes.  Some nodes may be missing.\n");
-					break;
-				}
-				current_attrib = &nodes[num_nodes].attribute;
+				dlg_reserve_nodes(num_nodes + 1);
+				nodes[num_nodes].attribute = dlg_arena.num_attrib;
 				save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
 				nodes[num_nodes].id = strtol(subfield.value, (char **)0, 10);
 				subfield.value[subfield.length] = save_byte;
@@ -1812,15 +2047,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 				if (i <= attrib_files[module_num].num_attrib)  {
 					for (j = 0; j < MAX_EXTRA; j++)  {
 						if (attrib_files[module_num].attrib[i - 1].major[j] != 0)  {
-							*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-							if (*current_attrib == (struct attribute *)0)  {
-								fprintf(stderr, "malloc failed\n");
-								exit(0);
-							}
-							(*current_attrib)->major = attrib_files[module_num].attrib[i - 1].major[j];
-							(*current_attrib)->minor = attrib_files[module_num].attrib[i - 1].minor[j];
-
-							current_attrib = &((*current_attrib)->attribute);
+							(void)dlg_arena_add_attrib(attrib_files[module_num].attrib[i - 1].major[j], attrib_files[module_num].attrib[i - 1].minor[j]);
 							attrib++;
 						}
 					}
@@ -1885,9 +2112,8 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 		 * then close out the attribute information of the
 		 * previous line and node and update the counts.
 		 */
-		*current_attrib = (struct attribute *)0;
 		nodes[num_nodes].number_attrib = attrib;
-		uniq_attrib(&nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
+		uniq_attrib(nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
 	}
 	num_nodes++;
 	num_NO_nodes = num_nodes;
@@ -1956,36 +2182,31 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 						 * then terminate the attribute string of the
 						 * previous line and update the counts.
 						 */
-						*current_attrib = (struct attribute *)0;
-						*current_point = (struct point *)0;
 						lines[num_lines].number_attrib = attrib;
 						lines[num_lines].number_coords = count;
-						uniq_attrib(&lines[num_lines].attribute, &lines[num_lines].number_attrib);
+						uniq_attrib(lines[num_lines].attribute, &lines[num_lines].number_attrib);
+						set_line_bounds(&lines[num_lines]);
 	
 //						*current_attrib2 = (struct attribute *)0;
 //						nodes[num_nodes].number_attrib = attrib;
-//						uniq_attrib(&nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
+//						uniq_attrib(nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
 					}
 					module_num = -1;
 					num_nodes++;
 					num_lines++;
 					count = 0;
 					attrib = 0;
-					if (num_nodes >= MAX_NODES)  {
-						fprintf(stderr, "Ran out of space to store nodes.  Some nodes may be missing.\n");
-						break;
-					}
-					if (num_lines >= MAX_LINES)  {
-						fprintf(stderr, "Ran out of space to store lines.  Some lines may be missing.\n");
-						break;
-					}
+					dlg_reserve_nodes(num_nodes + 1);
+					dlg_reserve_lines(num_lines + 1);
 //					current_attrib2 = &nodes[num_nodes].attribute;
 					save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
 					nodes[num_nodes].id = strtol(subfield.value, (char **)0, 10);
 					subfield.value[subfield.length] = save_byte;
 	
-					current_attrib = &lines[num_lines].attribute;
-					current_point = &lines[num_lines].point;
+					lines[num_lines].attribute = dlg_arena.num_attrib;
+					lines[num_lines].point = dlg_arena.num_coords;
+					lines[num_lines].record = -1;	// Degenerate lines stay in dlg_arena.
+					lines[num_lines].drawn = 0;
 					lines[num_lines].id = nodes[num_nodes].id;
 					lines[num_lines].start_node = nodes[num_nodes].id;
 					lines[num_lines].end_node = nodes[num_nodes].id;
@@ -2018,25 +2239,8 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					if (i <= attrib_files[module_num].num_attrib)  {
 						for (j = 0; j < MAX_EXTRA; j++)  {
 							if (attrib_files[module_num].attrib[i - 1].major[j] != 0)  {
-								*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-								if (*current_attrib == (struct attribute *)0)  {
-									fprintf(stderr, "malloc failed\n");
-									exit(0);
-								}
-//								*current_attrib2 = (struct attribute *)malloc(sizeof(struct attribute));
-//								if (*current_attrib2 == (struct attribute *)0)  {
-//									fprintf(stderr, "malloc failed\n");
-//									exit(0);
-//								}
-
-								(*current_attrib)->major = attrib_files[module_num].attrib[i - 1].major[j];	// line attribute entry
-								(*current_attrib)->minor = attrib_files[module_num].attrib[i - 1].minor[j];
-
-//								(*current_attrib2)->major = attrib_files[module_num].attrib[i - 1].major[j];	// node attribute entry
-//								(*current_attrib2)->minor = attrib_files[module_num].attrib[i - 1].minor[j];
-
-								current_attrib = &((*current_attrib)->attribute);
-//								current_attrib2 = &((*current_attrib2)->attribute);
+//								node_attrib = dlg_arena_add_attrib(attrib_files[module_num].attrib[i - 1].major[j], attrib_files[module_num].attrib[i - 1].minor[j]);	// node attribute entry
+								(void)dlg_arena_add_attrib(attrib_files[module_num].attrib[i - 1].major[j], attrib_files[module_num].attrib[i - 1].minor[j]);	// line attribute entry
 								attrib++;
 							}
 						}
@@ -2058,23 +2262,14 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 				 */
 				if ((strstr(subfield.format, "B") != (char *)0) && (strcmp(subfield.label, "X") == 0))  {
 					/* We must add an extra endpoint, so get two storage slots instead of one. */
-					*current_point = (struct point *)malloc(sizeof(struct point));
-					if (*current_point == (struct point *)0)  {
-						fprintf(stderr, "malloc failed\n");
-						exit(0);
-					}
-					current_point2 = &((*current_point)->point);
-					*current_point2 = (struct point *)malloc(sizeof(struct point));
-					if (*current_point2 == (struct point *)0)  {
-						fprintf(stderr, "malloc failed\n");
-						exit(0);
-					}
+					current_point = dlg_arena_add_coord(-1.0, -1.0);
+					current_point2 = dlg_arena_add_coord(-1.0, -1.0);
 	
 					if (subfield.length != 4)  {
 						/* Error */
 						nodes[num_nodes].x = -1.0;
-						(*current_point)->x = -1.0;
-						(*current_point2)->x = -1.0;
+						dlg_arena.x[current_point] = -1.0;
+						dlg_arena.x[current_point2] = -1.0;
 					}
 					else  {
 						i = (((int32_t)subfield.value[3] & 0xff) << 24) |
@@ -2083,20 +2278,20 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 						     ((int32_t)subfield.value[0] & 0xff);
 						if (byte_order == 0)  {
 							nodes[num_nodes].x = (double)i * x_scale_factor + x_origin;
-							(*current_point)->x = nodes[num_nodes].x;
-							(*current_point2)->x = nodes[num_nodes].x;
+							dlg_arena.x[current_point] = nodes[num_nodes].x;
+							dlg_arena.x[current_point2] = nodes[num_nodes].x;
 						}
 						else if (byte_order == 1)  {
 							LE_SWAB(&i);
 							nodes[num_nodes].x = (double)i * x_scale_factor + x_origin;
-							(*current_point)->x = nodes[num_nodes].x;
-							(*current_point2)->x = nodes[num_nodes].x;
+							dlg_arena.x[current_point] = nodes[num_nodes].x;
+							dlg_arena.x[current_point2] = nodes[num_nodes].x;
 						}
 						else if (byte_order == 2)  {
 							PDP_SWAB(&i);
 							nodes[num_nodes].x = (double)i * x_scale_factor + x_origin;
-							(*current_point)->x = nodes[num_nodes].x;
-							(*current_point2)->x = nodes[num_nodes].x;
+							dlg_arena.x[current_point] = nodes[num_nodes].x;
+							dlg_arena.x[current_point2] = nodes[num_nodes].x;
 						}
 					}
 				}
@@ -2104,8 +2299,8 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					if (subfield.length != 4)  {
 						/* Error */
 						nodes[num_nodes].y = -1.0;
-						(*current_point)->y = -1.0;
-						(*current_point2)->y = -1.0;
+						dlg_arena.y[current_point] = -1.0;
+						dlg_arena.y[current_point2] = -1.0;
 					}
 					else  {
 						i = (((int32_t)subfield.value[3] & 0xff) << 24) |
@@ -2114,24 +2309,23 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 						     ((int32_t)subfield.value[0] & 0xff);
 						if (byte_order == 0)  {
 							nodes[num_nodes].y = (double)i * y_scale_factor + y_origin;
-							(*current_point)->y = nodes[num_nodes].y;
-							(*current_point2)->y = nodes[num_nodes].y;
+							dlg_arena.y[current_point] = nodes[num_nodes].y;
+							dlg_arena.y[current_point2] = nodes[num_nodes].y;
 						}
 						else if (byte_order == 1)  {
 							LE_SWAB(&i);
 							nodes[num_nodes].y = (double)i * y_scale_factor + y_origin;
-							(*current_point)->y = nodes[num_nodes].y;
-							(*current_point2)->y = nodes[num_nodes].y;
+							dlg_arena.y[current_point] = nodes[num_nodes].y;
+							dlg_arena.y[current_point2] = nodes[num_nodes].y;
 						}
 						else if (byte_order == 2)  {
 							PDP_SWAB(&i);
 							nodes[num_nodes].y = (double)i * y_scale_factor + y_origin;
-							(*current_point)->y = nodes[num_nodes].y;
-							(*current_point2)->y = nodes[num_nodes].y;
+							dlg_arena.y[current_point] = nodes[num_nodes].y;
+							dlg_arena.y[current_point2] = nodes[num_nodes].y;
 						}
 					}
 	
-					current_point = &((*current_point2)->point);
 					count++;
 					count++;
 				}
@@ -2143,15 +2337,14 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * then close out the attribute information of the
 			 * previous line and node and update the counts.
 			 */
-			*current_attrib = (struct attribute *)0;
-			*current_point = (struct point *)0;
 			lines[num_lines].number_attrib = attrib;
 			lines[num_lines].number_coords = count;
-			uniq_attrib(&lines[num_lines].attribute, &lines[num_lines].number_attrib);
+			uniq_attrib(lines[num_lines].attribute, &lines[num_lines].number_attrib);
+			set_line_bounds(&lines[num_lines]);
 	
 //			*current_attrib2 = (struct attribute *)0;
 //			nodes[num_nodes].number_attrib = attrib;
-//			uniq_attrib(&nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
+//			uniq_attrib(nodes[num_nodes].attribute, &nodes[num_nodes].number_attrib);
 // For degenerate lines, the nodes don't appear to have the attributes attached.
 // Thus, we simply zero out the attribute count.  However, we will leave the
 // code in place for now, that keeps an attribute list for the nodes, just in
@@ -2231,9 +2424,13 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					if (module_num < 0)  {
 						continue;
 					}
-					if (num_polys >= MAX_POLY_NUM)  {
-						fprintf(stderr, "Ran out of polygon space.  Some attributes may not show up.\n");
-						break;
+					if (num_polys >= polygon_attrib_size)  {
+						polygon_attrib_size = polygon_attrib_size == 0 ? 4096 : polygon_attrib_size << 1;
+						polygon_attrib = (struct polygon_attrib *)realloc(polygon_attrib, polygon_attrib_size * sizeof(struct polygon_attrib));
+						if (polygon_attrib == (struct polygon_attrib *)0)  {
+							fprintf(stderr, "realloc of polygon attribute storage failed\n");
+							exit(0);
+						}
 					}
 					polygon_attrib[num_polys].poly_id = current_poly;
 					save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
@@ -2265,11 +2462,12 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 	 * representative point near that corner.
 	 */
 	num_areas++;
+	dlg_reserve_areas(num_areas + 1);
 	areas[num_areas].id = 1;
 	areas[num_areas].x = sw_x;
 	areas[num_areas].y = sw_y;
 	areas[num_areas].number_attrib = 0;
-	areas[num_areas].attribute = (struct attribute *)0;
+	areas[num_areas].attribute = dlg_arena.num_attrib;
 
 	strncpy(file_name, passed_file_name, MAX_FILE_NAME);
 	if (upper_case_flag == 0)  {
@@ -2310,17 +2508,13 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 						 * then terminate the attribute string of the
 						 * previous area and update the counts.
 						 */
-						*current_attrib = (struct attribute *)0;
 						areas[num_areas].number_attrib = attrib;
-						uniq_attrib(&areas[num_areas].attribute, &areas[num_areas].number_attrib);
+						uniq_attrib(areas[num_areas].attribute, &areas[num_areas].number_attrib);
 					}
 					num_areas++;
 					attrib = 0;
-					if (num_areas >= MAX_AREAS)  {
-						fprintf(stderr, "Ran out of space to store areas.  Some areas may be missing.\n");
-						break;
-					}
-					current_attrib = &areas[num_areas].attribute;
+					dlg_reserve_areas(num_areas + 1);
+					areas[num_areas].attribute = dlg_arena.num_attrib;
 					save_byte = subfield.value[subfield.length]; subfield.value[subfield.length] = '\0';
 					areas[num_areas].id = strtol(subfield.value, (char **)0, 10);
 					subfield.value[subfield.length] = save_byte;
@@ -2388,16 +2582,8 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 							if (polygon_attrib[j].attrib <= attrib_files[(int32_t)polygon_attrib[j].module_num].num_attrib)  {
 								for (k = 0; k < MAX_EXTRA; k++)  {
 									if (attrib_files[(int32_t)polygon_attrib[j].module_num].attrib[polygon_attrib[j].attrib - 1].major[k] != 0)  {
-										*current_attrib = (struct attribute *)malloc(sizeof(struct attribute));
-										if (*current_attrib == (struct attribute *)0)  {
-											fprintf(stderr, "malloc failed\n");
-											exit(0);
-										}
-	
-										(*current_attrib)->major = attrib_files[(int32_t)polygon_attrib[j].module_num].attrib[polygon_attrib[j].attrib - 1].major[k];
-										(*current_attrib)->minor = attrib_files[(int32_t)polygon_attrib[j].module_num].attrib[polygon_attrib[j].attrib - 1].minor[k];
-	
-										current_attrib = &((*current_attrib)->attribute);
+										(void)dlg_arena_add_attrib(attrib_files[(int32_t)polygon_attrib[j].module_num].attrib[polygon_attrib[j].attrib - 1].major[k],
+													   attrib_files[(int32_t)polygon_attrib[j].module_num].attrib[polygon_attrib[j].attrib - 1].minor[k]);
 										attrib++;
 									}
 								}
@@ -2413,9 +2599,8 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * then close out the attribute and node information of the
 			 * previous area and update the counts.
 			 */
-			*current_attrib = (struct attribute *)0;
 			areas[num_areas].number_attrib = attrib;
-			uniq_attrib(&areas[num_areas].attribute, &areas[num_areas].number_attrib);
+			uniq_attrib(areas[num_areas].attribute, &areas[num_areas].number_attrib);
 		}
 		/* We are done with this file, so close it. */
 		end_ddf();
@@ -2502,10 +2687,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 		 * the missing node slots in the node list.
 		 */
 		if (num_nodes > num_NO_nodes)  {
-			if (num_nodes >= MAX_NODES)  {	// We need one extra node slot for temporary storage
-				fprintf(stderr, "Ran out of space to store nodes.  Non-recoverable error.\n");
-				exit(0);
-			}
+			dlg_reserve_nodes(num_nodes + 1);	// We need one extra node slot for temporary storage
 			i = num_NO_nodes;
 			for (j = 0; j < num_nodes; j++)  {
 				if (nodes[j].id != (j + 1))  {
@@ -2545,28 +2727,24 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 		 * (The line list consists of all linear features for which this node is an endpoint.
 		 * The lines appear in no particular order.)
 		 */
+		max_id = 0;
 		for (i = 0; i < num_nodes; i++)  {
-			line_list_size = -1;
-			for (j = 0; j < num_lines; j++)  {
-				if (lines[j].start_node == nodes[i].id)  {
-					if ((line_list_size + 1) == MAX_LINE_LIST)  {
-						fprintf(stderr, "Ran out of space for a nodal line list (node %d).  Some lines are missing.\n", i + 1);
-						break;
-					}
-					line_list_size++;
-					line_list[line_list_size] = lines[j].id;
-				}
-				/* Note:  This is not an "else if" because degenerate lines must appear twice in the list. */
-				if (lines[j].end_node == nodes[i].id)  {
-					if ((line_list_size + 1) == MAX_LINE_LIST)  {
+			if (nodes[i].id > max_id)  {
+				max_id = nodes[i].id;
+			}
+		}
+		index_lines(num_lines, max_id, 0);
+		for (i = 0; i < num_nodes; i++)  {
+			line_list_size = 0;
+			if ((nodes[i].id >= 1) && (nodes[i].id <= max_id))  {
+				for (j = line_index_start[nodes[i].id]; j < line_index_start[nodes[i].id + 1]; j++)  {
+					if (line_list_size == MAX_LINE_LIST)  {
 						fprintf(stderr, "Ran out of space for a nodal line list (node %d).  Some lines are missing.\n", i + 1);
 						break;
 					}
-					line_list_size++;
-					line_list[line_list_size] = -lines[j].id;
+					line_list[line_list_size++] = line_index[j];
 				}
 			}
-			line_list_size++;
 
 			/*
 			 * Print the first record of the node.
@@ -2610,9 +2788,9 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * Print the attribute records.
 			 */
 			j = 0;
-			current_attrib = &nodes[i].attribute;
+			current_attrib = &dlg_arena.attrib[nodes[i].attribute];
 			for (k = 0; k < nodes[i].number_attrib; k++)  {
-				sprintf(&buf[j], "%6d%6d", (*current_attrib)->major, (*current_attrib)->minor);
+				sprintf(&buf[j], "%6d%6d", current_attrib->major, current_attrib->minor);
 				j = j + 12;
 				if (j == 72)  {
 					for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2624,7 +2802,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					}
 					j = 0;
 				}
-				current_attrib = &((*current_attrib)->attribute);
+				current_attrib++;
 			}
 			if (j > 0)  {
 				for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2646,22 +2824,24 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 		 * inserting a line number of zero into the list ahead of them.
 		 * Island nodes are listed in counterclockwise order.)
 		 */
+		max_id = 0;
 		for (i = 0; i < num_areas; i++)  {
-			line_list_size = -1;
-			for (j = 0; j < num_lines; j++)  {
-				if (lines[j].left_area == lines[j].right_area)  {
-					continue;
-				}
-				if ((lines[j].right_area == areas[i].id) || (lines[j].left_area == areas[i].id))  {
-					if ((line_list_size + 2) == MAX_LINE_LIST)  {	// Reserve an empty spot at the end of the list for later.
+			if (areas[i].id > max_id)  {
+				max_id = areas[i].id;
+			}
+		}
+		index_lines(num_lines, max_id, 1);
+		for (i = 0; i < num_areas; i++)  {
+			line_list_size = 0;
+			if ((areas[i].id >= 1) && (areas[i].id <= max_id))  {
+				for (j = line_index_start[areas[i].id]; j < line_index_start[areas[i].id + 1]; j++)  {
+					if ((line_list_size + 1) == MAX_LINE_LIST)  {	// Reserve an empty spot at the end of the list for later.
 						fprintf(stderr, "Ran out of space for an areal line list.  Some lines are missing for area %d.\n", i + 1);
 						break;
 					}
-					line_list_size++;
-					line_list[line_list_size] = lines[j].id;
+					line_list[line_list_size++] = line_index[j];
 				}
 			}
-			line_list_size++;
 
 			/*
 			 * Now we have the line list, but it still must be sorted
@@ -2677,16 +2857,14 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * in the enclosing polygon.)  The sorting
 			 * algorithm will pull contiguous points toward this first point,
 			 * and thus pull the primary area toward the front of the list.
+			 * (The line coordinates are no longer in memory, but the
+			 * bounding box of each line gives us its northernmost point.)
 			 */
 			y = -11000000.0;
 			for (j = 0; j < line_list_size; j++)  {
-				current_point = &lines[line_list[j] - 1].point;
-				while (*current_point != (struct point *)0)  {
-					if ((*current_point)->y > y)  {
-						y = (*current_point)->y;
-						k = j;
-					}
-					current_point = &((*current_point)->point);
+				if ((lines[line_list[j] - 1].number_coords > 0) && (lines[line_list[j] - 1].bounds.y_max > y))  {
+					y = lines[line_list[j] - 1].bounds.y_max;
+					k = j;
 				}
 			}
 			j = line_list[k];
@@ -2800,9 +2978,9 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * Print the attribute records.
 			 */
 			j = 0;
-			current_attrib = &areas[i].attribute;
+			current_attrib = &dlg_arena.attrib[areas[i].attribute];
 			for (k = 0; k < areas[i].number_attrib; k++)  {
-				sprintf(&buf[j], "%6d%6d", (*current_attrib)->major, (*current_attrib)->minor);
+				sprintf(&buf[j], "%6d%6d", current_attrib->major, current_attrib->minor);
 				j = j + 12;
 				if (j == 72)  {
 					for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2814,7 +2992,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					}
 					j = 0;
 				}
-				current_attrib = &((*current_attrib)->attribute);
+				current_attrib++;
 			}
 			if (j > 0)  {
 				for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2843,8 +3021,31 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 
 		/*
 		 * Now go through the lines, and print out the records.
+		 * The coordinates and attributes of most lines have to be read
+		 * in again first.  (See the comments at the top of the LE?? code.)
 		 */
 		for (i = 0; i < num_lines; i++)  {
+			if (lines[i].record >= 0)  {
+				lines[i].attribute = dlg_arena.num_attrib;
+				lines[i].point = dlg_arena.num_coords;
+				attrib = 0;
+				count = 0;
+				ddf_seek(le_ddf, lines[i].record);
+				for (j = 0; get_record(le_ddf, le_items, LE_NUM_ITEMS) != 0; j++)  {
+					if (le_reserve() != 0)  {
+						decode_record(le_ddf, le_items, LE_NUM_ITEMS);
+					}
+					if ((j > 0) && (le_items[LE_LINE].count > 0))  {
+						/* This is the start of the next line. */
+						break;
+					}
+					le_add_record(num_attrib_files, x_scale_factor, x_origin, y_scale_factor, y_origin, &attrib, &count);
+				}
+				lines[i].number_attrib = attrib;
+				lines[i].number_coords = count;
+				uniq_attrib(lines[i].attribute, &lines[i].number_attrib);
+			}
+
 			/*
 			 * Print the first record of the node.
 			 */
@@ -2860,9 +3061,9 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * Print the coordinate-list records.
 			 */
 			j = 0;
-			current_point = &lines[i].point;
+			current_point = lines[i].point;
 			for (k = 0; k < lines[i].number_coords; k++)  {
-				sprintf(&buf[j], "%12.2f%12.2f", (*current_point)->x, (*current_point)->y);
+				sprintf(&buf[j], "%12.2f%12.2f", dlg_arena.x[current_point], dlg_arena.y[current_point]);
 				j = j + 24;
 				if (j == 72)  {
 					for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2874,7 +3075,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					}
 					j = 0;
 				}
-				current_point = &((*current_point)->point);
+				current_point++;
 			}
 			if (j > 0)  {
 				for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2890,9 +3091,9 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 			 * Print the attribute records.
 			 */
 			j = 0;
-			current_attrib = &lines[i].attribute;
+			current_attrib = &dlg_arena.attrib[lines[i].attribute];
 			for (k = 0; k < lines[i].number_attrib; k++)  {
-				sprintf(&buf[j], "%6d%6d", (*current_attrib)->major, (*current_attrib)->minor);
+				sprintf(&buf[j], "%6d%6d", current_attrib->major, current_attrib->minor);
 				j = j + 12;
 				if (j == 72)  {
 					for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2904,7 +3105,7 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					}
 					j = 0;
 				}
-				current_attrib = &((*current_attrib)->attribute);
+				current_attrib++;
 			}
 			if (j > 0)  {
 				for ( ; j < DLG_RECORD_LENGTH; j++)  {
@@ -2915,259 +3116,64 @@ process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag
 					exit(0);
 				}
 			}
+
+			if (lines[i].record >= 0)  {
+				dlg_arena.num_coords = lines[i].point;
+				dlg_arena.num_attrib = lines[i].attribute;
+			}
 		}
 		close(output_fdesc);
+		ddf_close(le_ddf);
 	}
 	else  {
 		/*
 		 * This is the big block of code that writes the data
-		 * to the drawmap image buffer.
-		 *
-		 * First find the x and y image coordinates that border this DLG chunk.
-		 *
-		 * Then draw the lines for which we have appropriate atribute codes stored,
-		 * but don't go outside the x-y border.
-		 *
-		 * Then fill in all of the areas for which we have
-		 * appropriate attribute codes stored, but don't go outside
-		 * the x-y border.
-		 */
-		dlg_x_low = -1 + drawmap_round((long_sw - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-		dlg_y_low = image_corners->y - 1 - drawmap_round((lat_ne - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-		dlg_x_high = -1 + drawmap_round((long_ne - image_corners->sw_long) * (double)image_corners->x / (image_corners->ne_long - image_corners->sw_long));
-		dlg_y_high = image_corners->y - 1 - drawmap_round((lat_sw - image_corners->sw_lat) * (double)image_corners->y / (image_corners->ne_lat - image_corners->sw_lat));
-		if (dlg_x_low < -1)  {
-			dlg_x_low = -1;
-		}
-		if (dlg_y_low < -1)  {
-			dlg_y_low = -1;
-		}
-		if (dlg_x_high >= image_corners->x)  {
-			dlg_x_high = image_corners->x - 1;
-		}
-		if (dlg_y_high >= image_corners->y)  {
-			dlg_y_high = image_corners->y - 1;
-		}
-
-		/*
-		 * Cycle through all of the line data and draw all of the appropriate lines
-		 * onto the image (overlaying any previous data).
+		 * to the drawmap image buffer.  It is shared with the
+		 * optional-format DLG code.
 		 */
-		for (i = 0; i < num_lines; i++)  {
-			/*
-			 * In the DLG-3 format, the first area element listed
-			 * represents the universe outside of the map area.
-			 * (In SDTS, this is apparently no longer encodes as an area,
-			 * but is stored in connection with the definition of the data boundaries.)
-			 * Thus, lines that have area 1 as a boundary should be
-			 * "neatlines" that bound the map area.
-			 * Since these clutter up a map, we normally discard them.
-			 * (If you want to keep them, then change the #define of OMIT_NEATLINES
-			 * so that it is zero, rather than non-zero.)
-			 *
-			 * Here are relevant quotes from the DLG-3 guide:
-			 *
-			 *	expressed by network data is that of connectivity.  The network case
-			 *	differs from the area case in that, irrespective of the number of closed
-			 *	areas forming the graph, only two areas are encoded:  (1) the area out-
-			 *	side the graph, termed the outside area; and (2) the area within the
-			 *	graph, termed the background area.  All lines except the graph boundary,
-			 *	or neatline, are considered to be contained within the background area.
-			 *
-			 *	map border.  There is one outside area for each DLG-3. It is always the
-			 *	first area encountered (its ID is 1) and has the attribute code 000 0000.
-			 */
-
-			/*
-			 * If the user provided a file full of attributes, then
-			 * use them to control whether or not the lines are drawn.
-			 * If not, then just go ahead and draw everything.
-			 *
-			 * Note:  If a major or minor attribute code in the attribute
-			 *        file (supplied by the user) is less than
-			 *        zero, it is treated as a wild card and matches
-			 *        anything.
-			 */
-			if ((num_A_attrib > 0) || (num_L_attrib > 0))  {
-				if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
-					current_attrib = &lines[i].attribute;
-					if (*current_attrib != (struct attribute *)0)  {
-						while (*current_attrib != (struct attribute *)0)  {
-							for (j = 0; j < num_L_attrib; j++)  {
-								if (((attributes_L[j].major < 0) ||
-								     (attributes_L[j].major == ((*current_attrib)->major))) &&
-								    ((attributes_L[j].minor < 0) ||
-								     (attributes_L[j].minor == ((*current_attrib)->minor))))  {
-									draw_lines(&datum, lines[i].point, color, image_corners);
-									goto FIN1;
-								}
-							}
-							current_attrib = &((*current_attrib)->attribute);
-						}
-					}
-					else  {
-						/*
-						 * If the feature had no attribute codes, then check if
-						 * it is covered by a wild card in the attributes file.
-						 */
-						for (j = 0; j < num_L_attrib; j++)  {
-							if (((attributes_L[j].major < 0) ||
-							     (attributes_L[j].major == data_type)) &&
-							    (attributes_L[j].minor < 0))  {
-								draw_lines(&datum, lines[i].point, color, image_corners);
-								goto FIN1;
-							}
-						}
-					}
-				}
+		draw_dlg(&datum, color, data_type, num_lines, num_areas, image_corners);
+	}
 
-				/*
-				 * For those (hopefully rare) occasions in which something
-				 * goes wrong, we provide the capability for a user to
-				 * specifically request a single line from a DLG file so that
-				 * the cause of the problem can be isolated.
-				 * The user specifies a specific line by providing a major
-				 * attribute number of 10000, and a minor attribute number
-				 * equal to the desired line ID number.  Since no
-				 * valid attribute (as far as I know) is ever as large as
-				 * 10,000, such user-specified attribute pairs will not
-				 * affect the search for legitimate attributes above (since
-				 * they can't possibly match anything).  If we reach this point,
-				 * then we failed to draw a line due to the legitimate-attribute
-				 * checks above; so we give it one more try here, based on
-				 * user-requested ID numbers.
-				 *
-				 * Note:  If you are using this feature, then it doesn't make
-				 *        a lot of sense to process more than one DLG file,
-				 *        since the ID number you give (as the minor attribute)
-				 *        will be matched in every DLG file that has a
-				 *        Line with that ID.  If you are trying to isolate
-				 *        one (or a few) Line(s), then you probably want to
-				 *        be certain which file is the source of the data.
-				 */
-				for (j = 0; j < num_L_attrib; j++)  {
-					if ((attributes_L[j].major == 10000) &&
-					     (attributes_L[j].minor == lines[i].id))  {
-						draw_lines(&datum, lines[i].point, color, image_corners);
-						goto FIN1;
-					}
-				}
-			}
-			else  {
-				if ((OMIT_NEATLINES == 0) || ((lines[i].left_area != 1) && (lines[i].right_area != 1)))  {
-					draw_lines(&datum, lines[i].point, color, image_corners);
-				}
-			}
-FIN1:
-			{;}
-		}
 
-		/*
-		 * Now we fill in each interesting area on the map with the
-		 * same color that bounds the area.  (For example,
-		 * lakes (attribute code 050 0421) might be filled in.)
-		 * However, sometimes areas might be filled in improperly.
-		 * The code assumes that the reference point for an area falls
-		 * within the polygon of lines that define that area.
-		 * According to the DLG guide, this isn't guaranteed
-		 * to always be the case, but the assumption has nonetheless
-		 * worked reasonably well in practice.
-		 *
-		 * Area attributes are processed a bit differently than the
-		 * attributes for lines:  no areas are filled in automatically.
-		 * If the user did not specify any Area attributes in the attribute
-		 * file, then no areas are filled in.  This is because the area-fill
-		 * algorithm can occasionally run amok, and therefore the appropriate
-		 * default is to not give it a chance.  For extensive details on the
-		 * area-fill algorithm, see the comments at the top of fill_area().
-		 */
-		if (num_A_attrib > 0)  {
-			for (i = 0; i < num_areas; i++)  {
-				if (areas[i].number_attrib <= 0)  {
-					continue;
-				}
-
-				current_attrib = &areas[i].attribute;
-				while (*current_attrib != (struct attribute *)0)  {
-					for (j = 0; j < num_A_attrib; j++)  {
-						if (((attributes_A[j].major < 0) ||
-						     (attributes_A[j].major == ((*current_attrib)->major))) &&
-						    ((attributes_A[j].minor < 0) ||
-						     (attributes_A[j].minor == ((*current_attrib)->minor))))  {
-							fill_area(&datum, areas[i].x, areas[i].y, color, image_corners);
-							goto FIN2;
-						}
-					}
-					current_attrib = &((*current_attrib)->attribute);
-				}
 
-				/*
-				 * As with the Line attributes, we provide an interface
-				 * for the user to select specific areas, via their IDs.
-				 */
-				for (j = 0; j < num_A_attrib; j++)  {
-					if ((attributes_A[j].major == 10000) &&
-					     (attributes_A[j].minor == areas[i].id))  {
-						fill_area(&datum, areas[i].x, areas[i].y, color, image_corners);
-						goto FIN2;
-					}
-				}
-FIN2:
-				{;}
-			}
-		}
+	/* Free up all of the malloc() memory */
+	dlg_arena_reset();
+	for (i = 0; i < num_attrib_files; i++)  {
+		free(attrib_files[i].attrib);
 	}
 
+	return 0;
+}
 
 
-	/* Free up all of the malloc() memory */
-	for (i = 0; i < num_lines; i++)  {
-		if (lines[i].number_coords > 0)  {
-			current_point = &lines[i].point;
 
-			while (*current_point != (struct point *)0)  {
-				tmp_point = (*current_point)->point;
-				free(*current_point);
-				*current_point = tmp_point;
-			}
-		}
-		if (lines[i].number_attrib > 0)  {
-			current_attrib = &lines[i].attribute;
 
-			while (*current_attrib != (struct attribute *)0)  {
-				tmp_attrib = (*current_attrib)->attribute;
-				free(*current_attrib);
-				*current_attrib = tmp_attrib;
-			}
-		}
-	}
-	for (i = 0; i < num_areas; i++)  {
-		if (areas[i].number_attrib > 0)  {
-			current_attrib = &areas[i].attribute;
+/*
+ * Process an SDTS DLG transfer.  (See read_dlg_sdts() for the details.)
+ *
+ * The same modules are read more than once while a transfer is processed
+ * (process_attrib_sdts() scans the line, area, and node modules for
+ * attributes, before read_dlg_sdts() reads their geometry), so the
+ * modules are opened through an sdts_transfer, which keeps each one
+ * in memory after the first time it is loaded.
+ */
+int32_t
+process_dlg_sdts(char *passed_file_name, char *output_file_name, int32_t gz_flag,
+		struct image_corners *image_corners, int32_t info_flag, int32_t file_image_flag)
+{
+	int32_t ret_val;
+	struct sdts_transfer *transfer;
 
-			while (*current_attrib != (struct attribute *)0)  {
-				tmp_attrib = (*current_attrib)->attribute;
-				free(*current_attrib);
-				*current_attrib = tmp_attrib;
-			}
-		}
-	}
-	for (i = 0; i < num_nodes; i++)  {
-		if (nodes[i].number_attrib > 0)  {
-			current_attrib = &nodes[i].attribute;
+	transfer = sdts_open_transfer();
+	sdts_use_transfer(transfer);
 
-			while (*current_attrib != (struct attribute *)0)  {
-				tmp_attrib = (*current_attrib)->attribute;
-				free(*current_attrib);
-				*current_attrib = tmp_attrib;
-			}
-		}
-	}
-	for (i = 0; i < num_attrib_files; i++)  {
-		free(attrib_files[i].attrib);
-	}
+	ret_val = read_dlg_sdts(transfer, passed_file_name, output_file_name, gz_flag,
+			image_corners, info_flag, file_image_flag);
 
-	return 0;
+	sdts_use_transfer((struct sdts_transfer *)0);
+	sdts_close_transfer(transfer);
+
+	return ret_val;
 }
 
 
@@ -3310,18 +3316,216 @@ struct	features  {
 
 
 
+/*
+ * get_extra_attrib() is called for every feature of every attribute
+ * record, and the same few labels, with mostly the same few values,
+ * turn up over and over again.  Rather than search the features[] table
+ * with strncmp(), and decode the value, every time, we keep two hash
+ * tables, which last for the life of the process:
+ *
+ *	extra_feature_table:  (category major, label) -> index in features[], or -1
+ *	extra_value_table:    (feature index, value) -> the result of decoding the value
+ *
+ * The feature table is filled from features[] by extra_attrib_init().
+ * drawmap and sdts2dlg call it before they fork any worker processes,
+ * so that the workers inherit the table rather than each building its own.
+ * (If nobody has called it, find_feature() calls it the first time.)
+ * Since a label only has to begin with a feature name to match it, a label
+ * that isn't in the table is looked up the old way, and then added.
+ * The value table gets each value the first time it is decoded, except for
+ * township and range numbers, and features that decode_extra_attrib() has
+ * no case for.  Decoding those prints a warning that should appear each time.
+ * So that a long run can't grow it without limit, the value table stops
+ * taking new entries once it holds EXTRA_VALUE_MAX.
+ *
+ * Both are open-addressed tables with linear probing, kept no more than
+ * half full, like the attribute sets in dlg.c.
+ */
+#define EXTRA_VALUE_MAX	65536
+#define EXTRA_UNSET	INT32_MIN	// Marks a result that decode_extra_attrib() didn't set.
+
+struct extra_entry  {
+	char *string;		// Copy of the label or value (not null-terminated), or null for an empty slot
+	int32_t length;
+	int32_t key;		// Category major, or feature index
+	int32_t ret_val;	// Feature index, or the value returned by decode_extra_attrib()
+	int32_t results[4];	// major, minor, major2, minor2, or EXTRA_UNSET
+};
+struct extra_table  {
+	struct extra_entry *entries;
+	int32_t size;		// Number of slots, a power of two (or zero)
+	int32_t count;		// Number of entries in use
+};
+static struct extra_table extra_feature_table = { (struct extra_entry *)0, 0, 0 };
+static struct extra_table extra_value_table = { (struct extra_entry *)0, 0, 0 };
+static int32_t extra_no_cache;	// Set by decode_extra_attrib() when its result shouldn't be cached
+
+
+
+/*
+ * Find the slot for the given key and string:  either the slot that
+ * holds them, or the empty slot where they would go.
+ * The table must not be empty.
+ */
+static struct extra_entry *
+extra_slot(struct extra_table *table, int32_t key, char *string, int32_t length)
+{
+	struct extra_entry *entry;
+	uint32_t h;
+	int32_t i;
+
+	/* A 32-bit FNV-1a hash of the key and the string. */
+	h = 0x811c9dc5;
+	for (i = 0; i < 4; i++)  {
+		h = (h ^ (((uint32_t)key >> (i << 3)) & 0xff)) * 0x01000193;
+	}
+	for (i = 0; i < length; i++)  {
+		h = (h ^ (unsigned char)string[i]) * 0x01000193;
+	}
+
+	h &= table->size - 1;
+	for (;;)  {
+		entry = &table->entries[h];
+		if (entry->string == (char *)0)  {
+			return entry;
+		}
+		if ((entry->key == key) && (entry->length == length) && (memcmp(entry->string, string, length) == 0))  {
+			return entry;
+		}
+		h = (h + 1) & (table->size - 1);
+	}
+}
+
+
+
+/*
+ * Add the given key and string to a table, if they aren't already there,
+ * and return their entry.
+ */
+static struct extra_entry *
+extra_add(struct extra_table *table, int32_t key, char *string, int32_t length)
+{
+	struct extra_entry *old_entries, *entry;
+	int32_t old_size, i;
+
+	if (((table->count + 1) << 1) > table->size)  {
+		old_entries = table->entries;
+		old_size = table->size;
+		table->size = table->size == 0 ? 256 : table->size << 1;
+		table->entries = (struct extra_entry *)calloc(table->size, sizeof(struct extra_entry));
+		if (table->entries == (struct extra_entry *)0)  {
+			fprintf(stderr, "calloc of attribute feature table failed\n");
+			exit(0);
+		}
+		for (i = 0; i < old_size; i++)  {
+			if (old_entries[i].string != (char *)0)  {
+				*extra_slot(table, old_entries[i].key, old_entries[i].string, old_entries[i].length) = old_entries[i];
+			}
+		}
+		free(old_entries);
+	}
+
+	entry = extra_slot(table, key, string, length);
+	if (entry->string == (char *)0)  {
+		if ((entry->string = (char *)malloc(length > 0 ? length : 1)) == (char *)0)  {
+			fprintf(stderr, "malloc of attribute feature table entry failed\n");
+			exit(0);
+		}
+		memcpy(entry->string, string, length);
+		entry->length = length;
+		entry->key = key;
+		table->count++;
+	}
+
+	return entry;
+}
+
+
+
+/*
+ * Search the features[] table for the first feature, in the given category,
+ * whose name the label begins with.  Return its index, or -1 if there isn't one.
+ */
+static int32_t
+scan_features(int32_t category_major, char *label)
+{
+	int32_t i;
+
+	for (i = 0; i < NUM_FEATURES; i++)  {
+		if (features[i].main_major == category_major)  {
+			if (strncmp(label, features[i].feature_name, features[i].feature_name_length) == 0)  {
+				return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*
+ * Fill the feature table from features[].  This only needs to be done once.
+ */
+void
+extra_attrib_init(void)
+{
+	struct extra_entry *entry;
+	int32_t i;
+
+	if (extra_feature_table.count > 0)  {
+		return;
+	}
+	for (i = 0; i < NUM_FEATURES; i++)  {
+		entry = extra_add(&extra_feature_table, features[i].main_major, features[i].feature_name, features[i].feature_name_length);
+		entry->ret_val = scan_features(features[i].main_major, features[i].feature_name);
+	}
+}
+
+
+
+/*
+ * Return the index in features[] of the feature that the label refers to,
+ * or -1 if there isn't one.  (This gives the same answer as scan_features().)
+ */
+static int32_t
+find_feature(int32_t category_major, char *label)
+{
+	struct extra_entry *entry;
+
+	extra_attrib_init();
+
+	entry = extra_slot(&extra_feature_table, category_major, label, strlen(label));
+	if (entry->string == (char *)0)  {
+		entry = extra_add(&extra_feature_table, category_major, label, strlen(label));
+		entry->ret_val = scan_features(category_major, label);
+	}
+
+	return entry->ret_val;
+}
+
+
+
+static int32_t decode_extra_attrib(int32_t, int32_t, int32_t *, int32_t *, int32_t *, int32_t *, struct subfield *);
+
+
+
 /*
  * A primary attribute may have additional attribute characteristics
  * associated with it.
  * Process this addtional attribute information.
+ *
+ * Returns 0 if the attribute yields a major/minor pair (and possibly a second
+ * pair, in *major2 and *minor2), 1 if it doesn't, or -1 if the value is empty.
  */
 int32_t
 get_extra_attrib(int32_t category_major, int32_t *major, int32_t *minor, int32_t *major2, int32_t *minor2, struct subfield *subfield)
 {
-	int32_t i;
-	double f;
-	char save_byte;
-	char *end_ptr;
+	int32_t i, j;
+	int32_t ret_val;
+	int32_t results[4];
+	int32_t *dest[4];
+	struct extra_entry *entry;
 
 
 	/*
@@ -3338,18 +3542,71 @@ get_extra_attrib(int32_t category_major, int32_t *major, int32_t *minor, int32_t
 		return 1;
 	}
 
-	for (i = 0; i < NUM_FEATURES; i++)  {
-		if (features[i].main_major == category_major)  {
-			if (strncmp(subfield->label, features[i].feature_name, features[i].feature_name_length) == 0)  {
-				break;
+	i = find_feature(category_major, subfield->label);
+	if (i < 0)  {
+		fprintf(stderr, "Couldn't find attribute feature name (%s) for major %d.  Attribute feature ignored.\n", subfield->label, category_major);
+		return 1;
+	}
+
+	dest[0] = major;
+	dest[1] = minor;
+	dest[2] = major2;
+	dest[3] = minor2;
+
+	/*
+	 * If we have decoded this value before, just hand back the results.
+	 * decode_extra_attrib() doesn't always set all of them, so we only
+	 * pass along the ones that it set.
+	 */
+	if (extra_value_table.count > 0)  {
+		entry = extra_slot(&extra_value_table, i, subfield->value, subfield->length);
+		if (entry->string != (char *)0)  {
+			for (j = 0; j < 4; j++)  {
+				if (entry->results[j] != EXTRA_UNSET)  {
+					*dest[j] = entry->results[j];
+				}
 			}
+			return entry->ret_val;
 		}
 	}
-	if (i == NUM_FEATURES)  {
-		fprintf(stderr, "Couldn't find attribute feature name (%s) for major %d.  Attribute feature ignored.\n", subfield->label, category_major);
-		return 1;
+
+	for (j = 0; j < 4; j++)  {
+		results[j] = EXTRA_UNSET;
+	}
+	extra_no_cache = 0;
+	ret_val = decode_extra_attrib(category_major, i, &results[0], &results[1], &results[2], &results[3], subfield);
+	for (j = 0; j < 4; j++)  {
+		if (results[j] != EXTRA_UNSET)  {
+			*dest[j] = results[j];
+		}
 	}
 
+	if ((features[i].key != 108) && (features[i].key != 109) && (extra_no_cache == 0) && (extra_value_table.count < EXTRA_VALUE_MAX))  {
+		entry = extra_add(&extra_value_table, i, subfield->value, subfield->length);
+		entry->ret_val = ret_val;
+		for (j = 0; j < 4; j++)  {
+			entry->results[j] = results[j];
+		}
+	}
+
+	return ret_val;
+}
+
+
+
+
+/*
+ * Decode the value of additional attribute information, for the
+ * given feature (an index in features[]).  This is the slow part of
+ * get_extra_attrib(), which remembers the results.
+ */
+static int32_t
+decode_extra_attrib(int32_t category_major, int32_t i, int32_t *major, int32_t *minor, int32_t *major2, int32_t *minor2, struct subfield *subfield)
+{
+	double f;
+	char save_byte;
+	char *end_ptr;
+
 
 
 	switch (category_major)  {
@@ -4319,6 +4576,7 @@ get_extra_attrib(int32_t category_major, int32_t *major, int32_t *minor, int32_t
 
 	default:
 		fprintf(stderr, "Couldn't find attribute feature name (%s).  Attribute feature ignored.  Internal codes: %d,%d\n", subfield->label, i, features[i].key);
+		extra_no_cache = 1;
 		return 1;
 		break;
 	}
@@ -5323,48 +5581,35 @@ process_attrib_sdts(char *passed_file_name, char *category_name, int32_t *data_t
  * One of these should be removed.
  */
 void
-uniq_attrib(struct attribute **initial_attrib, short *attrib)
+uniq_attrib(int32_t first, int32_t *attrib)
 {
-	short i;
-	struct attribute **current_base;
-	struct attribute **current_attrib;
-	struct attribute **search_attrib;
-	struct attribute **next_attrib;
-	struct attribute **prev_attrib;
-
-	current_base = initial_attrib;
+	int32_t i, j;
+	int32_t old_attrib = *attrib;
+	struct attribute *a = &dlg_arena.attrib[first];
+
 	for (i = 0; i < *attrib; i++)  {
-		search_attrib = current_base;
-		while (*(search_attrib = &((*search_attrib)->attribute)) != (struct attribute *)0)  {
-			if (((*search_attrib)->major != 177) &&		// 177 is a special case for spelling out alphabetic items
-			    ((*search_attrib)->major == (*current_base)->major) &&
-			    ((*search_attrib)->minor == (*current_base)->minor))  {
+		for (j = i + 1; j < *attrib; j++)  {
+			if ((a[j].major != 177) &&		// 177 is a special case for spelling out alphabetic items
+			    (a[j].major == a[i].major) &&
+			    (a[j].minor == a[i].minor))  {
 				/*
-				 * We have found a duplicate.  Remove the earlier entry.
-				 *
-				 * It is easier to alter the list by unlinking the
-				 * last entry than by removing an entry from the middle
-				 * of the list.  Thus, we shift the data backwards
-				 * to fill in the unwanted entry, rather than removing the
-				 * actual list element of the unwanted entry.
-				 * Then we simply unlink and free the final entry.
+				 * We have found a duplicate.  Remove the earlier entry
+				 * by shifting the rest of the list back over it,
+				 * and then start the search over again.
 				 */
-				prev_attrib = (struct attribute **)0;	// Induce a core dump if there is a bug in the code.
-				current_attrib = current_base;
-				next_attrib = current_base;
-				while (*(next_attrib = &((*next_attrib)->attribute)) != (struct attribute *)0)  {
-					(*current_attrib)->major = (*next_attrib)->major;
-					(*current_attrib)->minor = (*next_attrib)->minor;
-					prev_attrib = current_attrib;
-					current_attrib = next_attrib;
-				}
-				(*prev_attrib)->attribute = (struct attribute *)0;
-				free(*current_attrib);
+				memmove(&a[i], &a[i + 1], (*attrib - i - 1) * sizeof(struct attribute));
 				(*attrib)--;
-				search_attrib = current_base;
+				j = i;
 			}
 		}
-		current_base = &((*current_base)->attribute);
+	}
+
+	/*
+	 * The list is normally the last thing in the arena, so give back
+	 * the slots that we freed up.
+	 */
+	if (first + old_attrib == dlg_arena.num_attrib)  {
+		dlg_arena.num_attrib = first + *attrib;
 	}
 }
 
@@ -5470,11 +5715,13 @@ void get_theme(char *passed_file_name, char *category_name, int32_t upper_case_f
 							}
 						}
 
+						end_ddf();
 						return;
 					}
 				}
 			}
 		}
+		end_ddf();
 	}
 
 	return;
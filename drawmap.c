@@ -34,12 +34,14 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <math.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <signal.h>
 #include <time.h>
 #include <string.h>
 #include "drawmap.h"
@@ -47,6 +49,7 @@
 #include "colors.h"
 #include "dem.h"
 #include "dlg.h"
+#include "sdts_utils.h"
 #include "font_5x8.h"
 #include "font_6x10.h"
 
@@ -65,8 +68,11 @@ struct dem_record_type_c dem_c;
 int32_t x_prime;
 
 int32_t bottom_border = BOTTOM_BORDER;
+extern int32_t tm_engine;	// Defined and initialized in utilities.c, which selects the transverse Mercator engine
 extern int32_t right_border;	// Defined and initialized in dlg.c because needed in programs that don't include drawmap.o
 
+char *dlg_cache_dir = (char *)0;	// Directory of pre-projected DLG files (see dlg_cache.c), or null
+
 // int32_t histogram[256];	/* For debugging. */
 // int32_t angle_hist[100000];	/* For debugging. */
 // int32_t total;	/* For debugging. */
@@ -74,10 +80,72 @@ extern int32_t right_border;	// Defined and initialized in dlg.c because needed
 
 #define CONTOUR_INTVL	(100.0)
 
+
+
+/*
+ * This is the header of an elevation checkpoint file (the -k option).
+ * A checkpoint file holds a copy of the image_in array, as it stands after
+ * all of the DEM files have been read in, and after gap filling and image smoothing
+ * have been done, so that later runs over the same area (with, say, a different
+ * relief factor, color table, or set of DLG overlays) can skip the expensive
+ * work of reading and resampling the DEM files.
+ *
+ * The first group of fields is the key.  It records the map boundaries and
+ * image size, as the user specified them, and a hash of the DEM file names,
+ * sizes, and modification times.  If any of these change, the checkpoint is
+ * stale and is ignored (and overwritten).  The second group of fields holds the
+ * results of the DEM processing that the rest of the program needs.
+ *
+ * The file is written in native byte order.  It is a cache, not an interchange
+ * format, so a checkpoint from a machine with a different byte order is simply
+ * treated as stale.
+ */
+#define CHECKPOINT_MAGIC	"DMAPELEV"
+#define CHECKPOINT_VERSION	1
+
+struct elev_checkpoint  {
+	char magic[8];
+	int32_t version;
+	int32_t num_dem;
+	uint64_t input_hash;
+	double req_sw_lat;
+	double req_sw_long;
+	double req_ne_lat;
+	double req_ne_long;
+	int32_t req_x;
+	int32_t req_y;
+
+	double sw_x_gp;
+	double sw_y_gp;
+	double ne_x_gp;
+	double ne_y_gp;
+	double sw_lat;
+	double sw_long;
+	double ne_lat;
+	double ne_long;
+	int32_t sw_zone;
+	int32_t ne_zone;
+	int32_t x;
+	int32_t y;
+	int32_t dem_flag;
+	int32_t min_elevation;
+	int32_t max_elevation;
+	int32_t min_e_lat;
+	int32_t min_e_long;
+	int32_t max_e_lat;
+	int32_t max_e_long;
+	char dem_name[135];
+};
+
 int32_t get_factor(double);
 void add_text(struct image_corners *, char *, int32_t, int32_t, int32_t, char *, int32_t, int32_t, int32_t, int32_t);
 void get_short_array(short **, int32_t, int32_t);
 void gen_texture(int32_t, int32_t, struct color_tab *, char *);
+void elev_checkpoint_key(struct elev_checkpoint *, struct image_corners *, char **, int32_t);
+int32_t read_elev_checkpoint(char *, struct elev_checkpoint *, short **);
+void process_dlg_file(char *, struct image_corners *, int32_t);
+void process_dlg_parallel(char **, int32_t, int32_t, struct image_corners *);
+void write_elev_checkpoint(char *, struct elev_checkpoint *, short *);
 
 
 void
@@ -86,10 +154,12 @@ usage(char *program_name)
 	fprintf(stderr, "\nDrawmap, %s.\n\n", VERSION);
 	fprintf(stderr, "Usage:  %s [-L]\n", program_name);
 	fprintf(stderr, "          [-o output_file.sun] [-l latitude1,longitude1,latitude2,longitude2]\n");
-	fprintf(stderr, "          [-d dem_file1 [-d dem_file2 [...]]] [-a attribute_file] [-z] [-w]\n");
-	fprintf(stderr, "          [-c contour_interval] [-C contour_interval] [-g gnis_file] [-t]\n");
+	fprintf(stderr, "          [-d dem_file1 [-d dem_file2 [...]]] [-k checkpoint_file]\n");
+	fprintf(stderr, "          [-a attribute_file] [-z] [-w]\n");
+	fprintf(stderr, "          [-c contour_interval] [-C contour_interval] [-g gnis_file] [-t] [-K]\n");
 	fprintf(stderr, "          [-x x_size] [-y y_size] [-r relief_factor] [-m relief_mag] [-i] [-h]\n");
-	fprintf(stderr, "          [-n color_table_number] [dlg_file1 [dlg_file2 [...]]]\n");
+	fprintf(stderr, "          [-n color_table_number] [-j jobs] [-P dlg_cache_directory]\n");
+	fprintf(stderr, "          [dlg_file1 [dlg_file2 [...]]]\n");
 	fprintf(stderr, "\nNote that the DLG files are processed in order, and each one overlays the\n");
 	fprintf(stderr, "last.  If you want (for example) roads on top of streams, put the\n");
 	fprintf(stderr, "transportation data after the hydrography data.  Note also that\n");
@@ -144,7 +214,6 @@ main(int argc, char *argv[])
 	unsigned char  map[3][256];
 	int dem_fdesc;
 	int gnis_fdesc;
-	int dlg_fdesc;
 	int output_fdesc;
 	ssize_t ret_val;
 	int32_t length = 100000000;	// bogus initializer to expose errors.
@@ -172,10 +241,15 @@ main(int argc, char *argv[])
 	double latitude1, longitude1, latitude2, longitude2;
 	int32_t tmp_width, tmp_height, tmp_x, tmp_y;
 	char *dem_files[NUM_DEM];
+	char dem_member[MAX_FILE_NAME + 1];
 	int32_t num_dem, num_dlg;
+	int32_t num_jobs;
 	char *gnis_file;
 	char *attribute_file;
 	char *output_file;
+	char *checkpoint_file;
+	int32_t checkpoint_loaded;
+	struct elev_checkpoint checkpoint;
 	int32_t option;
 	int32_t x_low, x_high, y_low, y_high;
 	double res_y, res_xy;
@@ -219,7 +293,9 @@ main(int argc, char *argv[])
 	int32_t gtopo30_flag;	// When nonzero, we are processing a GTOPO30 file
 	int32_t byte_order;
 	double utm_x, utm_y;
-	int32_t utm_zone;
+	double *row_lat = (double *)0, *row_long = (double *)0;	// One row of image points, for redfearn_array()
+	double *row_utm_x = (double *)0, *row_utm_y = (double *)0;
+	int32_t row_size = 0;
 
 	if (argc == 1)  {
 		usage(argv[0]);
@@ -237,6 +313,7 @@ main(int argc, char *argv[])
 	gnis_file = (char *)0;
 	attribute_file = (char *)0;
 	output_file = (char *)0;
+	checkpoint_file = (char *)0;
 	num_dem = 0;
 	dem_flag = 0;		/* When set to 1, this flag says that at least some DEM data was read in. */
 	contour_flag = 0;	/* When set to 1, this flag says that we should produce contours instead of shaded relief. */
@@ -248,11 +325,15 @@ main(int argc, char *argv[])
 	tick_flag = 1;		/* When set to 1, tick marks and numeric latitudes/longitudes are added around the map. */
 	height_field_flag = 0;	/* When set to 1, drawmap generates a height-field file instead of an image. */
 	color_table_number = 2;	/* Select default color scheme. */
+	num_jobs = sysconf(_SC_NPROCESSORS_ONLN);	/* Number of DLG files to parse at once. */
+	if (num_jobs < 1)  {
+		num_jobs = 1;
+	}
 	opterr = 0;		/* Shut off automatic unrecognized-argument messages. */
 	relief_factor = -1.0;	/* Valid values are real numbers between 0 and 1, inclusive.  Initialize to invalid value. */
 	relief_mag = 1.0;	/* Valid values are real numbers between 0 and 1, inclusive.  Initialize to default value. */
 
-	while ((option = getopt(argc, argv, "o:d:c:C:g:a:x:y:r:m:l:n:Lwihzt")) != -1)  {
+	while ((option = getopt(argc, argv, "o:d:k:c:C:g:a:x:y:r:m:l:n:j:P:LwihztK")) != -1)  {
 		switch(option)  {
 		case 'o':
 			if (output_file != (char *)0)  {
@@ -279,6 +360,19 @@ main(int argc, char *argv[])
 			}
 			dem_files[num_dem++] = optarg;
 			break;
+		case 'k':
+			if (checkpoint_file != (char *)0)  {
+				fprintf(stderr, "More than one checkpoint file specified with -k\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			if (optarg == (char *)0)  {
+				fprintf(stderr, "No checkpoint file specified with -k\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			checkpoint_file = optarg;
+			break;
 		case 'C':
 			capital_c_flag = 1;
 		case 'c':
@@ -476,6 +570,30 @@ main(int argc, char *argv[])
 		case 't':
 			tick_flag = 0;
 			break;
+		case 'K':
+			tm_engine = TM_KRUGER;
+			break;
+		case 'j':
+			if (optarg == (char *)0)  {
+				fprintf(stderr, "No number of jobs specified with -j\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			num_jobs = atoi(optarg);
+			if (num_jobs < 1)  {
+				fprintf(stderr, "The number of jobs specified with -j must be at least 1\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			break;
+		case 'P':
+			if (optarg == (char *)0)  {
+				fprintf(stderr, "No cache directory specified with -P\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			dlg_cache_dir = optarg;
+			break;
 		default:
 			usage(argv[0]);
 			exit(0);
@@ -748,10 +866,72 @@ main(int argc, char *argv[])
 	dem_name[0] = '\0';
 	file_index = 0;
 	smooth_image_flag = 0;
-	if ((info_flag == 0) && (image_corners.x > 0) && (image_corners.y > 0))  {
+	checkpoint_loaded = 0;
+	if ((info_flag == 0) && (checkpoint_file != (char *)0) && (num_dem > 0))  {
+		/*
+		 * If the user gave us a checkpoint file, and it was produced from the
+		 * same DEM files, for the same map boundaries and image size,
+		 * then load the elevation data from it, and skip the DEM loop entirely.
+		 * The image dimensions and boundaries stored in the file are the ones
+		 * that the DEM loop settled on, so we restore them, too.
+		 */
+		elev_checkpoint_key(&checkpoint, &image_corners, dem_files, num_dem);
+		if (read_elev_checkpoint(checkpoint_file, &checkpoint, &image_in) != 0)  {
+			if ((image_corners.x < 0) && (checkpoint.x & 1))  {
+				right_border++;
+			}
+			if ((image_corners.y < 0) && (checkpoint.y & 1))  {
+				bottom_border++;
+			}
+			image_corners.sw_x_gp = checkpoint.sw_x_gp;
+			image_corners.sw_y_gp = checkpoint.sw_y_gp;
+			image_corners.sw_zone = checkpoint.sw_zone;
+			image_corners.ne_x_gp = checkpoint.ne_x_gp;
+			image_corners.ne_y_gp = checkpoint.ne_y_gp;
+			image_corners.ne_zone = checkpoint.ne_zone;
+			image_corners.sw_lat = checkpoint.sw_lat;
+			image_corners.sw_long = checkpoint.sw_long;
+			image_corners.ne_lat = checkpoint.ne_lat;
+			image_corners.ne_long = checkpoint.ne_long;
+			image_corners.x = checkpoint.x;
+			image_corners.y = checkpoint.y;
+			lat_flag = 1;
+			res_x_image = (double)image_corners.x / (image_corners.ne_long - image_corners.sw_long);
+			res_y_image = (double)image_corners.y / (image_corners.ne_lat - image_corners.sw_lat);
+
+			dem_flag = checkpoint.dem_flag;
+			min_elevation = checkpoint.min_elevation;
+			max_elevation = checkpoint.max_elevation;
+			min_e_lat = checkpoint.min_e_lat;
+			min_e_long = checkpoint.min_e_long;
+			max_e_lat = checkpoint.max_e_lat;
+			max_e_long = checkpoint.max_e_long;
+			strcpy(dem_name, checkpoint.dem_name);
+
+			fprintf(stderr, "Elevation data loaded from checkpoint file:  %s\n", checkpoint_file);
+			checkpoint_loaded = 1;
+			file_index = num_dem;
+		}
+	}
+	if ((info_flag == 0) && (checkpoint_loaded == 0) && (image_corners.x > 0) && (image_corners.y > 0))  {
 		get_short_array(&image_in, image_corners.x, image_corners.y);
 	}
 	while (file_index < num_dem)  {
+		/*
+		 * If the user gave us a tar archive, rather than a file,
+		 * find the SDTS elevation module in it, and use that instead.
+		 * (The checkpoint key has already been computed from the
+		 * original names, so it is safe to replace them.)
+		 */
+		if ((ret_val = sdts_archive_find(dem_files[file_index], "CEL", dem_member)) < 0)  {
+			fprintf(stderr, "Can't find an SDTS elevation module (????CEL@.DDF) in %s.  Ignoring file.\n", dem_files[file_index]);
+			file_index++;
+			continue;
+		}
+		else if (ret_val > 0)  {
+			dem_files[file_index] = dem_member;
+		}
+
 		length = strlen(dem_files[file_index]);
 
 		/*
@@ -768,7 +948,11 @@ main(int argc, char *argv[])
 		}
 		else  {
 			gz_flag = 0;
-			if ((dem_fdesc = buf_open(dem_files[file_index], O_RDONLY)) < 0)  {
+			if (sdts_archive_member(dem_files[file_index]) != 0)  {
+				/* The file is inside a tar archive.  begin_ddf() will find it there. */
+				dem_fdesc = -1;
+			}
+			else if ((dem_fdesc = buf_open(dem_files[file_index], O_RDONLY)) < 0)  {
 				fprintf(stderr, "Can't open %s for reading, errno = %d\n", dem_files[file_index], errno);
 				exit(0);
 			}
@@ -818,7 +1002,9 @@ main(int argc, char *argv[])
 
 			/* Close the file.  We will reopen it in parse_dem_sdts(). */
 			if (gz_flag == 0)  {
-				buf_close(dem_fdesc);
+				if (dem_fdesc >= 0)  {
+					buf_close(dem_fdesc);
+				}
 			}
 			else  {
 				buf_close_z(dem_fdesc);
@@ -1338,13 +1524,39 @@ main(int argc, char *argv[])
 		 * perhaps as a command line option.  Another potential feature is to provide an option to
 		 * plot maps on a UTM grid instead of a latitude/longitude grid.  This would work better
 		 * for 7.5-minute UTM data.
+		 *
+		 * For UTM data, all of the points in a row of the image share a latitude, so
+		 * we convert the whole row at once with redfearn_array(), which is much faster
+		 * than calling redfearn() for each point.  All of the points are projected
+		 * into the zone of the DEM data, since that is the zone of the UTM coordinates
+		 * we are trying to match.
 		 */
+		if ((dem_a.plane_ref == 1) && ((x_high - x_low) > row_size))  {
+			row_size = x_high - x_low;
+			row_lat = (double *)realloc(row_lat, row_size * sizeof(double));
+			row_long = (double *)realloc(row_long, row_size * sizeof(double));
+			row_utm_x = (double *)realloc(row_utm_x, row_size * sizeof(double));
+			row_utm_y = (double *)realloc(row_utm_y, row_size * sizeof(double));
+			if ((row_lat == (double *)0) || (row_long == (double *)0) ||
+			    (row_utm_x == (double *)0) || (row_utm_y == (double *)0))  {
+				fprintf(stderr, "realloc of UTM row buffers failed\n");
+				exit(0);
+			}
+		}
 		if ((tmp_width != 0) && (tmp_height != 0))  {
 			for (i = y_low; i < y_high; i++)  {
 				if (dem_a.plane_ref != 1)  {
 					/* Geographic Planimetric coordinates. */
 					k = tmp_y + drawmap_round((double)(tmp_height * (i - y_low)) / (double)(y_high - 1 - y_low));
 				}
+				else  {
+					/* UTM Planimetric coordinates.  Convert the whole row. */
+					for (j = x_low; j < x_high; j++)  {
+						row_lat[j - x_low] = latitude2  - (double)(i - y_low) * (latitude2  - latitude1)  / (double)(y_high - y_low - 1);
+						row_long[j - x_low] = longitude1 + (double)(j - x_low) * (longitude2 - longitude1) / (double)(x_high - x_low - 1);
+					}
+					(void)redfearn_array(&dem_datum, row_utm_x, row_utm_y, dem_a.zone, row_lat, row_long, x_high - x_low);
+				}
 
 				for (j = x_low; j < x_high; j++)  {
 					if (dem_a.plane_ref != 1)  {
@@ -1368,11 +1580,8 @@ main(int argc, char *argv[])
 						 * Afterward, use these values to interpolate index values for
 						 * the DEM data array.
 						 */
-						(void)redfearn(&dem_datum, &utm_x, &utm_y, &utm_zone,
-							latitude2  - (double)(i - y_low) * (latitude2  - latitude1)  / (double)(y_high - y_low - 1),
-							longitude1 + (double)(j - x_low) * (longitude2 - longitude1) / (double)(x_high - x_low - 1), 0);
-						utm_x = rint(utm_x / dem_a.x_res) * dem_a.x_res;
-						utm_y = rint(utm_y / dem_a.y_res) * dem_a.y_res;
+						utm_x = rint(row_utm_x[j - x_low] / dem_a.x_res) * dem_a.x_res;
+						utm_y = rint(row_utm_y[j - x_low] / dem_a.y_res) * dem_a.y_res;
 
 						k = dem_corners.y - 1 - drawmap_round((((double)dem_corners.y - 1.0) * (utm_y - dem_corners.y_gp_min)) / (dem_corners.y_gp_max - dem_corners.y_gp_min));
 						l = drawmap_round((((double)dem_corners.x - 1.0) * (utm_x - dem_corners.x_gp_min)) / (dem_corners.x_gp_max - dem_corners.x_gp_min));
@@ -1591,8 +1800,11 @@ main(int argc, char *argv[])
 	 * s2 holds the pre-change version of the point we are currently looking at.
 	 * s1 holds the pre-change version of the previous point.
 	 * s0 holds the pre-change version of the point before s1.
+	 *
+	 * If the data came from a checkpoint file, then this, and the image
+	 * smoothing below, have already been done.
 	 */
-	if (info_flag == 0)  {
+	if ((info_flag == 0) && (checkpoint_loaded == 0))  {
 		tmp_row = (short *)malloc(sizeof(short) * (image_corners.x + 1));
 		if (tmp_row == (short *)0)  {
 			fprintf(stderr, "malloc of tmp_row failed\n");
@@ -1682,7 +1894,7 @@ main(int argc, char *argv[])
 	 * makes the image look better, but it does so essentially by removing some false data,
 	 * and adding new more-pleasant-looking false data to replace it.
 	 */
-	if (info_flag == 0)  {
+	if ((info_flag == 0) && (checkpoint_loaded == 0))  {
 		if ((dem_flag != 0) && (smooth_image_flag != 0))  {
 			/*
 			 * Prepare a smoothing kernel.
@@ -1767,6 +1979,39 @@ main(int argc, char *argv[])
 
 
 
+	/*
+	 * The elevation data are now in their final form.  If the user asked
+	 * for a checkpoint file, and we didn't just read the data from one,
+	 * then save the data for use by later runs.
+	 */
+	if ((info_flag == 0) && (checkpoint_file != (char *)0) && (num_dem > 0) && (checkpoint_loaded == 0) && (image_in != (short *)0))  {
+		checkpoint.sw_x_gp = image_corners.sw_x_gp;
+		checkpoint.sw_y_gp = image_corners.sw_y_gp;
+		checkpoint.sw_zone = image_corners.sw_zone;
+		checkpoint.ne_x_gp = image_corners.ne_x_gp;
+		checkpoint.ne_y_gp = image_corners.ne_y_gp;
+		checkpoint.ne_zone = image_corners.ne_zone;
+		checkpoint.sw_lat = image_corners.sw_lat;
+		checkpoint.sw_long = image_corners.sw_long;
+		checkpoint.ne_lat = image_corners.ne_lat;
+		checkpoint.ne_long = image_corners.ne_long;
+		checkpoint.x = image_corners.x;
+		checkpoint.y = image_corners.y;
+		checkpoint.dem_flag = dem_flag;
+		checkpoint.min_elevation = min_elevation;
+		checkpoint.max_elevation = max_elevation;
+		checkpoint.min_e_lat = min_e_lat;
+		checkpoint.min_e_long = min_e_long;
+		checkpoint.max_e_lat = max_e_lat;
+		checkpoint.max_e_long = max_e_long;
+		strncpy(checkpoint.dem_name, dem_name, sizeof(checkpoint.dem_name) - 1);
+		checkpoint.dem_name[sizeof(checkpoint.dem_name) - 1] = '\0';
+
+		write_elev_checkpoint(checkpoint_file, &checkpoint, image_in);
+	}
+
+
+
 	/*
 	 * If height_field_flag is non-zero, then we don't generate an image.
 	 * Instead we create a file full of height field information for use
@@ -2241,117 +2486,20 @@ main(int argc, char *argv[])
 	 * Process any DLG files.
 	 * These files contain line and area information, for drawing
 	 * things like streams, roads, boundaries, lakes, and such.
+	 *
+	 * Parsing and projecting the files takes far longer than drawing them,
+	 * and only the drawing has to be done in command-line order.
+	 * Thus, when there is more than one file, we parse them in parallel
+	 * with process_dlg_parallel(), which draws the results in order.
 	 */
-	file_index = 0;
-	while (file_index < num_dlg)  {
-		length = strlen(argv[optind + file_index]);
-
-		if ((length > 3) && ((strcmp(&argv[optind + file_index][length - 3], ".gz") == 0) ||
-		    (strcmp(&argv[optind + file_index][length - 3], ".GZ") == 0)))  {
-			gz_flag = 1;
+	if ((info_flag != 0) || (num_dlg < 2) || (num_jobs < 2))  {
+		for (file_index = 0; file_index < num_dlg; file_index++)  {
+			process_dlg_file(argv[optind + file_index], &image_corners, info_flag);
 		}
-		else  {
-			gz_flag = 0;
-		}
-
-		/*
-		 * Files in Spatial Data Transfer System (SDTS) format are markedly
-		 * different from the optional-format DLG files.
-		 *
-		 * Since SDTS files are so different, we must detect them handle
-		 * them separately.
-		 *
-		 * We insist that the user specify one, single, SDTS file on the command
-		 * line for each SDTS DLG directory.  The file must be the one whose
-		 * name has the form ????LE??.DDF (or ????le??.ddf), and it may have
-		 * a .gz on the end if it is gzip compressed.
-		 *
-		 * We allow the files to be gzip-compressed, and they can have either
-		 * ".gz" or ".GZ" on the end.  However, we insist that the rest of
-		 * the file name have consistent case.  That is, if the 'f' or 'F'
-		 * in the ".DDF" or ".ddf" is in a given case, the rest of the file
-		 * had better be in that same case.
-		 *
-		 * If the following "if" test succeeds, we assume we have an SDTS file.
-		 */
-		if (((length >= 15) && (gz_flag != 0) &&
-		     ((strncmp(&argv[optind + file_index][length - 7], ".ddf", 4) == 0) ||
-		      (strncmp(&argv[optind + file_index][length - 7], ".DDF", 4) == 0))) ||
-		    ((length >= 12) && (gz_flag == 0) &&
-		     ((strcmp(&argv[optind + file_index][length - 4], ".ddf") == 0) ||
-		      (strcmp(&argv[optind + file_index][length - 4], ".DDF") == 0))))  {
-			/* SDTS file */
-
-			/*
-			 * Check that the file name takes the form that we expect.
-			 */
-			if (((gz_flag != 0) &&
-			     (strncmp(&argv[optind + file_index][length - 11], "le", 2) != 0) &&
-			     (strncmp(&argv[optind + file_index][length - 11], "LE", 2) != 0)) ||
-			    ((gz_flag == 0) &&
-			     (strncmp(&argv[optind + file_index][length - 8], "le", 2) != 0) &&
-			     (strncmp(&argv[optind + file_index][length - 8], "LE", 2) != 0)))  {
-				fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.  Ignoring file.\n", argv[optind + file_index]);
-				file_index++;
-				continue;
-			}
-
-			/* If info_flag is nonzero, then just print some info about the DLG file. */
-			if (info_flag == 0)  {
-				fprintf(stderr, "Processing DLG file:  %s\n", argv[optind + file_index]);
-			}
-			else  {
-				fprintf(stdout, "%s", argv[optind + file_index]);
-			}
-
-			/*
-			 * The file name looks okay.  Let's launch into the information parsing.
-			 */
-			(void)process_dlg_sdts(argv[optind + file_index], (char *)0, gz_flag, &image_corners, info_flag, 0);
-		}
-		else  {
-			/* Not an SDTS file. */
-
-			if (gz_flag != 0)  {
-				if ((dlg_fdesc = buf_open_z(argv[optind + file_index], O_RDONLY)) < 0)  {
-					fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[optind + file_index], errno);
-					exit(0);
-				}
-			}
-			else  {
-				if ((dlg_fdesc = buf_open(argv[optind + file_index], O_RDONLY)) < 0)  {
-					fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[optind + file_index], errno);
-					exit(0);
-				}
-			}
-
-			/* If info_flag is nonzero, then just print some info about the DLG file. */
-			if (info_flag == 0)  {
-				fprintf(stderr, "Processing DLG file:  %s\n", argv[optind + file_index]);
-			}
-			else  {
-				fprintf(stdout, "%s", argv[optind + file_index]);
-			}
-
-			/*
-			 * With the DEM files, we parsed the header first, and then
-			 * called a separate processing function, and then did some
-			 * more processing here in the main body of drawmap.  DLG files are
-			 * more complicated to parse, and we don't need to return any DLG
-			 * data to this main processing loop.  Thus, we just encapsulate
-			 * all parsing and processing into a single function call.
-			 */
-			process_dlg_optional(dlg_fdesc, gz_flag, &image_corners, info_flag);
-
-			if (gz_flag == 0)  {
-				buf_close(dlg_fdesc);
-			}
-			else  {
-				buf_close_z(dlg_fdesc);
-			}
-		}
-
-		file_index++;
+	}
+	else  {
+		extra_attrib_init();	// Once, here, rather than once in each child.
+		process_dlg_parallel(&argv[optind], num_dlg, num_jobs, &image_corners);
 	}
 	if (info_flag != 0)  {
 		exit(0);
@@ -3289,3 +3437,433 @@ gen_texture(int32_t min_elevation, int32_t max_elevation, struct color_tab *colo
 
 	fclose(texture_stream);
 }
+
+
+
+
+
+
+/*
+ * Fill in the key fields of an elevation checkpoint header.
+ *
+ * The map boundaries and image size are taken as the user specified them,
+ * before the DEM loop has had a chance to fill them in from the data.
+ * The DEM files are identified by name, size, and modification time,
+ * all folded into a 64-bit FNV-1a hash.  We don't hash the file contents,
+ * because reading all of the files would cost about as much as simply
+ * processing them.
+ */
+void
+elev_checkpoint_key(struct elev_checkpoint *checkpoint, struct image_corners *image_corners, char **dem_files, int32_t num_dem)
+{
+	int32_t i, j;
+	uint64_t hash;
+	int64_t n;
+	unsigned char *ptr;
+	struct stat stat_buf;
+
+	memset(checkpoint, 0, sizeof(struct elev_checkpoint));
+	memcpy(checkpoint->magic, CHECKPOINT_MAGIC, sizeof(checkpoint->magic));
+	checkpoint->version = CHECKPOINT_VERSION;
+	checkpoint->num_dem = num_dem;
+	checkpoint->req_sw_lat = image_corners->sw_lat;
+	checkpoint->req_sw_long = image_corners->sw_long;
+	checkpoint->req_ne_lat = image_corners->ne_lat;
+	checkpoint->req_ne_long = image_corners->ne_long;
+	checkpoint->req_x = image_corners->x;
+	checkpoint->req_y = image_corners->y;
+
+	hash = 0xcbf29ce484222325ULL;
+	for (i = 0; i < num_dem; i++)  {
+		for (ptr = (unsigned char *)dem_files[i]; *ptr != '\0'; ptr++)  {
+			hash = (hash ^ *ptr) * 0x100000001b3ULL;
+		}
+		hash = (hash ^ 0) * 0x100000001b3ULL;
+
+		/*
+		 * If the file can't be stat'ed, leave it out of the hash.
+		 * The DEM loop will complain about it, if it turns out to be unreadable.
+		 */
+		if (stat(dem_files[i], &stat_buf) == 0)  {
+			n = (int64_t)stat_buf.st_size;
+			for (j = 0; j < 8; j++)  {
+				hash = (hash ^ ((n >> (j << 3)) & 0xff)) * 0x100000001b3ULL;
+			}
+			n = (int64_t)stat_buf.st_mtime;
+			for (j = 0; j < 8; j++)  {
+				hash = (hash ^ ((n >> (j << 3)) & 0xff)) * 0x100000001b3ULL;
+			}
+		}
+	}
+	checkpoint->input_hash = hash;
+}
+
+
+
+
+
+/*
+ * Try to read an elevation checkpoint file.
+ *
+ * On entry, *checkpoint must hold the key fields (see elev_checkpoint_key()).
+ * If the file exists, and its key matches, then the rest of *checkpoint is
+ * filled in from the file, *image_in is pointed at a newly-allocated copy of
+ * the elevation data, and 1 is returned.  Otherwise 0 is returned, and the
+ * key fields of *checkpoint are left intact so that the caller can later
+ * write a fresh checkpoint.
+ */
+int32_t
+read_elev_checkpoint(char *checkpoint_file, struct elev_checkpoint *checkpoint, short **image_in)
+{
+	int fdesc;
+	struct elev_checkpoint file_checkpoint;
+	short *ptr;
+	size_t size;
+	ssize_t ret_val;
+
+	if ((fdesc = open(checkpoint_file, O_RDONLY)) < 0)  {
+		return 0;
+	}
+	if (((ret_val = read(fdesc, &file_checkpoint, sizeof(struct elev_checkpoint))) < 0) || ((size_t)ret_val != sizeof(struct elev_checkpoint)))  {
+		close(fdesc);
+		return 0;
+	}
+	if ((memcmp(file_checkpoint.magic, checkpoint->magic, sizeof(checkpoint->magic)) != 0) ||
+	    (file_checkpoint.version != checkpoint->version) ||
+	    (file_checkpoint.num_dem != checkpoint->num_dem) ||
+	    (file_checkpoint.input_hash != checkpoint->input_hash) ||
+	    (file_checkpoint.req_sw_lat != checkpoint->req_sw_lat) ||
+	    (file_checkpoint.req_sw_long != checkpoint->req_sw_long) ||
+	    (file_checkpoint.req_ne_lat != checkpoint->req_ne_lat) ||
+	    (file_checkpoint.req_ne_long != checkpoint->req_ne_long) ||
+	    (file_checkpoint.req_x != checkpoint->req_x) ||
+	    (file_checkpoint.req_y != checkpoint->req_y) ||
+	    (file_checkpoint.x < 4) || (file_checkpoint.y < 4))  {
+		close(fdesc);
+		return 0;
+	}
+
+	size = sizeof(short) * (size_t)(file_checkpoint.y + 1) * (size_t)(file_checkpoint.x + 1);
+	ptr = (short *)malloc(size);
+	if (ptr == (short *)0)  {
+		fprintf(stderr, "malloc of checkpoint data failed\n");
+		exit(0);
+	}
+	if (((ret_val = read(fdesc, ptr, size)) < 0) || ((size_t)ret_val != size))  {
+		fprintf(stderr, "Checkpoint file %s is truncated.  Ignoring it.\n", checkpoint_file);
+		free(ptr);
+		close(fdesc);
+		return 0;
+	}
+	close(fdesc);
+
+	file_checkpoint.dem_name[sizeof(file_checkpoint.dem_name) - 1] = '\0';
+	*checkpoint = file_checkpoint;
+	*image_in = ptr;
+
+	return 1;
+}
+
+
+
+
+
+/*
+ * Write an elevation checkpoint file.
+ *
+ * A checkpoint is only a time saver, so failure to write one isn't fatal.
+ * We print a warning, remove any partial file, and carry on.
+ */
+void
+write_elev_checkpoint(char *checkpoint_file, struct elev_checkpoint *checkpoint, short *image_in)
+{
+	int fdesc;
+	size_t size;
+	ssize_t ret_val;
+
+	if ((fdesc = open(checkpoint_file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)  {
+		fprintf(stderr, "Warning:  Can't create checkpoint file %s, errno = %d\n", checkpoint_file, errno);
+		return;
+	}
+
+	size = sizeof(short) * (size_t)(checkpoint->y + 1) * (size_t)(checkpoint->x + 1);
+	if (((ret_val = write(fdesc, checkpoint, sizeof(struct elev_checkpoint))) < 0) || ((size_t)ret_val != sizeof(struct elev_checkpoint)) ||
+	    ((ret_val = write(fdesc, image_in, size)) < 0) || ((size_t)ret_val != size))  {
+		fprintf(stderr, "Warning:  Failed to write checkpoint file %s, errno = %d\n", checkpoint_file, errno);
+		close(fdesc);
+		unlink(checkpoint_file);
+		return;
+	}
+	close(fdesc);
+
+	fprintf(stderr, "Elevation data saved to checkpoint file:  %s\n", checkpoint_file);
+}
+
+
+
+/*
+ * Process a single DLG file, of either the optional format or SDTS format.
+ */
+void
+process_dlg_file(char *file_name, struct image_corners *image_corners, int32_t info_flag)
+{
+	int32_t length;
+	int32_t gz_flag;
+	int32_t ret_val;
+	int dlg_fdesc;
+	char archive_member[MAX_FILE_NAME + 1];
+
+	/*
+	 * If the user gave us a tar archive, rather than a file,
+	 * find the SDTS line module in it, and use that instead.
+	 */
+	if ((ret_val = sdts_archive_find(file_name, "LE", archive_member)) < 0)  {
+		fprintf(stderr, "Can't find an SDTS line module (????LE@@.DDF) in %s.  Ignoring file.\n", file_name);
+		return;
+	}
+	else if (ret_val > 0)  {
+		file_name = archive_member;
+	}
+
+	length = strlen(file_name);
+
+	if ((length > 3) && ((strcmp(&file_name[length - 3], ".gz") == 0) ||
+	    (strcmp(&file_name[length - 3], ".GZ") == 0)))  {
+		gz_flag = 1;
+	}
+	else  {
+		gz_flag = 0;
+	}
+
+	/*
+	 * If the user gave us a cache directory, and the file is already in it,
+	 * then we can draw it without parsing it at all.  If not, the code
+	 * below will add it to the cache as a side effect of drawing it.
+	 */
+	if ((dlg_cache_dir != (char *)0) && (info_flag == 0))  {
+		if (dlg_cache_draw(dlg_cache_dir, file_name, image_corners) == 0)  {
+			return;
+		}
+	}
+
+	/*
+	 * Files in Spatial Data Transfer System (SDTS) format are markedly
+	 * different from the optional-format DLG files.
+	 *
+	 * Since SDTS files are so different, we must detect them handle
+	 * them separately.
+	 *
+	 * We insist that the user specify one, single, SDTS file on the command
+	 * line for each SDTS DLG directory.  The file must be the one whose
+	 * name has the form ????LE??.DDF (or ????le??.ddf), and it may have
+	 * a .gz on the end if it is gzip compressed.
+	 *
+	 * We allow the files to be gzip-compressed, and they can have either
+	 * ".gz" or ".GZ" on the end.  However, we insist that the rest of
+	 * the file name have consistent case.  That is, if the 'f' or 'F'
+	 * in the ".DDF" or ".ddf" is in a given case, the rest of the file
+	 * had better be in that same case.
+	 *
+	 * If the following "if" test succeeds, we assume we have an SDTS file.
+	 */
+	if (((length >= 15) && (gz_flag != 0) &&
+	     ((strncmp(&file_name[length - 7], ".ddf", 4) == 0) ||
+	      (strncmp(&file_name[length - 7], ".DDF", 4) == 0))) ||
+	    ((length >= 12) && (gz_flag == 0) &&
+	     ((strcmp(&file_name[length - 4], ".ddf") == 0) ||
+	      (strcmp(&file_name[length - 4], ".DDF") == 0))))  {
+		/* SDTS file */
+
+		/*
+		 * Check that the file name takes the form that we expect.
+		 */
+		if (((gz_flag != 0) &&
+		     (strncmp(&file_name[length - 11], "le", 2) != 0) &&
+		     (strncmp(&file_name[length - 11], "LE", 2) != 0)) ||
+		    ((gz_flag == 0) &&
+		     (strncmp(&file_name[length - 8], "le", 2) != 0) &&
+		     (strncmp(&file_name[length - 8], "LE", 2) != 0)))  {
+			fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.  Ignoring file.\n", file_name);
+			return;
+		}
+
+		/* If info_flag is nonzero, then just print some info about the DLG file. */
+		if (info_flag == 0)  {
+			fprintf(stderr, "Processing DLG file:  %s\n", file_name);
+		}
+		else  {
+			fprintf(stdout, "%s", file_name);
+		}
+
+		/*
+		 * The file name looks okay.  Let's launch into the information parsing.
+		 */
+		(void)process_dlg_sdts(file_name, (char *)0, gz_flag, image_corners, info_flag, 0);
+	}
+	else  {
+		/* Not an SDTS file. */
+
+		if (gz_flag != 0)  {
+			if ((dlg_fdesc = buf_open_z(file_name, O_RDONLY)) < 0)  {
+				fprintf(stderr, "Can't open %s for reading, errno = %d\n", file_name, errno);
+				exit(0);
+			}
+		}
+		else  {
+			if ((dlg_fdesc = buf_open(file_name, O_RDONLY)) < 0)  {
+				fprintf(stderr, "Can't open %s for reading, errno = %d\n", file_name, errno);
+				exit(0);
+			}
+		}
+
+		/* If info_flag is nonzero, then just print some info about the DLG file. */
+		if (info_flag == 0)  {
+			fprintf(stderr, "Processing DLG file:  %s\n", file_name);
+		}
+		else  {
+			fprintf(stdout, "%s", file_name);
+		}
+
+		/*
+		 * With the DEM files, we parsed the header first, and then
+		 * called a separate processing function, and then did some
+		 * more processing here in the main body of drawmap.  DLG files are
+		 * more complicated to parse, and we don't need to return any DLG
+		 * data to this main processing loop.  Thus, we just encapsulate
+		 * all parsing and processing into a single function call.
+		 */
+		process_dlg_optional(dlg_fdesc, gz_flag, image_corners, info_flag);
+
+		if (gz_flag == 0)  {
+			buf_close(dlg_fdesc);
+		}
+		else  {
+			buf_close_z(dlg_fdesc);
+		}
+	}
+
+}
+
+
+
+/*
+ * Process several DLG files in parallel.
+ *
+ * Each file is handed to a child process, which parses it, and records the
+ * drawing operations that it would have performed in a display list
+ * (see dlg_display.c).  The display list goes into a temporary file.
+ * As the children finish, we replay their lists into the image,
+ * always in command-line order, so that each file still overlays the
+ * ones before it, and the image is the same as if we had processed
+ * the files one at a time.  At most num_jobs children run at once.
+ *
+ * Each finished list holds an open file until it is replayed, so if an
+ * early file is slow, the lists for the files after it pile up.  To keep
+ * them from using up the available file descriptors (and disk space),
+ * we don't start a child while 2 * num_jobs lists are already waiting,
+ * or being made.
+ *
+ * The children inherit the image (and everything else) from us, but they
+ * don't modify it, so the operating system doesn't have to copy it.
+ *
+ * The DLG code reports errors by printing a message and exiting.
+ * When that happens in a child, its display list is never written.  If we
+ * were processing the files one at a time, drawmap would have exited at
+ * that point, so we do the same when we come to the missing list.
+ * A child can also die without a word (if it is killed by a signal,
+ * or by the kernel when memory runs short), so we say which file was lost.
+ */
+void
+process_dlg_parallel(char **file_names, int32_t num_files, int32_t num_jobs, struct image_corners *image_corners)
+{
+	pid_t *pids;
+	FILE **lists;
+	char *done;
+	int *statuses;
+	pid_t pid;
+	int status;
+	int32_t next_start = 0;
+	int32_t next_replay = 0;
+	int32_t running = 0;
+	int32_t i;
+
+	pids = (pid_t *)malloc(num_files * sizeof(pid_t));
+	lists = (FILE **)malloc(num_files * sizeof(FILE *));
+	done = (char *)calloc(num_files, 1);
+	statuses = (int *)malloc(num_files * sizeof(int));
+	if ((pids == (pid_t *)0) || (lists == (FILE **)0) || (done == (char *)0) || (statuses == (int *)0))  {
+		fprintf(stderr, "malloc of DLG process table failed\n");
+		exit(0);
+	}
+
+	/* Don't let the children inherit, and later repeat, any buffered output. */
+	fflush(stdout);
+	fflush(stderr);
+
+	while (next_replay < num_files)  {
+		/* Start as many children as we are allowed. */
+		while ((running < num_jobs) && (next_start < num_files) && ((next_start - next_replay) < (2 * num_jobs)))  {
+			if ((lists[next_start] = tmpfile()) == (FILE *)0)  {
+				fprintf(stderr, "Can't create a temporary file for a DLG display list, errno = %d\n", errno);
+				exit(0);
+			}
+			if ((pid = fork()) < 0)  {
+				fprintf(stderr, "Can't fork a process for DLG file %s, errno = %d\n", file_names[next_start], errno);
+				exit(0);
+			}
+			if (pid == 0)  {
+				/* Child. */
+				display_list_begin();
+				process_dlg_file(file_names[next_start], image_corners, 0);
+				if (display_list_end(fileno(lists[next_start])) != 0)  {
+					fprintf(stderr, "Can't write the display list for DLG file %s\n", file_names[next_start]);
+					_exit(1);
+				}
+				_exit(0);
+			}
+			pids[next_start] = pid;
+			next_start++;
+			running++;
+		}
+
+		/* Wait for any child to finish. */
+		if ((pid = wait(&status)) < 0)  {
+			fprintf(stderr, "wait() for a DLG process failed, errno = %d\n", errno);
+			exit(0);
+		}
+		for (i = next_replay; i < next_start; i++)  {
+			if (pids[i] == pid)  {
+				done[i] = 1;
+				statuses[i] = status;
+				running--;
+				break;
+			}
+		}
+
+		/* Draw every list that is ready, as long as all of the lists before it have been drawn. */
+		while ((next_replay < num_files) && (done[next_replay] != 0))  {
+			if (WIFSIGNALED(statuses[next_replay]))  {
+				fprintf(stderr, "The process for DLG file %s was killed by signal %d\n",
+					file_names[next_replay], WTERMSIG(statuses[next_replay]));
+			}
+			if (WIFSIGNALED(statuses[next_replay]) ||
+			    (lseek(fileno(lists[next_replay]), 0, SEEK_SET) != 0) ||
+			    (display_list_replay(fileno(lists[next_replay]), image_corners) != 0))  {
+				fprintf(stderr, "The display list for DLG file %s is missing or incomplete.  Giving up.\n", file_names[next_replay]);
+				for (i = next_replay + 1; i < next_start; i++)  {
+					if (done[i] == 0)  {
+						kill(pids[i], SIGTERM);
+					}
+				}
+				exit(0);
+			}
+			fclose(lists[next_replay]);
+			next_replay++;
+		}
+	}
+
+	free(pids);
+	free(lists);
+	free(done);
+	free(statuses);
+}
@@ -103,8 +103,28 @@ struct datum  {
 	double a2;		// Second coefficient in Redfearn integral expansion
 	double a4;		// Third coefficient in Redfearn integral expansion
 	double a6;		// Fourth coefficient in Redfearn integral expansion
+
+	/*
+	 * Coefficients for the Kruger-series projection.  These are derived from
+	 * a and f_inv by kruger_init() the first time the datum is used with that
+	 * projection.  kr_a and kr_f_inv record which ellipsoid they belong to,
+	 * so that nobody has to remember to initialize them.
+	 */
+	double kr_a;		// Semimajor radius the coefficients were computed for
+	double kr_f_inv;	// Inverse flattening the coefficients were computed for
+	double kr_e;		// Eccentricity
+	double kr_A;		// Rectifying radius
+	double kr_alpha[6];	// Coefficients for the forward series
+	double kr_beta[6];	// Coefficients for the inverse series
+	double kr_delta[6];	// Coefficients for the conformal-to-geodetic latitude series
 };
 
+/*
+ * Choices for the transverse Mercator projection engine, held in tm_engine.
+ */
+#define TM_REDFEARN	0	// Redfearn's formulas (the default)
+#define TM_KRUGER	1	// Kruger's n-series, to sixth order
+
 /*
  * These are the parameters for the Clarke 1866 ellipsoid, which is used with the
  * North American Datum of 1927 (NAD-27) datum.  The NAD-27 used a point on
@@ -207,6 +227,7 @@ ssize_t get_a_line(int, void *, size_t);
 int buf_close(int);
 int buf_open_z(const char *, int);
 ssize_t buf_read_z(int, void *, size_t);
+ssize_t buf_read_all_z(int, char **);
 ssize_t get_a_line_z(int, void *, size_t);
 int buf_close_z(int);
 double lat_conv(char *);
@@ -215,8 +236,16 @@ double find_latitude(double, double);
 double find_longitude(double, double);
 int32_t redfearn(struct datum *, double *, double *, int32_t *, double, double, int32_t);
 int32_t redfearn_inverse(struct datum *, double, double, int32_t, double *, double *);
+int32_t redfearn_array(struct datum *, double *, double *, int32_t, double *, double *, int32_t);
+int32_t redfearn_inverse_array(struct datum *, double *, double *, int32_t, double *, double *, int32_t);
+void kruger_init(struct datum *);
 void decimal_degrees_to_dms(double, int32_t *, int32_t *, double *);
 int32_t swab_type();
+int32_t clip_line(double *, double *, double *, double *, double, double, double, double);
+void draw_line(struct image_corners *, int32_t, int32_t, int32_t, int32_t, int32_t);
+int32_t batch_add(char *, char *);
+int32_t batch_add_list(char *, char *);
+int32_t batch_run(int32_t, void (*)(char *));
 
 /*
  * Some macros to do swabbing.
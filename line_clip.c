@@ -0,0 +1,193 @@
+/*
+ * =========================================================================
+ * line_clip.c - Routines to clip line segments and draw them into the image.
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * Line segments arrive here in image pixel coordinates, still in floating
+ * point, and possibly extending beyond the edges of the image.
+ * clip_line() trims a segment to a rectangular window, and draw_line()
+ * fills in the pixels between two integer endpoints.
+ *
+ * Clipping is done in pixel space with the Liang-Barsky algorithm.  The segment
+ * is written in parametric form, P(t) = P1 + t * (P2 - P1), for 0 <= t <= 1,
+ * and each of the four window edges either raises the lowest usable t or lowers
+ * the highest usable t.  If the range of usable t becomes empty, the segment
+ * misses the window entirely.  Unlike intercept-based methods, there are no
+ * special cases for corners, or for segments that are horizontal or vertical,
+ * so a segment that crosses the window is never lost.
+ *
+ * Drawing is done with Bresenham's algorithm, which uses nothing but integer
+ * additions and comparisons in the per-pixel loop.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "drawmap.h"
+
+
+extern int32_t x_prime;
+
+
+
+/*
+ * Clip the segment from (*x1, *y1) to (*x2, *y2) against the window
+ * x_low <= x <= x_high, y_low <= y <= y_high.
+ *
+ * If any part of the segment lies within the window, the endpoints
+ * are replaced by the endpoints of that part, and we return 1.
+ * Otherwise, we return 0 and leave the endpoints alone.
+ */
+int32_t
+clip_line(double *x1, double *y1, double *x2, double *y2,
+	  double x_low, double y_low, double x_high, double y_high)
+{
+	double dx, dy;
+	double t_low = 0.0, t_high = 1.0;
+	double p[4], q[4];
+	double r;
+	int32_t i;
+
+	dx = *x2 - *x1;
+	dy = *y2 - *y1;
+
+	/*
+	 * For each edge, p is the rate at which the segment moves toward
+	 * the outside of the edge, and q is the distance from the first
+	 * endpoint to the edge, measured toward the inside.
+	 */
+	p[0] = -dx;	q[0] = *x1 - x_low;
+	p[1] = dx;	q[1] = x_high - *x1;
+	p[2] = -dy;	q[2] = *y1 - y_low;
+	p[3] = dy;	q[3] = y_high - *y1;
+
+	for (i = 0; i < 4; i++)  {
+		if (p[i] == 0.0)  {
+			/* The segment is parallel to this edge.  Reject it if it is outside. */
+			if (q[i] < 0.0)  {
+				return 0;
+			}
+		}
+		else  {
+			r = q[i] / p[i];
+			if (p[i] < 0.0)  {
+				/* The segment enters the window across this edge. */
+				if (r > t_high)  {
+					return 0;
+				}
+				if (r > t_low)  {
+					t_low = r;
+				}
+			}
+			else  {
+				/* The segment leaves the window across this edge. */
+				if (r < t_low)  {
+					return 0;
+				}
+				if (r < t_high)  {
+					t_high = r;
+				}
+			}
+		}
+	}
+
+	/*
+	 * Compute the second endpoint first, since the first endpoint
+	 * is needed to compute it.
+	 */
+	if (t_high < 1.0)  {
+		*x2 = *x1 + t_high * dx;
+		*y2 = *y1 + t_high * dy;
+	}
+	if (t_low > 0.0)  {
+		*x1 = *x1 + t_low * dx;
+		*y1 = *y1 + t_low * dy;
+	}
+
+	return 1;
+}
+
+
+
+/*
+ * Draw a line segment, of the given color, between two pixels in the image.
+ * The caller is responsible for making sure that both endpoints are
+ * within the image.  (It is okay for either coordinate to go to -1,
+ * since the image borders are there to absorb it.)
+ */
+void
+draw_line(struct image_corners *image_corners, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t color)
+{
+	int32_t dx, dy;
+	int32_t step_x, step_y;
+	int32_t error;
+	int32_t i;
+	unsigned char *ptr;
+
+	dx = x2 - x1;
+	dy = y2 - y1;
+
+	/*
+	 * Walk the pointer through the image, rather than recomputing
+	 * the pixel address from (x, y) every time.
+	 */
+	if (dx < 0)  {
+		dx = -dx;
+		step_x = -1;
+	}
+	else  {
+		step_x = 1;
+	}
+	if (dy < 0)  {
+		dy = -dy;
+		step_y = -x_prime;
+	}
+	else  {
+		step_y = x_prime;
+	}
+
+	ptr = image_corners->ptr + (y1 + TOP_BORDER) * x_prime + x1 + LEFT_BORDER;
+	*ptr = color;
+
+	if (dx >= dy)  {
+		/* x is the fastest-changing coordinate. */
+		error = dx >> 1;
+		for (i = 0; i < dx; i++)  {
+			ptr += step_x;
+			error -= dy;
+			if (error < 0)  {
+				ptr += step_y;
+				error += dx;
+			}
+			*ptr = color;
+		}
+	}
+	else  {
+		/* y is the fastest-changing coordinate. */
+		error = dy >> 1;
+		for (i = 0; i < dy; i++)  {
+			ptr += step_y;
+			error -= dx;
+			if (error < 0)  {
+				ptr += step_x;
+				error += dy;
+			}
+			*ptr = color;
+		}
+	}
+}
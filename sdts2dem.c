@@ -68,6 +68,99 @@
 void gen_header(char *, struct dem_record_type_a *, struct datum *);
 
 
+
+/*
+ * The output records are built in place, in a large block of memory,
+ * and the block is written out whenever it fills up.  A typical 24K DEM
+ * has 1.4 million or so elevations, and formatting each of them with
+ * sprintf(), and writing the records out one at a time, used to take
+ * most of the conversion time.
+ *
+ * dem_record() returns a pointer to the next record in the block,
+ * filled with blanks, so that the caller only needs to fill in the
+ * non-blank parts.  dem_flush() writes out whatever is in the block.
+ */
+#define DEM_BLOCK_RECORDS	4096	// 4 Mbytes of output records
+static char dem_block[DEM_BLOCK_RECORDS * DEM_RECORD_LENGTH];
+static int32_t dem_block_used = 0;
+
+static void
+dem_flush(int output_fdesc)
+{
+	ssize_t size;
+
+	size = (ssize_t)dem_block_used * DEM_RECORD_LENGTH;
+	if ((size > 0) && (write(output_fdesc, dem_block, size) != size))  {
+		fprintf(stderr, "Failed to write records to DEM file.\n");
+		exit(0);
+	}
+	dem_block_used = 0;
+}
+
+static char *
+dem_record(int output_fdesc)
+{
+	char *record;
+
+	if (dem_block_used == DEM_BLOCK_RECORDS)  {
+		dem_flush(output_fdesc);
+	}
+	record = dem_block + dem_block_used * DEM_RECORD_LENGTH;
+	dem_block_used++;
+	memset(record, ' ', DEM_RECORD_LENGTH);
+
+	return record;
+}
+
+
+
+/*
+ * Put an integer into the given number of bytes at dest, right-justified
+ * and blank-filled, with no null terminator.  This is what sprintf()
+ * does with "%6d", and so on, as long as the number fits, which
+ * the callers ensure.  (Elevations are shorts, which always fit in 6 bytes.)
+ */
+static void
+put_int(char *dest, int32_t width, int32_t value)
+{
+	uint32_t u;
+	char *p;
+
+	u = value < 0 ? -(uint32_t)value : (uint32_t)value;
+	p = dest + width;
+	do  {
+		*--p = '0' + u % 10;
+		u = u / 10;
+	} while ((u != 0) && (p > dest));
+	if ((value < 0) && (p > dest))  {
+		*--p = '-';
+	}
+	while (p > dest)  {
+		*--p = ' ';
+	}
+}
+
+
+
+/*
+ * Put a real number into the 24 bytes at dest, in the "% 24.15E" format,
+ * but with a 'D' for the exponent, as the USGS does.  These only show up
+ * a few times per profile, so we leave the digits to sprintf(),
+ * which always gets the rounding right.
+ */
+static void
+put_real(char *dest, double value)
+{
+	char tmp[64];
+	int32_t i;
+
+	snprintf(tmp, sizeof(tmp), "% 24.15E", value);
+	for (i = 0; i < 24; i++)  {
+		dest[i] = tmp[i] == 'E' ? 'D' : tmp[i];
+	}
+}
+
+
 void
 license(void)
 {
@@ -88,76 +181,75 @@ license(void)
 
 
 
-int
-main(int argc, char *argv[])
+static void
+convert(char *input_file, char *output_name)
 {
 	int32_t i, j, k, l;
-	union {
-		uint32_t i;
-		float f;
-	} conv;
 	int dem_fdesc;
 	int output_fdesc;
 	int32_t length;
 	char buf[DEM_RECORD_LENGTH + 1];
 	char output_file[12];
 	int32_t gz_flag;
+	int32_t ret_val;
+	char archive_member[MAX_FILE_NAME + 1];
 	ssize_t (*read_function)();
-	int32_t byte_order;
 	struct dem_record_type_a dem_a;
 	struct dem_record_type_c dem_c;
 	struct datum datum;
 	char code1, code2;
-	struct subfield subfield;
+	struct ddf_item cvls_item = { "CVLS", "ELEVATION", DDF_SHORT, (void *)0, 0, 0 };
+	struct ddf *cel_ddf;
 	int32_t get_ret;
 	short *ptr, *sptr;
+	char *record;
 	int32_t num_elevs;
 	double x, y;
 	int32_t min_elev_prof, max_elev_prof;
 
 
-	if ((argc == 2) && (argv[1][0] == '-') && (argv[1][1] == 'L'))  {
-		license();
+	/*
+	 * If the user gave us a tar archive, rather than a file,
+	 * find the elevation module in it, and use that instead.
+	 */
+	if ((ret_val = sdts_archive_find(input_file, "CEL", archive_member)) < 0)  {
+		fprintf(stderr, "Can't find an SDTS elevation module (????CEL@.DDF) in %s\n", input_file);
 		exit(0);
 	}
-	if ((argc != 2) && (argc != 3))  {
-		fprintf(stderr, "Usage:  %s ????CEL@.DDF [output_file_name]\n", argv[0]);
-		fprintf(stderr, "        Where the ???? are alphanumeric characters, and @ represents a digit.\n");
-		exit(0);
+	else if (ret_val > 0)  {
+		input_file = archive_member;
 	}
 
 
-	/*
-	 * Find the byte order of this machine.
-	 */
-	byte_order = swab_type();
-
-
 	/* Find file name length. */
-	length = strlen(argv[1]);
+	length = strlen(input_file);
 	/* Find file name length. */
-	length = strlen(argv[1]);
+	length = strlen(input_file);
 	if (length < 12)  {
-		fprintf(stderr, "File name %s appears too short to be valid.  Should look like ????CEL@.DDF\n", argv[1]);
+		fprintf(stderr, "File name %s appears too short to be valid.  Should look like ????CEL@.DDF\n", input_file);
 		exit(0);
 	}
 
 	/*
 	 * Figure out if the file is gzip-compressed or not.
 	 */
-	if ((strcmp(&argv[1][length - 3], ".gz") == 0) ||
-	    (strcmp(&argv[1][length - 3], ".GZ") == 0))  {
+	if ((strcmp(&input_file[length - 3], ".gz") == 0) ||
+	    (strcmp(&input_file[length - 3], ".GZ") == 0))  {
 		gz_flag = 1;
-		if ((dem_fdesc = buf_open_z(argv[1], O_RDONLY)) < 0)  {
-			fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[1], errno);
+		if ((dem_fdesc = buf_open_z(input_file, O_RDONLY)) < 0)  {
+			fprintf(stderr, "Can't open %s for reading, errno = %d\n", input_file, errno);
 			exit(0);
 		}
 		read_function = buf_read_z;
 	}
 	else  {
 		gz_flag = 0;
-		if ((dem_fdesc = buf_open(argv[1], O_RDONLY)) < 0)  {
-			fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[1], errno);
+		if (sdts_archive_member(input_file) != 0)  {
+			/* The file is inside a tar archive.  begin_ddf() will find it there. */
+			dem_fdesc = -1;
+		}
+		else if ((dem_fdesc = buf_open(input_file, O_RDONLY)) < 0)  {
+			fprintf(stderr, "Can't open %s for reading, errno = %d\n", input_file, errno);
 			exit(0);
 		}
 		read_function = buf_read;
@@ -187,16 +279,18 @@ main(int argc, char *argv[])
 	 * If the following "if" test succeeds, we assume we have an SDTS file.
 	 */
 	if (((length >= 7) && (gz_flag != 0) &&
-	     ((strncmp(&argv[1][length - 7], ".ddf", 4) == 0) ||
-	      (strncmp(&argv[1][length - 7], ".DDF", 4) == 0))) ||
+	     ((strncmp(&input_file[length - 7], ".ddf", 4) == 0) ||
+	      (strncmp(&input_file[length - 7], ".DDF", 4) == 0))) ||
 	    ((length >= 4) && (gz_flag == 0) &&
-	     ((strcmp(&argv[1][length - 4], ".ddf") == 0) ||
-	      (strcmp(&argv[1][length - 4], ".DDF") == 0))))  {
+	     ((strcmp(&input_file[length - 4], ".ddf") == 0) ||
+	      (strcmp(&input_file[length - 4], ".DDF") == 0))))  {
 		/* SDTS file */
 
 		/* Close the file.  We will reopen it in parse_dem_sdts(). */
 		if (gz_flag == 0)  {
-			buf_close(dem_fdesc);
+			if (dem_fdesc >= 0)  {
+				buf_close(dem_fdesc);
+			}
 		}
 		else  {
 			buf_close_z(dem_fdesc);
@@ -206,19 +300,19 @@ main(int argc, char *argv[])
 		 * Check that the file name takes the form that we expect.
 		 */
 		if (((gz_flag != 0) &&
-		     ((strncmp(&argv[1][length - 11], "ce", 2) != 0) &&
-		      (strncmp(&argv[1][length - 11], "CE", 2) != 0))) ||
+		     ((strncmp(&input_file[length - 11], "ce", 2) != 0) &&
+		      (strncmp(&input_file[length - 11], "CE", 2) != 0))) ||
 		    ((gz_flag == 0) &&
-		     (strncmp(&argv[1][length - 8], "ce", 2) != 0) &&
-		     (strncmp(&argv[1][length - 8], "CE", 2) != 0)))  {
-			fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.\n", argv[1]);
+		     (strncmp(&input_file[length - 8], "ce", 2) != 0) &&
+		     (strncmp(&input_file[length - 8], "CE", 2) != 0)))  {
+			fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.\n", input_file);
 			exit(0);
 		}
 
 		/*
 		 * The file name looks okay.  Let's launch into the information parsing.
 		 */
-		if (parse_dem_sdts(argv[1], &dem_a, &dem_c, &datum, gz_flag) != 0)  {
+		if (parse_dem_sdts(input_file, &dem_a, &dem_c, &datum, gz_flag) != 0)  {
 			exit(0);
 		}
 	}
@@ -231,9 +325,9 @@ main(int argc, char *argv[])
 
 
 	/* Create the output file. */
-	if (argc == 3)  {
-		if ((output_fdesc = open(argv[2], O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0)  {
-			fprintf(stderr, "Can't create %s for writing, errno = %d\n", argv[2], errno);
+	if (output_name != (char *)0)  {
+		if ((output_fdesc = open(output_name, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0)  {
+			fprintf(stderr, "Can't create %s for writing, errno = %d\n", output_name, errno);
 			exit(0);
 		}
 	}
@@ -255,10 +349,7 @@ main(int argc, char *argv[])
 	 * Okay.  Fill in the header and write it out to the new DEM file.
 	 */
 	gen_header(buf, &dem_a, &datum);
-	if (write(output_fdesc, buf, DEM_RECORD_LENGTH) != DEM_RECORD_LENGTH)  {
-		fprintf(stderr, "Failed to write header to DEM file.\n");
-		exit(0);
-	}
+	memcpy(dem_record(output_fdesc), buf, DEM_RECORD_LENGTH);
 
 
 
@@ -283,94 +374,55 @@ main(int argc, char *argv[])
 	/*
 	 * Open the file in preparation for parsing.
 	 */
-	if (begin_ddf(argv[1]) < 0)  {
-		fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[1], errno);
+	if ((cel_ddf = ddf_open(input_file)) == (struct ddf *)0)  {
+		fprintf(stderr, "Can't open %s for reading, errno = %d\n", input_file, errno);
 		exit(0);
 	}
 	/*
-	 * Loop through the subfields until we find all of the elevation data.
+	 * Read the records one at a time.  Each record holds one row of elevations,
+	 * which get_record() converts, rounds to integers, and puts straight into
+	 * the corresponding row of the array.
 	 */
+	cvls_item.max = dem_a.cols;
+	(void)ddf_bind(cel_ddf, &cvls_item, 1);
 	for (j = 0; j < dem_a.rows; j++)  {
-		while ((get_ret = get_subfield(&subfield)) != 0)  {
+		cvls_item.dest = ptr + j * dem_a.cols;
+		while ((get_ret = get_record(cel_ddf, &cvls_item, 1)) != 0)  {
 			/*
-			 * Skip unwanted subfields at the beginning of the record.
+			 * Skip records that don't contain elevations.
 			 */
-			if (strcmp(subfield.tag, "CVLS") == 0)  {
+			if (cvls_item.count > 0)  {
 				break;
 			}
 		}
 		if (get_ret == 0)  {
 			/* At end of file and we still haven't found what we need. */
-			fprintf(stderr, "Ran out of data in file %s.\n", argv[1]);
-			end_ddf();
+			fprintf(stderr, "Ran out of data in file %s.\n", input_file);
+			ddf_close(cel_ddf);
 			exit(0);
 		}
-		for (i = 0; i < dem_a.cols; i++)  {
-			if ((strstr(subfield.format, "B") != (char *)0) && (strcmp(subfield.label, "ELEVATION") == 0))  {
-				sptr = (ptr + j * dem_a.cols + i);
-				/*
-				 * These values, rather than being stored in the expected 'I' format (integer numbers),
-				 * are stored in two's-complement binary.  Thus, they must be properly swabbed
-				 * during conversion to internal form.
-				 */
-				if (subfield.length == 2)  {
-					if (byte_order == 0)  {
-						*sptr = (((int32_t)subfield.value[1] << 8) & 0x0000ff00) + ((int32_t)subfield.value[0] & 0x000000ff);
-					}
-					else  {
-						*sptr = (((int32_t)subfield.value[0] << 8) & 0x0000ff00) + ((int32_t)subfield.value[1] & 0x000000ff);
-					}
-				}
-				else if (subfield.length == 4)  {
-					/*
-					 * Note:  When the length is 4, we assume that this is a
-					 * BFP32 value, which means that it is a raw binary IEEE 754
-					 * floating point number.  Thus, this conversion won't work
-					 * on machines where IEEE 754 is not the native floating point
-					 * format.  We could convert from binary into the native floating
-					 * point format the hard way, but it appears that most machines
-					 * support IEEE 754, so we will try it this way for a while.
-					 */
-					conv.i = (((int32_t)subfield.value[3] & 0xff) << 24) |
-						  (((int32_t)subfield.value[2] & 0xff) << 16) |
-						  (((int32_t)subfield.value[1] & 0xff) <<  8) |
-						   ((int32_t)subfield.value[0] & 0xff);
-					if (byte_order == 0)  {
-						/* Do nothing. */
-					}
-					else if (byte_order == 1)  {
-						LE_SWAB(&conv.i);
-					}
-					else if (byte_order == 2)  {
-						PDP_SWAB(&conv.i);
-					}
-					*sptr = drawmap_round(conv.f);
-				}
-				else  {
-					/* Error */
-					*sptr = dem_a.void_fill;
-				}
-
-				if (i == (dem_a.cols - 1))  {
-					break;
-				}
-			}
-
-			if (get_subfield(&subfield) == 0)  {
-				fprintf(stderr, "Shortage of data in %s.\n", argv[1]);
-				end_ddf();
-				exit(0);
-			}
-			if (strcmp(subfield.tag, "CVLS") != 0)  {
-				/* There weren't the expected number of elevations in the row. */
-				fprintf(stderr, "Shortage of data in %s.\n", argv[1]);
-				end_ddf();
-				exit(0);
+		if (cvls_item.count < dem_a.cols)  {
+			/* There weren't the expected number of elevations in the row. */
+			fprintf(stderr, "Shortage of data in %s.\n", input_file);
+			ddf_close(cel_ddf);
+			exit(0);
+		}
+		/*
+		 * The values are normally stored in two's-complement binary (BI16),
+		 * or as IEEE 754 floating point numbers (BFP32), rather than in
+		 * 'I' format.  get_record() has already taken care of swabbing them
+		 * into native form.
+		 */
+		if ((cvls_item.format == 'B') && (cvls_item.size != 2) && (cvls_item.size != 4))  {
+			/* Error */
+			sptr = ptr + j * dem_a.cols;
+			for (i = 0; i < dem_a.cols; i++)  {
+				sptr[i] = dem_a.void_fill;
 			}
 		}
 	}
 	/* We are done with this file, so close it. */
-	end_ddf();
+	ddf_close(cel_ddf);
 
 
 	/*
@@ -441,15 +493,22 @@ main(int argc, char *argv[])
 			y = y + dem_a.y_res;
 			i--;
 		}
-		sprintf(buf, "%6d%6d%6d%6d% 24.15E% 24.15E   0.0                  % 24.15E% 24.15E",
-			1, j + 1, num_elevs, 1, x, y, (double)min_elev_prof, (double)max_elev_prof);
-		for (k = 0; k < 144; k++)  {
-			if (buf[k] == 'E')  buf[k] = 'D';	// USGS files use 'D' for exponentiation.
-		}
+		record = dem_record(output_fdesc);
+		put_int(record, 6, 1);
+		put_int(record + 6, 6, j + 1);
+		put_int(record + 12, 6, num_elevs);
+		put_int(record + 18, 6, 1);
+		put_real(record + 24, x);
+		put_real(record + 48, y);
+		memcpy(record + 72, "   0.0", 6);
+		put_real(record + 96, (double)min_elev_prof);
+		put_real(record + 120, (double)max_elev_prof);
 
 		/*
 		 * The header is ready to go.
 		 * Now just pump out data until it is all gone.
+		 * A new record is started whenever the current one
+		 * doesn't have room for another elevation.
 		 */
 		k = 144;
 		for ( ; i >= 0; i--)  {
@@ -457,29 +516,12 @@ main(int argc, char *argv[])
 			if (*sptr == dem_a.edge_fill)  {
 				break;
 			}
-			sprintf(&buf[k], "%6d", *sptr);
-			k = k + 6;
-			if ((k > (DEM_RECORD_LENGTH - 6)) || (i == 0))  {
-				/* The record is full.  Write it out. */
-				for ( ; k < DEM_RECORD_LENGTH; k++)  {
-					buf[k] = ' ';
-				}
-				if (write(output_fdesc, buf, DEM_RECORD_LENGTH) != DEM_RECORD_LENGTH)  {
-					fprintf(stderr, "Failed to write record to DEM file.\n");
-					exit(0);
-				}
+			if (k > (DEM_RECORD_LENGTH - 6))  {
+				record = dem_record(output_fdesc);
 				k = 0;
 			}
-		}
-		if (k != 0)  {
-			/* Write out a partial record, if necessary. */
-			for ( ; k < DEM_RECORD_LENGTH; k++)  {
-				buf[k] = ' ';
-			}
-			if (write(output_fdesc, buf, DEM_RECORD_LENGTH) != DEM_RECORD_LENGTH)  {
-				fprintf(stderr, "Failed to write record to DEM file.\n");
-				exit(0);
-			}
+			put_int(record + k, 6, *sptr);
+			k = k + 6;
 		}
 	}
 
@@ -493,17 +535,114 @@ main(int argc, char *argv[])
 			dem_c.datum_rmse_z, dem_c.datum_sample_size,
 			dem_c.dem_stats_flag, dem_c.dem_rmse_x, dem_c.dem_rmse_y,
 			dem_c.dem_rmse_z, dem_c.dem_sample_size);
-		for (k =  60; k < DEM_RECORD_LENGTH; k++)  {
-			buf[k] = ' ';
+		memcpy(dem_record(output_fdesc), buf, 60);
+	}
+
+
+	dem_flush(output_fdesc);
+	close(output_fdesc);
+	free(ptr);
+}
+
+
+
+/*
+ * Convert one transfer in batch mode, letting convert()
+ * generate the output file name.
+ */
+static void
+batch_convert(char *input_file)
+{
+	convert(input_file, (char *)0);
+}
+
+
+
+void
+usage(char *program_name)
+{
+	fprintf(stderr, "Usage:  %s ????CEL@.DDF [output_file_name]\n", program_name);
+	fprintf(stderr, "        %s -b [-j num_jobs] [-f list_file] [file_or_directory ...]\n", program_name);
+	fprintf(stderr, "        Where the ???? are alphanumeric characters, and @ represents a digit.\n");
+	fprintf(stderr, "        You can also give the name of a tar archive (.tar, .tar.gz, or .tgz)\n");
+	fprintf(stderr, "        that holds the SDTS files.\n");
+	fprintf(stderr, "        With -b, each argument may be an SDTS file, a tar archive, or a directory\n");
+	fprintf(stderr, "        that is searched for them, and -f names a file that lists more of them,\n");
+	fprintf(stderr, "        one per line (- for the standard input).  The transfers are converted\n");
+	fprintf(stderr, "        num_jobs at a time, and the output files are given the usual names.\n");
+}
+
+
+
+int
+main(int argc, char *argv[])
+{
+	int option;
+	int32_t batch_flag = 0;
+	int32_t num_jobs;
+	char *list_file = (char *)0;
+	extern int optind;
+	extern char *optarg;
+
+
+	if ((argc == 2) && (argv[1][0] == '-') && (argv[1][1] == 'L'))  {
+		license();
+		exit(0);
+	}
+
+	num_jobs = sysconf(_SC_NPROCESSORS_ONLN);	/* Number of transfers to convert at once, in batch mode. */
+	if (num_jobs < 1)  {
+		num_jobs = 1;
+	}
+
+	while ((option = getopt(argc, argv, "bf:j:")) != -1)  {
+		switch(option)  {
+		case 'b':
+			batch_flag = 1;
+			break;
+		case 'f':
+			list_file = optarg;
+			batch_flag = 1;
+			break;
+		case 'j':
+			num_jobs = atoi(optarg);
+			if (num_jobs < 1)  {
+				fprintf(stderr, "The number of jobs specified with -j must be at least 1\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			break;
+		default:
+			usage(argv[0]);
+			exit(0);
+			break;
 		}
-		if (write(output_fdesc, buf, DEM_RECORD_LENGTH) != DEM_RECORD_LENGTH)  {
-			fprintf(stderr, "Failed to write record to DEM file.\n");
+	}
+
+	if (batch_flag == 0)  {
+		if (((argc - optind) != 1) && ((argc - optind) != 2))  {
+			usage(argv[0]);
 			exit(0);
 		}
+		convert(argv[optind], (argc - optind) == 2 ? argv[optind + 1] : (char *)0);
+		exit(0);
 	}
 
 
-	close(output_fdesc);
+	/*
+	 * Batch mode.  Gather up the transfers, and convert them all.
+	 */
+	if ((list_file == (char *)0) && (optind == argc))  {
+		usage(argv[0]);
+		exit(0);
+	}
+	for ( ; optind < argc; optind++)  {
+		(void)batch_add(argv[optind], "CEL");
+	}
+	if (list_file != (char *)0)  {
+		(void)batch_add_list(list_file, "CEL");
+	}
+	(void)batch_run(num_jobs, batch_convert);
 
 	exit(0);
 }
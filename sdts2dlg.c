@@ -65,49 +65,57 @@ license(void)
  * and produces a single optional-format DLG file
  * as output.
  */
-int
-main(int argc, char *argv[])
+static void
+convert(char *input_file, char *output_name)
 {
 	int dlg_fdesc;
 	int32_t length;
 	int32_t gz_flag;
+	int32_t ret_val;
+	char archive_member[MAX_FILE_NAME + 1];
 	ssize_t (*read_function)();
 
 
-	if ((argc == 2) && (argv[1][0] == '-') && (argv[1][1] == 'L'))  {
-		license();
+	/*
+	 * If the user gave us a tar archive, rather than a file,
+	 * find the line module in it, and use that instead.
+	 */
+	if ((ret_val = sdts_archive_find(input_file, "LE", archive_member)) < 0)  {
+		fprintf(stderr, "Can't find an SDTS line module (????LE@@.DDF) in %s\n", input_file);
 		exit(0);
 	}
-	if ((argc != 2) && (argc != 3))  {
-		fprintf(stderr, "Usage:  %s ????LE@@.DDF [output_file_name]\n", argv[0]);
-		fprintf(stderr, "        Where the ???? are alphanumeric characters, and @ represents a digit.\n");
-		exit(0);
+	else if (ret_val > 0)  {
+		input_file = archive_member;
 	}
 
 
 	/* Find file name length. */
-	length = strlen(argv[1]);
+	length = strlen(input_file);
 	if (length < 12)  {
-		fprintf(stderr, "File name %s appears too short to be valid.  Should look like ????LE@@.DDF\n", argv[1]);
+		fprintf(stderr, "File name %s appears too short to be valid.  Should look like ????LE@@.DDF\n", input_file);
 		exit(0);
 	}
 
 	/*
 	 * Figure out if the file is gzip-compressed or not.
 	 */
-	if ((strcmp(&argv[1][length - 3], ".gz") == 0) ||
-	    (strcmp(&argv[1][length - 3], ".GZ") == 0))  {
+	if ((strcmp(&input_file[length - 3], ".gz") == 0) ||
+	    (strcmp(&input_file[length - 3], ".GZ") == 0))  {
 		gz_flag = 1;
-		if ((dlg_fdesc = buf_open_z(argv[1], O_RDONLY)) < 0)  {
-			fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[1], errno);
+		if ((dlg_fdesc = buf_open_z(input_file, O_RDONLY)) < 0)  {
+			fprintf(stderr, "Can't open %s for reading, errno = %d\n", input_file, errno);
 			exit(0);
 		}
 		read_function = buf_read_z;
 	}
 	else  {
 		gz_flag = 0;
-		if ((dlg_fdesc = buf_open(argv[1], O_RDONLY)) < 0)  {
-			fprintf(stderr, "Can't open %s for reading, errno = %d\n", argv[1], errno);
+		if (sdts_archive_member(input_file) != 0)  {
+			/* The file is inside a tar archive.  begin_ddf() will find it there. */
+			dlg_fdesc = -1;
+		}
+		else if ((dlg_fdesc = buf_open(input_file, O_RDONLY)) < 0)  {
+			fprintf(stderr, "Can't open %s for reading, errno = %d\n", input_file, errno);
 			exit(0);
 		}
 		read_function = buf_read;
@@ -133,16 +141,18 @@ main(int argc, char *argv[])
 	 * If the following "if" test succeeds, we assume we have an SDTS file.
 	 */
 	if (((length >= 7) && (gz_flag != 0) &&
-	     ((strncmp(&argv[1][length - 7], ".ddf", 4) == 0) ||
-	      (strncmp(&argv[1][length - 7], ".DDF", 4) == 0))) ||
+	     ((strncmp(&input_file[length - 7], ".ddf", 4) == 0) ||
+	      (strncmp(&input_file[length - 7], ".DDF", 4) == 0))) ||
 	    ((length >= 4) && (gz_flag == 0) &&
-	     ((strcmp(&argv[1][length - 4], ".ddf") == 0) ||
-	      (strcmp(&argv[1][length - 4], ".DDF") == 0))))  {
+	     ((strcmp(&input_file[length - 4], ".ddf") == 0) ||
+	      (strcmp(&input_file[length - 4], ".DDF") == 0))))  {
 		/* SDTS file */
 
 		/* Close the file.  We will reopen it in parse_full_dlg_sdts(). */
 		if (gz_flag == 0)  {
-			buf_close(dlg_fdesc);
+			if (dlg_fdesc >= 0)  {
+				buf_close(dlg_fdesc);
+			}
 		}
 		else  {
 			buf_close_z(dlg_fdesc);
@@ -152,12 +162,12 @@ main(int argc, char *argv[])
 		 * Check that the file name takes the form that we expect.
 		 */
 		if (((gz_flag != 0) &&
-		     ((strncmp(&argv[1][length - 11], "le", 2) != 0) &&
-		      (strncmp(&argv[1][length - 11], "LE", 2) != 0))) ||
+		     ((strncmp(&input_file[length - 11], "le", 2) != 0) &&
+		      (strncmp(&input_file[length - 11], "LE", 2) != 0))) ||
 		    ((gz_flag == 0) &&
-		     (strncmp(&argv[1][length - 8], "le", 2) != 0) &&
-		     (strncmp(&argv[1][length - 8], "LE", 2) != 0)))  {
-			fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.\n", argv[1]);
+		     (strncmp(&input_file[length - 8], "le", 2) != 0) &&
+		     (strncmp(&input_file[length - 8], "LE", 2) != 0)))  {
+			fprintf(stderr, "The file %s looks like an SDTS file, but the name doesn't look right.\n", input_file);
 			exit(0);
 		}
 
@@ -167,17 +177,120 @@ main(int argc, char *argv[])
 		 *
 		 * process_dlg_sdts() will create and write the output file.
 		 */
-		if (argc == 3)  {
-			if (process_dlg_sdts(argv[1], argv[2], gz_flag, (struct image_corners *)0, 0, 1) != 0)  {
+		if (output_name != (char *)0)  {
+			if (process_dlg_sdts(input_file, output_name, gz_flag, (struct image_corners *)0, 0, 1) != 0)  {
 				exit(0);
 			}
 		}
 		else  {
-			if (process_dlg_sdts(argv[1], (char *)0, gz_flag, (struct image_corners *)0, 0, 1) != 0)  {
+			if (process_dlg_sdts(input_file, (char *)0, gz_flag, (struct image_corners *)0, 0, 1) != 0)  {
 				exit(0);
 			}
 		}
 	}
 
+}
+
+
+
+/*
+ * Convert one transfer in batch mode, letting convert()
+ * generate the output file name.
+ */
+static void
+batch_convert(char *input_file)
+{
+	convert(input_file, (char *)0);
+}
+
+
+
+void
+usage(char *program_name)
+{
+	fprintf(stderr, "Usage:  %s ????LE@@.DDF [output_file_name]\n", program_name);
+	fprintf(stderr, "        %s -b [-j num_jobs] [-f list_file] [file_or_directory ...]\n", program_name);
+	fprintf(stderr, "        Where the ???? are alphanumeric characters, and @ represents a digit.\n");
+	fprintf(stderr, "        You can also give the name of a tar archive (.tar, .tar.gz, or .tgz)\n");
+	fprintf(stderr, "        that holds the SDTS files.\n");
+	fprintf(stderr, "        With -b, each argument may be an SDTS file, a tar archive, or a directory\n");
+	fprintf(stderr, "        that is searched for them, and -f names a file that lists more of them,\n");
+	fprintf(stderr, "        one per line (- for the standard input).  The transfers are converted\n");
+	fprintf(stderr, "        num_jobs at a time, and the output files are given the usual names.\n");
+}
+
+
+
+int
+main(int argc, char *argv[])
+{
+	int option;
+	int32_t batch_flag = 0;
+	int32_t num_jobs;
+	char *list_file = (char *)0;
+	extern int optind;
+	extern char *optarg;
+
+
+	if ((argc == 2) && (argv[1][0] == '-') && (argv[1][1] == 'L'))  {
+		license();
+		exit(0);
+	}
+
+	num_jobs = sysconf(_SC_NPROCESSORS_ONLN);	/* Number of transfers to convert at once, in batch mode. */
+	if (num_jobs < 1)  {
+		num_jobs = 1;
+	}
+
+	while ((option = getopt(argc, argv, "bf:j:")) != -1)  {
+		switch(option)  {
+		case 'b':
+			batch_flag = 1;
+			break;
+		case 'f':
+			list_file = optarg;
+			batch_flag = 1;
+			break;
+		case 'j':
+			num_jobs = atoi(optarg);
+			if (num_jobs < 1)  {
+				fprintf(stderr, "The number of jobs specified with -j must be at least 1\n");
+				usage(argv[0]);
+				exit(0);
+			}
+			break;
+		default:
+			usage(argv[0]);
+			exit(0);
+			break;
+		}
+	}
+
+	if (batch_flag == 0)  {
+		if (((argc - optind) != 1) && ((argc - optind) != 2))  {
+			usage(argv[0]);
+			exit(0);
+		}
+		convert(argv[optind], (argc - optind) == 2 ? argv[optind + 1] : (char *)0);
+		exit(0);
+	}
+
+
+	/*
+	 * Batch mode.  Gather up the transfers, and convert them all.
+	 */
+	if ((list_file == (char *)0) && (optind == argc))  {
+		usage(argv[0]);
+		exit(0);
+	}
+	for ( ; optind < argc; optind++)  {
+		(void)batch_add(argv[optind], "LE");
+	}
+	if (list_file != (char *)0)  {
+		(void)batch_add_list(list_file, "LE");
+	}
+	extra_attrib_init();	// Once, here, rather than once in each child.
+	(void)batch_run(num_jobs, batch_convert);
+
 	exit(0);
 }
@@ -27,7 +27,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
-#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "drawmap.h"
 #include "sdts_utils.h"
 
@@ -39,7 +42,7 @@
  * The truly SDTS-specific stuff is handled at a higher layer.
  *
  *
- * There is a lot of code in this file, but only three
+ * There is a lot of code in this file, but only a few
  * functions that are normally used as entry points:
  *
  *	int32_t begin_ddf(char *file_name)
@@ -48,15 +51,84 @@
  *
  *	void end_ddf()
  *
+ *	struct ddf *ddf_open(char *file_name)
+ *
+ *	int32_t ddf_get_subfield(struct ddf *h, struct subfield *subfield)
+ *
+ *	int32_t ddf_bind(struct ddf *h, struct ddf_item *items, int32_t num_items)
+ *
+ *	int32_t get_record(struct ddf *h, struct ddf_item *items, int32_t num_items)
+ *
+ *	void decode_record(struct ddf *h, struct ddf_item *items, int32_t num_items)
+ *
+ *	void ddf_close(struct ddf *h)
+ *
  * Call begin_ddf(), with the name of an SDTS file as argument,
  * to begin parsing an ISO 8211 file.  Call end_ddf() when you are
- * done with that file.  YOU CAN ONLY HAVE ONE FILE OPEN AT ONCE.
+ * done with that file.  begin_ddf() can only have one file open at
+ * once.  If you need more than that, call ddf_open() instead, which
+ * returns a handle (or a null pointer if the file can't be opened).
+ * Each handle carries all of its own state, so you can have as many
+ * open as you like, and read them in any order.  ddf_get_subfield()
+ * is get_subfield() for a handle, and ddf_close() closes the handle.
  *
  * get_subfield() returns the subfields of the file, one at a time.
  * If you call it, and it returns 1, then you have retrieved a
  * subfield.  If it returns 0, you have reached end of file.
  * If there is an error, the function calls exit().
  *
+ * get_subfield() is convenient for the small modules, but it is
+ * slow for the big ones (like the LE?? line modules in a DLG, or
+ * the CEL0 elevation module in a DEM), since the caller has to
+ * compare the tag and label of every subfield it gets back.
+ * For those, the caller can instead describe the subfields
+ * it wants in an array of ddf_item structures, call ddf_bind()
+ * once after ddf_open(), and then call get_record() to
+ * read a whole record at a time.  get_record() converts the
+ * wanted subfields and stores them directly into the caller's
+ * variables, and skips everything else.  It returns 1 when it
+ * has read a record, and 0 at end of file.  decode_record()
+ * decodes the current record again, for callers that need to
+ * make more room for a long record.  (See sdts_utils.h for the
+ * details of struct ddf_item.)
+ *
+ * To make get_record() fast, parse_ddr() compiles each field
+ * description into a decode plan when the file is opened:
+ * the data type of each subfield, and its offset within
+ * the field if all of the subfields before it have fixed
+ * widths.  When a field consists entirely of fixed-width
+ * subfields, get_record() can go straight to each wanted value
+ * without scanning the rest of the field.
+ *
+ * Nothing is allocated on a per-record basis.  The whole file is
+ * held in memory (an uncompressed file is simply mapped, and a
+ * gzip-compressed file is decompressed when it is opened), and
+ * the DRs are used in place, without being copied at all.  The
+ * fields of a DR are described by their positions and lengths,
+ * and are never written into.
+ *
+ * An SDTS transfer consists of a number of modules, and some of
+ * them get read several times while a DLG is processed.  To avoid
+ * loading them over and over, call sdts_open_transfer() to create
+ * a transfer, and then sdts_open_file() to open each module of
+ * the transfer.  A module is loaded the first time it is opened,
+ * and all later handles on it share the copy in memory, until
+ * sdts_close_transfer() is called.  sdts_use_transfer() makes
+ * begin_ddf() open its files the same way, so that code written
+ * for the original interface gets the benefit too.
+ *
+ * SDTS transfers are usually distributed as tar archives (often
+ * gzip-compressed).  A file inside an archive can be opened
+ * without extracting it, by giving the name of the archive
+ * followed by the name of the member, as if the archive were a
+ * directory:  "1234567.DLG.SDTS.TAR.GZ/HY01LE01.DDF".  The archive
+ * is read into memory and indexed the first time one of its
+ * members is opened, and the module simply points at the member's
+ * contents in the archive, so the other modules of the transfer
+ * come straight from memory.  sdts_archive_find() looks through
+ * an archive for a module of a given type, for the programs that
+ * let the user give just the name of the archive.
+ *
  * If you want to try parsing some sample DDF files, there is a
  * commented-out test program at the end of this file which
  * will try to read and print out the contents of a DDF file.
@@ -236,26 +308,6 @@
 
 
 
-/*
- * Some global state variables used by many of the subroutines.
- *
- * Note that the fact that these are global means that we can only
- * have one DDF file open at once.
- *
- * If it becomes necessary to have more than one file open at once,
- * we could put these variables into an array of structures, indexed
- * by the file descriptor.
- */
-static int32_t leaderless_flag;		// When non-zero, we have encountered a record leader with a Leader ID of 'R'
-static char *ddr_buf = (char *)0;	// DDR record buffer.
-static char *dr_buf = (char *)0;	// DR record buffer.
-static int32_t gz_flag;	// If non-zero, we are reading a gzip-compressed file.
-static ssize_t (*read_function)(int, void *, size_t);
-static int fdesc;	// File descriptor of the open DDF file.
-static int32_t dr_tag;	// Next-available field in the DR.
-static int32_t dr_label;	// Next-available subfield in the field.
-
-
 /*
  * SDTS files are organized into records, fields, and subfields.
  * The basic structure of each record, whether it is the DDR, or one of the
@@ -346,6 +398,16 @@ struct ddr_directory  {
 	char cartesian[MAX_SUBFIELDS];	// Cartesian delimiter flag.  If non-zero, the label had a '*' in front of it.
 	int32_t num_labels;	// The number of user subfield labels in the record.
 	int32_t num_formats;	// The number of user subfield formats in the record.
+
+	/*
+	 * The remaining items are the decode plan used by get_record().
+	 * They are filled in by compile_plan(), after the rest of the DDR has been parsed.
+	 */
+	int32_t structure;	// 0 = elementary, 1 = vector, 2 = array.  (See get_subfield().)
+	int32_t cycle;		// Number of subfields before the labels start repeating.
+	char types[MAX_SUBFIELDS];	// Format letter for each subfield ('A', 'I', 'R', 'B', ...), or 0 if there was no format.
+	int32_t offsets[MAX_SUBFIELDS];	// Offset of each subfield from the start of its cycle, or -1 if a delimited subfield precedes it.
+	int32_t cycle_len;	// Bytes in one cycle if every subfield has a fixed width, otherwise 0.
 };
 
 
@@ -354,13 +416,13 @@ struct ddr_directory  {
  * It includes space for the Leader and Directory, but the
  * contents of the Field Area reside in the DDR buffer, ddr_buf.
  */
-static struct ddr  {
+struct ddr  {
 	struct record_leader record_leader;
 	struct ddr_directory f0000;	// DDR Directory entry for file-control entry
 //	struct ddr_directory f0002;	// DDR Directory entry for user-augmented file description (currently unsupported)
 	struct ddr_directory user[MAX_TAGS]; // DDR Directory entry for user data entry
 	int32_t num_tags;		// Total number of field tags stored in user[]
-} ddr;
+};
 
 
 
@@ -378,44 +440,178 @@ struct dr_directory  {
 				// Its length is specified by the Size of Field Length in the record_leader.
 	int32_t field_pos;	// Field Position.  Integer stored as ASCII bytes.  Its length is
 				// specified by the Size of Field Position in the record_leader.
+	int32_t ddr_index;	// Index of the DDR Directory entry that describes this field.
 };
 
 
 /*
  * This is a structure for the DR contents.
  * It includes space for the Leader and Directory, but the
- * contents of the Field Area reside in the DR buffer, dr_buf.
+ * contents of the Field Area reside in the module image.
+ *
+ * Nothing ever writes into the image.  The fields are described
+ * by (position, length) pairs in the Directory entries, and the
+ * tags point at the (null-terminated) copies in the DDR.
  */
-static struct dr  {
+struct dr  {
 	struct record_leader record_leader;
 	struct dr_directory user[MAX_TAGS]; // DR Directory entries
 	int32_t num_tags;		// Total number of field tags stored in user[]
-} dr;
+	char *field_area;		// Start of the Field Area of the current record.
+};
+
+
+
+/*
+ * A tar archive, held in memory, and an index of the ordinary files
+ * in it.  Modules that are read from the archive point straight into
+ * the archive's image, so the archive is kept until the last of them
+ * has been freed.  (See open_archive().)
+ */
+#define TAR_BLOCK	512
+
+struct tar_member  {
+	char *name;		// The member's name, including any directories.
+	int32_t offset;		// Offset of the member's contents in the archive image.
+	int32_t size;		// Size of the member's contents, in bytes.
+};
+
+struct tar_archive  {
+	char *file_name;
+	char *image;		// The contents of the archive.
+	int32_t size;
+	int32_t mapped;		// Non-zero if image was mapped, rather than malloc()ed.
+	struct tar_member *members;
+	int32_t num_members;
+	int32_t refs;		// Number of modules that point into the image.
+	struct tar_archive *next;
+};
+
+static struct tar_archive *archives = (struct tar_archive *)0;
+
+
+
+/*
+ * A module is the whole of one DDF file, held in memory, along with
+ * its parsed DDR.  Uncompressed files are mapped with mmap(), and
+ * gzip-compressed files are decompressed into a malloc()ed buffer
+ * when they are opened.  Once the DDR has been parsed, nothing
+ * writes into a module again, so any number of DDF handles can
+ * read the same module at once.
+ */
+struct ddf_module  {
+	char *file_name;	// The name the module was opened with.
+	char *image;		// The contents of the file.
+	int32_t size;		// The size of the file, in bytes.
+	int32_t mapped;		// Non-zero if image was mapped, rather than malloc()ed.
+	struct tar_archive *archive;	// The archive that holds the image, or null if the module has its own.
+	char *ddr_buf;		// A private copy of the DDR, which parse_ddr() carves up.
+	struct ddr ddr;
+	int32_t dr_start;	// Offset of the first DR in the image.
+	struct ddf_module *next;	// The next module in the transfer's list.
+};
+
+
+
+/*
+ * A DDF handle is a read position in a module, along with
+ * everything get_subfield() and get_record() need to remember
+ * from one call to the next.  Each handle has its own state, so
+ * several handles may be open at once, and handles on different
+ * modules (or on the same module) can be read in any order, or
+ * by different threads.  (Opening and closing modules is not
+ * thread-safe, however, since the gzip code keeps global state.)
+ */
+struct ddf  {
+	struct ddf_module *module;
+	int32_t own_module;	// Non-zero if ddf_close() should free the module too.
+	int32_t pos;		// Offset, in the image, of the next record.
+	int32_t leaderless_flag;	// When non-zero, we have encountered a record leader with a Leader ID of 'R'
+	int32_t leaderless_pos;		// Offset of the record with the 'R' Leader ID (or -1 if none yet).
+	int32_t leaderless_start;	// Offset of the first bare Field Area that follows that record.
+	struct dr dr;		// The current DR.
+	int32_t dr_tag;		// Next-available field in the DR.
+	int32_t dr_label;	// Next-available subfield in the field.
+	int32_t data_index;	// get_subfield()'s position in the Field Area of the current DR.
+	char *value_buf;	// Holds the null-terminated copies of get_subfield() values.
+	int32_t value_buf_size;
+	int32_t bound[MAX_TAGS][MAX_SUBFIELDS];	// Index of the ddf_item bound to each subfield, or -1.
+	int32_t num_bound[MAX_TAGS];	// Number of subfields in each field with an item bound to them.
+};
+
 
 
+/*
+ * A transfer is the set of modules that make up one SDTS transfer.
+ * Modules are loaded (and their DDRs parsed) the first time they
+ * are opened, and then kept until the transfer is closed, so
+ * that opening the same module again costs almost nothing.
+ */
+struct sdts_transfer  {
+	struct ddf_module *modules;	// The modules loaded so far.
+};
+
+
+
+/*
+ * The state behind the original, one-file-at-a-time interface:
+ * begin_ddf(), get_subfield(), and end_ddf().  If a transfer is
+ * in use (see sdts_use_transfer()), then begin_ddf() gets its
+ * modules from the transfer.
+ */
+static struct ddf *current_ddf = (struct ddf *)0;
+static struct sdts_transfer *current_transfer = (struct sdts_transfer *)0;
+
 
 
 /*
- * Read in an ISO 8211 record.
- * Fill in the record leader structure.
+ * Convert a fixed-width ASCII number (a record length, or a Directory
+ * entry) into an integer, without needing a null terminator.
+ * Leading blanks are skipped, as strtol() would do.
  */
 static int32_t
-read_record(struct record_leader *record_leader, char **rec_buf)
+ddf_number(char *ptr, int32_t length)
 {
 	int32_t i;
-	char tmp[REC_LEN_LEN + 1];
-	char *ptr;
-	ssize_t ret_val;
-	char save_byte;
+	int32_t value = 0;
+
+	for (i = 0; (i < length) && (ptr[i] == ' '); i++);
+	for ( ; (i < length) && (ptr[i] >= '0') && (ptr[i] <= '9'); i++)  {
+		value = value * 10 + ptr[i] - '0';
+	}
+
+	return value;
+}
+
+
+
+
+/*
+ * Parse the leader of the ISO 8211 record that starts at offset pos
+ * in the module image, and fill in the record leader structure.
+ * The record itself stays where it is, in the image.
+ *
+ * Returns the length of the record, 0 at end of file,
+ * or -1 if there is an error.
+ */
+static int32_t
+read_record(struct ddf_module *module, int32_t pos, struct record_leader *record_leader)
+{
+	int32_t i;
+	char *rec;
+	int32_t avail;
 	int32_t long_record_flag = 0;
 	int32_t field_pos, field_len;
 
+	rec = module->image + pos;
+	avail = module->size - pos;
+
 	/*
-	 * Read in the record length, which is the first thing in the
+	 * Get the record length, which is the first thing in the
 	 * record.
 	 */
-	if ((ret_val = read_function(fdesc, tmp, REC_LEN_LEN)) != REC_LEN_LEN)  {
-		if (ret_val == 0)  {
+	if (avail < REC_LEN_LEN)  {
+		if (avail == 0)  {
 			return 0;
 		}
 		else  {
@@ -423,8 +619,7 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 			return -1;
 		}
 	}
-	tmp[REC_LEN_LEN] = '\0';
-	record_leader->length = strtol(tmp, (char **)0, 10);
+	record_leader->length = ddf_number(rec, REC_LEN_LEN);
 	if (record_leader->length == 0)  {
 		/*
 		 * Note: If the record length is zero, then that means the
@@ -440,17 +635,17 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 		 * However, before we give do this, make sure that
 		 * the record length is actually zero.  There may be
 		 * non-numeric characters where the record length is supposed
-		 * to be.  strtol() will ignore these and return zero, which
+		 * to be.  ddf_number() will ignore these and return zero, which
 		 * isn't strictly-speaking the correct interpretation of
 		 * a garbage-filled record length.
 		 */
 		for (i = 0; i < REC_LEN_LEN; i++) {
 			/* Check for leading blanks. */
-			if (tmp[i] != ' ') break;
+			if (rec[i] != ' ') break;
 		}
 		for ( ; i < REC_LEN_LEN; i++)  {
 			/* Check for all zeros, following the blanks. */
-			if (tmp[i] != '0') break;
+			if (rec[i] != '0') break;
 		}
 		if (i < REC_LEN_LEN)  {
 			fprintf(stderr, "Warning: Record length is nonsensical.  Assuming end of file.\n");
@@ -466,73 +661,57 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 	}
 
 	/*
-	 * Get space for the record, copy the already-read record length
-	 * into the beginning of the space, and read the remainder of the record.
-	 * (Or read just the Leader, if this is a long record.)
+	 * Check that the remainder of the record is present.
+	 * (Or just the Leader, if this is a long record.)
 	 */
-	if ((*rec_buf = (char *)malloc(record_leader->length + 1)) == (char *)0)  {
-		fprintf(stderr, "malloc(%d) returns null.\n", record_leader->length + 1);
+	if (avail < record_leader->length)  {
+		fprintf(stderr, "Couldn't read SDTS record.  Ret_val = %d.\n", avail - REC_LEN_LEN);
 		return -1;
 	}
-	for (i = 0; i < REC_LEN_LEN; i++)  {
-		(*rec_buf)[i] = tmp[i];
-	}
-	if ((ret_val = read_function(fdesc, *rec_buf + REC_LEN_LEN, record_leader->length - REC_LEN_LEN)) !=
-									(record_leader->length - REC_LEN_LEN))  {
-		fprintf(stderr, "Couldn't read SDTS record.  Ret_val = %d.\n", (int)ret_val);
-		free(*rec_buf);
-		return -1;
-	}
-	(*rec_buf)[record_leader->length] = '\0';	// Not really necessary, but I like to do it.
 
 
 	/*
 	 * Parse the record leader and put the results into the
 	 * record_leader structure.
 	 */
-	if ((*rec_buf)[REC_LEN_LEN] == ' ')  {	// The Interchange Level is a single digit, or blank
+	if (rec[REC_LEN_LEN] == ' ')  {	// The Interchange Level is a single digit, or blank
 		record_leader->ichg_level = -1;
 	}
 	else  {
-		record_leader->ichg_level = (*rec_buf)[REC_LEN_LEN] - '0';
+		record_leader->ichg_level = rec[REC_LEN_LEN] - '0';
 	}
-	record_leader->leader_id = (*rec_buf)[REC_LEN_LEN + 1];	// Leader Identifier.  A single ASCII byte.  'L' for DDR, 'D' or 'R' for DR.
-	record_leader->ice_ind = (*rec_buf)[REC_LEN_LEN + 2];		// Inline Code Extension.  A single ASCII byte.
-	record_leader->reserved_space = (*rec_buf)[REC_LEN_LEN + 3];	// Reserved Space.  A single ASCII byte.
-	record_leader->application = (*rec_buf)[REC_LEN_LEN + 4];	// Application Indicator.  A single ASCII byte.
-	if ((*rec_buf)[REC_LEN_LEN + 6] == ' ')  {	// Field Control Indicator.  Integer stored as two ASCII bytes.
+	record_leader->leader_id = rec[REC_LEN_LEN + 1];	// Leader Identifier.  A single ASCII byte.  'L' for DDR, 'D' or 'R' for DR.
+	record_leader->ice_ind = rec[REC_LEN_LEN + 2];		// Inline Code Extension.  A single ASCII byte.
+	record_leader->reserved_space = rec[REC_LEN_LEN + 3];	// Reserved Space.  A single ASCII byte.
+	record_leader->application = rec[REC_LEN_LEN + 4];	// Application Indicator.  A single ASCII byte.
+	if (rec[REC_LEN_LEN + 6] == ' ')  {	// Field Control Indicator.  Integer stored as two ASCII bytes.
 		record_leader->field_cntrl_len = -1;
 	}
 	else  {
-		record_leader->field_cntrl_len = ((*rec_buf)[REC_LEN_LEN + 5] - '0') * 10 + (*rec_buf)[REC_LEN_LEN + 6] - '0';
-	}
-	save_byte = (*rec_buf)[REC_LEN_LEN + 12]; (*rec_buf)[REC_LEN_LEN + 12] = '\0';
-	record_leader->fa_addr = strtol(*rec_buf + REC_LEN_LEN + 7, (char **)0, 10);	// Base address of Field Area.  Integer stored as 5 ASCII bytes.
-	(*rec_buf)[REC_LEN_LEN + 12] = save_byte;
-	record_leader->ccs[0] = (*rec_buf)[REC_LEN_LEN + 12];	// Code Character Set Indicator.  Three ASCII bytes.
-	record_leader->ccs[1] = (*rec_buf)[REC_LEN_LEN + 13];
-	record_leader->ccs[2] = (*rec_buf)[REC_LEN_LEN + 14];
-	record_leader->field_len_len = (*rec_buf)[REC_LEN_LEN + 15] - '0';	// Size of Field Length.  Integer stored as one ASCII byte.  (1 <= length <=9)
+		record_leader->field_cntrl_len = (rec[REC_LEN_LEN + 5] - '0') * 10 + rec[REC_LEN_LEN + 6] - '0';
+	}
+	record_leader->fa_addr = ddf_number(rec + REC_LEN_LEN + 7, 5);	// Base address of Field Area.  Integer stored as 5 ASCII bytes.
+	record_leader->ccs[0] = rec[REC_LEN_LEN + 12];	// Code Character Set Indicator.  Three ASCII bytes.
+	record_leader->ccs[1] = rec[REC_LEN_LEN + 13];
+	record_leader->ccs[2] = rec[REC_LEN_LEN + 14];
+	record_leader->field_len_len = rec[REC_LEN_LEN + 15] - '0';	// Size of Field Length.  Integer stored as one ASCII byte.  (1 <= length <=9)
 	if ((record_leader->field_len_len < 1) || (record_leader->field_len_len > 9))  {
-		free(*rec_buf);
 		fprintf(stderr, "Field length length in record leader (%d) is out of bounds.\n", record_leader->field_len_len);
 		return -1;
 	}
-	record_leader->field_pos_len = (*rec_buf)[REC_LEN_LEN + 16] - '0';	// Size of Field Position.  Integer stored as one ASCII byte.  (1 <= length <=9)
+	record_leader->field_pos_len = rec[REC_LEN_LEN + 16] - '0';	// Size of Field Position.  Integer stored as one ASCII byte.  (1 <= length <=9)
 	if ((record_leader->field_pos_len < 1) || (record_leader->field_pos_len > 9))  {
-		free(*rec_buf);
 		fprintf(stderr, "Field position length in record leader (%d) is out of bounds.\n", record_leader->field_pos_len);
 		return -1;
 	}
-	if ((*rec_buf)[REC_LEN_LEN + 17] != ' ')  {
-		record_leader->reserved_digit = (*rec_buf)[REC_LEN_LEN + 17] - '0';	// Reserved Digit.  Integer stored as one ASCII byte.
+	if (rec[REC_LEN_LEN + 17] != ' ')  {
+		record_leader->reserved_digit = rec[REC_LEN_LEN + 17] - '0';	// Reserved Digit.  Integer stored as one ASCII byte.
 	}
 	else  {
 		record_leader->reserved_digit = -1;	// Reserved Digit.  Integer stored as one ASCII byte.
 	}
-	record_leader->field_tag_len = (*rec_buf)[REC_LEN_LEN + 18] - '0';	// Size of Field Tag.  Integer stored as one ASCII byte.  (1 <= length <=7)
+	record_leader->field_tag_len = rec[REC_LEN_LEN + 18] - '0';	// Size of Field Tag.  Integer stored as one ASCII byte.  (1 <= length <=7)
 	if ((record_leader->field_tag_len < 1) || (record_leader->field_tag_len > 7))  {
-		free(*rec_buf);
 		fprintf(stderr, "Field tag length in record leader (%d) is out of bounds.\n", record_leader->field_tag_len);
 		return -1;
 	}
@@ -541,32 +720,17 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 		/*
 		 * The record is longer than 100000 bytes.  Get the record the hard way.
 		 *
-		 * Start by re-sizing the record buffer to 100000 bytes, since
-		 * we know the record must be at least that long.
-		 */
-		if ((ptr = (char *)realloc(*rec_buf, 100000)) == (char *)0)  {
-			free(*rec_buf);
-			fprintf(stderr, "realloc(100000) returns null.\n");
-			return -1;
-		}
-		*rec_buf = ptr;
-
-		/*
-		 * Now search after the Leader to find the first FIELD_TERMINATOR.
+		 * Search after the Leader to find the first FIELD_TERMINATOR.
 		 * This should be the end of the Directory.
 		 */
-		i = REC_LEADER_LEN;
-		while (((ret_val = read_function(fdesc, *rec_buf + i, 1)) == 1) && ((*rec_buf)[i] != FIELD_TERMINATOR))  {
-			i++;
+		for (i = REC_LEADER_LEN; (i < avail) && (rec[i] != FIELD_TERMINATOR); i++)  {
 			if (i == 100000)  {
 				fprintf(stderr, "Failed to find end of Directory in first 100000 bytes.  This seems implausible.  Giving up.\n");
-				free(*rec_buf);
 				return -1;
 			}
 		}
-		if (ret_val != 1)  {
-			fprintf(stderr, "Couldn't read SDTS record.  Ret_val = %d.\n", (int)ret_val);
-			free(*rec_buf);
+		if (i == avail)  {
+			fprintf(stderr, "Couldn't read SDTS record.  Ret_val = 0.\n");
 			return -1;
 		}
 
@@ -575,39 +739,20 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 		 * We need to backtrack from here to determine the last Field Length Length
 		 * and Field Position Length in the Directory.
 		 */
-		save_byte = (*rec_buf)[i]; (*rec_buf)[i] = '\0';
-		field_pos = strtol(*rec_buf + i - record_leader->field_pos_len, (char **)0, 10);
-		(*rec_buf)[i] = save_byte;
-		save_byte = (*rec_buf)[i - record_leader->field_pos_len]; (*rec_buf)[i - record_leader->field_pos_len] = '\0';
-		field_len = strtol(*rec_buf + i - record_leader->field_pos_len - record_leader->field_len_len, (char **)0, 10);
-		(*rec_buf)[i - record_leader->field_pos_len] = save_byte;
+		field_pos = ddf_number(rec + i - record_leader->field_pos_len, record_leader->field_pos_len);
+		field_len = ddf_number(rec + i - record_leader->field_pos_len - record_leader->field_len_len, record_leader->field_len_len);
 
 		/*
-		 * Now we have what we need to figure out the
-		 * record length.  Figure it out and then re-size the
-		 * buffer accordingly.
+		 * Now we have what we need to figure out the record length.
+		 * Check that the remainder of the record, which consists of
+		 * the Field Area, is present.
 		 */
 		record_leader->length = record_leader->fa_addr + field_pos + field_len;
-		if ((ptr = (char *)realloc(*rec_buf, record_leader->length + 1)) == (char *)0)  {
-			free(*rec_buf);
-			fprintf(stderr, "realloc(%d) returns null.\n", record_leader->length + 1);
-			return -1;
-		}
-		*rec_buf = ptr;
-
-		/*
-		 * Now, at last, we are ready to read in the remainder of the record.
-		 * The remainder consists of the Field Area, since we have already read in
-		 * the Leader and the Directory.
-		 */
-		if ((ret_val = read_function(fdesc, *rec_buf + i + 1, record_leader->length - i - 1)) !=
-									(record_leader->length - i - 1))  {
-			fprintf(stderr, "Couldn't read SDTS record.  Ret_val = %d.\n", (int)ret_val);
-			free(*rec_buf);
+		if (avail < record_leader->length)  {
+			fprintf(stderr, "Couldn't read SDTS record.  Ret_val = %d.\n", avail - i - 1);
 			return -1;
 		}
 	}
-	(*rec_buf)[record_leader->length] = '\0';	// Not really necessary, but I like to do it.
 
 	return record_leader->length;
 }
@@ -616,69 +761,75 @@ read_record(struct record_leader *record_leader, char **rec_buf)
 
 
 /*
- * For testing purposes, print an SDTS DDR record structure.
+ * For testing purposes, print the DDR of the file opened with begin_ddf().
  */
 void
 print_ddr()
 {
 	int32_t i;
 	int32_t j;
+	struct ddr *ddr;
+
+	if (current_ddf == (struct ddf *)0)  {
+		return;
+	}
+	ddr = &current_ddf->module->ddr;
 
-	fprintf(stderr, "ddr.record_leader.length = %d\n", ddr.record_leader.length);
-	fprintf(stderr, "ddr.record_leader.ichg_level = %d\n", ddr.record_leader.ichg_level);
-	if (ddr.record_leader.ichg_level >= 0)  {
-		if ((ddr.record_leader.ichg_level < 1) || (ddr.record_leader.ichg_level > 3))  {
-			fprintf(stderr, "Bad interchange level in DDR = %d.\n", ddr.record_leader.ichg_level);
+	fprintf(stderr, "ddr->record_leader.length = %d\n", ddr->record_leader.length);
+	fprintf(stderr, "ddr->record_leader.ichg_level = %d\n", ddr->record_leader.ichg_level);
+	if (ddr->record_leader.ichg_level >= 0)  {
+		if ((ddr->record_leader.ichg_level < 1) || (ddr->record_leader.ichg_level > 3))  {
+			fprintf(stderr, "Bad interchange level in DDR = %d.\n", ddr->record_leader.ichg_level);
 			exit(0);
 		}
 	}
-	fprintf(stderr, "ddr.record_leader.leader_id = \"%c\"\n", ddr.record_leader.leader_id);
-	fprintf(stderr, "ddr.record_leader.ice_ind = \"%c\"\n", ddr.record_leader.ice_ind);
-	fprintf(stderr, "ddr.record_leader.reserved_space = \"%c\"\n", ddr.record_leader.reserved_space);
-	fprintf(stderr, "ddr.record_leader.application = \"%c\"\n", ddr.record_leader.application);
-	fprintf(stderr, "ddr.record_leader.field_cntrl_len = %d\n", ddr.record_leader.field_cntrl_len);
-	if (ddr.record_leader.ichg_level >= 0)  {
-		if (((ddr.record_leader.ichg_level == 1) && (ddr.record_leader.field_cntrl_len != 0)) ||
-		    ((ddr.record_leader.ichg_level == 2) && (ddr.record_leader.field_cntrl_len != 6)) ||
-		    ((ddr.record_leader.ichg_level == 3) && (ddr.record_leader.field_cntrl_len != 6)))  {
-			fprintf(stderr, "Bad field control length in DDR = %d.\n", ddr.record_leader.field_cntrl_len);
+	fprintf(stderr, "ddr->record_leader.leader_id = \"%c\"\n", ddr->record_leader.leader_id);
+	fprintf(stderr, "ddr->record_leader.ice_ind = \"%c\"\n", ddr->record_leader.ice_ind);
+	fprintf(stderr, "ddr->record_leader.reserved_space = \"%c\"\n", ddr->record_leader.reserved_space);
+	fprintf(stderr, "ddr->record_leader.application = \"%c\"\n", ddr->record_leader.application);
+	fprintf(stderr, "ddr->record_leader.field_cntrl_len = %d\n", ddr->record_leader.field_cntrl_len);
+	if (ddr->record_leader.ichg_level >= 0)  {
+		if (((ddr->record_leader.ichg_level == 1) && (ddr->record_leader.field_cntrl_len != 0)) ||
+		    ((ddr->record_leader.ichg_level == 2) && (ddr->record_leader.field_cntrl_len != 6)) ||
+		    ((ddr->record_leader.ichg_level == 3) && (ddr->record_leader.field_cntrl_len != 6)))  {
+			fprintf(stderr, "Bad field control length in DDR = %d.\n", ddr->record_leader.field_cntrl_len);
 			exit(0);
 		}
 	}
-	fprintf(stderr, "ddr.record_leader.fa_addr = %d\n", ddr.record_leader.fa_addr);
-	if (ddr.record_leader.fa_addr < REC_LEADER_LEN)  {
-		fprintf(stderr, "Bad DDA address in DDR = %d.\n", ddr.record_leader.fa_addr);
+	fprintf(stderr, "ddr->record_leader.fa_addr = %d\n", ddr->record_leader.fa_addr);
+	if (ddr->record_leader.fa_addr < REC_LEADER_LEN)  {
+		fprintf(stderr, "Bad DDA address in DDR = %d.\n", ddr->record_leader.fa_addr);
 		exit(0);
 	}
-	fprintf(stderr, "ddr.record_leader.ccs = \"%c%c%c\"\n", ddr.record_leader.ccs[0], ddr.record_leader.ccs[1], ddr.record_leader.ccs[2]);
-	fprintf(stderr, "ddr.record_leader.field_len_len = %d\n", ddr.record_leader.field_len_len);
-	fprintf(stderr, "ddr.record_leader.field_pos_len = %d\n", ddr.record_leader.field_pos_len);
-	fprintf(stderr, "ddr.record_leader.reserved_digit = %d\n", ddr.record_leader.reserved_digit);
-	fprintf(stderr, "ddr.record_leader.field_tag_len = %d\n", ddr.record_leader.field_tag_len);
+	fprintf(stderr, "ddr->record_leader.ccs = \"%c%c%c\"\n", ddr->record_leader.ccs[0], ddr->record_leader.ccs[1], ddr->record_leader.ccs[2]);
+	fprintf(stderr, "ddr->record_leader.field_len_len = %d\n", ddr->record_leader.field_len_len);
+	fprintf(stderr, "ddr->record_leader.field_pos_len = %d\n", ddr->record_leader.field_pos_len);
+	fprintf(stderr, "ddr->record_leader.reserved_digit = %d\n", ddr->record_leader.reserved_digit);
+	fprintf(stderr, "ddr->record_leader.field_tag_len = %d\n", ddr->record_leader.field_tag_len);
 	fprintf(stderr, "\n");
 
-	if (ddr.f0000.tag == (char *)0)  {
-		fprintf(stderr, "ddr.f0000 did not appear\n");
+	if (ddr->f0000.tag == (char *)0)  {
+		fprintf(stderr, "ddr->f0000 did not appear\n");
 	}
 	else  {
-		fprintf(stderr, "ddr.f0000.tag = \"%.*s\"\n", ddr.record_leader.field_tag_len, ddr.f0000.tag);
-		fprintf(stderr, "ddr.f0000.field_len = %d\n", ddr.f0000.field_len);
-		fprintf(stderr, "ddr.f0000.field_pos = %d\n", ddr.f0000.field_pos);
-		fprintf(stderr, "ddr.f0000.field_cntrl = \"%.*s\"\n", ddr.record_leader.ichg_level > 1 ? 6 : 0, ddr.f0000.field_cntrl);
-		fprintf(stderr, "ddr.f0000.name = \"%s\"\n", ddr.f0000.name);
+		fprintf(stderr, "ddr->f0000.tag = \"%.*s\"\n", ddr->record_leader.field_tag_len, ddr->f0000.tag);
+		fprintf(stderr, "ddr->f0000.field_len = %d\n", ddr->f0000.field_len);
+		fprintf(stderr, "ddr->f0000.field_pos = %d\n", ddr->f0000.field_pos);
+		fprintf(stderr, "ddr->f0000.field_cntrl = \"%.*s\"\n", ddr->record_leader.ichg_level > 1 ? 6 : 0, ddr->f0000.field_cntrl);
+		fprintf(stderr, "ddr->f0000.name = \"%s\"\n", ddr->f0000.name);
 	}
 	fprintf(stderr, "\n");
 
-	for (i = 0; i < ddr.num_tags; i++)  {
-		fprintf(stderr, "ddr.user[%d].tag = \"%.*s\"\n", i, ddr.record_leader.field_tag_len, ddr.user[i].tag);
-		fprintf(stderr, "ddr.user[%d].field_len = %d\n", i, ddr.user[i].field_len);
-		fprintf(stderr, "ddr.user[%d].field_pos = %d\n", i, ddr.user[i].field_pos);
-		fprintf(stderr, "ddr.user[%d].field_cntrl = \"%.*s\"\n", i, ddr.record_leader.ichg_level > 1 ? 6 : 0, ddr.user[i].field_cntrl);
-		fprintf(stderr, "ddr.user[%d].name = \"%s\"\n", i, ddr.user[i].name);
+	for (i = 0; i < ddr->num_tags; i++)  {
+		fprintf(stderr, "ddr->user[%d].tag = \"%.*s\"\n", i, ddr->record_leader.field_tag_len, ddr->user[i].tag);
+		fprintf(stderr, "ddr->user[%d].field_len = %d\n", i, ddr->user[i].field_len);
+		fprintf(stderr, "ddr->user[%d].field_pos = %d\n", i, ddr->user[i].field_pos);
+		fprintf(stderr, "ddr->user[%d].field_cntrl = \"%.*s\"\n", i, ddr->record_leader.ichg_level > 1 ? 6 : 0, ddr->user[i].field_cntrl);
+		fprintf(stderr, "ddr->user[%d].name = \"%s\"\n", i, ddr->user[i].name);
 
-		for (j = 0; j < ddr.user[i].num_labels; j++)  {
-			fprintf(stderr, "ddr.user[%d].labels[%d] = \"%s\"\n", i, j, ddr.user[i].labels[j]);
-			fprintf(stderr, "ddr.user[%d].formats[%d] = \"%s\"\n", i, j, ddr.user[i].formats[j]);
+		for (j = 0; j < ddr->user[i].num_labels; j++)  {
+			fprintf(stderr, "ddr->user[%d].labels[%d] = \"%s\"\n", i, j, ddr->user[i].labels[j]);
+			fprintf(stderr, "ddr->user[%d].formats[%d] = \"%s\"\n", i, j, ddr->user[i].formats[j]);
 		}
 
 		fprintf(stderr, "\n");
@@ -689,12 +840,85 @@ print_ddr()
 
 
 
+/*
+ * Compile the field descriptions in the DDR into a decode plan for get_record().
+ *
+ * For each field, we work out the structure type (using the same rules
+ * as get_subfield()), the number of subfields before the labels start
+ * repeating, and the data type of each subfield.  For each subfield
+ * we also record its offset from the start of the repeating cycle,
+ * provided that all of the subfields in front of it have fixed widths.
+ * If every subfield in the cycle has a fixed width, then the field is
+ * just an array of identical fixed-size cycles (the SADR coordinates
+ * in a DLG, or the CVLS elevations in a DEM), and get_record() can
+ * index directly to each value it wants.
+ *
+ * This is only done once per file, when the DDR is read, rather than
+ * every time a subfield is fetched.
+ */
+static void
+compile_plan(struct ddr *ddr)
+{
+	int32_t i;
+	int32_t k;
+	int32_t offset;
+	char type;
+	struct ddr_directory *d;
+
+	for (i = 0; i < ddr->num_tags; i++)  {
+		d = &ddr->user[i];
+
+		if ((ddr->record_leader.ichg_level == -1) || (ddr->record_leader.ichg_level == 1) || (d->field_cntrl[0] == '0'))  {
+			d->structure = 0;
+			d->cycle = 1;
+		}
+		else if (d->field_cntrl[0] == '1')  {
+			d->structure = 1;
+			d->cycle = d->num_labels > 0 ? d->num_labels : 1;
+		}
+		else if (d->field_cntrl[0] == '2')  {
+			d->structure = 2;
+			d->cycle = d->num_labels > d->num_formats ? d->num_labels : d->num_formats;
+			if (d->cycle == 0)  {
+				d->cycle = 1;
+			}
+		}
+		else  {
+			/* We don't know how to decode this.  decode_field() will complain if anyone asks for it. */
+			d->structure = -1;
+			d->cycle = 1;
+		}
+
+		offset = 0;
+		for (k = 0; k < d->cycle; k++)  {
+			type = d->formats[k][0];
+			if ((type >= 'a') && (type <= 'z'))  {
+				type = type - 'a' + 'A';
+			}
+			d->types[k] = type;
+
+			d->offsets[k] = offset;
+			if ((offset >= 0) && (d->sizes[k] > 0) && (d->structure != 0))  {
+				offset = offset + d->sizes[k];
+			}
+			else  {
+				offset = -1;
+			}
+		}
+		d->cycle_len = offset > 0 ? offset : 0;
+	}
+}
+
+
+
+
+
 /*
  * Parse the DDR record and put all of the
  * information into the DDR structure.
  *
  * We have already parsed the record leader, in the read_record() function.
- * The values have been stored away in ddr.record_leader.
+ * The values have been stored away in ddr->record_leader.
  * This was done separately because the leader always has the same
  * interpretation for every record, and we can parse and check it
  * right after reading any record.
@@ -734,7 +958,7 @@ print_ddr()
  * parts of the ddr structure.
  */
 static void
-parse_ddr()
+parse_ddr(struct ddf_module *module)
 {
 	int32_t i;		// We use this as an index into the Directory
 	int32_t j;		// We use this as an index into the Field Area
@@ -743,17 +967,32 @@ parse_ddr()
 	int32_t repeat_count;
 	char save_byte;
 	char *ptr, *end_ptr;
-	ssize_t ret_val;
+	int32_t ret_val;
+	struct ddr *ddr = &module->ddr;
+	char *ddr_buf;
 
-	if ((ret_val = read_record(&(ddr.record_leader), &ddr_buf)) <= 0)  {
+	if ((ret_val = read_record(module, 0, &(ddr->record_leader))) <= 0)  {
 		/* If ret_val is < 0, read_record() already printed an error message. */
 		if (ret_val == 0)  {
 			fprintf(stderr, "At end of file, reading DDR.  This should not happen.\n");
 		}
 		exit(0);
 	}
-	if (ddr.record_leader.leader_id != 'L')  {
-		fprintf(stderr, "DDR Leader ID is '%c'.  Can't handle this.\n", ddr.record_leader.leader_id);
+
+	/*
+	 * Make a private copy of the DDR, since we are about to
+	 * null-terminate all of the strings in it.
+	 */
+	if ((ddr_buf = (char *)malloc(ret_val + 1)) == (char *)0)  {
+		fprintf(stderr, "malloc(%d) returns null.\n", ret_val + 1);
+		exit(0);
+	}
+	memcpy(ddr_buf, module->image, ret_val);
+	ddr_buf[ret_val] = '\0';	// Not really necessary, but I like to do it.
+	module->ddr_buf = ddr_buf;
+	module->dr_start = ret_val;
+	if (ddr->record_leader.leader_id != 'L')  {
+		fprintf(stderr, "DDR Leader ID is '%c'.  Can't handle this.\n", ddr->record_leader.leader_id);
 		exit(0);
 	}
 	/*
@@ -765,14 +1004,14 @@ parse_ddr()
 	 */
 
 	i = REC_LEADER_LEN;			// Start of DDR Directory
-	j = ddr.record_leader.fa_addr;	// Start of Field Area
+	j = ddr->record_leader.fa_addr;	// Start of Field Area
 
 	/* Initialize so that we know nothing is initially present. */
-	ddr.f0000.tag = (char *)0;
-	ddr.f0000.name = (char *)0;
-	ddr.f0000.field_cntrl = (char *)0;
-	ddr.f0000.num_labels = 0;
-	ddr.num_tags = 0;
+	ddr->f0000.tag = (char *)0;
+	ddr->f0000.name = (char *)0;
+	ddr->f0000.field_cntrl = (char *)0;
+	ddr->f0000.num_labels = 0;
+	ddr->num_tags = 0;
 
 	/*
 	 * First we examine the field tag to find out if it is one of the special
@@ -782,39 +1021,39 @@ parse_ddr()
 	 * as far as I know, without a copy of the standard), we play some pointer games
 	 * and index into the comparison strings to get comparison strings of the
 	 * correct length.  This gives us the odd-looking construct:
-	 * "0000002" + 7 - ddr.record_leader.field_tag_len
+	 * "0000002" + 7 - ddr->record_leader.field_tag_len
 	 * If the tag length is 4, then we are really comparing against "0002".
 	 */
-	while (i < (ddr.record_leader.fa_addr - 1))  {
-		if (strncmp(&ddr_buf[i], "0000000", ddr.record_leader.field_tag_len) == 0)  {
+	while (i < (ddr->record_leader.fa_addr - 1))  {
+		if (strncmp(&ddr_buf[i], "0000000", ddr->record_leader.field_tag_len) == 0)  {
 			/* This is a file-control tag. */
-			ddr.f0000.tag = &ddr_buf[i];
-			i = i + ddr.record_leader.field_tag_len;
+			ddr->f0000.tag = &ddr_buf[i];
+			i = i + ddr->record_leader.field_tag_len;
 
 			k = i;
-			save_byte = ddr_buf[i + ddr.record_leader.field_len_len];
-			ddr_buf[i + ddr.record_leader.field_len_len] = '\0';
-			ddr.f0000.field_len = strtol(&ddr_buf[i], (char **)0, 10);
-			ddr_buf[i + ddr.record_leader.field_len_len] = save_byte;
-			i = i + ddr.record_leader.field_len_len;
+			save_byte = ddr_buf[i + ddr->record_leader.field_len_len];
+			ddr_buf[i + ddr->record_leader.field_len_len] = '\0';
+			ddr->f0000.field_len = strtol(&ddr_buf[i], (char **)0, 10);
+			ddr_buf[i + ddr->record_leader.field_len_len] = save_byte;
+			i = i + ddr->record_leader.field_len_len;
 			ddr_buf[k] = '\0';	// Null-terminate tag.
 
-			save_byte = ddr_buf[i + ddr.record_leader.field_pos_len];
-			ddr_buf[i + ddr.record_leader.field_pos_len] = '\0';
-			ddr.f0000.field_pos = strtol(&ddr_buf[i], (char **)0, 10);
-			ddr_buf[i + ddr.record_leader.field_pos_len] = save_byte;
-			i = i + ddr.record_leader.field_pos_len;
+			save_byte = ddr_buf[i + ddr->record_leader.field_pos_len];
+			ddr_buf[i + ddr->record_leader.field_pos_len] = '\0';
+			ddr->f0000.field_pos = strtol(&ddr_buf[i], (char **)0, 10);
+			ddr_buf[i + ddr->record_leader.field_pos_len] = save_byte;
+			i = i + ddr->record_leader.field_pos_len;
 
-			if ((ddr.record_leader.ichg_level == 2) || (ddr.record_leader.ichg_level == 3))  {
-				ddr.f0000.field_cntrl = &ddr_buf[j];
-				j = j + ddr.record_leader.field_cntrl_len;
+			if ((ddr->record_leader.ichg_level == 2) || (ddr->record_leader.ichg_level == 3))  {
+				ddr->f0000.field_cntrl = &ddr_buf[j];
+				j = j + ddr->record_leader.field_cntrl_len;
 			}
 			else  {
-				ddr.f0000.field_cntrl = (char *)0;
+				ddr->f0000.field_cntrl = (char *)0;
 			}
 
-			ddr.f0000.name = &ddr_buf[j];
-			k = ddr.record_leader.fa_addr + ddr.f0000.field_pos + ddr.f0000.field_len;
+			ddr->f0000.name = &ddr_buf[j];
+			k = ddr->record_leader.fa_addr + ddr->f0000.field_pos + ddr->f0000.field_len;
 			for ( ; j < k; j++)  {	// Search the whole field, if necessary, for a terminator.
 				if ((ddr_buf[j] == UNIT_TERMINATOR) || (ddr_buf[j] == FIELD_TERMINATOR))  {
 					break;
@@ -827,21 +1066,21 @@ parse_ddr()
 			ddr_buf[j++] = '\0';	// Null terminate the end of the name.  The null-terminator may end up being the whole name if no name was present.
 			j = k;
 		}
-		else if (strncmp(&ddr_buf[i], "0000002" + 7 - ddr.record_leader.field_tag_len, ddr.record_leader.field_tag_len) == 0)  {
+		else if (strncmp(&ddr_buf[i], "0000002" + 7 - ddr->record_leader.field_tag_len, ddr->record_leader.field_tag_len) == 0)  {
 			/* This is a user-augmented file description.  We don't know how to handle these. */
 			fprintf(stderr, "File contains field tag of \"0..2\".  Can't handle this.\n");
 			exit(0);
 		}
-		else if ((strncmp(&ddr_buf[i], "0000000" + 7 - ddr.record_leader.field_tag_len, ddr.record_leader.field_tag_len - 1) == 0) &&
-			 (ddr_buf[i + ddr.record_leader.field_tag_len - 1] >= '3') &&
-			 (ddr_buf[i + ddr.record_leader.field_tag_len - 1] <= '9'))  {
+		else if ((strncmp(&ddr_buf[i], "0000000" + 7 - ddr->record_leader.field_tag_len, ddr->record_leader.field_tag_len - 1) == 0) &&
+			 (ddr_buf[i + ddr->record_leader.field_tag_len - 1] >= '3') &&
+			 (ddr_buf[i + ddr->record_leader.field_tag_len - 1] <= '9'))  {
 			/* This is one of the other special tags that we can't handle. */
-			fprintf(stderr, "File contains field tag of \"0..%c\".  Can't handle this.\n", ddr_buf[i + ddr.record_leader.field_tag_len - 1]);
+			fprintf(stderr, "File contains field tag of \"0..%c\".  Can't handle this.\n", ddr_buf[i + ddr->record_leader.field_tag_len - 1]);
 			exit(0);
 		}
 		else  {
 			/* This is a plain old non-special tag.  (Which includes the pseudo-special "0..1" tag. */
-			if (ddr.num_tags == MAX_TAGS)  {
+			if (ddr->num_tags == MAX_TAGS)  {
 				fprintf(stderr, "Ran out of space for field tags.  Can't proceed.\n");
 				exit(0);
 			}
@@ -851,39 +1090,39 @@ parse_ddr()
 			 * case we don't find any labels and/or formats.
 			 */
 			for (k = 0; k < MAX_SUBFIELDS; k++)  {
-				ddr.user[ddr.num_tags].labels[k] = "";
-				ddr.user[ddr.num_tags].formats[k] = "";
-				ddr.user[ddr.num_tags].sizes[k] = 0;
-				ddr.user[ddr.num_tags].cartesian[k] = 0;
+				ddr->user[ddr->num_tags].labels[k] = "";
+				ddr->user[ddr->num_tags].formats[k] = "";
+				ddr->user[ddr->num_tags].sizes[k] = 0;
+				ddr->user[ddr->num_tags].cartesian[k] = 0;
 			}
 
-			ddr.user[ddr.num_tags].tag = &ddr_buf[i];
-			i = i + ddr.record_leader.field_tag_len;
+			ddr->user[ddr->num_tags].tag = &ddr_buf[i];
+			i = i + ddr->record_leader.field_tag_len;
 
 			k = i;
-			save_byte = ddr_buf[i + ddr.record_leader.field_len_len];
-			ddr_buf[i + ddr.record_leader.field_len_len] = '\0';
-			ddr.user[ddr.num_tags].field_len = strtol(&ddr_buf[i], (char **)0, 10);
-			ddr_buf[i + ddr.record_leader.field_len_len] = save_byte;
-			i = i + ddr.record_leader.field_len_len;
+			save_byte = ddr_buf[i + ddr->record_leader.field_len_len];
+			ddr_buf[i + ddr->record_leader.field_len_len] = '\0';
+			ddr->user[ddr->num_tags].field_len = strtol(&ddr_buf[i], (char **)0, 10);
+			ddr_buf[i + ddr->record_leader.field_len_len] = save_byte;
+			i = i + ddr->record_leader.field_len_len;
 			ddr_buf[k] = '\0';	// Null-terminate tag.
 
-			save_byte = ddr_buf[i + ddr.record_leader.field_pos_len];
-			ddr_buf[i + ddr.record_leader.field_pos_len] = '\0';
-			ddr.user[ddr.num_tags].field_pos = strtol(&ddr_buf[i], (char **)0, 10);
-			ddr_buf[i + ddr.record_leader.field_pos_len] = save_byte;
-			i = i + ddr.record_leader.field_pos_len;
+			save_byte = ddr_buf[i + ddr->record_leader.field_pos_len];
+			ddr_buf[i + ddr->record_leader.field_pos_len] = '\0';
+			ddr->user[ddr->num_tags].field_pos = strtol(&ddr_buf[i], (char **)0, 10);
+			ddr_buf[i + ddr->record_leader.field_pos_len] = save_byte;
+			i = i + ddr->record_leader.field_pos_len;
 
-			if ((ddr.record_leader.ichg_level == 2) || (ddr.record_leader.ichg_level == 3))  {
-				ddr.user[ddr.num_tags].field_cntrl = &ddr_buf[j];
-				j = j + ddr.record_leader.field_cntrl_len;
+			if ((ddr->record_leader.ichg_level == 2) || (ddr->record_leader.ichg_level == 3))  {
+				ddr->user[ddr->num_tags].field_cntrl = &ddr_buf[j];
+				j = j + ddr->record_leader.field_cntrl_len;
 			}
 			else  {
-				ddr.user[ddr.num_tags].field_cntrl = (char *)0;
+				ddr->user[ddr->num_tags].field_cntrl = (char *)0;
 			}
 
-			ddr.user[ddr.num_tags].name = &ddr_buf[j];
-			k = ddr.record_leader.fa_addr + ddr.user[ddr.num_tags].field_pos + ddr.user[ddr.num_tags].field_len;
+			ddr->user[ddr->num_tags].name = &ddr_buf[j];
+			k = ddr->record_leader.fa_addr + ddr->user[ddr->num_tags].field_pos + ddr->user[ddr->num_tags].field_len;
 			for ( ; j < k; j++)  {	// Search the whole field, if necessary, for a terminator.
 				if ((ddr_buf[j] == UNIT_TERMINATOR) || (ddr_buf[j] == FIELD_TERMINATOR))  {
 					break;
@@ -894,10 +1133,12 @@ parse_ddr()
 				exit(0);
 			}
 			if ((ddr_buf[j] != UNIT_TERMINATOR) ||
-			    (ddr.record_leader.ichg_level == 1) ||
-			    (ddr.user[ddr.num_tags].field_cntrl[0] == '0'))  {
+			    (ddr->record_leader.ichg_level == 1) ||
+			    (ddr->user[ddr->num_tags].field_cntrl[0] == '0'))  {
 				ddr_buf[j++] = '\0';	// Null terminate the end of the name.
-				ddr.num_tags++;
+				ddr->user[ddr->num_tags].num_labels = 0;
+				ddr->user[ddr->num_tags].num_formats = 0;
+				ddr->num_tags++;
 				j = k;
 				continue;
 			}
@@ -913,7 +1154,7 @@ parse_ddr()
 			 * cartesian delimiter.  If we come across the latter, we remember
 			 * it for later use, and then null it just like the '!' delimiters.
 			 */
-			ddr.user[ddr.num_tags].num_labels = 0;
+			ddr->user[ddr->num_tags].num_labels = 0;
 			if (ddr_buf[j] != UNIT_TERMINATOR)  {
 				/*
 				 * Either we have some labels, or we are at end of field.
@@ -924,17 +1165,17 @@ parse_ddr()
 				/* Check for leading '*' delimiter */
 				if ((j != k) && (ddr_buf[j] == '*'))  {
 					j++;
-					ddr.user[ddr.num_tags].cartesian[0] = 1;
+					ddr->user[ddr->num_tags].cartesian[0] = 1;
 				}
 
 				/* Now, process the labels, if there are any. */
 				while ((j != k) && (ddr_buf[j] != UNIT_TERMINATOR) && (ddr_buf[j] != FIELD_TERMINATOR))  {
-					if (ddr.user[ddr.num_tags].num_labels == MAX_SUBFIELDS)  {
+					if (ddr->user[ddr->num_tags].num_labels == MAX_SUBFIELDS)  {
 						fprintf(stderr, "Ran out of space for subfield labels.  Can't proceed.\n");
 						exit(0);
 					}
 
-					ddr.user[ddr.num_tags].labels[ddr.user[ddr.num_tags].num_labels] = &ddr_buf[j];
+					ddr->user[ddr->num_tags].labels[ddr->user[ddr->num_tags].num_labels] = &ddr_buf[j];
 					j++;
 					for ( ; j < (k - 1); j++)  {
 						if ((ddr_buf[j] == '!') || (ddr_buf[j] == '*') ||
@@ -943,19 +1184,19 @@ parse_ddr()
 						}
 					}
 					if (ddr_buf[j] == '*')  {
-						if (ddr.user[ddr.num_tags].num_labels == (MAX_SUBFIELDS - 1))  {
+						if (ddr->user[ddr->num_tags].num_labels == (MAX_SUBFIELDS - 1))  {
 							fprintf(stderr, "Ran out of space for subfield labels.  Can't proceed.\n");
 							exit(0);
 						}
-						ddr.user[ddr.num_tags].cartesian[ddr.user[ddr.num_tags].num_labels + 1] = 1;
+						ddr->user[ddr->num_tags].cartesian[ddr->user[ddr->num_tags].num_labels + 1] = 1;
 					}
 					if (ddr_buf[j] != '!')  {
 						ddr_buf[j++] = '\0';	// Null terminate the end of the tag.
-						ddr.user[ddr.num_tags].num_labels++;
+						ddr->user[ddr->num_tags].num_labels++;
 						break;
 					}
 					ddr_buf[j++] = '\0';	// Null terminate the end of the tag.
-					ddr.user[ddr.num_tags].num_labels++;
+					ddr->user[ddr->num_tags].num_labels++;
 				}
 			}
 			else  {
@@ -976,7 +1217,7 @@ parse_ddr()
 			 * known USGS data.  If it becomes necessary to handle more complex format
 			 * strings, we should probably move the parsing to a separate function.
 			 */
-			ddr.user[ddr.num_tags].num_formats = 0;
+			ddr->user[ddr->num_tags].num_formats = 0;
 			if (ddr_buf[j] != FIELD_TERMINATOR)  {
 				if ((k - j) > 3)  {	// We need at least "(?)" followed by a field terminator before we can proceed.
 					if ((ddr_buf[j] != '(') || (ddr_buf[k - 2] != ')') || (ddr_buf[k - 1] != FIELD_TERMINATOR))  {
@@ -1045,8 +1286,8 @@ parse_ddr()
 						}
 
 						while(repeat_count > 0)  {
-							ddr.user[ddr.num_tags].formats[ddr.user[ddr.num_tags].num_formats] = &ddr_buf[j];
-							ddr.user[ddr.num_tags].sizes[ddr.user[ddr.num_tags].num_formats++] = size;
+							ddr->user[ddr->num_tags].formats[ddr->user[ddr->num_tags].num_formats] = &ddr_buf[j];
+							ddr->user[ddr->num_tags].sizes[ddr->user[ddr->num_tags].num_formats++] = size;
 							repeat_count--;
 						}
 
@@ -1064,17 +1305,19 @@ parse_ddr()
 			 * an equal number of each, because otherwise, we don't know
 			 * what to do.
 			 */
-			if ((ddr.user[ddr.num_tags].num_formats > 0) && (ddr.user[ddr.num_tags].num_labels > 0))  {
-				if (ddr.user[ddr.num_tags].num_formats != ddr.user[ddr.num_tags].num_labels)  {
+			if ((ddr->user[ddr->num_tags].num_formats > 0) && (ddr->user[ddr->num_tags].num_labels > 0))  {
+				if (ddr->user[ddr->num_tags].num_formats != ddr->user[ddr->num_tags].num_labels)  {
 					fprintf(stderr, "File does not contain a format descriptor for each subfield.  Can't handle this.\n");
 					exit(0);
 				}
 			}
 
-			ddr.num_tags++;
+			ddr->num_tags++;
 			j = k;
 		}
 	}
+
+	compile_plan(ddr);
 }
 
 
@@ -1086,7 +1329,7 @@ parse_ddr()
  * information into the DR structure.
  *
  * We have already parsed the record leader, in the read_record() function.
- * The values have been stored away in dr.record_leader.
+ * The values have been stored away in h->dr.record_leader.
  * This was done separately because the leader always has the same
  * interpretation for every record, and we can parse and check it
  * right after reading any record.
@@ -1101,57 +1344,73 @@ parse_ddr()
  * corresponding to the subfields of each of the fields.
  */
 static void
-parse_dr()
+parse_dr(struct ddf *h, char *dr_buf)
 {
 	int32_t i;		// We use this as an index into the Directory
-	int32_t j;		// We use this as an index into the Field Area
 	int32_t k;
-	char save_byte;
+	struct ddr *ddr = &h->module->ddr;
 
-	if (leaderless_flag != 0)  {
+	if (h->leaderless_flag != 0)  {
 		/*
-		 * Once the leaderless_flag has been set, we shouldn't be calling this function.
+		 * Once the h->leaderless_flag has been set, we shouldn't be calling this function.
 		 */
 		fprintf(stderr, "parse_dr() called during leaderless processing.  Something is wrong.\n");
 		exit(0);
 	}
 
-	j = dr.record_leader.fa_addr;	// Start of Field Area
+	h->dr.field_area = dr_buf + h->dr.record_leader.fa_addr;	// Start of Field Area
 
-	dr.num_tags = 0;
+	h->dr.num_tags = 0;
 
 
 	/*
 	 * Iterate through the directory entries and stick the data
 	 * into the dr structure.
+	 *
+	 * The record may be a read-only view of the file, so we don't
+	 * null-terminate anything here.  The numbers are converted
+	 * in place by ddf_number(), and the tag is compared in place
+	 * against the DDR.
 	 */
 	i = REC_LEADER_LEN;			// Start of DR Directory
 
-	while (i < (dr.record_leader.fa_addr - 1))  {
-		if (ddr.num_tags == MAX_TAGS)  {
+	while (i < (h->dr.record_leader.fa_addr - 1))  {
+		if (h->dr.num_tags == MAX_TAGS)  {
 			fprintf(stderr, "Ran out of space for field tags.  Can't proceed.\n");
 			exit(0);
 		}
 
-		dr.user[dr.num_tags].tag = &dr_buf[i];
-		i = i + dr.record_leader.field_tag_len;
+		/*
+		 * Find the DDR entry that describes this field, so that
+		 * get_subfield() and get_record() don't have to search
+		 * for it every time they look at the field.  From then on,
+		 * we use the null-terminated copy of the tag in the DDR.
+		 */
+		for (k = 0; k < ddr->num_tags; k++)  {
+			if (strncmp(&dr_buf[i], ddr->user[k].tag, h->dr.record_leader.field_tag_len) == 0)  {
+				break;
+			}
+		}
+		if (k == ddr->num_tags)  {
+			fprintf(stderr, "Failed to find user tag %.*s in DDR.\n", h->dr.record_leader.field_tag_len, &dr_buf[i]);
+			exit(0);
+		}
+		h->dr.user[h->dr.num_tags].ddr_index = k;
+		h->dr.user[h->dr.num_tags].tag = ddr->user[k].tag;
+		i = i + h->dr.record_leader.field_tag_len;
+
+		h->dr.user[h->dr.num_tags].field_len = ddf_number(&dr_buf[i], h->dr.record_leader.field_len_len);
+		i = i + h->dr.record_leader.field_len_len;
 
-		k = i;
-		save_byte = dr_buf[i + dr.record_leader.field_len_len];
-		dr_buf[i + dr.record_leader.field_len_len] = '\0';
-		dr.user[dr.num_tags].field_len = strtol(&dr_buf[i], (char **)0, 10);
-		dr_buf[i + dr.record_leader.field_len_len] = save_byte;
-		i = i + dr.record_leader.field_len_len;
-		dr_buf[k] = '\0';	// Null-terminate tag.
+		h->dr.user[h->dr.num_tags].field_pos = ddf_number(&dr_buf[i], h->dr.record_leader.field_pos_len);
+		i = i + h->dr.record_leader.field_pos_len;
 
-		save_byte = dr_buf[i + dr.record_leader.field_pos_len];
-		dr_buf[i + dr.record_leader.field_pos_len] = '\0';
-		dr.user[dr.num_tags].field_pos = strtol(&dr_buf[i], (char **)0, 10);
-		dr_buf[i + dr.record_leader.field_pos_len] = save_byte;
-		i = i + dr.record_leader.field_pos_len;
+		if ((h->dr.user[h->dr.num_tags].field_pos + h->dr.user[h->dr.num_tags].field_len) > (h->dr.record_leader.length - h->dr.record_leader.fa_addr))  {
+			fprintf(stderr, "Field %s extends past the end of the DR.\n", h->dr.user[h->dr.num_tags].tag);
+			exit(0);
+		}
 
-		dr.num_tags++;
-		j = k;
+		h->dr.num_tags++;
 	}
 
 	/*
@@ -1162,9 +1421,96 @@ parse_dr()
 	 * end of file, and we interpret it using the Directory
 	 * entry in the just-parsed Directory.
 	 */
-	if (dr.record_leader.leader_id == 'R')  {
-		leaderless_flag = 1;
+	if (h->dr.record_leader.leader_id == 'R')  {
+		h->leaderless_flag = 1;
+	}
+}
+
+
+
+
+/*
+ * Read in the next Data Record, and parse its Directory.
+ * If we have already seen a leaderless record, then just
+ * read in the next copy of its Field Area instead.
+ *
+ * This function returns 1 when it has read a record,
+ * and 0 at end of file.  It exits on errors.
+ */
+static int32_t
+next_dr(struct ddf *h)
+{
+	int32_t ret_val;
+	int32_t length;
+
+	if (h->leaderless_flag == 0)  {
+		if ((ret_val = read_record(h->module, h->pos, &h->dr.record_leader)) < 0)  {
+			/* Error message was printed by read_record(), so just exit. */
+			exit(0);
+		}
+		else if (ret_val == 0)  {
+			return 0;
+		}
+
+		parse_dr(h, h->module->image + h->pos);
+		if ((h->leaderless_flag != 0) && (h->leaderless_pos < 0))  {
+			h->leaderless_pos = h->pos;
+			h->leaderless_start = h->pos + ret_val;
+		}
+		h->pos = h->pos + ret_val;
 	}
+	else  {
+		/* Just point at the next copy of the Field Area. */
+		length = h->dr.record_leader.length - h->dr.record_leader.fa_addr;
+		ret_val = h->module->size - h->pos < length ? h->module->size - h->pos : length;
+		if (ret_val != length)  {
+			if (ret_val == 0)  {
+				return 0;
+			}
+			else  {
+				fprintf(stderr, "Tried to read %d bytes from SDTS record.  Got ret_val = %d\n",
+					length, (int)ret_val);
+				exit(0);
+			}
+		}
+		h->dr.field_area = h->module->image + h->pos;
+		h->pos = h->pos + length;
+	}
+
+	return 1;
+}
+
+
+
+
+/*
+ * Copy a subfield value into the value buffer and null-terminate it,
+ * so that get_subfield() callers can hand it to strtol() and the like,
+ * and can temporarily null-terminate pieces of it, without writing
+ * into the record.
+ */
+static char *
+copy_value(struct ddf *h, char *value, int32_t length)
+{
+	char *ptr;
+	int32_t size;
+
+	if ((length + 1) > h->value_buf_size)  {
+		size = h->value_buf_size > 0 ? h->value_buf_size : 256;
+		while (size < (length + 1))  {
+			size = size << 1;
+		}
+		if ((ptr = (char *)realloc(h->value_buf, size)) == (char *)0)  {
+			fprintf(stderr, "realloc(%d) returns null.\n", size);
+			exit(0);
+		}
+		h->value_buf = ptr;
+		h->value_buf_size = size;
+	}
+	memcpy(h->value_buf, value, length);
+	h->value_buf[length] = '\0';
+
+	return h->value_buf;
 }
 
 
@@ -1173,9 +1519,8 @@ parse_dr()
 /*
  * When the user calls this function,
  * we return the next available subfield from the
- * file.  This routine depends on global
- * static state information, since it must
- * remember its state from one invocation to the next.
+ * file.  The handle remembers our position from
+ * one invocation to the next.
  *
  * This function returns 1 when it finds a subfield.
  * It returns 0 at end of file.
@@ -1184,72 +1529,41 @@ parse_dr()
  * In the subfield structure returned by this function,
  * the subfield.tag, subfield.label, and subfield.format
  * elements will be null-terminated.  The subfield.value
- * element will not be null-terminated, and you must
- * use the subfield.length element to find its end.
+ * element is a null-terminated copy of the value, which
+ * is overwritten by the next call.  (The record itself may
+ * be a read-only view of the file.)  Binary values may
+ * contain nulls, so use the subfield.length element to find
+ * the end of the value.
  */
 int32_t
-get_subfield(struct subfield *subfield)
+ddf_get_subfield(struct ddf *h, struct subfield *subfield)
 {
-	ssize_t ret_val;
 	int32_t i;
-	static int32_t data_index;
 	int32_t ddr_index;
+	struct ddr *ddr = &h->module->ddr;
 	int32_t field_limit;
-	char *tag_wanted;
 	int32_t max_labels_formats;	// contains the maximum of the number of labels or the number of formats
 
 	/*
 	 * Check whether we have used up all of the data from the last record we
 	 * read.  If so, try to read another record.
 	 */
-	if (dr_tag >= dr.num_tags)  {
+	if (h->dr_tag >= h->dr.num_tags)  {
 		/* We have finished with the old record and need to read another. */
-		if (leaderless_flag == 0)  {
-			if ((ret_val = read_record(&dr.record_leader, &dr_buf)) < 0)  {
-				/* Error message was printed by read_record(), so just exit. */
-				exit(0);
-			}
-			else if (ret_val == 0)  {
-				return 0;
-			}
-
-			parse_dr(&dr);
-		}
-		else  {
-			if ((ret_val = read_function(fdesc, &dr_buf[dr.record_leader.fa_addr],
-			     dr.record_leader.length - dr.record_leader.fa_addr)) !=
-			     (dr.record_leader.length - dr.record_leader.fa_addr))  {
-				if (ret_val == 0)  {
-					return 0;
-				}
-				else  {
-					fprintf(stderr, "Tried to read %d bytes from SDTS record.  Got ret_val = %d\n",
-						dr.record_leader.length - dr.record_leader.fa_addr, (int)ret_val);
-					exit(0);
-				}
-			}
+		if (next_dr(h) == 0)  {
+			return 0;
 		}
 
-		dr_tag = 0;
-		dr_label = 0;
-		data_index = dr.record_leader.fa_addr;
+		h->dr_tag = 0;
+		h->dr_label = 0;
+		h->data_index = 0;
 	}
 
 	/*
 	 * We are trying to pry the next tag/label pair out of the record.
-	 * Set a pointer to the tag we are looking for, and then search
-	 * for that tag in the DDR.
+	 * parse_dr() has already found the DDR entry for the tag.
 	 */
-	tag_wanted = dr.user[dr_tag].tag;
-	for (ddr_index = 0; ddr_index < ddr.num_tags; ddr_index++)  {
-		if (strncmp(tag_wanted, ddr.user[ddr_index].tag, ddr.record_leader.field_tag_len) == 0)  {
-			break;
-		}
-	}
-	if (ddr_index == ddr.num_tags)  {
-		fprintf(stderr, "Failed to find user tag %.*s in DDR.\n", ddr.record_leader.field_tag_len, tag_wanted);
-		exit(0);
-	}
+	ddr_index = h->dr.user[h->dr_tag].ddr_index;
 
 	/*
 	 * Handle the data based on its type.  This particular
@@ -1278,49 +1592,48 @@ get_subfield(struct subfield *subfield)
 	 * However, the first byte adds some complications.  Structure types 0 and
 	 * 1 are fairly straightforward, type 2 can take a variety of forms.
 	 */
-	if ((ddr.record_leader.ichg_level == -1) || (ddr.record_leader.ichg_level == 1) || (ddr.user[ddr_index].field_cntrl[0] == '0'))  {
+	if ((ddr->record_leader.ichg_level == -1) || (ddr->record_leader.ichg_level == 1) || (ddr->user[ddr_index].field_cntrl[0] == '0'))  {
 		/*
 		 * We have a simple atomic data field, with no subfield label.
 		 */
-		subfield->tag = dr.user[dr_tag].tag;
+		subfield->tag = h->dr.user[h->dr_tag].tag;
 		subfield->label = "";
-		subfield->value = dr_buf + data_index;
 		subfield->format = "";
-		subfield->length = dr.user[dr_tag].field_len - 1;	// Subtract 1 for the terminator
+		subfield->length = h->dr.user[h->dr_tag].field_len - 1;	// Subtract 1 for the terminator
+		subfield->value = copy_value(h, h->dr.field_area + h->data_index, subfield->length);
 
-		data_index = data_index + dr.user[dr_tag].field_len;
-		dr_buf[data_index - 1] = '\0';
+		h->data_index = h->data_index + h->dr.user[h->dr_tag].field_len;
 
-		dr_label++;
-		if (dr_label >= ddr.user[ddr_index].num_labels)  {
-			dr_label = 0;
-			dr_tag++;
+		h->dr_label++;
+		if (h->dr_label >= ddr->user[ddr_index].num_labels)  {
+			h->dr_label = 0;
+			h->dr_tag++;
 		}
 	}
-	else if (ddr.user[ddr_index].field_cntrl[0] == '1')  {
+	else if (ddr->user[ddr_index].field_cntrl[0] == '1')  {
 		/*
 		 * We have a vector of subfields, which may be of various types, each with its own label.
 		 *
 		 * The complications here arise when labels and/or formats
 		 * are not present.
 		 */
-		subfield->tag = dr.user[dr_tag].tag;
-		subfield->label = ddr.user[ddr_index].labels[dr_label];
-		subfield->value = dr_buf + data_index;
-		subfield->format = ddr.user[ddr_index].formats[dr_label];
+		subfield->tag = h->dr.user[h->dr_tag].tag;
+		subfield->label = ddr->user[ddr_index].labels[h->dr_label];
+		subfield->format = ddr->user[ddr_index].formats[h->dr_label];
 
-		field_limit = dr.record_leader.fa_addr + dr.user[dr_tag].field_pos + dr.user[dr_tag].field_len;
+		field_limit = h->dr.user[h->dr_tag].field_pos + h->dr.user[h->dr_tag].field_len;
 
-		if (ddr.user[ddr_index].sizes[dr_label] > 0)  {
+		if (ddr->user[ddr_index].sizes[h->dr_label] > 0)  {
 			/*
 			 * A size was provided in the format string.  Use it.
 			 * There shouldn't be any UNIT_TERMINATORS between subfields.
 			 */
-			subfield->length = ddr.user[ddr_index].sizes[dr_label];
-			data_index = data_index + subfield->length;
-			if (data_index == (field_limit - 1))  {
+			subfield->length = ddr->user[ddr_index].sizes[h->dr_label];
+			subfield->value = copy_value(h, h->dr.field_area + h->data_index, subfield->length);
+			h->data_index = h->data_index + subfield->length;
+			if (h->data_index == (field_limit - 1))  {
 				/* If at end of field, step over FIELD_TERMINATOR */
-				data_index++;
+				h->data_index++;
 			}
 		}
 		else  {
@@ -1328,8 +1641,8 @@ get_subfield(struct subfield *subfield)
 			 * No size was provided in the format string.  (Or there was no format string.)
 			 * Must find the end of the subfield via the terminator.
 			 */
-			for (i = data_index; i < field_limit; i++)  {
-				if ((dr_buf[i] == UNIT_TERMINATOR) || (dr_buf[i] == FIELD_TERMINATOR))  {
+			for (i = h->data_index; i < field_limit; i++)  {
+				if ((h->dr.field_area[i] == UNIT_TERMINATOR) || (h->dr.field_area[i] == FIELD_TERMINATOR))  {
 					break;
 				}
 			}
@@ -1337,18 +1650,18 @@ get_subfield(struct subfield *subfield)
 				fprintf(stderr, "Ran out of data in DR.\n");
 				exit(0);
 			}
-			subfield->length = i - data_index;
+			subfield->length = i - h->data_index;
+			subfield->value = copy_value(h, h->dr.field_area + h->data_index, subfield->length);
 
-			data_index = i + 1;
-			dr_buf[data_index - 1] = '\0';
+			h->data_index = i + 1;
 		}
 
-		if ((ddr.user[ddr_index].num_labels > 0) || (ddr.user[ddr_index].num_formats > 0))  {
-			dr_label++;
-			if (dr_label >= ddr.user[ddr_index].num_labels)  {
-				dr_label = 0;
+		if ((ddr->user[ddr_index].num_labels > 0) || (ddr->user[ddr_index].num_formats > 0))  {
+			h->dr_label++;
+			if (h->dr_label >= ddr->user[ddr_index].num_labels)  {
+				h->dr_label = 0;
 				/*
-				 * I added the following "if" statement, around the "dr_tag++;"
+				 * I added the following "if" statement, around the "h->dr_tag++;"
 				 * statement, because some files don't define a sequence of
 				 * X,Y pairs as cartesian arrays (which are handled below), but
 				 * instead define such pairs as a non-cartesian pair of labels that
@@ -1357,17 +1670,17 @@ get_subfield(struct subfield *subfield)
 				 * the construct is present in some USGS DEM files, so we attempt to
 				 * handle it whether it is conforming or not.
 				 */
-				if (data_index == field_limit)  {
-					dr_tag++;
+				if (h->data_index == field_limit)  {
+					h->dr_tag++;
 				}
 			}
 		}
-		else if (data_index == field_limit)  {
-			dr_label = 0;
-			dr_tag++;
+		else if (h->data_index == field_limit)  {
+			h->dr_label = 0;
+			h->dr_tag++;
 		}
 	}
-	else if (ddr.user[ddr_index].field_cntrl[0] == '2')  {
+	else if (ddr->user[ddr_index].field_cntrl[0] == '2')  {
 		/*
 		 * We have an array of subfields.
 		 *
@@ -1417,26 +1730,26 @@ get_subfield(struct subfield *subfield)
 		 * the '*' delimiter appears.  We don't use this information now, but
 		 * it is available if we eventually need to handle some other cases.
 		 */
-		max_labels_formats = ddr.user[ddr_index].num_labels > ddr.user[ddr_index].num_formats ?
-					ddr.user[ddr_index].num_labels : ddr.user[ddr_index].num_formats;
+		max_labels_formats = ddr->user[ddr_index].num_labels > ddr->user[ddr_index].num_formats ?
+					ddr->user[ddr_index].num_labels : ddr->user[ddr_index].num_formats;
 
-		subfield->tag = dr.user[dr_tag].tag;
-		subfield->label = ddr.user[ddr_index].labels[dr_label];
-		subfield->value = dr_buf + data_index;
-		subfield->format = ddr.user[ddr_index].formats[dr_label];
+		subfield->tag = h->dr.user[h->dr_tag].tag;
+		subfield->label = ddr->user[ddr_index].labels[h->dr_label];
+		subfield->format = ddr->user[ddr_index].formats[h->dr_label];
 
-		field_limit = dr.record_leader.fa_addr + dr.user[dr_tag].field_pos + dr.user[dr_tag].field_len;
+		field_limit = h->dr.user[h->dr_tag].field_pos + h->dr.user[h->dr_tag].field_len;
 
-		if (ddr.user[ddr_index].sizes[dr_label] > 0)  {
+		if (ddr->user[ddr_index].sizes[h->dr_label] > 0)  {
 			/*
 			 * A size was provided in the format string.  Use it.
 			 * There shouldn't be any UNIT_TERMINATORS between subfields.
 			 */
-			subfield->length = ddr.user[ddr_index].sizes[dr_label];
-			data_index = data_index + subfield->length;
-			if (data_index == (field_limit - 1))  {
+			subfield->length = ddr->user[ddr_index].sizes[h->dr_label];
+			subfield->value = copy_value(h, h->dr.field_area + h->data_index, subfield->length);
+			h->data_index = h->data_index + subfield->length;
+			if (h->data_index == (field_limit - 1))  {
 				/* If at end of field, step over FIELD_TERMINATOR */
-				data_index++;
+				h->data_index++;
 			}
 		}
 		else  {
@@ -1444,8 +1757,8 @@ get_subfield(struct subfield *subfield)
 			 * No size was provided in the format string.  (Or there was no format string.)
 			 * Must find the end of the subfield via the terminator.
 			 */
-			for (i = data_index; i < field_limit; i++)  {
-				if ((dr_buf[i] == UNIT_TERMINATOR) || (dr_buf[i] == FIELD_TERMINATOR))  {
+			for (i = h->data_index; i < field_limit; i++)  {
+				if ((h->dr.field_area[i] == UNIT_TERMINATOR) || (h->dr.field_area[i] == FIELD_TERMINATOR))  {
 					break;
 				}
 			}
@@ -1453,10 +1766,10 @@ get_subfield(struct subfield *subfield)
 				fprintf(stderr, "Ran out of data in DR.\n");
 				exit(0);
 			}
-			subfield->length = i - data_index;
+			subfield->length = i - h->data_index;
+			subfield->value = copy_value(h, h->dr.field_area + h->data_index, subfield->length);
 
-			data_index = i + 1;
-			dr_buf[data_index - 1] = '\0';
+			h->data_index = i + 1;
 		}
 
 		/*
@@ -1464,19 +1777,19 @@ get_subfield(struct subfield *subfield)
 		 * has been simplified to handle only the single
 		 * case we discussed above.
 		 */
-		if (data_index >= (field_limit - 1))  {
-			dr_label = 0;
-			dr_tag++;
+		if (h->data_index >= (field_limit - 1))  {
+			h->dr_label = 0;
+			h->dr_tag++;
 		}
 		else  {
-			dr_label++;
-			if (dr_label >= max_labels_formats)  {
-				dr_label = 0;
+			h->dr_label++;
+			if (h->dr_label >= max_labels_formats)  {
+				h->dr_label = 0;
 			}
 		}
 	}
 	else  {
-		fprintf(stderr, "Field structure type %c is unknown.\n", ddr.user[ddr_index].field_cntrl[0]);
+		fprintf(stderr, "Field structure type %c is unknown.\n", ddr->user[ddr_index].field_cntrl[0]);
 		exit(0);
 	}
 
@@ -1488,65 +1801,1252 @@ get_subfield(struct subfield *subfield)
 
 
 /*
- * Open a DDF file for processing.
+ * Connect the caller's ddf_item structures to the decode plan
+ * for the currently-open file.  Call this after begin_ddf() and
+ * before the first call to get_record().
+ *
+ * An item is left unbound (with item->field set to -1) if its tag or
+ * label doesn't appear in the DDR, or if the subfield's format can't
+ * be converted into the requested type.  (DDF_INT needs an 'I' or 'B'
+ * format, and DDF_DOUBLE needs an 'I', 'R', or 'B' format.  DDF_STRING
+ * will take anything.)  Unbound items always come back with a count
+ * of zero.
+ *
+ * Returns the number of items that were bound.
  */
 int32_t
-begin_ddf(char *file_name)
+ddf_bind(struct ddf *h, struct ddf_item *items, int32_t num_items)
 {
-	int32_t length;
+	int32_t i;
+	int32_t k;
+	int32_t n;
+	int32_t num_found = 0;
+	struct ddr_directory *d;
+	struct ddr *ddr = &h->module->ddr;
+
+	for (i = 0; i < ddr->num_tags; i++)  {
+		for (k = 0; k < MAX_SUBFIELDS; k++)  {
+			h->bound[i][k] = -1;
+		}
+		h->num_bound[i] = 0;
+	}
 
-	leaderless_flag = 0;
-	dr_tag = MAX_TAGS;
-	dr_label = MAX_SUBFIELDS;
+	for (n = 0; n < num_items; n++)  {
+		items[n].field = -1;
+		items[n].subfield = -1;
+		items[n].format = 0;
+		items[n].size = 0;
+		items[n].count = 0;
 
-	length = strlen(file_name);
+		for (i = 0; i < ddr->num_tags; i++)  {
+			if (strcmp(items[n].tag, ddr->user[i].tag) == 0)  {
+				break;
+			}
+		}
+		if (i == ddr->num_tags)  {
+			continue;
+		}
+		d = &ddr->user[i];
 
-	if ((length > 3) && ((strcmp(file_name + length - 3, ".gz") == 0) ||
-	    (strcmp(file_name + length - 3, ".GZ") == 0)))  {
-		gz_flag = 1;
-		read_function = buf_read_z;
-		if ((fdesc = buf_open_z(file_name, O_RDONLY)) < 0)  {
-			return(fdesc);
+		if (d->structure == 0)  {
+			k = items[n].label[0] == '\0' ? 0 : d->cycle;
 		}
-	}
-	else  {
-		gz_flag = 0;
-		read_function = buf_read;
-		if ((fdesc = buf_open(file_name, O_RDONLY)) < 0)  {
-			return(fdesc);
+		else  {
+			for (k = 0; k < d->cycle; k++)  {
+				if (strcmp(items[n].label, d->labels[k]) == 0)  {
+					break;
+				}
+			}
+		}
+		if (k == d->cycle)  {
+			continue;
 		}
-	}
 
-	/*
-	 * Read and parse the DDR.
-	 */
-	parse_ddr();
+		if (((items[n].type == DDF_INT) && (d->types[k] != 'I') && (d->types[k] != 'B')) ||
+		    ((items[n].type == DDF_DOUBLE) && (d->types[k] != 'I') && (d->types[k] != 'R') && (d->types[k] != 'B')))  {
+			continue;
+		}
+
+		items[n].field = i;
+		items[n].subfield = k;
+		items[n].format = d->types[k];
+		items[n].size = d->sizes[k];
+		if (h->bound[i][k] < 0)  {
+			h->num_bound[i]++;
+		}
+		h->bound[i][k] = n;
+		num_found++;
+	}
 
-	return fdesc;
+	return num_found;
 }
 
 
 
 
 /*
- * Close an open DDF file.
+ * Convert one subfield value and store it in the next free slot of an item.
+ *
+ * Binary values are stored most-significant byte first.  We assemble
+ * them a byte at a time, so that the conversion works regardless of
+ * the native byte order.
  */
-void
-end_ddf()
+static void
+deliver(struct ddf_item *item, unsigned char *value, int32_t length, char format)
 {
-	if (gz_flag == 0)  {
-		buf_close(fdesc);
-	}
-	else  {
-		buf_close_z(fdesc);
+	char *dest;
+	char tmp[64];
+	int32_t i;
+	int32_t sign;
+	uint32_t u;
+	union {
+		uint32_t i;
+		float f;
+	} conv;
+
+	if (item->count >= item->max)  {
+		item->count++;
+		return;
 	}
 
-	if (ddr_buf != (char *)0)  {
-		free(ddr_buf);
-	}
-	if (dr_buf != (char *)0)  {
-		free(dr_buf);
-	}
+	switch (item->type)  {
+	case DDF_INT:
+		dest = (char *)item->dest + item->count * (item->stride > 0 ? item->stride : sizeof(int32_t));
+		if (format == 'B')  {
+			if (length == 4)  {
+				u = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | (uint32_t)value[3];
+				*(int32_t *)dest = (int32_t)u;
+			}
+			else if (length == 2)  {
+				*(int32_t *)dest = (short)(((uint32_t)value[0] << 8) | (uint32_t)value[1]);
+			}
+			else  {
+				*(int32_t *)dest = 0;
+			}
+		}
+		else  {
+			/* The same thing strtol() would do, but without needing a null terminator. */
+			for (i = 0; (i < length) && ((value[i] == ' ') || (value[i] == '\t')); i++);
+			sign = 1;
+			if ((i < length) && ((value[i] == '-') || (value[i] == '+')))  {
+				sign = value[i] == '-' ? -1 : 1;
+				i++;
+			}
+			u = 0;
+			for ( ; (i < length) && (value[i] >= '0') && (value[i] <= '9'); i++)  {
+				u = u * 10 + value[i] - '0';
+			}
+			*(int32_t *)dest = sign * (int32_t)u;
+		}
+		break;
+	case DDF_DOUBLE:
+		dest = (char *)item->dest + item->count * (item->stride > 0 ? item->stride : sizeof(double));
+		if (format == 'B')  {
+			if (length == 4)  {
+				/*
+				 * We assume that this is a BFP32 value, which means that it is
+				 * a raw binary IEEE 754 floating point number.  As in the rest
+				 * of drawmap, we assume that IEEE 754 is also the native floating
+				 * point format.
+				 */
+				conv.i = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | (uint32_t)value[3];
+				*(double *)dest = conv.f;
+			}
+			else if (length == 2)  {
+				*(double *)dest = (short)(((uint32_t)value[0] << 8) | (uint32_t)value[1]);
+			}
+			else  {
+				*(double *)dest = 0.0;
+			}
+		}
+		else  {
+			i = length < (int32_t)sizeof(tmp) ? length : sizeof(tmp) - 1;
+			memcpy(tmp, value, i);
+			tmp[i] = '\0';
+			*(double *)dest = strtod(tmp, (char **)0);
+		}
+		break;
+	case DDF_SHORT:
+		dest = (char *)item->dest + item->count * (item->stride > 0 ? item->stride : sizeof(short));
+		if (format == 'B')  {
+			if (length == 4)  {
+				conv.i = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | (uint32_t)value[3];
+				*(short *)dest = drawmap_round(conv.f);
+			}
+			else if (length == 2)  {
+				*(short *)dest = (short)(((uint32_t)value[0] << 8) | (uint32_t)value[1]);
+			}
+			else  {
+				*(short *)dest = 0;
+			}
+		}
+		else  {
+			i = length < (int32_t)sizeof(tmp) ? length : sizeof(tmp) - 1;
+			memcpy(tmp, value, i);
+			tmp[i] = '\0';
+			*(short *)dest = drawmap_round(strtod(tmp, (char **)0));
+		}
+		break;
+	case DDF_STRING:
+		dest = (char *)item->dest + item->count * (item->stride > 0 ? item->stride : sizeof(struct ddf_string));
+		((struct ddf_string *)dest)->value = (char *)value;
+		((struct ddf_string *)dest)->length = length;
+		break;
+	}
+
+	item->count++;
+}
+
+
+
+
+/*
+ * Deliver an array of n packed, fixed-width binary values to an item,
+ * all at once.  The result is the same as calling deliver() for each
+ * value, but the conversion is done in simple loops over the whole
+ * array, which the compiler can turn into vector instructions.  This
+ * is the path that the elevations in a DEM's CEL0 module take.
+ */
+static void
+deliver_array(struct ddf_item *item, unsigned char *data, int32_t n, int32_t size)
+{
+	int32_t i;
+	int32_t amount;
+	short *sdest;
+	double *ddest;
+	union {
+		uint32_t i;
+		float f;
+	} conv;
+
+	amount = item->max - item->count;
+	if (amount > n)  {
+		amount = n;
+	}
+
+	if (item->type == DDF_SHORT)  {
+		sdest = (short *)item->dest + item->count;
+		if (size == 2)  {
+			for (i = 0; i < amount; i++)  {
+				sdest[i] = (short)(((uint32_t)data[2 * i] << 8) | (uint32_t)data[2 * i + 1]);
+			}
+		}
+		else if (size == 4)  {
+			for (i = 0; i < amount; i++)  {
+				conv.i = ((uint32_t)data[4 * i] << 24) | ((uint32_t)data[4 * i + 1] << 16) |
+					 ((uint32_t)data[4 * i + 2] << 8) | (uint32_t)data[4 * i + 3];
+				sdest[i] = drawmap_round(conv.f);
+			}
+		}
+		else  {
+			for (i = 0; i < amount; i++)  {
+				sdest[i] = 0;
+			}
+		}
+	}
+	else  {
+		ddest = (double *)item->dest + item->count;
+		if (size == 2)  {
+			for (i = 0; i < amount; i++)  {
+				ddest[i] = (short)(((uint32_t)data[2 * i] << 8) | (uint32_t)data[2 * i + 1]);
+			}
+		}
+		else if (size == 4)  {
+			for (i = 0; i < amount; i++)  {
+				conv.i = ((uint32_t)data[4 * i] << 24) | ((uint32_t)data[4 * i + 1] << 16) |
+					 ((uint32_t)data[4 * i + 2] << 8) | (uint32_t)data[4 * i + 3];
+				ddest[i] = conv.f;
+			}
+		}
+		else  {
+			for (i = 0; i < amount; i++)  {
+				ddest[i] = 0.0;
+			}
+		}
+	}
+
+	item->count += n;
+}
+
+
+
+
+/*
+ * Decode the wanted subfields of one field in the current DR.
+ * The field begins at data, and is length bytes long, including
+ * the field terminator.  bound[] gives the item (if any) that
+ * each subfield goes to.
+ *
+ * The general case walks through the subfields one at a time,
+ * following the same rules as get_subfield().  If the field
+ * consists of whole cycles of fixed-width subfields, we skip
+ * the walk and go straight to the subfields we want.  And if
+ * the field is nothing but an array of one binary subfield,
+ * bound to a packed numeric item, deliver_array() converts the
+ * whole array at once.
+ */
+static void
+decode_field(struct ddr_directory *d, int32_t *bound, unsigned char *data, int32_t length, struct ddf_item *items)
+{
+	int32_t i;
+	int32_t k;
+	int32_t r;
+	int32_t pos;
+	int32_t next;
+	int32_t value_length;
+	int32_t num_cycles;
+	unsigned char *ptr;
+
+	if (d->structure < 0)  {
+		fprintf(stderr, "Field structure type %c is unknown.\n", d->field_cntrl[0]);
+		exit(0);
+	}
+
+	if (d->structure == 0)  {
+		/* A simple atomic data field, with no subfield label. */
+		deliver(&items[bound[0]], data, length - 1, d->types[0]);
+		return;
+	}
+
+	if ((d->cycle_len > 0) && (length > 1) && (((length - 1) % d->cycle_len) == 0))  {
+		num_cycles = (length - 1) / d->cycle_len;
+		if ((d->cycle == 1) && (bound[0] >= 0) && (d->types[0] == 'B') && (items[bound[0]].stride == 0) &&
+		    ((items[bound[0]].type == DDF_SHORT) || (items[bound[0]].type == DDF_DOUBLE)))  {
+			deliver_array(&items[bound[0]], data, num_cycles, d->sizes[0]);
+			return;
+		}
+		for (r = 0; r < num_cycles; r++)  {
+			ptr = data + r * d->cycle_len;
+			for (k = 0; k < d->cycle; k++)  {
+				if (bound[k] >= 0)  {
+					deliver(&items[bound[k]], ptr + d->offsets[k], d->sizes[k], d->types[k]);
+				}
+			}
+		}
+		return;
+	}
+
+	pos = 0;
+	k = 0;
+	while (pos < length)  {
+		if (d->sizes[k] > 0)  {
+			value_length = d->sizes[k];
+			if ((pos + value_length) > (length - 1))  {
+				/* The field is truncated.  Deliver what we have, and let the caller notice the shortage. */
+				break;
+			}
+			next = pos + value_length;
+			if (next == (length - 1))  {
+				/* If at end of field, step over FIELD_TERMINATOR */
+				next++;
+			}
+		}
+		else  {
+			for (i = pos; i < length; i++)  {
+				if ((data[i] == UNIT_TERMINATOR) || (data[i] == FIELD_TERMINATOR))  {
+					break;
+				}
+			}
+			if (i == length)  {
+				fprintf(stderr, "Ran out of data in DR.\n");
+				exit(0);
+			}
+			value_length = i - pos;
+			next = i + 1;
+		}
+
+		if (bound[k] >= 0)  {
+			deliver(&items[bound[k]], data + pos, value_length, d->types[k]);
+		}
+		pos = next;
+
+		if (d->structure == 2)  {
+			if (pos >= (length - 1))  {
+				break;
+			}
+			k = k + 1 < d->cycle ? k + 1 : 0;
+		}
+		else  {
+			k++;
+			if (k == d->cycle)  {
+				k = 0;
+				if (pos == length)  {
+					break;
+				}
+			}
+		}
+	}
+}
+
+
+
+
+/*
+ * Decode the wanted subfields of the current DR into the
+ * caller's ddf_item structures.  get_record() calls this
+ * after reading each record.  The caller may also call it
+ * directly, to decode the current record a second time, after
+ * making more room for values that didn't fit.
+ */
+void
+decode_record(struct ddf *h, struct ddf_item *items, int32_t num_items)
+{
+	int32_t i;
+	int32_t k;
+
+	for (i = 0; i < num_items; i++)  {
+		items[i].count = 0;
+	}
+
+	for (i = 0; i < h->dr.num_tags; i++)  {
+		k = h->dr.user[i].ddr_index;
+		if (h->num_bound[k] == 0)  {
+			continue;
+		}
+		decode_field(&h->module->ddr.user[k], h->bound[k], (unsigned char *)h->dr.field_area + h->dr.user[i].field_pos, h->dr.user[i].field_len, items);
+	}
+}
+
+
+
+
+/*
+ * Read the next DR and decode the subfields that were
+ * registered with ddf_bind().
+ *
+ * This function returns 1 when it has read a record.
+ * It returns 0 at end of file.
+ * It exits on errors.
+ */
+int32_t
+get_record(struct ddf *h, struct ddf_item *items, int32_t num_items)
+{
+	if (next_dr(h) == 0)  {
+		return 0;
+	}
+
+	/* If the caller switches to ddf_get_subfield(), it will start on the next record. */
+	h->dr_tag = h->dr.num_tags;
+
+	decode_record(h, items, num_items);
+
+	return 1;
+}
+
+
+
+
+/*
+ * Return the position of the next record that get_record() or
+ * ddf_get_subfield() will read.  The position can be handed to
+ * ddf_seek() later, to go back and read the same record again.
+ */
+int32_t
+ddf_tell(struct ddf *h)
+{
+	return h->pos;
+}
+
+
+
+
+/*
+ * Move a handle to a position returned by ddf_tell(), so that the
+ * record there is the next one read.  Since the whole module is
+ * in memory, this costs nothing, and lets the caller keep a small
+ * table of record positions, rather than the contents of the records.
+ *
+ * The records after a leaderless ('R') record are bare Field Areas,
+ * which can only be read with that record's Directory.  Thus, if we
+ * move back to before the leaderless part of the file, we go back to
+ * reading whole records; and if we move into the leaderless part, but
+ * no longer have its Directory, we read the 'R' record again first.
+ */
+void
+ddf_seek(struct ddf *h, int32_t pos)
+{
+	if ((h->leaderless_pos >= 0) && (pos >= h->leaderless_start))  {
+		if (h->leaderless_flag == 0)  {
+			h->pos = h->leaderless_pos;
+			(void)next_dr(h);
+		}
+	}
+	else  {
+		h->leaderless_flag = 0;
+	}
+	h->pos = pos;
+	h->dr_tag = h->dr.num_tags;
+}
+
+
+
+
+/*
+ * Read a whole file into memory.  An uncompressed file is mapped,
+ * if possible, and a gzip-compressed file (one whose name ends
+ * in ".gz", ".GZ", ".tgz", or ".TGZ") is decompressed into a
+ * malloc()ed buffer.  *mapped is set to non-zero if the image
+ * was mapped, in which case it must be freed with munmap().
+ *
+ * Returns 0 on success, or -1 if the file can't be opened.
+ * (In which case errno tells why.)
+ */
+static int32_t
+load_image(char *file_name, char **image, int32_t *size, int32_t *mapped)
+{
+	int32_t length;
+	int fdesc;
+	ssize_t ret_val;
+	struct stat stat_buf;
+
+	length = strlen(file_name);
+
+	if (((length > 3) && ((strcmp(file_name + length - 3, ".gz") == 0) ||
+	     (strcmp(file_name + length - 3, ".GZ") == 0))) ||
+	    ((length > 4) && ((strcmp(file_name + length - 4, ".tgz") == 0) ||
+	     (strcmp(file_name + length - 4, ".TGZ") == 0))))  {
+		/*
+		 * A compressed file gets decompressed into memory,
+		 * all in one go.
+		 */
+		if ((fdesc = buf_open_z(file_name, O_RDONLY)) < 0)  {
+			return -1;
+		}
+		ret_val = buf_read_all_z(fdesc, image);
+		buf_close_z(fdesc);
+		if ((ret_val < 0) || (ret_val > INT32_MAX))  {
+			fprintf(stderr, "Couldn't decompress %s.\n", file_name);
+			exit(0);
+		}
+		*size = ret_val;
+		*mapped = 0;
+	}
+	else  {
+		if ((fdesc = buf_open(file_name, O_RDONLY)) < 0)  {
+			return -1;
+		}
+		if (fstat(fdesc, &stat_buf) != 0)  {
+			fprintf(stderr, "Can't stat %s, errno = %d\n", file_name, errno);
+			exit(0);
+		}
+		if (stat_buf.st_size > INT32_MAX)  {
+			fprintf(stderr, "%s is too large to process.\n", file_name);
+			exit(0);
+		}
+		*size = stat_buf.st_size;
+
+		/*
+		 * If we can, map the whole file into memory.  If the mapping fails,
+		 * we fall back on reading the whole file into a buffer.
+		 */
+		*image = (char *)MAP_FAILED;
+		if (*size > 0)  {
+			*image = (char *)mmap((void *)0, *size, PROT_READ, MAP_PRIVATE, fdesc, 0);
+		}
+		if (*image != (char *)MAP_FAILED)  {
+			*mapped = 1;
+		}
+		else  {
+			*mapped = 0;
+			if ((*image = (char *)malloc(*size + 1)) == (char *)0)  {
+				fprintf(stderr, "malloc(%d) returns null.\n", *size + 1);
+				exit(0);
+			}
+			if ((*size > 0) && (buf_read(fdesc, *image, *size) != *size))  {
+				fprintf(stderr, "Couldn't read %s.\n", file_name);
+				exit(0);
+			}
+		}
+		buf_close(fdesc);
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * Free an image from load_image().
+ */
+static void
+free_image(char *image, int32_t size, int32_t mapped)
+{
+	if (mapped != 0)  {
+		munmap(image, size);
+	}
+	else if (image != (char *)0)  {
+		free(image);
+	}
+}
+
+
+
+
+/*
+ * If the final component of file_name ends in one of the tar
+ * archive suffixes (".tar", ".tar.gz", or ".tgz", in either case),
+ * return the length of the suffix.  Otherwise return 0.
+ * Only the first length bytes of file_name are examined.
+ */
+static int32_t
+tar_suffix(char *file_name, int32_t length)
+{
+	static char *suffixes[] = { ".tar", ".TAR", ".tar.gz", ".TAR.GZ", ".tgz", ".TGZ" };
+	int32_t i;
+	int32_t suffix_length;
+
+	for (i = 0; i < (int32_t)(sizeof(suffixes) / sizeof(suffixes[0])); i++)  {
+		suffix_length = strlen(suffixes[i]);
+		if ((length > suffix_length) && (strncmp(file_name + length - suffix_length, suffixes[i], suffix_length) == 0))  {
+			return suffix_length;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * If file_name refers to a file inside a tar archive, which is to say
+ * it looks like "some/dir/transfer.tar.gz/MODULE.DDF", return the
+ * length of the archive part of the name (not counting the slash).
+ * Otherwise, return 0.  The archive part must name an ordinary file,
+ * so a directory that happens to be called "something.tar" still works
+ * as a directory.
+ */
+static int32_t
+archive_path(char *file_name)
+{
+	int32_t i;
+	char archive_name[MAX_FILE_NAME + 1];
+	struct stat stat_buf;
+
+	for (i = 1; file_name[i] != '\0'; i++)  {
+		if ((file_name[i] != '/') || (i > MAX_FILE_NAME) || (tar_suffix(file_name, i) == 0))  {
+			continue;
+		}
+		strncpy(archive_name, file_name, i);
+		archive_name[i] = '\0';
+		if ((stat(archive_name, &stat_buf) == 0) && S_ISREG(stat_buf.st_mode))  {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * Convert a number from a tar header.  The numbers are stored
+ * as octal ASCII digits, possibly with leading blanks, and
+ * terminated by a blank or a null.
+ * Returns -1 if the number is malformed, or too large.
+ */
+static int64_t
+tar_number(char *ptr, int32_t length)
+{
+	int32_t i;
+	int64_t value = 0;
+
+	for (i = 0; (i < length) && (ptr[i] == ' '); i++)  {
+		;
+	}
+	for ( ; (i < length) && (ptr[i] >= '0') && (ptr[i] <= '7'); i++)  {
+		value = (value << 3) + ptr[i] - '0';
+		if (value > INT32_MAX)  {
+			return -1;
+		}
+	}
+	for ( ; i < length; i++)  {
+		if ((ptr[i] != ' ') && (ptr[i] != '\0'))  {
+			return -1;
+		}
+	}
+
+	return value;
+}
+
+
+
+
+/*
+ * Build the index of an archive's members.  The archive is a sequence
+ * of 512-byte blocks.  Each member starts with a header block, which holds
+ * (among other things) the name of the member, its size, and its type,
+ * followed by the member's contents, padded out to a whole number of blocks.
+ * Two blocks of zeros mark the end of the archive.  Ordinary files are
+ * the only members we care about.  Long names are stored in the POSIX
+ * ustar format as a prefix and a name, or in the GNU format as a special
+ * 'L' member whose contents are the name of the next member.
+ *
+ * Returns 0 on success, or -1 if the archive isn't a valid tar archive.
+ */
+static int32_t
+index_archive(struct tar_archive *archive)
+{
+	int32_t i;
+	int32_t pos = 0;
+	int32_t sum;
+	int64_t member_size;
+	int32_t max_members = 0;
+	unsigned char *header;
+	char name[2 * TAR_BLOCK + 1];
+	char long_name[MAX_FILE_NAME + 1];
+	int32_t long_name_flag = 0;
+	struct tar_member *tmp;
+
+	while ((pos + TAR_BLOCK) <= archive->size)  {
+		header = (unsigned char *)archive->image + pos;
+		if (header[0] == '\0')  {
+			/* End of archive. */
+			break;
+		}
+
+		/*
+		 * Check the header checksum, which is the sum of the bytes
+		 * in the header, with the checksum field itself counted as blanks.
+		 */
+		sum = 0;
+		for (i = 0; i < TAR_BLOCK; i++)  {
+			sum += ((i >= 148) && (i < 156)) ? ' ' : header[i];
+		}
+		if ((member_size = tar_number((char *)header + 124, 12)) < 0)  {
+			return -1;
+		}
+		if (sum != tar_number((char *)header + 148, 8))  {
+			return -1;
+		}
+		if ((pos + TAR_BLOCK + member_size) > archive->size)  {
+			return -1;
+		}
+
+		if (header[156] == 'L')  {
+			/* A GNU long name for the next member. */
+			if (member_size > MAX_FILE_NAME)  {
+				return -1;
+			}
+			memcpy(long_name, archive->image + pos + TAR_BLOCK, member_size);
+			long_name[member_size] = '\0';
+			long_name_flag = 1;
+		}
+		else if ((header[156] == '0') || (header[156] == '\0'))  {
+			/* An ordinary file. */
+			if (long_name_flag != 0)  {
+				strcpy(name, long_name);
+				long_name_flag = 0;
+			}
+			else if ((strncmp((char *)header + 257, "ustar", 5) == 0) && (header[345] != '\0'))  {
+				sprintf(name, "%.155s/%.100s", header + 345, header);
+			}
+			else  {
+				sprintf(name, "%.100s", header);
+			}
+
+			if (archive->num_members == max_members)  {
+				max_members = max_members == 0 ? 64 : max_members * 2;
+				tmp = (struct tar_member *)realloc(archive->members, max_members * sizeof(struct tar_member));
+				if (tmp == (struct tar_member *)0)  {
+					fprintf(stderr, "realloc of tar archive index failed.\n");
+					exit(0);
+				}
+				archive->members = tmp;
+			}
+			/* Drop any leading "./", so that "./FILE.DDF" can be found as "FILE.DDF". */
+			for (i = 0; (name[i] == '.') && (name[i + 1] == '/'); i += 2)  {
+				;
+			}
+			if ((archive->members[archive->num_members].name = strdup(name + i)) == (char *)0)  {
+				fprintf(stderr, "strdup of tar member name failed.\n");
+				exit(0);
+			}
+			archive->members[archive->num_members].offset = pos + TAR_BLOCK;
+			archive->members[archive->num_members].size = member_size;
+			archive->num_members++;
+		}
+		else  {
+			long_name_flag = 0;
+		}
+
+		pos = pos + TAR_BLOCK + ((member_size + TAR_BLOCK - 1) / TAR_BLOCK) * TAR_BLOCK;
+	}
+
+	return 0;
+}
+
+
+
+
+/*
+ * Free an archive and its index.
+ */
+static void
+free_archive(struct tar_archive *archive)
+{
+	int32_t i;
+
+	for (i = 0; i < archive->num_members; i++)  {
+		free(archive->members[i].name);
+	}
+	if (archive->members != (struct tar_member *)0)  {
+		free(archive->members);
+	}
+	free_image(archive->image, archive->size, archive->mapped);
+	free(archive->file_name);
+	free(archive);
+}
+
+
+
+
+/*
+ * Open a tar archive, load it into memory, and index its members.
+ * An archive that is already open is simply returned.  Before a new
+ * archive is loaded, any archives that no module is still using are
+ * freed, so that only one unused archive is ever kept around.
+ *
+ * Returns a null pointer if the archive can't be opened, or isn't
+ * a tar archive.  (In which case errno tells why.)
+ */
+static struct tar_archive *
+open_archive(char *file_name)
+{
+	struct tar_archive *archive;
+	struct tar_archive **prev;
+
+	for (archive = archives; archive != (struct tar_archive *)0; archive = archive->next)  {
+		if (strcmp(archive->file_name, file_name) == 0)  {
+			return archive;
+		}
+	}
+
+	prev = &archives;
+	while ((archive = *prev) != (struct tar_archive *)0)  {
+		if (archive->refs == 0)  {
+			*prev = archive->next;
+			free_archive(archive);
+		}
+		else  {
+			prev = &archive->next;
+		}
+	}
+
+	if ((archive = (struct tar_archive *)calloc(1, sizeof(struct tar_archive))) == (struct tar_archive *)0)  {
+		fprintf(stderr, "calloc of tar archive failed.\n");
+		exit(0);
+	}
+	if ((archive->file_name = strdup(file_name)) == (char *)0)  {
+		fprintf(stderr, "strdup of tar archive name failed.\n");
+		exit(0);
+	}
+	if (load_image(file_name, &archive->image, &archive->size, &archive->mapped) != 0)  {
+		free(archive->file_name);
+		free(archive);
+		return (struct tar_archive *)0;
+	}
+	if (index_archive(archive) != 0)  {
+		fprintf(stderr, "%s does not appear to be a valid tar archive.\n", file_name);
+		free_archive(archive);
+		errno = EINVAL;
+		return (struct tar_archive *)0;
+	}
+
+	archive->next = archives;
+	archives = archive;
+
+	return archive;
+}
+
+
+
+
+/*
+ * Find a member of an archive by name.
+ * Returns the index of the member, or -1 if there is no such member.
+ */
+static int32_t
+find_member(struct tar_archive *archive, char *member_name)
+{
+	int32_t i;
+
+	for (i = 0; i < archive->num_members; i++)  {
+		if (strcmp(archive->members[i].name, member_name) == 0)  {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+
+
+
+/*
+ * If archive_name is the name of a tar archive, look in the archive for
+ * an SDTS module whose name has the form ????XXXX.DDF, where the first
+ * characters of XXXX are module_type (such as "LE" or "CEL").  The test is
+ * not case-sensitive.  If there is more than one, the one that comes first
+ * in the archive is used.  The name of the module, in the form that
+ * begin_ddf() understands ("archive_name/member_name"), is put into
+ * file_name, which must have room for MAX_FILE_NAME + 1 bytes.
+ *
+ * Returns 1 if a module was found, 0 if archive_name isn't the name of
+ * a tar archive, and -1 if it is, but the archive can't be read or has
+ * no such module.
+ */
+int32_t
+sdts_archive_find(char *archive_name, char *module_type, char *file_name)
+{
+	int32_t i;
+	int32_t length;
+	int32_t type_length;
+	char *name;
+	struct tar_archive *archive;
+
+	length = strlen(archive_name);
+	if (tar_suffix(archive_name, length) == 0)  {
+		return 0;
+	}
+	if ((archive = open_archive(archive_name)) == (struct tar_archive *)0)  {
+		return -1;
+	}
+
+	type_length = strlen(module_type);
+	for (i = 0; i < archive->num_members; i++)  {
+		name = archive->members[i].name;
+		length = strlen(name);
+		if ((length >= 12) && (strcasecmp(name + length - 4, ".ddf") == 0) &&
+		    (strncasecmp(name + length - 8, module_type, type_length) == 0))  {
+			if ((strlen(archive_name) + length + 1) > MAX_FILE_NAME)  {
+				return -1;
+			}
+			sprintf(file_name, "%s/%s", archive_name, name);
+			return 1;
+		}
+	}
+
+	return -1;
+}
+
+
+
+
+/*
+ * Return non-zero if file_name refers to a file inside a tar archive,
+ * (like "transfer.tar.gz/MODULE.DDF"), rather than an ordinary file,
+ * and the archive actually holds the file.
+ */
+int32_t
+sdts_archive_member(char *file_name)
+{
+	int32_t length;
+	char archive_name[MAX_FILE_NAME + 1];
+	struct tar_archive *archive;
+
+	if ((length = archive_path(file_name)) == 0)  {
+		return 0;
+	}
+	strncpy(archive_name, file_name, length);
+	archive_name[length] = '\0';
+	if ((archive = open_archive(archive_name)) == (struct tar_archive *)0)  {
+		return 0;
+	}
+
+	return find_member(archive, file_name + length + 1) >= 0;
+}
+
+
+
+
+/*
+ * Load a DDF file into memory, and parse its DDR.
+ * If the file is inside a tar archive, then the module
+ * simply points at the member's contents within the archive.
+ *
+ * Returns a pointer to the new module, or a null pointer if the file
+ * can't be opened or read.  (In which case errno tells why.)
+ */
+static struct ddf_module *
+load_module(char *file_name)
+{
+	int32_t i;
+	int32_t length;
+	char archive_name[MAX_FILE_NAME + 1];
+	struct tar_archive *archive;
+	struct ddf_module *module;
+
+	if ((module = (struct ddf_module *)calloc(1, sizeof(struct ddf_module))) == (struct ddf_module *)0)  {
+		fprintf(stderr, "calloc of DDF module failed.\n");
+		exit(0);
+	}
+	if ((module->file_name = strdup(file_name)) == (char *)0)  {
+		fprintf(stderr, "strdup of DDF module name failed.\n");
+		exit(0);
+	}
+
+	if ((length = archive_path(file_name)) != 0)  {
+		strncpy(archive_name, file_name, length);
+		archive_name[length] = '\0';
+		if ((archive = open_archive(archive_name)) == (struct tar_archive *)0)  {
+			free(module->file_name);
+			free(module);
+			return (struct ddf_module *)0;
+		}
+		if ((i = find_member(archive, file_name + length + 1)) < 0)  {
+			free(module->file_name);
+			free(module);
+			errno = ENOENT;
+			return (struct ddf_module *)0;
+		}
+		module->image = archive->image + archive->members[i].offset;
+		module->size = archive->members[i].size;
+		module->archive = archive;
+		archive->refs++;
+	}
+	else if (load_image(file_name, &module->image, &module->size, &module->mapped) != 0)  {
+		free(module->file_name);
+		free(module);
+		return (struct ddf_module *)0;
+	}
+
+	/*
+	 * Read and parse the DDR.
+	 */
+	parse_ddr(module);
+
+	return module;
+}
+
+
+
+
+/*
+ * Free a module, and everything in it.
+ */
+static void
+free_module(struct ddf_module *module)
+{
+	if (module->archive != (struct tar_archive *)0)  {
+		module->archive->refs--;
+	}
+	else  {
+		free_image(module->image, module->size, module->mapped);
+	}
+	if (module->ddr_buf != (char *)0)  {
+		free(module->ddr_buf);
+	}
+	free(module->file_name);
+	free(module);
+}
+
+
+
+
+/*
+ * Create a new handle, positioned at the first DR of a module.
+ * If own_module is non-zero, the module is freed when the handle is closed.
+ */
+static struct ddf *
+new_handle(struct ddf_module *module, int32_t own_module)
+{
+	struct ddf *h;
+
+	if ((h = (struct ddf *)calloc(1, sizeof(struct ddf))) == (struct ddf *)0)  {
+		fprintf(stderr, "calloc of DDF handle failed.\n");
+		exit(0);
+	}
+	h->module = module;
+	h->own_module = own_module;
+	h->pos = module->dr_start;
+	h->leaderless_flag = 0;
+	h->leaderless_pos = -1;
+	h->dr.num_tags = 0;
+	h->dr_tag = MAX_TAGS;
+	h->dr_label = MAX_SUBFIELDS;
+
+	return h;
+}
+
+
+
+
+/*
+ * Open a DDF file for processing, and return a handle for it.
+ * Returns a null pointer if the file can't be opened.
+ */
+struct ddf *
+ddf_open(char *file_name)
+{
+	struct ddf_module *module;
+
+	if ((module = load_module(file_name)) == (struct ddf_module *)0)  {
+		return (struct ddf *)0;
+	}
+
+	return new_handle(module, 1);
+}
+
+
+
+
+/*
+ * Close a DDF handle.
+ */
+void
+ddf_close(struct ddf *h)
+{
+	if (h->own_module != 0)  {
+		free_module(h->module);
+	}
+	if (h->value_buf != (char *)0)  {
+		free(h->value_buf);
+	}
+	free(h);
+}
+
+
+
+
+/*
+ * Create an empty transfer.  Modules are added to it as
+ * they are opened with sdts_open_file().
+ */
+struct sdts_transfer *
+sdts_open_transfer()
+{
+	struct sdts_transfer *transfer;
+
+	if ((transfer = (struct sdts_transfer *)calloc(1, sizeof(struct sdts_transfer))) == (struct sdts_transfer *)0)  {
+		fprintf(stderr, "calloc of SDTS transfer failed.\n");
+		exit(0);
+	}
+
+	return transfer;
+}
+
+
+
+
+/*
+ * Open one module of a transfer, and return a new handle for it.
+ * The module is loaded the first time it is opened, and is then
+ * shared by every handle that opens it, until the transfer is
+ * closed.  The handles may be read in any order.
+ *
+ * Returns a null pointer if the file can't be opened.
+ */
+struct ddf *
+sdts_open_file(struct sdts_transfer *transfer, char *file_name)
+{
+	struct ddf_module *module;
+
+	for (module = transfer->modules; module != (struct ddf_module *)0; module = module->next)  {
+		if (strcmp(module->file_name, file_name) == 0)  {
+			break;
+		}
+	}
+	if (module == (struct ddf_module *)0)  {
+		if ((module = load_module(file_name)) == (struct ddf_module *)0)  {
+			return (struct ddf *)0;
+		}
+		module->next = transfer->modules;
+		transfer->modules = module;
+	}
+
+	return new_handle(module, 0);
+}
+
+
+
+
+/*
+ * Make begin_ddf() get its files from the given transfer, or, if
+ * transfer is a null pointer, go back to opening files directly.
+ */
+void
+sdts_use_transfer(struct sdts_transfer *transfer)
+{
+	current_transfer = transfer;
+}
+
+
+
+
+/*
+ * Close a transfer, and free all of its modules.
+ * All of the handles opened with sdts_open_file() must
+ * already have been closed.
+ */
+void
+sdts_close_transfer(struct sdts_transfer *transfer)
+{
+	struct ddf_module *module;
+
+	if (current_transfer == transfer)  {
+		current_transfer = (struct sdts_transfer *)0;
+	}
+
+	while ((module = transfer->modules) != (struct ddf_module *)0)  {
+		transfer->modules = module->next;
+		free_module(module);
+	}
+	free(transfer);
+}
+
+
+
+
+/*
+ * Open a DDF file for processing with get_subfield().
+ * Returns 0 on success, or -1 if the file can't be opened.
+ *
+ * Any file still open from a previous begin_ddf() is closed first.
+ */
+int32_t
+begin_ddf(char *file_name)
+{
+	if (current_ddf != (struct ddf *)0)  {
+		end_ddf();
+	}
+
+	if (current_transfer != (struct sdts_transfer *)0)  {
+		current_ddf = sdts_open_file(current_transfer, file_name);
+	}
+	else  {
+		current_ddf = ddf_open(file_name);
+	}
+
+	return current_ddf == (struct ddf *)0 ? -1 : 0;
+}
+
+
+
+
+/*
+ * Get the next subfield from the file opened with begin_ddf().
+ * (See ddf_get_subfield().)
+ */
+int32_t
+get_subfield(struct subfield *subfield)
+{
+	return ddf_get_subfield(current_ddf, subfield);
+}
+
+
+
+
+/*
+ * Close the file opened with begin_ddf().
+ */
+void
+end_ddf()
+{
+	ddf_close(current_ddf);
+	current_ddf = (struct ddf *)0;
 }
 
 
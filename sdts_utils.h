@@ -33,6 +33,93 @@ struct subfield  {
 };
 
 
+/*
+ * Callers that want whole records, rather than a subfield at
+ * a time, fill in an array of these, one per (tag, label) pair
+ * of interest, and hand the array to ddf_bind() and get_record().
+ * get_record() then delivers converted values straight into the
+ * caller's storage.
+ *
+ * A subfield that repeats within a record (like the X and Y
+ * coordinates of a line) delivers one value per repetition, at
+ * dest, dest + stride, dest + 2 * stride, and so on.  A stride of
+ * zero means the values are packed together.  At most max values
+ * are stored, but count is the number actually present, so a caller
+ * that finds count > max can grow dest and call decode_record() to
+ * decode the same record again.
+ *
+ * Binary ('B') subfields are converted according to the type requested:
+ * DDF_INT treats them as two's-complement integers, and DDF_DOUBLE treats
+ * 32-bit values as IEEE 754 floating point (and 16-bit values as integers).
+ * DDF_SHORT does the same as DDF_DOUBLE, and then rounds the result to
+ * the nearest integer, which suits elevation grids.  A packed (stride 0)
+ * DDF_SHORT or DDF_DOUBLE item, bound to a field that is just an array
+ * of fixed-width binary values, has the whole array converted in bulk.
+ * A DDF_STRING destination receives a struct ddf_string that points into
+ * the record (which may be a read-only mapping of the file), so it must
+ * not be written into, and is only valid until the next record is read.
+ */
+#define DDF_INT		1	// dest is int32_t
+#define DDF_DOUBLE	2	// dest is double
+#define DDF_STRING	3	// dest is struct ddf_string
+#define DDF_SHORT	4	// dest is short
+
+struct ddf_string  {
+	char *value;		// Not null-terminated.
+	int32_t length;
+};
+
+struct ddf_item  {
+	char *tag;		// Field tag, such as "SADR".
+	char *label;		// Subfield label, such as "X".  Use "" for elementary fields.
+	int32_t type;		// DDF_INT, DDF_DOUBLE, or DDF_STRING.
+	void *dest;		// Where the values go.
+	int32_t stride;		// Bytes between successive values, or 0 for packed values.
+	int32_t max;		// Number of values that fit at dest.
+	int32_t count;		// Set by get_record():  number of values in the current record.
+	char format;		// Set by ddf_bind():  format letter from the DDR ('A', 'I', 'R', 'B'), or 0.
+	int32_t size;		// Set by ddf_bind():  subfield width in bytes, or 0 if delimited.
+	int32_t field;		// Set by ddf_bind():  index of the field in the DDR, or -1 if the subfield isn't available.
+	int32_t subfield;	// Set by ddf_bind():  index of the subfield within the field.
+};
+
+
+/*
+ * A DDF handle (struct ddf) is one reader of one DDF file.  Each handle
+ * keeps its own position and decoding state, so any number of them can
+ * be open at once.  A transfer (struct sdts_transfer) holds the modules
+ * of an SDTS transfer in memory, so that each one is only loaded, and
+ * its DDR only parsed, once, no matter how many times it is opened.
+ * The contents of both structures are private to sdts_utils.c.
+ *
+ * Any of the open functions will also take the name of a file inside
+ * a tar archive, in the form "archive.tar.gz/MODULE.DDF".
+ *
+ * ddf_tell() and ddf_seek() let a caller note where records are,
+ * and come back to read them again later.
+ *
+ * begin_ddf(), get_subfield(), and end_ddf() are the original interface,
+ * which reads one file at a time through a hidden handle.
+ */
+struct ddf;
+struct sdts_transfer;
+
+struct ddf *ddf_open(char *);
+void ddf_close(struct ddf *);
+int32_t ddf_get_subfield(struct ddf *, struct subfield *);
+int32_t ddf_bind(struct ddf *, struct ddf_item *, int32_t);
+int32_t get_record(struct ddf *, struct ddf_item *, int32_t);
+void decode_record(struct ddf *, struct ddf_item *, int32_t);
+int32_t ddf_tell(struct ddf *);
+void ddf_seek(struct ddf *, int32_t);
+
+struct sdts_transfer *sdts_open_transfer();
+struct ddf *sdts_open_file(struct sdts_transfer *, char *);
+void sdts_use_transfer(struct sdts_transfer *);
+void sdts_close_transfer(struct sdts_transfer *);
+int32_t sdts_archive_find(char *, char *, char *);
+int32_t sdts_archive_member(char *);
+
 void print_ddr();
 int32_t get_subfield(struct subfield *);
 int32_t begin_ddf(char *);
@@ -0,0 +1,318 @@
+/*
+ * =========================================================================
+ * tmcompare - A program that compares the transverse Mercator engines
+ * Copyright (c) 2026  The drawmap contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * =========================================================================
+ *
+ *
+ * Program to compare the two transverse Mercator engines in utilities.c
+ * (Redfearn's formulas, and Kruger's series), for accuracy and for speed.
+ *
+ * For a range of distances from the central meridian, it projects a column
+ * of points, from the equator to 80 degrees north, into a single UTM zone,
+ * and then back again, and reports the worst round-trip error for each
+ * engine, and the worst disagreement between the two engines.  Then it
+ * times the single-point and batch versions of the forward and inverse
+ * projections, in nanoseconds per point.
+ *
+ * The round-trip error is a measure of how consistent each engine is with
+ * itself, not of how accurate it is, but Redfearn's formulas lose both
+ * together as one moves away from the central meridian.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include "drawmap.h"
+
+
+#define ZONE		14		// UTM zone used for all of the tests.  Its central meridian is 99 W.
+#define NUM_LATITUDES	81		// Test latitudes, one degree apart, starting at the equator.
+#define NUM_TIMED	200000		// Number of points in each timing run.
+
+
+extern int32_t tm_engine;	// Defined and initialized in utilities.c, which selects the transverse Mercator engine
+
+
+void
+license(void)
+{
+	fprintf(stderr, "This program is free software; you can redistribute it and/or modify\n");
+	fprintf(stderr, "it under the terms of the GNU General Public License as published by\n");
+	fprintf(stderr, "the Free Software Foundation; either version 2, or (at your option)\n");
+	fprintf(stderr, "any later version.\n\n");
+
+	fprintf(stderr, "This program is distributed in the hope that it will be useful,\n");
+	fprintf(stderr, "but WITHOUT ANY WARRANTY; without even the implied warranty of\n");
+	fprintf(stderr, "MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n");
+	fprintf(stderr, "GNU General Public License for more details.\n\n");
+
+	fprintf(stderr, "You should have received a copy of the GNU General Public License\n");
+	fprintf(stderr, "along with this program; if not, write to the Free Software\n");
+	fprintf(stderr, "Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.\n");
+}
+
+
+
+/*
+ * The time, in seconds.
+ */
+double
+get_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, (struct timezone *)0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+
+
+/*
+ * The approximate distance, in meters, between two nearby points
+ * given in latitude and longitude.
+ */
+double
+ground_distance(struct datum *datum, double lat1, double long1, double lat2, double long2)
+{
+	double dx, dy;
+
+	dy = (lat2 - lat1) * M_PI / 180.0 * datum->a;
+	dx = (long2 - long1) * M_PI / 180.0 * datum->a * cos(lat1 * M_PI / 180.0);
+
+	return sqrt(dx * dx + dy * dy);
+}
+
+
+
+/*
+ * Project a column of points, offset degrees east of the central meridian,
+ * with the given engine.  The UTM coordinates go into utm_x and utm_y, and
+ * the worst round-trip error, in meters, is returned.  If the projection fails,
+ * -1 is returned.
+ */
+double
+round_trip(struct datum *datum, int32_t engine, double offset, double *utm_x, double *utm_y)
+{
+	double latitude[NUM_LATITUDES], longitude[NUM_LATITUDES];
+	double latitude2[NUM_LATITUDES], longitude2[NUM_LATITUDES];
+	double error, max_error = 0.0;
+	int32_t i;
+
+	for (i = 0; i < NUM_LATITUDES; i++)  {
+		latitude[i] = (double)i;
+		longitude[i] = -99.0 + offset;
+	}
+
+	tm_engine = engine;
+	if ((redfearn_array(datum, utm_x, utm_y, ZONE, latitude, longitude, NUM_LATITUDES) != 0) ||
+	    (redfearn_inverse_array(datum, utm_x, utm_y, ZONE, latitude2, longitude2, NUM_LATITUDES) != 0))  {
+		return -1.0;
+	}
+
+	for (i = 0; i < NUM_LATITUDES; i++)  {
+		error = ground_distance(datum, latitude[i], longitude[i], latitude2[i], longitude2[i]);
+		if (error > max_error)  {
+			max_error = error;
+		}
+	}
+
+	return max_error;
+}
+
+
+
+/*
+ * Time the four projection routines with the given engine, and print
+ * the results in nanoseconds per point.  The points zig-zag back and forth
+ * across the test zone, so that, as in a DLG line, each point is close
+ * to the one before it.
+ */
+void
+time_engine(struct datum *datum, int32_t engine, char *name)
+{
+	double *latitude, *longitude, *utm_x, *utm_y;
+	double start, scalar_fwd, scalar_inv, batch_fwd, batch_inv;
+	int32_t zone;
+	int32_t i;
+
+	latitude = (double *)malloc(4 * NUM_TIMED * sizeof(double));
+	if (latitude == (double *)0)  {
+		fprintf(stderr, "malloc of timing arrays failed\n");
+		exit(0);
+	}
+	longitude = latitude + NUM_TIMED;
+	utm_x = longitude + NUM_TIMED;
+	utm_y = utm_x + NUM_TIMED;
+
+	for (i = 0; i < NUM_TIMED; i++)  {
+		latitude[i] = 25.0 + 24.0 * (double)i / (double)NUM_TIMED;
+		longitude[i] = -101.9 + 5.8 * fabs((double)(i % 2000) / 1000.0 - 1.0);
+	}
+
+	tm_engine = engine;
+
+	start = get_time();
+	for (i = 0; i < NUM_TIMED; i++)  {
+		(void)redfearn(datum, &utm_x[i], &utm_y[i], &zone, latitude[i], longitude[i], 0);
+	}
+	scalar_fwd = get_time() - start;
+
+	start = get_time();
+	for (i = 0; i < NUM_TIMED; i++)  {
+		(void)redfearn_inverse(datum, utm_x[i], utm_y[i], ZONE, &latitude[i], &longitude[i]);
+	}
+	scalar_inv = get_time() - start;
+
+	start = get_time();
+	(void)redfearn_array(datum, utm_x, utm_y, ZONE, latitude, longitude, NUM_TIMED);
+	batch_fwd = get_time() - start;
+
+	start = get_time();
+	(void)redfearn_inverse_array(datum, utm_x, utm_y, ZONE, latitude, longitude, NUM_TIMED);
+	batch_inv = get_time() - start;
+
+	fprintf(stdout, "%-10s %12.0f %12.0f %12.0f %12.0f\n", name,
+		scalar_fwd * 1.0e9 / NUM_TIMED, scalar_inv * 1.0e9 / NUM_TIMED,
+		batch_fwd * 1.0e9 / NUM_TIMED, batch_inv * 1.0e9 / NUM_TIMED);
+
+	free(latitude);
+}
+
+
+
+int
+main(int argc, char *argv[])
+{
+	static double offsets[] = { 0.5, 1.0, 3.0, 6.0, 10.0, 15.0, 20.0 };
+	double redfearn_x[NUM_LATITUDES], redfearn_y[NUM_LATITUDES];
+	double kruger_x[NUM_LATITUDES], kruger_y[NUM_LATITUDES];
+	double redfearn_error, kruger_error, difference, max_difference;
+	int32_t dtype;
+	int32_t i, j;
+	struct datum datum;
+
+	if (argc > 2)  {
+		fprintf(stderr, "Compares the Redfearn and Kruger transverse Mercator engines.\n");
+		fprintf(stderr, "Usage:  %s [nad27 | nad83 | wgs84]\n", argv[0]);
+		fprintf(stderr, "The default is nad27.\n");
+		exit(0);
+	}
+	if (argc == 2)  {
+		if ((argv[1][0] == '-') && (argv[1][1] == 'L'))  {
+			license();
+			exit(0);
+		}
+		if (strcmp(argv[1], "nad27")  == 0)  {
+			dtype = 0;
+		}
+		else if (strcmp(argv[1], "nad83") == 0)  {
+			dtype = 1;
+		}
+		else if (strcmp(argv[1], "wgs84") == 0)  {
+			dtype = 2;
+		}
+		else  {
+			fprintf(stderr, "Unknown datum specified.\n");
+			fprintf(stderr, "Usage:  %s [nad27 | nad83 | wgs84]\n", argv[0]);
+			fprintf(stderr, "Default is nad27.\n");
+			exit(0);
+		}
+	}
+	else  {
+		dtype = 0;
+	}
+
+
+	/*
+	 * The Kruger coefficients are filled in on first use,
+	 * so start with a clean structure.
+	 */
+	memset(&datum, 0, sizeof(datum));
+	if (dtype == 0)  {
+		/* Fill in the datum parameters for NAD-27. */
+		datum.a = NAD27_SEMIMAJOR;
+		datum.b = NAD27_SEMIMINOR;
+		datum.e_2 = NAD27_E_SQUARED;
+		datum.f_inv = NAD27_F_INV;
+		datum.k0 = UTM_K0;
+		datum.a0 = NAD27_A0;
+		datum.a2 = NAD27_A2;
+		datum.a4 = NAD27_A4;
+		datum.a6 = NAD27_A6;
+	}
+	else if (dtype == 1)  {
+		/* Fill in the datum parameters for NAD-83. */
+		datum.a = NAD83_SEMIMAJOR;
+		datum.b = NAD83_SEMIMINOR;
+		datum.e_2 = NAD83_E_SQUARED;
+		datum.f_inv = NAD83_F_INV;
+		datum.k0 = UTM_K0;
+		datum.a0 = NAD83_A0;
+		datum.a2 = NAD83_A2;
+		datum.a4 = NAD83_A4;
+		datum.a6 = NAD83_A6;
+	}
+	else  {
+		/* Fill in the datum parameters for WGS-84. */
+		datum.a = WGS84_SEMIMAJOR;
+		datum.b = WGS84_SEMIMINOR;
+		datum.e_2 = WGS84_E_SQUARED;
+		datum.f_inv = WGS84_F_INV;
+		datum.k0 = UTM_K0;
+		datum.a0 = WGS84_A0;
+		datum.a2 = WGS84_A2;
+		datum.a4 = WGS84_A4;
+		datum.a6 = WGS84_A6;
+	}
+
+
+	fprintf(stdout, "Worst errors, in meters, over latitudes 0 to 80 N:\n\n");
+	fprintf(stdout, "%-10s %16s %16s %16s\n", "offset", "Redfearn trip", "Kruger trip", "difference");
+	for (j = 0; j < (int32_t)(sizeof(offsets) / sizeof(offsets[0])); j++)  {
+		redfearn_error = round_trip(&datum, TM_REDFEARN, offsets[j], redfearn_x, redfearn_y);
+		kruger_error = round_trip(&datum, TM_KRUGER, offsets[j], kruger_x, kruger_y);
+		if ((redfearn_error < 0.0) || (kruger_error < 0.0))  {
+			fprintf(stdout, "%-7.1f deg %16s\n", offsets[j], "projection failed");
+			continue;
+		}
+
+		max_difference = 0.0;
+		for (i = 0; i < NUM_LATITUDES; i++)  {
+			difference = sqrt((redfearn_x[i] - kruger_x[i]) * (redfearn_x[i] - kruger_x[i]) +
+					  (redfearn_y[i] - kruger_y[i]) * (redfearn_y[i] - kruger_y[i]));
+			if (difference > max_difference)  {
+				max_difference = difference;
+			}
+		}
+
+		fprintf(stdout, "%-7.1f deg %16.3g %16.3g %16.3g\n", offsets[j], redfearn_error, kruger_error, max_difference);
+	}
+
+	fprintf(stdout, "\nTimes, in nanoseconds per point:\n\n");
+	fprintf(stdout, "%-10s %12s %12s %12s %12s\n", "engine", "forward", "inverse", "batch fwd", "batch inv");
+	time_engine(&datum, TM_REDFEARN, "Redfearn");
+	time_engine(&datum, TM_KRUGER, "Kruger");
+
+	tm_engine = TM_REDFEARN;
+
+	exit(0);
+}
@@ -25,6 +25,17 @@
 #include "drawmap.h"
 
 
+static void kruger_forward(struct datum *, double, double, double *, double *);
+static void kruger_inverse(struct datum *, double, double, double *, double *);
+
+
+/*
+ * The transverse Mercator engine used by redfearn(), redfearn_inverse(),
+ * and their batch versions.  See the comments above kruger_init().
+ */
+int32_t tm_engine = TM_REDFEARN;
+
+
 /*
  * Convert latitudes in degree/min/sec format into decimal degrees.
  *
@@ -474,6 +485,13 @@ redfearn_inverse(struct datum *datum, double utm_x, double utm_y, int32_t zone,
 		lat_pm = M_PI / 4.0;
 	}
 
+	if (tm_engine == TM_KRUGER)  {
+		kruger_inverse(datum, x, y, latitude, longitude);
+		*latitude = *latitude * 180.0 / M_PI;
+		*longitude = utm_zones[zone].central_meridian + *longitude * 180.0 / M_PI;
+		return 0;
+	}
+
 	/*
 	 * Find lat_pm, via iterative Newton's method.
 	 * The goal is to find lat_pm, such that m == y, or equivalently
@@ -601,6 +619,18 @@ redfearn(struct datum *datum, double *utm_x, double *utm_y, int32_t *zone, doubl
 
 	o = (longitude - utm_zones[*zone].central_meridian) * M_PI / 180.0;
 
+	if (tm_engine == TM_KRUGER)  {
+		kruger_forward(datum, latitude * M_PI / 180.0, o, utm_x, utm_y);
+		*utm_x = 500000.0 + datum->k0 * *utm_x;
+		*utm_y = datum->k0 * *utm_y;
+		if (latitude < 0)  {
+			/* In the southern hemisphere, we return a negative zone number. */
+			*zone = -*zone;
+			*utm_y += 10000000.0;
+		}
+		return 0;
+	}
+
 	latitude *= M_PI / 180.0;
 	longitude *= M_PI / 180.0;
 	slat = sin(latitude);
@@ -657,6 +687,485 @@ redfearn(struct datum *datum, double *utm_x, double *utm_y, int32_t *zone, doubl
 
 
 
+/*
+ * The following two functions are batch versions of redfearn_inverse() and
+ * redfearn().  They convert whole arrays of points that share a datum and a
+ * UTM zone, which is the common case when drawing DLG lines or filling DLG
+ * areas, and when transferring UTM DEM data into the image.
+ *
+ * They evaluate the same series as the single-point versions, but arrange the
+ * arithmetic to be cheaper:
+ *
+ *	The zone check, the central meridian, and the products of the datum
+ *	constants are computed once per call, rather than once per point.
+ *
+ *	The multiple-angle terms, sin(2*lat), sin(4*lat), sin(6*lat) (and the
+ *	matching cosines), are built from a single sin/cos pair with the
+ *	double-angle and angle-sum identities.
+ *
+ *	The radii of curvature share a single square root, and pow() is gone.
+ *	(Note that phi = nu / rho = (1 - e^2 * sin^2(lat)) / (1 - e^2).)
+ *
+ *	The series are evaluated in Horner form, in powers of d^2 (or omega^2 * cos^2(lat)).
+ *
+ *	In redfearn_inverse_array(), Newton's method for the foot-point latitude
+ *	starts from the foot-point latitude of the previous point, rather than from
+ *	45 degrees.  Consecutive points in a line are close together, so it usually
+ *	converges in one or two steps.  The convergence test is the same one that
+ *	redfearn_inverse() uses, so the answer is just as good.
+ *
+ * The loops over the points are straight-line code, with no function calls other
+ * than sin(), cos(), and sqrt(), so a vectorizing compiler has a fair chance with them.
+ * The results agree with the single-point versions to well under a millimeter.
+ *
+ * Note:  Both functions return 0 if the conversions appear to be successful, nonzero otherwise.
+ *        Unlike redfearn(), redfearn_array() does not pick the zone.  The caller
+ *        supplies it, and all of the points are projected into that zone.
+ *        As with redfearn(), a point in the southern hemisphere gets the false northing.
+ */
+int32_t
+redfearn_inverse_array(struct datum *datum, double *utm_x, double *utm_y, int32_t zone,
+		double *latitude, double *longitude, int32_t num_points)
+{
+	double x, y;	// UTM coordinates with false easting and northing removed and scale factor applied.
+	double lat_pm;	// foot-point latitude
+	double y_offset;
+	double central_meridian;
+	double aa0, aa2, aa4, aa6;
+	double one_minus_e_2;
+	double m, m_pm;
+	double s2, c2, s4, c4, s6, c6;
+	double slat, slat_2, clat, w;
+	double d, d_2, t_pm, t_pm_2, t_pm_4, t_pm_6;
+	double nu_pm, phi_pm, phi_pm_2, phi_pm_3, phi_pm_4;
+	int32_t i, j;
+
+	if ((zone > 60) || (zone == 0) || (zone < -60)) {
+		return -1;
+	}
+	if (zone < 0)  {
+		/* southern hemisphere */
+		zone = -zone;
+		y_offset = 10000000.0;
+		lat_pm = -M_PI / 4.0;
+	}
+	else  {
+		y_offset = 0.0;
+		lat_pm = M_PI / 4.0;
+	}
+	central_meridian = utm_zones[zone].central_meridian;
+
+	aa0 = datum->a * datum->a0;
+	aa2 = datum->a * datum->a2;
+	aa4 = datum->a * datum->a4;
+	aa6 = datum->a * datum->a6;
+	one_minus_e_2 = 1.0 - datum->e_2;
+
+	if (tm_engine == TM_KRUGER)  {
+		for (i = 0; i < num_points; i++)  {
+			kruger_inverse(datum, (utm_x[i] - 500000.0) / datum->k0, (utm_y[i] - y_offset) / datum->k0, &latitude[i], &longitude[i]);
+			latitude[i] = latitude[i] * 180.0 / M_PI;
+			longitude[i] = central_meridian + longitude[i] * 180.0 / M_PI;
+		}
+		return 0;
+	}
+
+	for (i = 0; i < num_points; i++)  {
+		x = (utm_x[i] - 500000.0) / datum->k0;
+		y = (utm_y[i] - y_offset) / datum->k0;
+
+		/* Find lat_pm, via Newton's method, as in redfearn_inverse(). */
+		for (j = 0; j < 100; j++)  {
+			s2 = sin(2.0 * lat_pm);
+			c2 = cos(2.0 * lat_pm);
+			s4 = 2.0 * s2 * c2;
+			c4 = 1.0 - 2.0 * s2 * s2;
+			s6 = s4 * c2 + c4 * s2;
+			c6 = c4 * c2 - s4 * s2;
+			m = aa0 * lat_pm - aa2 * s2 + aa4 * s4 - aa6 * s6 - y;
+			m_pm = aa0 - 2.0 * aa2 * c2 + 4.0 * aa4 * c4 - 6.0 * aa6 * c6;
+			if (fabs(m / m_pm) < 1.0e-12)  {
+				break;
+			}
+			lat_pm -= m / m_pm;
+		}
+
+		slat = sin(lat_pm);
+		slat_2 = slat * slat;
+		clat = sqrt(1.0 - slat_2);
+		t_pm = slat / clat;
+
+		w = 1.0 - datum->e_2 * slat_2;
+		nu_pm = datum->a / sqrt(w);
+		phi_pm = w / one_minus_e_2;
+		d = x / nu_pm;
+
+		d_2 = d * d;
+		t_pm_2 = t_pm * t_pm;
+		t_pm_4 = t_pm_2 * t_pm_2;
+		t_pm_6 = t_pm_2 * t_pm_4;
+		phi_pm_2 = phi_pm * phi_pm;
+		phi_pm_3 = phi_pm_2 * phi_pm;
+		phi_pm_4 = phi_pm_3 * phi_pm;
+
+		latitude[i] = (lat_pm - phi_pm * t_pm * d_2 * (1.0 / 2.0 -
+				d_2 * ((-4.0 * phi_pm_2 + 9.0 * phi_pm * (1.0 - t_pm_2) + 12.0 * t_pm_2) / 24.0 -
+				d_2 * ((8.0 * phi_pm_4 * (11.0 - 24.0 * t_pm_2) - 12.0 * phi_pm_3 * (21.0 - 71.0 * t_pm_2) +
+					15.0 * phi_pm_2 * (15.0 - 98.0 * t_pm_2 + 15.0 * t_pm_4) +
+					180.0 * phi_pm * (5.0 * t_pm_2 - 3.0 * t_pm_4) + 360.0 * t_pm_4) / 720.0 -
+				d_2 * (1385.0 + 3633.0 * t_pm_2 + 4095.0 * t_pm_4 + 1575.0 * t_pm_6) / 40320.0)))) * 180.0 / M_PI;
+		longitude[i] = central_meridian + (d * (1.0 -
+				d_2 * ((phi_pm + 2.0 * t_pm_2) / 6.0 -
+				d_2 * ((-4.0 * phi_pm_3 * (1.0 - 6.0 * t_pm_2) + phi_pm_2 * (9.0 - 68.0 * t_pm_2) +
+					72.0 * phi_pm * t_pm_2 + 24.0 * t_pm_4) / 120.0 -
+				d_2 * (61.0 + 662.0 * t_pm_2 + 1320.0 * t_pm_4 + 720.0 * t_pm_6) / 5040.0))) / clat) * 180.0 / M_PI;
+	}
+
+	return 0;
+}
+
+int32_t
+redfearn_array(struct datum *datum, double *utm_x, double *utm_y, int32_t zone,
+		double *latitude, double *longitude, int32_t num_points)
+{
+	double central_meridian;
+	double aa0, aa2, aa4, aa6;
+	double one_minus_e_2;
+	double lat, o, o_2, u;
+	double m;
+	double s2, c2, s4, c4, s6;
+	double slat, slat_2, clat, w;
+	double t, t_2, t_4, t_6;
+	double nu, phi, phi_2, phi_3, phi_4;
+	int32_t ret_val = 0;
+	int32_t i;
+
+	if (zone < 0)  {
+		zone = -zone;
+	}
+	if ((zone > 60) || (zone == 0)) {
+		return -1;
+	}
+	central_meridian = utm_zones[zone].central_meridian;
+
+	aa0 = datum->a * datum->a0;
+	aa2 = datum->a * datum->a2;
+	aa4 = datum->a * datum->a4;
+	aa6 = datum->a * datum->a6;
+	one_minus_e_2 = 1.0 - datum->e_2;
+
+	for (i = 0; i < num_points; i++)  {
+		if ((latitude[i] > 90.0) || (latitude[i] < -90.0) || (longitude[i] > 180.0) || (longitude[i] < -180.0))  {
+			/* Leave this point alone, but let the caller know about it. */
+			ret_val = -1;
+			continue;
+		}
+
+		o = (longitude[i] - central_meridian) * M_PI / 180.0;
+		lat = latitude[i] * M_PI / 180.0;
+
+		if (tm_engine == TM_KRUGER)  {
+			kruger_forward(datum, lat, o, &utm_x[i], &utm_y[i]);
+			utm_x[i] = 500000.0 + datum->k0 * utm_x[i];
+			utm_y[i] = datum->k0 * utm_y[i];
+			if (lat < 0)  {
+				utm_y[i] += 10000000.0;
+			}
+			continue;
+		}
+
+		slat = sin(lat);
+		slat_2 = slat * slat;
+		clat = sqrt(1.0 - slat_2);	// cos(latitude)
+		t = slat / clat;		// tan(latitude)
+
+		s2 = 2.0 * slat * clat;
+		c2 = 1.0 - 2.0 * slat_2;
+		s4 = 2.0 * s2 * c2;
+		c4 = 1.0 - 2.0 * s2 * s2;
+		s6 = s4 * c2 + c4 * s2;
+		m = aa0 * lat - aa2 * s2 + aa4 * s4 - aa6 * s6;
+
+		w = 1.0 - datum->e_2 * slat_2;
+		nu = datum->a / sqrt(w);
+		phi = w / one_minus_e_2;
+
+		t_2 = t * t;
+		t_4 = t_2 * t_2;
+		t_6 = t_2 * t_4;
+		phi_2 = phi * phi;
+		phi_3 = phi_2 * phi;
+		phi_4 = phi_2 * phi_2;
+		o_2 = o * o;
+		u = o_2 * clat * clat;
+
+		utm_x[i] = 500000.0 + datum->k0 * nu * clat * o * (1.0 +
+				u * ((phi - t_2) / 6.0 +
+				u * ((4.0 * phi_3 * (1.0 - 6.0 * t_2) + phi_2 * (1.0 + 8.0 * t_2) - 2.0 * phi * t_2 + t_4) / 120.0 +
+				u * (61.0 - 479.0 * t_2 + 179.0 * t_4 - t_6) / 5040.0)));
+		utm_y[i] = datum->k0 * (m + nu * slat * clat * o_2 * (1.0 / 2.0 +
+				u * ((4.0 * phi_2 + phi - t_2) / 24.0 +
+				u * ((8.0 * phi_4 * (11.0 - 24.0 * t_2) - 28.0 * phi_3 * (1.0 - 6.0 * t_2) +
+					phi_2 * (1.0 - 32.0 * t_2) - 2.0 * phi * t_2 + t_4) / 720.0 +
+				u * (1385.0 - 3111.0 * t_2 + 543.0 * t_4 - t_6) / 40320.0))));
+
+		if (lat < 0)  {
+			utm_y[i] += 10000000.0;
+		}
+	}
+
+	return ret_val;
+}
+
+
+
+/*
+ * An alternative to Redfearn's formulas:  the transverse Mercator projection
+ * computed from Kruger's series in the third flattening, n, carried to sixth order.
+ * This is selected by setting tm_engine to TM_KRUGER.  (The drawmap -K option does this.)
+ *
+ *	Kruger, L., "Konforme Abbildung des Erdellipsoids in der Ebene",
+ *	Royal Prussian Geodetic Institute, New Series 52, 1912.
+ *
+ *	Karney, C.F.F., "Transverse Mercator with an accuracy of a few nanometers",
+ *	Journal of Geodesy 85(8), 2011, 475-485.
+ *
+ * Redfearn's formulas are series in the distance from the central meridian, and they
+ * degrade quickly as one moves away from it.  (They are fine within a UTM zone, but
+ * drawmap also uses them for GTOPO30 data, which can span many zones.)  Kruger's series
+ * are instead series in n, which is about 0.0017 for the ellipsoids we use, so six
+ * terms give errors of well under a millimeter out to several thousand kilometers from
+ * the central meridian.
+ *
+ * The method goes through the conformal latitude, phi', and the Gauss-Schreiber
+ * (spherical transverse Mercator) coordinates, xi' and eta':
+ *
+ *	n = f / (2 - f)
+ *	A = (a / (1 + n)) * (1 + n^2/4 + n^4/64 + n^6/256)		(the rectifying radius)
+ *
+ *	tan(phi') = tan(phi) * sqrt(1 + sigma^2) - sigma * sqrt(1 + tan^2(phi)),
+ *		where sigma = sinh(e * atanh(e * sin(phi)))
+ *	xi' = atan2(tan(phi'), cos(omega))
+ *	eta' = asinh(sin(omega) / sqrt(tan^2(phi') + cos^2(omega)))
+ *
+ *	xi  = xi'  + sum(j = 1 to 6) alpha[j] * sin(2*j*xi') * cosh(2*j*eta')
+ *	eta = eta' + sum(j = 1 to 6) alpha[j] * cos(2*j*xi') * sinh(2*j*eta')
+ *
+ *	y = k0 * A * xi,  x = k0 * A * eta
+ *
+ * The inverse runs the other way, with the beta coefficients in place of alpha (and the
+ * signs of the sums reversed).  That gives the conformal latitude, chi, and a third
+ * series, in the delta coefficients, takes chi back to phi with no iteration:
+ *
+ *	phi = chi + sum(j = 1 to 6) delta[j] * sin(2*j*chi)
+ *
+ * Both sums are the real and imaginary parts of sum(alpha[j] * sin(2 * j * zeta)), where
+ * zeta = xi' + i * eta', so we evaluate them together with Clenshaw's recurrence, in
+ * complex arithmetic.  That needs only one sin/cos of 2*xi' and one sinh/cosh of 2*eta',
+ * rather than twelve of each.
+ *
+ * kruger_init() computes n, A, e, and the alpha, beta, and delta coefficients for a datum.
+ * The coefficients, to sixth order in n, are from Karney's paper.
+ */
+void
+kruger_init(struct datum *datum)
+{
+	double f, n, n_2, n_3, n_4, n_5, n_6;
+
+	f = 1.0 / datum->f_inv;
+	n = f / (2.0 - f);
+	n_2 = n * n;
+	n_3 = n_2 * n;
+	n_4 = n_3 * n;
+	n_5 = n_4 * n;
+	n_6 = n_5 * n;
+
+	datum->kr_e = sqrt(f * (2.0 - f));
+	datum->kr_A = datum->a / (1.0 + n) * (1.0 + n_2 / 4.0 + n_4 / 64.0 + n_6 / 256.0);
+
+	datum->kr_alpha[0] = n / 2.0 - 2.0 * n_2 / 3.0 + 5.0 * n_3 / 16.0 + 41.0 * n_4 / 180.0 - 127.0 * n_5 / 288.0 + 7891.0 * n_6 / 37800.0;
+	datum->kr_alpha[1] = 13.0 * n_2 / 48.0 - 3.0 * n_3 / 5.0 + 557.0 * n_4 / 1440.0 + 281.0 * n_5 / 630.0 - 1983433.0 * n_6 / 1935360.0;
+	datum->kr_alpha[2] = 61.0 * n_3 / 240.0 - 103.0 * n_4 / 140.0 + 15061.0 * n_5 / 26880.0 + 167603.0 * n_6 / 181440.0;
+	datum->kr_alpha[3] = 49561.0 * n_4 / 161280.0 - 179.0 * n_5 / 168.0 + 6601661.0 * n_6 / 7257600.0;
+	datum->kr_alpha[4] = 34729.0 * n_5 / 80640.0 - 3418889.0 * n_6 / 1995840.0;
+	datum->kr_alpha[5] = 212378941.0 * n_6 / 319334400.0;
+
+	datum->kr_beta[0] = n / 2.0 - 2.0 * n_2 / 3.0 + 37.0 * n_3 / 96.0 - n_4 / 360.0 - 81.0 * n_5 / 512.0 + 96199.0 * n_6 / 604800.0;
+	datum->kr_beta[1] = n_2 / 48.0 + n_3 / 15.0 - 437.0 * n_4 / 1440.0 + 46.0 * n_5 / 105.0 - 1118711.0 * n_6 / 3870720.0;
+	datum->kr_beta[2] = 17.0 * n_3 / 480.0 - 37.0 * n_4 / 840.0 - 209.0 * n_5 / 4480.0 + 5569.0 * n_6 / 90720.0;
+	datum->kr_beta[3] = 4397.0 * n_4 / 161280.0 - 11.0 * n_5 / 504.0 - 830251.0 * n_6 / 7257600.0;
+	datum->kr_beta[4] = 4583.0 * n_5 / 161280.0 - 108847.0 * n_6 / 3991680.0;
+	datum->kr_beta[5] = 20648693.0 * n_6 / 638668800.0;
+
+	datum->kr_delta[0] = 2.0 * n - 2.0 * n_2 / 3.0 - 2.0 * n_3 + 116.0 * n_4 / 45.0 + 26.0 * n_5 / 45.0 - 2854.0 * n_6 / 675.0;
+	datum->kr_delta[1] = 7.0 * n_2 / 3.0 - 8.0 * n_3 / 5.0 - 227.0 * n_4 / 45.0 + 2704.0 * n_5 / 315.0 + 2323.0 * n_6 / 945.0;
+	datum->kr_delta[2] = 56.0 * n_3 / 15.0 - 136.0 * n_4 / 35.0 - 1262.0 * n_5 / 105.0 + 73814.0 * n_6 / 2835.0;
+	datum->kr_delta[3] = 4279.0 * n_4 / 630.0 - 332.0 * n_5 / 35.0 - 399572.0 * n_6 / 14175.0;
+	datum->kr_delta[4] = 4174.0 * n_5 / 315.0 - 144838.0 * n_6 / 6237.0;
+	datum->kr_delta[5] = 601676.0 * n_6 / 22275.0;
+
+	datum->kr_a = datum->a;
+	datum->kr_f_inv = datum->f_inv;
+}
+
+/*
+ * Compute sigma = sinh(e * atanh(e * sin(phi))), given e and sin(phi).
+ *
+ * Since e * sin(phi) is never bigger than e (about 0.082), and e * atanh(e * sin(phi))
+ * is never bigger than about 0.0067, short power series for atanh() and sinh()
+ * are good to full double precision, and much cheaper than the library functions.
+ */
+static double
+kruger_sigma(double e, double s_phi)
+{
+	double z, z_2, w, w_2;
+
+	z = e * s_phi;
+	z_2 = z * z;
+	w = e * z * (1.0 + z_2 * (1.0 / 3.0 + z_2 * (1.0 / 5.0 + z_2 * (1.0 / 7.0 + z_2 * (1.0 / 9.0 +
+		z_2 * (1.0 / 11.0 + z_2 * (1.0 / 13.0 + z_2 / 15.0)))))));
+	w_2 = w * w;
+
+	return w * (1.0 + w_2 * (1.0 / 6.0 + w_2 / 120.0));
+}
+
+/*
+ * Evaluate sum(j = 1 to 6) c[j - 1] * sin(2 * j * (xi + i * eta)) with Clenshaw's
+ * recurrence, and return the real part in *sum_xi and the imaginary part in *sum_eta.
+ * The caller supplies s2 = sin(2 * xi), c2 = cos(2 * xi), sh2 = sinh(2 * eta), and
+ * ch2 = cosh(2 * eta), since it can often get them more cheaply than by calling
+ * the library functions.
+ */
+static void
+kruger_sum(double *c, double s2, double c2, double sh2, double ch2, double *sum_xi, double *sum_eta)
+{
+	double ar, ai;		// 2 * cos(2 * zeta)
+	double b1r, b1i, b2r, b2i, tr, ti;
+	int32_t j;
+
+	ar = 2.0 * c2 * ch2;
+	ai = -2.0 * s2 * sh2;
+
+	b1r = 0.0;
+	b1i = 0.0;
+	b2r = 0.0;
+	b2i = 0.0;
+	for (j = 5; j >= 0; j--)  {
+		tr = ar * b1r - ai * b1i - b2r + c[j];
+		ti = ar * b1i + ai * b1r - b2i;
+		b2r = b1r;
+		b2i = b1i;
+		b1r = tr;
+		b1i = ti;
+	}
+
+	/* Multiply by sin(2 * zeta) = sin(2 * xi) * cosh(2 * eta) + i * cos(2 * xi) * sinh(2 * eta). */
+	*sum_xi = b1r * s2 * ch2 - b1i * c2 * sh2;
+	*sum_eta = b1r * c2 * sh2 + b1i * s2 * ch2;
+}
+
+/*
+ * Given latitude phi and longitude offset omega from the central meridian (both in radians),
+ * return the easting x and northing y, without the scale factor or the false easting.
+ *
+ * The only transcendental functions needed are sin/cos of phi and omega, one atan2(), and one log().
+ * Everything else (the sines and cosines of 2*xi', and the hyperbolic functions
+ * of 2*eta') follows algebraically from tan(phi') and omega.
+ */
+static void
+kruger_forward(struct datum *datum, double phi, double omega, double *x, double *y)
+{
+	double s_phi, c_phi, s_omega, c_omega;
+	double tau_p, sigma, r_2, r, xi_p, eta_p, ex, ex_2;
+	double sum_xi, sum_eta;
+
+	if ((datum->kr_a != datum->a) || (datum->kr_f_inv != datum->f_inv))  {
+		kruger_init(datum);
+	}
+
+	s_phi = sin(phi);
+	c_phi = cos(phi);
+	sigma = kruger_sigma(datum->kr_e, s_phi);
+	tau_p = (s_phi * sqrt(1.0 + sigma * sigma) - sigma) / c_phi;
+
+	s_omega = sin(omega);
+	c_omega = cos(omega);
+	r_2 = tau_p * tau_p + c_omega * c_omega;
+	r = sqrt(r_2);
+	xi_p = atan2(tau_p, c_omega);
+
+	/* exp(eta') = sinh(eta') + cosh(eta'), where sinh(eta') = sin(omega) / r */
+	ex = (s_omega + sqrt(s_omega * s_omega + r_2)) / r;
+	eta_p = log(ex);
+	ex_2 = ex * ex;
+
+	kruger_sum(datum->kr_alpha, 2.0 * tau_p * c_omega / r_2, (c_omega * c_omega - tau_p * tau_p) / r_2,
+		0.5 * (ex_2 - 1.0 / ex_2), 0.5 * (ex_2 + 1.0 / ex_2), &sum_xi, &sum_eta);
+
+	*x = datum->kr_A * (eta_p + sum_eta);
+	*y = datum->kr_A * (xi_p + sum_xi);
+}
+
+/*
+ * Given the easting x and northing y, without the scale factor or the false easting,
+ * return latitude phi and longitude offset omega from the central meridian (both in radians).
+ *
+ * Rather than solving for phi by iteration, we use one more series in n, which takes us
+ * from the conformal latitude, chi, to phi:
+ *
+ *	phi = chi + sum(j = 1 to 6) delta[j] * sin(2 * j * chi)
+ *
+ * (The delta coefficients are also from Karney's paper.)  sin(2 * chi) and cos(2 * chi)
+ * follow algebraically from tan(chi), so the only transcendental functions needed are
+ * sin/cos of 2*xi and xi', two exp(), one atan2(), and one atan().
+ */
+static void
+kruger_inverse(struct datum *datum, double x, double y, double *phi, double *omega)
+{
+	double xi, eta, xi_p, eta_p, s_xi_p, c_xi_p, s_eta_p, ex;
+	double tau_p, tau_p_2, s2, c2, a, b1, b2, t;
+	double sum_xi, sum_eta;
+	int32_t j;
+
+	if ((datum->kr_a != datum->a) || (datum->kr_f_inv != datum->f_inv))  {
+		kruger_init(datum);
+	}
+
+	xi = y / datum->kr_A;
+	eta = x / datum->kr_A;
+	ex = exp(2.0 * eta);
+	kruger_sum(datum->kr_beta, sin(2.0 * xi), cos(2.0 * xi), 0.5 * (ex - 1.0 / ex), 0.5 * (ex + 1.0 / ex), &sum_xi, &sum_eta);
+	xi_p = xi - sum_xi;
+	eta_p = eta - sum_eta;
+
+	ex = exp(eta_p);
+	s_eta_p = 0.5 * (ex - 1.0 / ex);
+	s_xi_p = sin(xi_p);
+	c_xi_p = cos(xi_p);
+	*omega = atan2(s_eta_p, c_xi_p);
+
+	/* tan(chi) */
+	tau_p = s_xi_p / sqrt(s_eta_p * s_eta_p + c_xi_p * c_xi_p);
+	tau_p_2 = tau_p * tau_p;
+	s2 = 2.0 * tau_p / (1.0 + tau_p_2);
+	c2 = (1.0 - tau_p_2) / (1.0 + tau_p_2);
+
+	/* Clenshaw's recurrence for the (real) delta series. */
+	a = 2.0 * c2;
+	b1 = 0.0;
+	b2 = 0.0;
+	for (j = 5; j >= 0; j--)  {
+		t = a * b1 - b2 + datum->kr_delta[j];
+		b2 = b1;
+		b1 = t;
+	}
+
+	*phi = atan(tau_p) + b1 * s2;
+}
+
+
+
+
 
 /*
  * Check the type of swabbing needed on this machine.